@@ -399,7 +399,7 @@ void CL_ShutdownCGame( void ) {
 		return;
 	}
 #ifdef USE_SQLITE3
-	sql_insert_null(sql, "client", "cgame_QVM", "CG_SHUTDOWN");
+	sql_insert_null(sql_logs[SQL_LOG_CGAME], SQL_EP_CLIENT, SQL_EP_CGAME_QVM, SQL_CGAME_CALL(CG_SHUTDOWN));
 #endif
 	VM_Call( cgvm, CG_SHUTDOWN );
 	VM_Free( cgvm );
@@ -412,6 +412,78 @@ static int	FloatAsInt( float f ) {
 	return fi.i;
 }
 
+/*
+====================
+CL_CgamePointContents
+
+This and the ones below are the traps a cgame frame makes for each entity
+and effect.  They're in cl_cgameSyscalls instead of the switch so compiled
+code can call them directly.
+====================
+*/
+static intptr_t CL_CgamePointContents( intptr_t *args ) {
+	return CM_PointContents( VMA(1), args[2] );
+}
+
+static intptr_t CL_CgameTransformedPointContents( intptr_t *args ) {
+	return CM_TransformedPointContents( VMA(1), args[2], VMA(3), VMA(4) );
+}
+
+static intptr_t CL_CgameBoxTrace( intptr_t *args ) {
+	CM_BoxTrace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qfalse );
+	return 0;
+}
+
+static intptr_t CL_CgameCapsuleTrace( intptr_t *args ) {
+	CM_BoxTrace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qtrue );
+	return 0;
+}
+
+static intptr_t CL_CgameTransformedBoxTrace( intptr_t *args ) {
+	CM_TransformedBoxTrace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], VMA(8), VMA(9), /*int capsule*/ qfalse );
+	return 0;
+}
+
+static intptr_t CL_CgameTransformedCapsuleTrace( intptr_t *args ) {
+	CM_TransformedBoxTrace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], VMA(8), VMA(9), /*int capsule*/ qtrue );
+	return 0;
+}
+
+static intptr_t CL_CgameAddRefEntityToScene( intptr_t *args ) {
+	re.AddRefEntityToScene( VMA(1) );
+	return 0;
+}
+
+static intptr_t CL_CgameAddPolyToScene( intptr_t *args ) {
+	re.AddPolyToScene( args[1], args[2], VMA(3), 1 );
+	return 0;
+}
+
+static intptr_t CL_CgameAddLightToScene( intptr_t *args ) {
+	re.AddLightToScene( VMA(1), VMF(2), VMF(3), VMF(4), VMF(5) );
+	return 0;
+}
+
+// by trap number, with the number of arguments each one reads
+static const vmSyscall_t cl_cgameSyscalls[] = {
+	[CG_CM_POINTCONTENTS]				= { CL_CgamePointContents, 2 },
+	[CG_CM_TRANSFORMEDPOINTCONTENTS]	= { CL_CgameTransformedPointContents, 4 },
+	[CG_CM_BOXTRACE]					= { CL_CgameBoxTrace, 7 },
+	[CG_CM_CAPSULETRACE]				= { CL_CgameCapsuleTrace, 7 },
+	[CG_CM_TRANSFORMEDBOXTRACE]			= { CL_CgameTransformedBoxTrace, 9 },
+	[CG_CM_TRANSFORMEDCAPSULETRACE]		= { CL_CgameTransformedCapsuleTrace, 9 },
+	[CG_R_ADDREFENTITYTOSCENE]			= { CL_CgameAddRefEntityToScene, 1 },
+	[CG_R_ADDPOLYTOSCENE]				= { CL_CgameAddPolyToScene, 3 },
+	[CG_R_ADDLIGHTTOSCENE]				= { CL_CgameAddLightToScene, 5 },
+
+	[CG_MEMSET]							= { VM_TrapMemset, 3, VM_INLINE_MEMSET },
+	[CG_MEMCPY]							= { VM_TrapMemcpy, 3, VM_INLINE_MEMCPY },
+	[CG_STRNCPY]						= { VM_TrapStrncpy, 3, VM_INLINE_STRNCPY },
+	[CG_SIN]							= { VM_TrapSin, 1, VM_INLINE_SIN },
+	[CG_COS]							= { VM_TrapCos, 1, VM_INLINE_COS },
+	[CG_SQRT]							= { VM_TrapSqrt, 1, VM_INLINE_SQRT }
+};
+
 /*
 ====================
 CL_CgameSystemCalls
@@ -420,118 +492,62 @@ The cgame module is making a system call
 ====================
 */
 intptr_t CL_CgameSystemCalls( intptr_t *args ) {
+	if ( args[0] >= 0 && args[0] < ARRAY_LEN( cl_cgameSyscalls ) && cl_cgameSyscalls[args[0]].func ) {
+		return cl_cgameSyscalls[args[0]].func( args );
+	}
+
 	switch( args[0] ) {
 	case CG_PRINT:
-#ifdef USE_SQLITE3
-		sql_insert_text(sql, "cgame_QVM", "client", "CG_PRINT", (const char *)VMA(1));
-#endif
 		Com_Printf( "%s", (const char*)VMA(1) );
 		return 0;
 	case CG_ERROR:
-#ifdef USE_SQLITE3
-		sql_insert_text(sql, "cgame_QVM", "client", "CG_ERROR", (const char *)VMA(1));
-#endif
 		Com_Error( ERR_DROP, "%s", (const char*)VMA(1) );
 		return 0;
 	case CG_MILLISECONDS:
-	{
-		int res = Sys_Milliseconds();
-#ifdef USE_SQLITE3
-		sql_insert_int(sql, "cgame_QVM", "client", "CG_MILLISECONDS", res);
-#endif
-		return res;
-	}
+		return Sys_Milliseconds();
 	case CG_CVAR_REGISTER:
-#ifdef USE_SQLITE3
-		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_CVAR_REGISTER", "%s %s %d", (const char *)VMA(2), (const char *)VMA(3), args[4]);
-#endif
 		Cvar_Register( VMA(1), VMA(2), VMA(3), args[4] ); 
 		return 0;
 	case CG_CVAR_UPDATE:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_CVAR_UPDATE");
-//#endif
 		Cvar_Update( VMA(1) );
 		return 0;
 	case CG_CVAR_SET:
-#ifdef USE_SQLITE3
-		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_CVAR_SET", "%s %s", (const char *)VMA(1), (const char *)VMA(2));
-#endif
 		Cvar_SetSafe( VMA(1), VMA(2) );
 		return 0;
 	case CG_CVAR_VARIABLESTRINGBUFFER:
 		Cvar_VariableStringBuffer( VMA(1), VMA(2), args[3] );
-#ifdef USE_SQLITE3
-		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_CVAR_VARIABLESTRINGBUFFER", "%s %s", (const char *)VMA(1), (const char *)VMA(2));
-#endif
 		return 0;
 	case CG_ARGC:
-#ifdef USE_SQLITE3
-		sql_insert_int(sql, "cgame_QVM", "client", "CG_ARGC", Cmd_Argc());
-#endif
 		return Cmd_Argc();
 	case CG_ARGV:
 		Cmd_ArgvBuffer( args[1], VMA(2), args[3] );
-#ifdef USE_SQLITE3
-		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_ARGV", "%d %s", args[1], (const char *)VMA(2));
-#endif
 		return 0;
 	case CG_ARGS:
 		Cmd_ArgsBuffer( VMA(1), args[2] );
-#ifdef USE_SQLITE3
-		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_ARGS", "%d %s", args[2], (const char *)VMA(1));
-#endif
 		return 0;
 	case CG_FS_FOPENFILE:
-//#ifdef USE_SQLITE3
-//		sql_insert_text(sql, "cgame_QVM", "client", "CG_FS_FOPENFILE", (const char *)VMA(1));
-//#endif
 		return FS_FOpenFileByMode( VMA(1), VMA(2), args[3] );
 	case CG_FS_READ:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_FS_READ", args[2]);
-//#endif
 		FS_Read2( VMA(1), args[2], args[3] );
 		return 0;
 	case CG_FS_WRITE:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_FS_WRITE", args[2]);
-//#endif
 		FS_Write( VMA(1), args[2], args[3] );
 		return 0;
 	case CG_FS_FCLOSEFILE:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_FS_FCLOSEFILE", args[1]);
-//#endif
 		FS_FCloseFile( args[1] );
 		return 0;
 	case CG_FS_SEEK:
-//#ifdef USE_SQLITE3
-//		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_FS_SEEK", "%d %d %d", args[1], args[2], args[3]);
-//#endif
 		return FS_Seek( args[1], args[2], args[3] );
 	case CG_SENDCONSOLECOMMAND:
-#ifdef USE_SQLITE3
-		sql_insert_text(sql, "cgame_QVM", "client", "CG_SENDCONSOLECOMMAND", (const char *)VMA(1));
-#endif
 		Cbuf_AddText( VMA(1) );
 		return 0;
 	case CG_ADDCOMMAND:
-#ifdef USE_SQLITE3
-		sql_insert_text(sql, "cgame_QVM", "client", "CG_ADDCOMMAND", (const char *)VMA(1));
-#endif
 		CL_AddCgameCommand( VMA(1) );
 		return 0;
 	case CG_REMOVECOMMAND:
-#ifdef USE_SQLITE3
-		sql_insert_text(sql, "cgame_QVM", "client", "CG_REMOVECOMMAND", (const char *)VMA(1));
-#endif
 		Cmd_RemoveCommandSafe( VMA(1) );
 		return 0;
 	case CG_SENDCLIENTCOMMAND:
-#ifdef USE_SQLITE3
-		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_SENDCLIENTCOMMAND", "%s %d", (const char *)VMA(1), 0);
-#endif
 		CL_AddReliableCommand(VMA(1), qfalse);
 		return 0;
 	case CG_UPDATESCREEN:
@@ -540,479 +556,171 @@ intptr_t CL_CgameSystemCalls( intptr_t *args ) {
 // We can't call Com_EventLoop here, a restart will crash and this _does_ happen
 // if there is a map change while we are downloading at pk3.
 // ZOID
-#ifdef USE_SQLITE3
-		sql_insert_null(sql, "cgame_QVM", "client", "CG_UPDATESCREEN");
-#endif
 		SCR_UpdateScreen();
 		return 0;
 	case CG_CM_LOADMAP:
-#ifdef USE_SQLITE3
-		sql_insert_text(sql, "cgame_QVM", "client", "CG_CM_LOADMAP", (const char *)VMA(1));
-#endif
 		CL_CM_LoadMap( VMA(1) );
 		return 0;
 	case CG_CM_NUMINLINEMODELS:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_CM_NUMINLINEMODELS", CM_NumInlineModels());
-//#endif
 		return CM_NumInlineModels();
 	case CG_CM_INLINEMODEL:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_CM_INLINEMODEL", args[1]);
-//#endif
 		return CM_InlineModel( args[1] );
 	case CG_CM_TEMPBOXMODEL:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_CM_TEMPBOXMODEL");
-//#endif
 		return CM_TempBoxModel( VMA(1), VMA(2), /*int capsule*/ qfalse );
 	case CG_CM_TEMPCAPSULEMODEL:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_CM_TEMPCAPSULEMODEL");
-//#endif
 		return CM_TempBoxModel( VMA(1), VMA(2), /*int capsule*/ qtrue );
-	case CG_CM_POINTCONTENTS:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_CM_POINTCONTENTS");
-//#endif
-		return CM_PointContents( VMA(1), args[2] );
-	case CG_CM_TRANSFORMEDPOINTCONTENTS:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_CM_TRANSFORMEDPOINTCONTENTS");
-//#endif
-		return CM_TransformedPointContents( VMA(1), args[2], VMA(3), VMA(4) );
-	case CG_CM_BOXTRACE:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_CM_BOXTRACE");
-//#endif
-		CM_BoxTrace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qfalse );
-		return 0;
-	case CG_CM_CAPSULETRACE:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_CM_CAPSULETRACE");
-//#endif
-		CM_BoxTrace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qtrue );
-		return 0;
-	case CG_CM_TRANSFORMEDBOXTRACE:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_CM_TRANSFORMEDBOXTRACE");
-//#endif
-		CM_TransformedBoxTrace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], VMA(8), VMA(9), /*int capsule*/ qfalse );
-		return 0;
-	case CG_CM_TRANSFORMEDCAPSULETRACE:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_CM_TRANSFORMEDCAPSULETRACE");
-//#endif
-		CM_TransformedBoxTrace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], VMA(8), VMA(9), /*int capsule*/ qtrue );
-		return 0;
 	case CG_CM_MARKFRAGMENTS:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_CM_MARKFRAGMENTS");
-//#endif
 		return re.MarkFragments( args[1], VMA(2), VMA(3), args[4], VMA(5), args[6], VMA(7) );
 	case CG_S_STARTSOUND:
-#ifdef USE_SQLITE3
-		sql_insert_int(sql, "cgame_QVM", "client", "CG_S_STARTSOUND", args[4]);
-#endif
 		S_StartSound( VMA(1), args[2], args[3], args[4] );
 		return 0;
 	case CG_S_STARTLOCALSOUND:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_S_STARTLOCALSOUND", args[1]);
-//#endif
 		S_StartLocalSound( args[1], args[2] );
 		return 0;
 	case CG_S_CLEARLOOPINGSOUNDS:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_S_CLEARLOOPINGSOUNDS", args[1]);
-//#endif
 		S_ClearLoopingSounds(args[1]);
 		return 0;
 	case CG_S_ADDLOOPINGSOUND:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_S_ADDLOOPINGSOUNDS", args[4]);
-//#endif
 		S_AddLoopingSound( args[1], VMA(2), VMA(3), args[4] );
 		return 0;
 	case CG_S_ADDREALLOOPINGSOUND:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_S_ADDREALLOOPINGSOUNDS", args[4]);
-//#endif
 		S_AddRealLoopingSound( args[1], VMA(2), VMA(3), args[4] );
 		return 0;
 	case CG_S_STOPLOOPINGSOUND:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_S_STOPLOOPINGSOUND", args[1]);
-//#endif
 		S_StopLoopingSound( args[1] );
 		return 0;
 	case CG_S_UPDATEENTITYPOSITION:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_S_UPDATEENTITYPOSITION", args[1]);
-//#endif
 		S_UpdateEntityPosition( args[1], VMA(2) );
 		return 0;
 	case CG_S_RESPATIALIZE:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_S_RESPATIALIZE", args[1]);
-//#endif
 		S_Respatialize( args[1], VMA(2), VMA(3), args[4] );
 		return 0;
 	case CG_S_REGISTERSOUND:
-#ifdef USE_SQLITE3
-		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_S_REGISTERSOUND", "%s %d", (const char *)VMA(1), args[2]);
-#endif
 		return S_RegisterSound( VMA(1), args[2] );
 	case CG_S_STARTBACKGROUNDTRACK:
-//#ifdef USE_SQLITE3
-//		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_S_STARTBACKGROUNDTRACK", "%s %s", (const char *)VMA(1), (const char *)VMA(2));
-//#endif
 		S_StartBackgroundTrack( VMA(1), VMA(2) );
 		return 0;
 	case CG_R_LOADWORLDMAP:
-#ifdef USE_SQLITE3
-		sql_insert_text(sql, "cgame_QVM", "client", "CG_R_LOADWORLDMAP", (const char *)VMA(1));
-#endif
 		re.LoadWorld( VMA(1) );
 		return 0; 
 	case CG_R_REGISTERMODEL:
-//#ifdef USE_SQLITE3
-//		sql_insert_text(sql, "cgame_QVM", "client", "CG_R_REGISTERMODEL", (const char *)VMA(1));
-//#endif
 		return re.RegisterModel( VMA(1) );
 	case CG_R_REGISTERSKIN:
-//#ifdef USE_SQLITE3
-//		sql_insert_text(sql, "cgame_QVM", "client", "CG_R_REGISTERSKIN", (const char *)VMA(1));
-//#endif
 		return re.RegisterSkin( VMA(1) );
 	case CG_R_REGISTERSHADER:
-//#ifdef USE_SQLITE3
-//		sql_insert_text(sql, "cgame_QVM", "client", "CG_R_REGISTERSHADER", (const char *)VMA(1));
-//#endif
 		return re.RegisterShader( VMA(1) );
 	case CG_R_REGISTERSHADERNOMIP:
-//#ifdef USE_SQLITE3
-//		sql_insert_text(sql, "cgame_QVM", "client", "CG_R_REGISTERSHADERNOMIP", (const char *)VMA(1));
-//#endif
 		return re.RegisterShaderNoMip( VMA(1) );
 	case CG_R_REGISTERFONT:
-//#ifdef USE_SQLITE3
-//		sql_insert_text(sql, "cgame_QVM", "client", "CG_R_REGISTERFONT", (const char *)VMA(1));
-//#endif
 		re.RegisterFont( VMA(1), args[2], VMA(3));
 		return 0;
 	case CG_R_CLEARSCENE:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_R_CLEARSCENE");
-//#endif
 		re.ClearScene();
 		return 0;
-	case CG_R_ADDREFENTITYTOSCENE:
-//#ifdef USE_SQLITE3
-//		sql_insert_text(sql, "cgame_QVM", "client", "CG_R_ADDREFENTITYTOSCENE", (const char *)VMA(1));
-//#endif
-		re.AddRefEntityToScene( VMA(1) );
-		return 0;
-	case CG_R_ADDPOLYTOSCENE:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_R_ADDPOLYTOSCENE", args[1]);
-//#endif
-		re.AddPolyToScene( args[1], args[2], VMA(3), 1 );
-		return 0;
 	case CG_R_ADDPOLYSTOSCENE:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_R_ADDPOLYSTOSCENE", args[1]);
-//#endif
 		re.AddPolyToScene( args[1], args[2], VMA(3), args[4] );
 		return 0;
 	case CG_R_LIGHTFORPOINT:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_R_LIGHTFORPOINT");
-//#endif
 		return re.LightForPoint( VMA(1), VMA(2), VMA(3), VMA(4) );
-	case CG_R_ADDLIGHTTOSCENE:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_R_ADDLIGHTTOSCENE");
-//#endif
-		re.AddLightToScene( VMA(1), VMF(2), VMF(3), VMF(4), VMF(5) );
-		return 0;
 	case CG_R_ADDADDITIVELIGHTTOSCENE:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_R_ADDADDITIVELIGHTTOSCENE");
-//#endif
 		re.AddAdditiveLightToScene( VMA(1), VMF(2), VMF(3), VMF(4), VMF(5) );
 		return 0;
 	case CG_R_RENDERSCENE:
-//#ifdef USE_SQLITE3
-//		sql_insert_text(sql, "cgame_QVM", "client", "CG_R_RENDERSCENE", (const char *)VMA(1));
-//#endif
 		re.RenderScene( VMA(1) );
 		return 0;
 	case CG_R_SETCOLOR:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_R_SETCOLOR");
-//#endif
 		re.SetColor( VMA(1) );
 		return 0;
 	case CG_R_DRAWSTRETCHPIC:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_R_DRAWSTRETCHPIC");
-//#endif
 		re.DrawStretchPic( VMF(1), VMF(2), VMF(3), VMF(4), VMF(5), VMF(6), VMF(7), VMF(8), args[9] );
 		return 0;
 	case CG_R_MODELBOUNDS:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_R_MODELBOUNDS");
-//#endif
 		re.ModelBounds( args[1], VMA(2), VMA(3) );
 		return 0;
 	case CG_R_LERPTAG:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_R_LERPTAG");
-//#endif
 		return re.LerpTag( VMA(1), args[2], args[3], args[4], VMF(5), VMA(6) );
 	case CG_GETGLCONFIG:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_GETGLCONFIG");
-//#endif
 		CL_GetGlconfig( VMA(1) );
 		return 0;
 	case CG_GETGAMESTATE:
 		CL_GetGameState( VMA(1) );
-#ifdef USE_SQLITE3
-		sql_insert_blob(sql, "cgame_QVM", "client", "CG_GETGAMESTATE", (gameState_t *)VMA(1), sizeof(gameState_t));
-#endif
 		return 0;
 	case CG_GETCURRENTSNAPSHOTNUMBER:
 		CL_GetCurrentSnapshotNumber( VMA(1), VMA(2) );
-#ifdef USE_SQLITE3
-		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_GETCURRENTSNAPSHOTNUMBER", "%d %d", (*(int *)VMA(1)), (*(int *)VMA(2)));
-#endif
 		return 0;
 	case CG_GETSNAPSHOT:
-	{
-		qboolean res = CL_GetSnapshot( args[1], VMA(2) );
-#ifdef USE_SQLITE3
-		if (res) {
-			sql_insert_blob(sql, "cgame_QVM", "client", "CG_GETSNAPSHOT", (snapshot_t *)VMA(2), sizeof(snapshot_t));
-		} else {
-			sql_insert_null(sql, "cgame_QVM", "client", "CG_GETSNAPSHOT");
-		}
-#endif
-		return res;
-	}
+		return CL_GetSnapshot( args[1], VMA(2) );
 	case CG_GETSERVERCOMMAND:
-#ifdef USE_SQLITE3
-		sql_insert_text(sql, "cgame_QVM", "client", "CG_GETSERVERCOMMAND", clc.serverCommands[ args[1] % ( MAX_RELIABLE_COMMANDS - 1) ]);
-#endif
 		return CL_GetServerCommand( args[1] );
 	case CG_GETCURRENTCMDNUMBER:
-#ifdef USE_SQLITE3
-		sql_insert_int(sql, "cgame_QVM", "client", "CG_GETCURRENTCMDNUMBER", CL_GetCurrentCmdNumber());
-#endif
 		return CL_GetCurrentCmdNumber();
 	case CG_GETUSERCMD:
-	{
-		qboolean res = CL_GetUserCmd( args[1], VMA(2) );
-#ifdef USE_SQLITE3
-		if (res) {
-			sql_insert_blob(sql, "cgame_QVM", "client", "CG_GETUSERCMD", (usercmd_t *)VMA(2), sizeof(usercmd_t));
-		} else {
-			sql_insert_null(sql, "cgame_QVM", "client", "CG_GETUSERCMD");
-		}
-#endif
-		return res;
-	}
+		return CL_GetUserCmd( args[1], VMA(2) );
 	case CG_SETUSERCMDVALUE:
-#ifdef USE_SQLITE3
-		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_GETUSERCMD", "%d %f", args[1], VMF(2));
-#endif
 		CL_SetUserCmdValue( args[1], VMF(2) );
 		return 0;
 	case CG_MEMORY_REMAINING:
-	{
-		int res = Hunk_MemoryRemaining();
-#ifdef USE_SQLITE3
-		sql_insert_int(sql, "cgame_QVM", "client", "CG_MEMORY_REMAINING", res);
-#endif
-		return res;
-	}
+		return Hunk_MemoryRemaining();
 	case CG_KEY_ISDOWN:
-	{
-		int res = Key_IsDown( args[1] );
-//#ifdef USE_SQLITE3
-//		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_KEY_ISDOWN", "%d %d", args[1], res);
-//#endif
-		return res;
-	}
+		return Key_IsDown( args[1] );
 	case CG_KEY_GETCATCHER:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_KEY_GETCATCHER", Key_GetCatcher());
-//#endif
 		return Key_GetCatcher();
 	case CG_KEY_SETCATCHER:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_KEY_SETCATCHER",  args[1] | ( Key_GetCatcher( ) & KEYCATCH_CONSOLE ) );
-//#endif
 		// Don't allow the cgame module to close the console
 		Key_SetCatcher( args[1] | ( Key_GetCatcher( ) & KEYCATCH_CONSOLE ) );
 		return 0;
 	case CG_KEY_GETKEY:
-	{
-		int res = Key_GetKey( VMA(1) );
-//#ifdef USE_SQLITE3
-//		sql_insert_text(sql, "cgame_QVM", "client", "CG_KEY_GETKEY", (const char *)VMA(1), res);
-//#endif
-		return res;
-	}
+		return Key_GetKey( VMA(1) );
 
-	case CG_MEMSET:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_MEMSET", args[3]);
-//#endif
-		Com_Memset( VMA(1), args[2], args[3] );
-		return 0;
-	case CG_MEMCPY:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_MEMCPY", args[3]);
-//#endif
-		Com_Memcpy( VMA(1), VMA(2), args[3] );
-		return 0;
-	case CG_STRNCPY:
-	{
-#ifdef USE_SQLITE3
-		char *buf;
-		if ((buf = malloc(args[3] + 1)) == NULL) {
-			Com_Error(ERR_DROP, "Failed to malloc");
-		}
-		Q_strncpyz(buf, (const char *)VMA(2), args[3] + 1);
-		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_STRNCPY", "%d %s", args[1], buf);
-		free(buf);
-#endif
-		strncpy( VMA(1), VMA(2), args[3] );
-		return args[1];
-	}
-	case CG_SIN:
-//#ifdef USE_SQLITE3
-//		sql_insert_double(sql, "cgame_QVM", "client", "CG_SIN", VMF(1));
-//#endif
-		return FloatAsInt( sin( VMF(1) ) );
-	case CG_COS:
-//#ifdef USE_SQLITE3
-//		sql_insert_double(sql, "cgame_QVM", "client", "CG_COS", VMF(1));
-//#endif
-		return FloatAsInt( cos( VMF(1) ) );
 	case CG_ATAN2:
-//#ifdef USE_SQLITE3
-//		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_ATAN2", "%f %f", VMF(1), VMF(2));
-//#endif
 		return FloatAsInt( atan2( VMF(1), VMF(2) ) );
-	case CG_SQRT:
-//#ifdef USE_SQLITE3
-//		sql_insert_double(sql, "cgame_QVM", "client", "CG_SQRT", VMF(1));
-//#endif
-		return FloatAsInt( sqrt( VMF(1) ) );
 	case CG_FLOOR:
-//#ifdef USE_SQLITE3
-//		sql_insert_double(sql, "cgame_QVM", "client", "CG_FLOOR", VMF(1));
-//#endif
 		return FloatAsInt( floor( VMF(1) ) );
 	case CG_CEIL:
-//#ifdef USE_SQLITE3
-//		sql_insert_double(sql, "cgame_QVM", "client", "CG_CEIL", VMF(1));
-//#endif
 		return FloatAsInt( ceil( VMF(1) ) );
 	case CG_ACOS:
-//#ifdef USE_SQLITE3
-//		sql_insert_double(sql, "cgame_QVM", "client", "CG_ACOS", VMF(1));
-//#endif
 		return FloatAsInt( Q_acos( VMF(1) ) );
 
 	case CG_PC_ADD_GLOBAL_DEFINE:
-//#ifdef USE_SQLITE3
-//		sql_insert_text(sql, "cgame_QVM", "client", "CG_PC_ADD_GLOBAL_DEFINE", (const char *)VMA(1));
-//#endif
 		return botlib_export->PC_AddGlobalDefine( VMA(1) );
 	case CG_PC_LOAD_SOURCE:
-//#ifdef USE_SQLITE3
-//		sql_insert_text(sql, "cgame_QVM", "client", "CG_PC_LOAD_SOURCE", (const char *)VMA(1));
-//#endif
 		return botlib_export->PC_LoadSourceHandle( VMA(1) );
 	case CG_PC_FREE_SOURCE:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_PC_FREE_SOURCE", args[1]);
-//#endif
 		return botlib_export->PC_FreeSourceHandle( args[1] );
 	case CG_PC_READ_TOKEN:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_PC_READ_TOKEN", args[1]);
-//#endif
 		return botlib_export->PC_ReadTokenHandle( args[1], VMA(2) );
 	case CG_PC_SOURCE_FILE_AND_LINE:
-//#ifdef USE_SQLITE3
-//		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_PC_SOURCE_FILE_AND_LINE", "%d %s %s", args[1], (const char *)VMA(2), (const char *)VMA(3));
-//#endif
 		return botlib_export->PC_SourceFileAndLine( args[1], VMA(2), VMA(3) );
 
 	case CG_S_STOPBACKGROUNDTRACK:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_S_STOPBACKGROUNDTRACK");
-//#endif
 		S_StopBackgroundTrack();
 		return 0;
 
 	case CG_REAL_TIME:
-	{
-		int res = Com_RealTime( VMA(1) );
-#ifdef USE_SQLITE3
-		sql_insert_int(sql, "cgame_QVM", "client", "CG_REAL_TIME", res);
-#endif
-		return res;
-	}
+		return Com_RealTime( VMA(1) );
 
 	case CG_SNAPVECTOR:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_SNAPVECTOR");
-//#endif
 		Q_SnapVector(VMA(1));
 		return 0;
 
 	case CG_CIN_PLAYCINEMATIC:
-//#ifdef USE_SQLITE3
-//		sql_insert_text(sql, "cgame_QVM", "client", "CG_CIN_PLAYCINEMATIC", (const char *)VMA(1));
-//#endif
 		return CIN_PlayCinematic(VMA(1), args[2], args[3], args[4], args[5], args[6]);
 
 	case CG_CIN_STOPCINEMATIC:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_CIN_STOPCINEMATIC", args[1]);
-//#endif
 		return CIN_StopCinematic(args[1]);
 
 	case CG_CIN_RUNCINEMATIC:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_CIN_RUNCINEMATIC", args[1]);
-//#endif
 		return CIN_RunCinematic(args[1]);
 
 	case CG_CIN_DRAWCINEMATIC:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_CIN_DRAWCINEMATIC", args[1]);
-//#endif
 		CIN_DrawCinematic(args[1]);
 		return 0;
 
 	case CG_CIN_SETEXTENTS:
-//#ifdef USE_SQLITE3
-//		sql_insert_int(sql, "cgame_QVM", "client", "CG_CIN_SETEXTENTS", args[1]);
-//#endif
 		CIN_SetExtents(args[1], args[2], args[3], args[4], args[5]);
 		return 0;
 
 	case CG_R_REMAP_SHADER:
-//#ifdef USE_SQLITE3
-//		sql_insert_var_text(sql, "cgame_QVM", "client", "CG_R_REMAP_SHADER", "%s %s %s", (const char *)VMA(1), (const char *)VMA(2), (const char *)VMA(3));
-//#endif
 		re.RemapShader( VMA(1), VMA(2), VMA(3) );
 		return 0;
 
@@ -1028,14 +736,8 @@ intptr_t CL_CgameSystemCalls( intptr_t *args ) {
 		return getCameraInfo(args[1], VMA(2), VMA(3));
 */
 	case CG_GET_ENTITY_TOKEN:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_GET_ENTITY_TOKEN");
-//#endif
 		return re.GetEntityToken( VMA(1), args[2] );
 	case CG_R_INPVS:
-//#ifdef USE_SQLITE3
-//		sql_insert_null(sql, "cgame_QVM", "client", "CG_INPVS");
-//#endif
 		return re.inPVS( VMA(1), VMA(2) );
 
 	default:
@@ -1045,6 +747,37 @@ intptr_t CL_CgameSystemCalls( intptr_t *args ) {
 	return 0;
 }
 
+/*
+====================
+CL_CgameSystemCallsLogged
+
+CL_CgameSystemCalls with each trap logged as its entry in sql_names.c
+describes and timed for the sql_trapstats histograms
+====================
+*/
+static intptr_t CL_CgameSystemCallsLogged( intptr_t *args ) {
+#ifdef USE_SQLITE3
+	return sql_syscall( SQL_NS_CGAME_IMPORT, CL_CgameSystemCalls, args );
+#else
+	return CL_CgameSystemCalls( args );
+#endif
+}
+
+/*
+====================
+CL_CgameTrapsLogged
+
+cl_cgameSyscalls can't be called directly while a trap is logged or timed
+====================
+*/
+static qboolean CL_CgameTrapsLogged( int trap ) {
+#ifdef USE_SQLITE3
+	return sql_syscall_logged( SQL_NS_CGAME_IMPORT, trap );
+#else
+	return qfalse;
+#endif
+}
+
 
 /*
 ====================
@@ -1078,7 +811,8 @@ void CL_InitCGame( void ) {
 			interpret = VMI_COMPILED;
 	}
 
-	cgvm = VM_Create( "cgame", CL_CgameSystemCalls, interpret );
+	VM_RegisterSyscalls( CL_CgameSystemCallsLogged, cl_cgameSyscalls, ARRAY_LEN( cl_cgameSyscalls ), CL_CgameTrapsLogged );
+	cgvm = VM_Create( "cgame", CL_CgameSystemCallsLogged, interpret );
 	if ( !cgvm ) {
 		Com_Error( ERR_DROP, "VM_Create on cgame failed" );
 	}
@@ -1088,7 +822,7 @@ void CL_InitCGame( void ) {
 	// use the lastExecutedServerCommand instead of the serverCommandSequence
 	// otherwise server commands sent just before a gamestate are dropped
 #ifdef USE_SQLITE3
-	sql_insert_var_text(sql, "client", "cgame_QVM", "CG_INIT", "%d %d %d",  clc.serverMessageSequence, clc.lastExecutedServerCommand, clc.clientNum );
+	sql_insert_var_text(sql_logs[SQL_LOG_CGAME], SQL_EP_CLIENT, SQL_EP_CGAME_QVM, SQL_CGAME_CALL(CG_INIT), "%d %d %d",  clc.serverMessageSequence, clc.lastExecutedServerCommand, clc.clientNum );
 #endif
 	VM_Call( cgvm, CG_INIT, clc.serverMessageSequence, clc.lastExecutedServerCommand, clc.clientNum );
 
@@ -1131,7 +865,7 @@ qboolean CL_GameCommand( void ) {
 	}
 
 #ifdef USE_SQLITE3
-	sql_insert_null(sql, "client", "cgame_QVM", "CG_CONSOLE_COMMAND");
+	sql_insert_null(sql_logs[SQL_LOG_CGAME], SQL_EP_CLIENT, SQL_EP_CGAME_QVM, SQL_CGAME_CALL(CG_CONSOLE_COMMAND));
 #endif
 	return VM_Call( cgvm, CG_CONSOLE_COMMAND );
 }
@@ -1145,7 +879,7 @@ CL_CGameRendering
 */
 void CL_CGameRendering( stereoFrame_t stereo ) {
 #ifdef USE_SQLITE3
-	sql_insert_var_text(sql, "client", "cgame_QVM", "CG_DRAW_ACTIVE_FRAME", "%d %d %d", cl.serverTime, stereo, clc.demoplaying );
+	sql_insert_var_text(sql_logs[SQL_LOG_CGAME], SQL_EP_CLIENT, SQL_EP_CGAME_QVM, SQL_CGAME_CALL(CG_DRAW_ACTIVE_FRAME), "%d %d %d", cl.serverTime, stereo, clc.demoplaying );
 #endif
 	VM_Call( cgvm, CG_DRAW_ACTIVE_FRAME, cl.serverTime, stereo, clc.demoplaying );
 	VM_Debug( 0 );
@@ -3406,10 +3406,13 @@ void CL_Init( void ) {
 	Com_Printf( "----- Client Initialization -----\n" );
 
 #ifdef USE_SQLITE3
-	// Start the logger before CGame so we capture all messages
-	if (sql_init(&sql, "client_qvm_log.db") < 0) {
+	// Start the loggers before CGame so we capture all messages
+	if (sql_open_log(SQL_LOG_CGAME) < 0 || sql_open_log(SQL_LOG_UI) < 0 ||
+	    sql_open_log(SQL_LOG_NETCHAN) < 0) {
 		Com_Error(ERR_DROP, "Failed to initialize the database");
 	}
+	sql_context.clientTime = &cl.serverTime;
+	sql_context.localClient = &clc.clientNum;
 #endif
 
 	// initialize the CGame
@@ -3687,7 +3690,10 @@ void CL_Shutdown(char *finalmsg, qboolean disconnect, qboolean quit)
 	Key_SetCatcher( 0 );
 
 #ifdef USE_SQLITE3
-	if (sql_close(&sql) < 0) {
+	sql_context.clientTime = NULL;
+	sql_context.localClient = NULL;
+	if (sql_close_log(SQL_LOG_NETCHAN) < 0 || sql_close_log(SQL_LOG_UI) < 0 ||
+	    sql_close_log(SQL_LOG_CGAME) < 0) {
 		Com_Error(ERR_DROP, "Failed to close the database\n");
 	}
 	Com_Printf("SQLite3 database shut down.\n");
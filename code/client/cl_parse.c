@@ -323,7 +323,7 @@ void CL_ParseSnapshot( msg_t *msg ) {
 	cl.newSnapshots = qtrue;
 
 #ifdef USE_SQLITE3
-	sql_insert_blob(sql, "server", "client", "snapshot", &newSnap, sizeof(newSnap));
+	sql_insert_delta(sql_logs[SQL_LOG_NETCHAN], SQL_EP_SERVER, SQL_EP_CLIENT, SQL_ENGINE(SQL_MSG_SNAPSHOT), &newSnap, sizeof(newSnap));
 #endif
 }
 
@@ -405,7 +405,7 @@ void CL_SystemInfoChanged( void ) {
 		// ehw!
 		if (!Q_stricmp(key, "fs_game"))
 		{
-			if(FS_CheckDirTraversal(value))
+			if(FS_InvalidGameDir(value))
 			{
 				Com_Printf(S_COLOR_YELLOW "WARNING: Server sent invalid fs_game value %s\n", value);
 				continue;
@@ -558,7 +558,7 @@ void CL_ParseGamestate( msg_t *msg ) {
 	Cvar_Set( "cl_paused", "0" );
 
 #ifdef USE_SQLITE3
-	sql_insert_blob(sql, "server", "client", "gamestate", &cl.gameState, sizeof(cl.gameState));
+	sql_insert_delta(sql_logs[SQL_LOG_NETCHAN], SQL_EP_SERVER, SQL_EP_CLIENT, SQL_ENGINE(SQL_MSG_GAMESTATE), &cl.gameState, sizeof(cl.gameState));
 #endif
 }
 
@@ -867,7 +867,7 @@ void CL_ParseCommandString( msg_t *msg ) {
 	Q_strncpyz( clc.serverCommands[ index ], s, sizeof( clc.serverCommands[ index ] ) );
 
 #ifdef USE_SQLITE3
-	sql_insert_text(sql, "server", "client", "commandString", s);
+	sql_insert_text(sql_logs[SQL_LOG_NETCHAN], SQL_EP_SERVER, SQL_EP_CLIENT, SQL_ENGINE(SQL_MSG_COMMANDSTRING), s);
 #endif
 }
 
@@ -478,7 +478,7 @@ void SCR_DrawScreenField( stereoFrame_t stereoFrame ) {
 	re.BeginFrame( stereoFrame );
 
 #ifdef USE_SQLITE3
-	sql_insert_null(sql, "client", "ui_QVM", "UI_IS_FULLSCREEN");
+	sql_insert_null(sql_logs[SQL_LOG_UI], SQL_EP_CLIENT, SQL_EP_UI_QVM, SQL_UI_CALL(UI_IS_FULLSCREEN));
 #endif
 	uiFullscreen = (uivm && VM_Call( uivm, UI_IS_FULLSCREEN ));
 
@@ -506,7 +506,7 @@ void SCR_DrawScreenField( stereoFrame_t stereoFrame ) {
 			// force menu up
 			S_StopAllSounds();
 #ifdef USE_SQLITE3
-			sql_insert_text(sql, "client", "ui_QVM", "UI_SET_ACTIVE_MENU", "UIMENU_MAIN");
+			sql_insert_text(sql_logs[SQL_LOG_UI], SQL_EP_CLIENT, SQL_EP_UI_QVM, SQL_UI_CALL(UI_SET_ACTIVE_MENU), "UIMENU_MAIN");
 #endif
 			VM_Call( uivm, UI_SET_ACTIVE_MENU, UIMENU_MAIN );
 			break;
@@ -516,11 +516,11 @@ void SCR_DrawScreenField( stereoFrame_t stereoFrame ) {
 			// connecting clients will only show the connection dialog
 			// refresh to update the time
 #ifdef USE_SQLITE3
-			sql_insert_int(sql, "client", "ui_QVM", "UI_REFRESH", cls.realtime);
+			sql_insert_int(sql_logs[SQL_LOG_UI], SQL_EP_CLIENT, SQL_EP_UI_QVM, SQL_UI_CALL(UI_REFRESH), cls.realtime);
 #endif
 			VM_Call( uivm, UI_REFRESH, cls.realtime );
 #ifdef USE_SQLITE3
-			sql_insert_int(sql, "client", "ui_QVM", "UI_DRAW_CONNECT_SCREEN", 0);
+			sql_insert_int(sql_logs[SQL_LOG_UI], SQL_EP_CLIENT, SQL_EP_UI_QVM, SQL_UI_CALL(UI_DRAW_CONNECT_SCREEN), 0);
 #endif
 			VM_Call( uivm, UI_DRAW_CONNECT_SCREEN, qfalse );
 			break;
@@ -533,11 +533,11 @@ void SCR_DrawScreenField( stereoFrame_t stereoFrame ) {
 			// flash away too briefly on local or lan games
 			// refresh to update the time
 #ifdef USE_SQLITE3
-			sql_insert_int(sql, "client", "ui_QVM", "UI_REFRESH", cls.realtime);
+			sql_insert_int(sql_logs[SQL_LOG_UI], SQL_EP_CLIENT, SQL_EP_UI_QVM, SQL_UI_CALL(UI_REFRESH), cls.realtime);
 #endif
 			VM_Call( uivm, UI_REFRESH, cls.realtime );
 #ifdef USE_SQLITE3
-			sql_insert_int(sql, "client", "ui_QVM", "UI_DRAW_CONNECT_SCREEN", cls.realtime);
+			sql_insert_int(sql_logs[SQL_LOG_UI], SQL_EP_CLIENT, SQL_EP_UI_QVM, SQL_UI_CALL(UI_DRAW_CONNECT_SCREEN), cls.realtime);
 #endif
 			VM_Call( uivm, UI_DRAW_CONNECT_SCREEN, qtrue );
 			break;
@@ -555,7 +555,7 @@ void SCR_DrawScreenField( stereoFrame_t stereoFrame ) {
 	// the menu draws next
 	if ( Key_GetCatcher( ) & KEYCATCH_UI && uivm ) {
 #ifdef USE_SQLITE3
-		sql_insert_int(sql, "client", "ui_QVM", "UI_REFRESH", cls.realtime);
+		sql_insert_int(sql_logs[SQL_LOG_UI], SQL_EP_CLIENT, SQL_EP_UI_QVM, SQL_UI_CALL(UI_REFRESH), cls.realtime);
 #endif
 		VM_Call( uivm, UI_REFRESH, cls.realtime );
 	}
@@ -306,6 +306,9 @@ void QDECL Com_Error( int code, const char *fmt, ... ) {
 		longjmp (abortframe, -1);
 	} else if (code == ERR_DROP) {
 		Com_Printf ("********************\nERROR: %s\n********************\n", com_errorMessage);
+#ifdef USE_SQLITE3
+		sql_replay_abort();
+#endif
 		VM_Forced_Unload_Start();
 		SV_Shutdown (va("Server crashed: %s",  com_errorMessage));
 		CL_Disconnect( qtrue );
@@ -2415,6 +2418,12 @@ Expose possibility to change current running mod to the user
 
 void Com_GameRestart_f(void)
 {
+	if(FS_InvalidGameDir(Cmd_Argv(1)))
+	{
+		Com_Printf("%s is not a valid game directory\n", Cmd_Argv(1));
+		return;
+	}
+
 	if(!FS_FilenameCompare(Cmd_Argv(1), com_basegame->string))
 	{
 		// This is the standard base game. Servers and clients should
@@ -2703,6 +2712,9 @@ void Com_Init( char *commandLine ) {
 	Cmd_AddCommand ("writeconfig", Com_WriteConfig_f );
 	Cmd_SetCommandCompletionFunc( "writeconfig", Cmd_CompleteCfgName );
 	Cmd_AddCommand("game_restart", Com_GameRestart_f);
+#ifdef USE_SQLITE3
+	Cmd_AddCommand("sql_replay", sql_replay_f);
+#endif
 
 	Com_ExecuteCfg();
 
@@ -3207,6 +3219,11 @@ void Com_Frame( void ) {
 
 	NET_FlushPacketQueue();
 
+#ifdef USE_SQLITE3
+	// commit the QVM logs between frames
+	sql_frame();
+#endif
+
 	//
 	// report timing information
 	//
@@ -550,17 +550,25 @@ qboolean FS_CreatePath (char *OSPath) {
 =================
 FS_CheckFilenameIsNotExecutable
 
-ERR_FATAL if trying to maniuplate a file with the platform library extension
+ERR_FATAL if trying to maniuplate a file with the platform library extension,
+or the extension of the code the compile cache runs, see FS_VMCacheFOpenFile
 =================
  */
 static void FS_CheckFilenameIsNotExecutable( const char *filename,
 		const char *function )
 {
+	const char *ext = NULL;
+
 	// Check if the filename ends with the library extension
 	if(COM_CompareExtension(filename, DLL_EXT))
+		ext = DLL_EXT;
+	else if(COM_CompareExtension(filename, VM_CACHE_EXT))
+		ext = VM_CACHE_EXT;
+
+	if(ext)
 	{
 		Com_Error( ERR_FATAL, "%s: Not allowed to manipulate '%s' due "
-			"to %s extension", function, filename, DLL_EXT );
+			"to %s extension", function, filename, ext );
 	}
 }
 
@@ -755,6 +763,55 @@ long FS_SV_FOpenFileRead(const char *filename, fileHandle_t *fp)
 }
 
 
+/*
+===========
+FS_VMCacheFOpenFile
+
+Open a file of the compile cache for FS_READ or FS_WRITE.  It's only ever
+in the home path's VM_CACHE_DIR, and this is the only way to write the
+VM_CACHE_EXT files there.  Returns the length, or -1 if it can't be opened
+===========
+*/
+long FS_VMCacheFOpenFile( const char *filename, fileHandle_t *fp, fsMode_t mode ) {
+	char *ospath;
+	fileHandle_t	f;
+
+	*fp = 0;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+
+	if ( Q_stricmpn( filename, VM_CACHE_DIR "/", strlen( VM_CACHE_DIR "/" ) ) || FS_CheckDirTraversal( filename ) ) {
+		Com_Error( ERR_FATAL, "FS_VMCacheFOpenFile: %s isn't in " VM_CACHE_DIR, filename );
+	}
+
+	ospath = FS_BuildOSPath( fs_homepath->string, filename, "" );
+	ospath[strlen(ospath)-1] = '\0';
+
+	if ( fs_debug->integer ) {
+		Com_Printf( "FS_VMCacheFOpenFile: %s\n", ospath );
+	}
+
+	if ( mode == FS_WRITE && FS_CreatePath( ospath ) ) {
+		return -1;
+	}
+
+	f = FS_HandleForFile();
+	fsh[f].zipFile = qfalse;
+	fsh[f].handleSync = qfalse;
+	Q_strncpyz( fsh[f].name, filename, sizeof( fsh[f].name ) );
+
+	fsh[f].handleFiles.file.o = fopen( ospath, mode == FS_WRITE ? "wb" : "rb" );
+	if ( !fsh[f].handleFiles.file.o ) {
+		return -1;
+	}
+
+	*fp = f;
+	return mode == FS_WRITE ? 0 : FS_filelength( f );
+}
+
+
 /*
 ===========
 FS_SV_Rename
@@ -2917,6 +2974,31 @@ qboolean FS_CheckDirTraversal(const char *checkdir)
 	return qfalse;
 }
 
+/*
+================
+FS_InvalidGameDir
+
+return qtrue if gamedir can't be a game directory: it isn't a single
+directory of the base or home path, or it's the compile cache's, which
+the game could then write its code to
+================
+*/
+qboolean FS_InvalidGameDir( const char *gamedir )
+{
+	int len = strlen( VM_CACHE_DIR );
+
+	if ( strchr( gamedir, '/' ) || strchr( gamedir, '\\' ) ||
+		!strcmp( gamedir, "." ) || !strcmp( gamedir, ".." ) )
+		return qtrue;
+
+	// "vmcache." and "vmcache " are the same directory on windows
+	if ( !Q_stricmpn( gamedir, VM_CACHE_DIR, len ) &&
+		( !gamedir[len] || gamedir[len] == '.' || gamedir[len] == ' ' ) )
+		return qtrue;
+
+	return qfalse;
+}
+
 /*
 ================
 FS_ComparePaks
@@ -3159,6 +3241,18 @@ static void FS_Startup( const char *gameName )
 	fs_homepath = Cvar_Get ("fs_homepath", homePath, CVAR_INIT|CVAR_PROTECTED );
 	fs_gamedirvar = Cvar_Get ("fs_game", "", CVAR_INIT|CVAR_SYSTEMINFO );
 
+	if ( FS_InvalidGameDir( gameName ) ) {
+		Com_Error( ERR_FATAL, "%s is not a valid game directory", gameName );
+	}
+	if ( FS_InvalidGameDir( fs_basegame->string ) ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: fs_basegame %s is not a valid game directory\n", fs_basegame->string );
+		Cvar_Set( "fs_basegame", "" );
+	}
+	if ( FS_InvalidGameDir( fs_gamedirvar->string ) ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: fs_game %s is not a valid game directory\n", fs_gamedirvar->string );
+		Cvar_Set( "fs_game", "" );
+	}
+
 	// add search path elements in reverse priority order
 	if (fs_basepath->string[0]) {
 		FS_AddGameDirectory( fs_basepath->string, gameName );
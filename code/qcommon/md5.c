@@ -308,3 +308,42 @@ char *Com_MD5File( const char *fn, int length, const char *prefix, int prefix_le
 	}
 	return final;
 }
+
+/*
+ * HMAC-MD5 (RFC 2104) of length bytes of data, for checking a file
+ * was written by something that knows key
+ */
+void Com_MD5HMAC(const byte *key, int keyLength, const byte *data, int length, byte digest[16])
+{
+	MD5_CTX md5;
+	byte pad[64];
+	byte keyDigest[16];
+	byte inner[16];
+	int i;
+
+	if(keyLength > sizeof(pad)) {
+		MD5Init(&md5);
+		MD5Update(&md5, key, keyLength);
+		MD5Final(&md5, keyDigest);
+		key = keyDigest;
+		keyLength = sizeof(keyDigest);
+	}
+
+	memset(pad, 0, sizeof(pad));
+	memcpy(pad, key, keyLength);
+	for(i = 0; i < sizeof(pad); i++)
+		pad[i] ^= 0x36;
+	MD5Init(&md5);
+	MD5Update(&md5, pad, sizeof(pad));
+	MD5Update(&md5, data, length);
+	MD5Final(&md5, inner);
+
+	for(i = 0; i < sizeof(pad); i++)
+		pad[i] ^= 0x36 ^ 0x5c;
+	MD5Init(&md5);
+	MD5Update(&md5, pad, sizeof(pad));
+	MD5Update(&md5, inner, sizeof(inner));
+	MD5Final(&md5, digest);
+
+	memset(pad, 0, sizeof(pad));
+}
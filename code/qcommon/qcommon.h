@@ -39,36 +39,320 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #ifdef USE_SQLITE3
 #include "../sqlite3/sqlite3.h"
 
+#ifdef USE_SQLITE3_ASYNC
+/* Queue and writer thread state, private to sql_log.c */
+typedef struct sql_async_s sql_async_t;
+#endif
+
+/* Trace file backend state, private to sql_log.c */
+typedef struct sql_trace_s sql_trace_t;
+typedef struct sql_batch_s sql_batch_t;
+
+/* PRAGMAs a log database is opened with, see sql_profile.c */
+typedef struct {
+	const char *name;
+	const char *journalMode;
+	int synchronous;	/* 0 off, 1 normal, 2 full */
+	int pageSize;
+	int cacheSize;		/* negative for KB */
+	long long mmapSize;
+	int tempStore;		/* 0 default, 1 file, 2 memory */
+} sql_profile_t;
+
+/* Previous value of a delta coded message, see sql_insert_delta */
+typedef struct {
+	int msgID;
+	int size;
+	int count;
+	unsigned char *prev;
+	unsigned char *scratch;
+} sql_delta_t;
+
+#define SQL_DELTA_STREAMS 4
+
+/* Bits of the flags column of q3log_data */
+#define SQL_FLAG_ZLIB 1		/* the value is a zlib stream, see sql_compress.c */
+
 typedef struct {
 	sqlite3 *db;
 	sqlite3_stmt *table;
 	sqlite3_stmt *log;
+	sqlite3_stmt *logBatch;		/* SQL_BATCH_ROWS rows at once */
 	sqlite3_stmt *begin;
 	sqlite3_stmt *end;
+	sqlite3_stmt *stats;
 
 	size_t numInserts;
 	size_t numInstances;
+
+	const sql_profile_t *profile;
+	int keyframeInterval;
+
+	/* Commit policy, see sql_commit.  Used where the database is written. */
+	int batchLimit;			/* rows, adapted to commitBudget */
+	long long commitInterval;	/* nanoseconds */
+	long long commitBudget;		/* nanoseconds */
+	long long lastCommit;		/* sql_clock */
+	long long lastCommitTime;	/* how long it took */
+	sql_delta_t delta[SQL_DELTA_STREAMS];
+
+	/* Rows waiting for logBatch, see sql_batch_add */
+	sql_batch_t *batch;
+
+	/* Blob compression, see sql_compress.c.  Used where the database is
+	   written. */
+	int compressMin;		/* bytes, smaller blobs are stored as they are */
+	void *deflate;			/* NULL when sql_compress is 0 */
+	long long compressIn;		/* bytes of the blobs that were compressed */
+	long long compressOut;		/* and what they compressed to */
+
+	/* sql_insert_var_text text, or packed arguments in async mode */
+	byte *scratch;
+	int scratchSize;
+
+	/* Set instead of db when writing a q3trace file */
+	sql_trace_t *trace;
+
+	/* Log segments, see sql_rotate.  Only the game thread uses these. */
+	char filename[MAX_OSPATH];
+	char label[MAX_QPATH];		/* of the current segment */
+	int rotateRows;
+	long long rotateBytes;
+	qboolean rotateMap;
+	qboolean rotateVacuum;
+	int queuedRows;			/* since the segment was started */
+	long long queuedBytes;
+	qboolean rotateWarned;
+
+	/* Set where the database is written when a new segment couldn't be
+	   started, see sql_rotate_db.  Rows are dropped while db is NULL. */
+	volatile int rotateFailed;
+	size_t numLost;
+
+	/* A write failed, see SQL_FAILED */
+	qboolean failed;
+#ifdef USE_SQLITE3_ASYNC
+	sql_async_t *async;
+#endif
 } sql_data;
 
 #define SQL_FAIL(sql,x) do {  \
 	fprintf(stderr, "ERROR: %s in %s:%d [build: %s:%s]\n", x, __FILE__, __LINE__, __DATE__, __TIME__); \
 	sql_close(&sql); \
 } while (0);
+/* For a logger sql_logs points to: don't close it here, sql_frame closes
+   it through sql_close_log and nothing is written to it until then */
+#define SQL_FAILED(sql,x) do {  \
+	fprintf(stderr, "ERROR: %s in %s:%d [build: %s:%s]\n", x, __FILE__, __LINE__, __DATE__, __TIME__); \
+	if ((sql) != NULL) { \
+		(sql)->failed = qtrue; \
+	} \
+} while (0);
 #define DEBUG_PRINT(x) do { \
 	fprintf(stderr, "ERROR: %s in %s:%d [build: %s:%s]\n", x, __FILE__, __LINE__, __DATE__, __TIME__); \
 } while (0);
 
-extern sql_data *sql;
+/* Who is calling whom.  These are the rows of the endpoint table. */
+typedef enum {
+	SQL_EP_SERVER,
+	SQL_EP_CLIENT,
+	SQL_EP_QAGAME_QVM,
+	SQL_EP_CGAME_QVM,
+	SQL_EP_UI_QVM,
+
+	SQL_EP_MAX
+} sqlEndpoint_t;
+
+/* Message IDs are a namespace in the high bits and the trap or export
+   number from g_public.h, cg_public.h or ui_public.h in the low 16 bits.
+   These are the rows of the msgtype table.
+*/
+typedef enum {
+	SQL_NS_ENGINE,
+	SQL_NS_GAME_IMPORT,
+	SQL_NS_GAME_EXPORT,
+	SQL_NS_CGAME_IMPORT,
+	SQL_NS_CGAME_EXPORT,
+	SQL_NS_UI_IMPORT,
+	SQL_NS_UI_EXPORT,
+
+	SQL_NS_MAX
+} sqlNamespace_t;
+
+/* Messages in SQL_NS_ENGINE that don't belong to a VM interface */
+typedef enum {
+	SQL_MSG_SNAPSHOT,
+	SQL_MSG_GAMESTATE,
+	SQL_MSG_COMMANDSTRING,
+	SQL_MSG_VM_CREATE,
+	SQL_MSG_VM_RESTART,
+	SQL_MSG_VM_CALL
+} sqlEngineMsg_t;
+
+#define SQL_MSG(ns, num)	(((ns) << 16) | (num))
+#define SQL_MSG_NS(id)		((id) >> 16)
+#define SQL_MSG_NUM(id)		((id) & 0xffff)
+
+#define SQL_ENGINE(n)		SQL_MSG(SQL_NS_ENGINE, (n))
+#define SQL_GAME_TRAP(n)	SQL_MSG(SQL_NS_GAME_IMPORT, (n))
+#define SQL_GAME_CALL(n)	SQL_MSG(SQL_NS_GAME_EXPORT, (n))
+#define SQL_CGAME_TRAP(n)	SQL_MSG(SQL_NS_CGAME_IMPORT, (n))
+#define SQL_CGAME_CALL(n)	SQL_MSG(SQL_NS_CGAME_EXPORT, (n))
+#define SQL_UI_TRAP(n)		SQL_MSG(SQL_NS_UI_IMPORT, (n))
+#define SQL_UI_CALL(n)		SQL_MSG(SQL_NS_UI_EXPORT, (n))
+
+/* One logger per subsystem, each with its own database, transaction and
+   writer thread so a busy server doesn't hold up the client.  With sql_split
+   0 they all share the first one that was opened.  See sql_open_log.
+*/
+typedef enum {
+	SQL_LOG_QAGAME,		/* the server and the game VM */
+	SQL_LOG_CGAME,
+	SQL_LOG_UI,
+	SQL_LOG_NETCHAN,	/* what the client received from the server */
+	SQL_LOG_MAX
+} sqlLog_t;
+
+extern sql_data *sql_logs[SQL_LOG_MAX];
+
+/* Engine state stamped on every row next to the sql_clock timestamp.  The
+   server and client point these at their own state when they start.  Rows
+   with a client side endpoint (client, cgame, ui) take the client's view.
+*/
+typedef struct {
+	const int *serverTime;	/* svs.time */
+	const int *clientTime;	/* cl.serverTime */
+	const int *localClient;	/* clc.clientNum */
+	int serverClient;	/* client the game is running a command for, or -1 */
+} sql_context_t;
+
+extern sql_context_t sql_context;
+
+/* Monotonic nanoseconds */
+long long sql_clock(void);
+
+/* One row of the trap_stats table, times in nanoseconds */
+typedef struct {
+	long long count;
+	long long total;
+	long long p50;
+	long long p99;
+	long long max;
+} sql_trap_stats_t;
+
+/* Why a log segment was closed, see sql_rotate */
+typedef enum {
+	SQL_ROTATE_ROWS,
+	SQL_ROTATE_SIZE,
+	SQL_ROTATE_MAP,
+	SQL_ROTATE_COMMAND
+} sqlRotate_t;
+
+/* How a trap is logged, see sql_names.c */
+typedef struct {
+	const char *name;
+	const char *args;	/* one kind letter per argument, NULL to not log it */
+	int size;		/* of the structure a 'b' or 'B' argument points to */
+	qboolean quiet;		/* off unless sql_filter turns it on */
+} sql_msg_t;
+
+/* One value of a sql_insert_values row */
+typedef struct {
+	char type;		/* 'i', 'f', 's' or 'b' */
+	int size;		/* of a string or blob, -1 for a terminated string */
+	union {
+		int i;
+		double d;
+		const void *p;
+	} u;
+} sql_arg_t;
+
+#define SQL_ARGS_MAX 16
 
 int sql_init(sql_data **sql, const char *filename);
 int sql_close(sql_data **sql);
-int sql_insert_var_text(sql_data *sql, const char *caller, const char *target, const char *msgID, const char *msg, ...)  __attribute__ ((format (printf, 5, 6)));
-int sql_insert_null(sql_data *sql, const char *caller, const char *target, const char *msgID);
-int sql_insert_int(sql_data *sql, const char *caller, const char *target, const char *msgID, int value);
-int sql_insert_text(sql_data *sql, const char *caller, const char *target, const char *msgID, const char *value);
-int sql_insert_blob(sql_data *sql, const char *caller, const char *target, const char *msgID, void *value, int size);
-int sql_insert_double(sql_data *sql, const char *caller, const char *target, const char *msgID, double value);
-int sql_insert_double_ptr(sql_data *sql, const char *caller, const char *target, const char *msgID, double *value);
+int sql_open_log(sqlLog_t log);
+int sql_close_log(sqlLog_t log);
+sql_data *sql_log_ns(int ns);
+/* msg must be a string literal, the writer thread formats it later */
+int sql_insert_var_text(sql_data *sql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, const char *msg, ...)  __attribute__ ((format (printf, 5, 6)));
+int sql_insert_null(sql_data *sql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID);
+int sql_insert_int(sql_data *sql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, int value);
+int sql_insert_text(sql_data *sql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, const char *value);
+int sql_insert_blob(sql_data *sql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, void *value, int size);
+int sql_insert_double(sql_data *sql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, double value);
+int sql_insert_double_ptr(sql_data *sql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, double *value);
+int sql_insert_delta(sql_data *sql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, const void *value, int size);
+int sql_insert_trap_stats(sql_data *sql, int msgID, const sql_trap_stats_t *stats);
+int sql_insert_values(sql_data *sql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, sql_arg_t *values, int count);
+qboolean sql_want(int msgID);
+qboolean sql_unwanted(int msgID);
+int sql_syscall_generation(void);
+int sql_rotate(sql_data *sql, sqlRotate_t reason, const char *label);
+void sql_frame(void);
+
+// sql_delta.c
+int sql_delta_bound(int size);
+int sql_delta_encode(const unsigned char *prev, const unsigned char *cur, int size, unsigned char *out);
+int sql_delta_apply(unsigned char *base, int size, const unsigned char *in, int len);
+int sql_register_functions(sqlite3 *db);
+
+// sql_compress.c
+#ifdef USE_SQLITE3_DEFLATE
+void *sql_deflate_open(int level);
+void sql_deflate_close(void *stream);
+int sql_deflate(void *stream, const void *in, int size, void *out);
+#endif
+int sql_inflate(const void *in, int len, void *out, int outSize);
+void *sql_inflate_alloc(const void *in, int len, int *size);
+int sql_register_compress(sqlite3 *db);
+
+// sql_schema.c
+int sql_create_schema(sqlite3 *db);
+int sql_add_session(sqlite3 *db, double started, long long clock);
+int sql_next_segment(sqlite3 *db);
+int sql_add_segment(sqlite3 *db, int id, const char *file, const char *label, const char *reason);
+int sql_write_attach_script(sqlite3 *db, const char *filename);
+int sql_write_logs_script(const char *filename, const char * const *names, const char * const *files, int count);
+int sql_create_indexes(sqlite3 *db);
+long long sql_update_summary(sqlite3 *db);
+
+// sql_profile.c
+const sql_profile_t *sql_profile_find(const char *name);
+const sql_profile_t *sql_profile_get(int n);
+int sql_profile_apply(sqlite3 *db, const sql_profile_t *profile);
+int sql_profile_report(sqlite3 *db, const sql_profile_t *profile, char *out, int size);
+
+// sql_stats.c
+intptr_t sql_stats_syscall(int ns, intptr_t (*syscall)(intptr_t *), intptr_t *args);
+void sql_stats_init(void);
+void sql_stats_shutdown(void);
+int sql_stats_active(void);
+int sql_stats_generation(void);
+
+// sql_syscall.c
+intptr_t sql_syscall(int ns, intptr_t (*syscall)(intptr_t *), intptr_t *args);
+int sql_syscall_module(const char *module);
+qboolean sql_syscall_logged(int ns, int num);
+void sql_vm_call(const char *module, const int *args, int count);
+
+// sql_replay.c
+void sql_replay_f(void);
+void sql_replay_abort(void);
+
+// sql_format.c
+int sql_format_capture(byte *out, int max, const char *fmt, va_list ap);
+int sql_format_replay(char *out, int max, const char *fmt, const byte *args, int size);
+int sql_format_values_size(const sql_arg_t *values, int count);
+int sql_format_values(char *out, int max, const sql_arg_t *values, int count);
+int sql_format_pack(byte *out, int max, const sql_arg_t *values, int count);
+int sql_format_unpack(sql_arg_t *values, int max, const byte *packed, int size);
+
+// sql_names.c
+const char *sql_endpoint_name(int endpoint);
+const sql_msg_t *sql_msg(int msgID);
+const char *sql_msg_name(int msgID);
+int sql_msg_count(int ns);
 
 /* These operate on local instances.  You will want to use the non-local versions
    so it does reference tracking on the global variable.
@@ -395,7 +679,32 @@ typedef enum {
 	TRAP_TESTPRINTFLOAT
 } sharedTraps_t;
 
+// traps the compiler can do inline instead of calling func
+typedef enum {
+	VM_INLINE_NONE,
+	VM_INLINE_MEMSET,
+	VM_INLINE_MEMCPY,
+	VM_INLINE_STRNCPY,
+	VM_INLINE_SQRT,
+	VM_INLINE_SIN,
+	VM_INLINE_COS
+} vmInline_t;
+
+// a trap the engine answers with its own function, indexed by trap number
+// in the table given to VM_RegisterSyscalls
+typedef struct {
+	intptr_t	(*func)( intptr_t *args );	// takes the same args as systemCall
+	int			numArgs;					// reads args[1] to args[numArgs]
+	vmInline_t	inlined;
+} vmSyscall_t;
+
+// VM_Compile caches what it compiled in the home path's VM_CACHE_DIR
+#define VM_CACHE_DIR	"vmcache"
+#define VM_CACHE_EXT	".jit"
+
 void	VM_Init( void );
+void	VM_RegisterSyscalls( intptr_t (*systemCalls)(intptr_t *), const vmSyscall_t *syscalls,
+				int numSyscalls, qboolean (*logged)( int trap ) );
 vm_t	*VM_Create( const char *module, intptr_t (*systemCalls)(intptr_t *), 
 				   vmInterpret_t interpret );
 // module should be bare: "cgame", not "cgame.dll" or "vm/cgame.qvm"
@@ -410,8 +719,18 @@ intptr_t		QDECL VM_Call( vm_t *vm, int callNum, ... );
 
 void	VM_Debug( int level );
 
+// the memory and math traps every module has, for their syscall tables
+intptr_t	VM_TrapMemset( intptr_t *args );
+intptr_t	VM_TrapMemcpy( intptr_t *args );
+intptr_t	VM_TrapStrncpy( intptr_t *args );
+intptr_t	VM_TrapSqrt( intptr_t *args );
+intptr_t	VM_TrapSin( intptr_t *args );
+intptr_t	VM_TrapCos( intptr_t *args );
+
 void	*VM_ArgPtr( intptr_t intValue );
 void	*VM_ExplicitArgPtr( vm_t *vm, intptr_t intValue );
+unsigned	VM_DataChecksum( vm_t *vm );
+vmInterpret_t	VM_Interpret( vm_t *vm );
 
 #define	VMA(x) VM_ArgPtr(args[x])
 static ID_INLINE float _vmf(intptr_t x)
@@ -683,6 +1002,8 @@ fileHandle_t	FS_FCreateOpenPipeFile( const char *filename );
 
 fileHandle_t FS_SV_FOpenFileWrite( const char *filename );
 long		FS_SV_FOpenFileRead( const char *filename, fileHandle_t *fp );
+long		FS_VMCacheFOpenFile( const char *filename, fileHandle_t *fp, fsMode_t mode );
+// only the home path, filename has to be in VM_CACHE_DIR
 void	FS_SV_Rename( const char *from, const char *to );
 long		FS_FOpenFileRead( const char *qpath, fileHandle_t *file, qboolean uniqueFILE );
 // if uniqueFILE is true, then a new FILE will be fopened even if the file
@@ -764,6 +1085,7 @@ void FS_PureServerSetLoadedPaks( const char *pakSums, const char *pakNames );
 // sole exception of .cfg files.
 
 qboolean FS_CheckDirTraversal(const char *checkdir);
+qboolean FS_InvalidGameDir(const char *gamedir);
 qboolean FS_idPak(char *pak, char *base, int numPaks);
 qboolean FS_ComparePaks( char *neededpaks, int len, qboolean dlstring );
 
@@ -867,6 +1189,7 @@ void		Com_GameRestart(int checksumFeed, qboolean disconnect);
 int			Com_Milliseconds( void );	// will be journaled properly
 unsigned	Com_BlockChecksum( const void *buffer, int length );
 char		*Com_MD5File(const char *filename, int length, const char *prefix, int prefix_len);
+void		Com_MD5HMAC(const byte *key, int keyLength, const byte *data, int length, byte digest[16]);
 int			Com_Filter(char *filter, char *name, int casesensitive);
 int			Com_FilterPath(char *filter, char *name, int casesensitive);
 int			Com_RealTime(qtime_t *qtime);
@@ -921,6 +1244,7 @@ extern	int		time_frontend;
 extern	int		time_backend;		// renderer backend time
 
 extern	int		com_frameTime;
+extern	int		com_frameNumber;
 
 extern	qboolean	com_errorEntered;
 extern	qboolean	com_fullyInitialized;
@@ -1169,6 +1493,11 @@ char **Sys_ListFiles( const char *directory, const char *extension, char *filter
 void	Sys_FreeFileList( char **list );
 void	Sys_Sleep(int msec);
 
+// calls sample from a timer every 1/hz seconds of CPU time used by the
+// calling thread, with the program counter and stack pointer it stopped
+qboolean Sys_StartSampling( int hz, void (*sample)( void *pc, void *sp ) );
+void	Sys_StopSampling( void );
+
 qboolean Sys_LowPhysicalMemory( void );
 
 void Sys_SetEnv(const char *name, const char *value);
@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef USE_LOCAL_HEADERS
+#include "../zlib/zlib.h"
+#else
+#include <zlib.h>
+#endif
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+/* zlib compression of large blobs.
+
+   With sql_compress set to a zlib level, blobs of at least sql_compressMin
+   bytes are compressed where the row is written (the writer thread in
+   async mode) and marked with SQL_FLAG_ZLIB in the flags column.  A blob
+   that doesn't get smaller is stored as it is.  The value is a plain zlib
+   stream, so anything with zlib can read it as well as q3_uncompress.
+
+   The zlib in code/zlib only has inflate, so compressing needs a build
+   against the system zlib (USE_INTERNAL_ZLIB=0), which defines
+   USE_SQLITE3_DEFLATE.  Reading compressed rows works either way.
+*/
+
+#ifdef USE_SQLITE3_DEFLATE
+/* One stream per logger, reset for every blob instead of set up again */
+void *
+sql_deflate_open(int level)
+{
+	z_stream *zs = calloc(1, sizeof(*zs));
+
+	if (zs == NULL) {
+		return NULL;
+	}
+	if (deflateInit(zs, level) != Z_OK) {
+		free(zs);
+		return NULL;
+	}
+	return zs;
+}
+
+void
+sql_deflate_close(void *stream)
+{
+	if (stream != NULL) {
+		deflateEnd(stream);
+		free(stream);
+	}
+}
+
+/* Compress in into out, which holds size bytes.  Returns the compressed
+   size, or 0 when it wouldn't be smaller than the input. */
+int
+sql_deflate(void *stream, const void *in, int size, void *out)
+{
+	z_stream *zs = stream;
+	int len;
+
+	if (deflateReset(zs) != Z_OK) {
+		return 0;
+	}
+	zs->next_in = (Bytef *)in;
+	zs->avail_in = size;
+	zs->next_out = out;
+	zs->avail_out = size;
+
+	if (deflate(zs, Z_FINISH) != Z_STREAM_END) {
+		return 0;
+	}
+	len = size - zs->avail_out;
+	return len < size ? len : 0;
+}
+#endif
+
+/* Uncompress a blob into out.  Returns the size, or -1 when it's corrupt
+   or more than outSize bytes. */
+int
+sql_inflate(const void *in, int len, void *out, int outSize)
+{
+	z_stream zs;
+	int rc;
+
+	memset(&zs, 0, sizeof(zs));
+	if (inflateInit(&zs) != Z_OK) {
+		return -1;
+	}
+	zs.next_in = (Bytef *)in;
+	zs.avail_in = len;
+	zs.next_out = out;
+	zs.avail_out = outSize;
+	rc = inflate(&zs, Z_FINISH);
+	inflateEnd(&zs);
+
+	return rc == Z_STREAM_END ? outSize - (int)zs.avail_out : -1;
+}
+
+/* Uncompress a blob of unknown size into a malloced buffer.  Returns NULL
+   when it's corrupt. */
+void *
+sql_inflate_alloc(const void *in, int len, int *size)
+{
+	z_stream zs;
+	unsigned char *out = NULL;
+	int outSize = len * 4 > 1024 ? len * 4 : 1024;
+	int rc = Z_OK;
+
+	memset(&zs, 0, sizeof(zs));
+	if (inflateInit(&zs) != Z_OK) {
+		return NULL;
+	}
+	zs.next_in = (Bytef *)in;
+	zs.avail_in = len;
+
+	while (rc == Z_OK) {
+		unsigned char *grown = realloc(out, outSize);
+
+		if (grown == NULL) {
+			break;
+		}
+		zs.next_out = grown + zs.total_out;
+		zs.avail_out = outSize - zs.total_out;
+		out = grown;
+		rc = inflate(&zs, Z_NO_FLUSH);
+		outSize *= 2;
+	}
+	inflateEnd(&zs);
+
+	if (rc != Z_STREAM_END) {
+		free(out);
+		return NULL;
+	}
+	*size = zs.total_out;
+	return out;
+}
+
+/* q3_uncompress(value, flags): the value as it was logged */
+static void
+sql_func_uncompress(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+	const void *blob;
+	void *out;
+	int size;
+
+	if (! (sqlite3_value_int(argv[1]) & SQL_FLAG_ZLIB)) {
+		sqlite3_result_value(ctx, argv[0]);
+		return;
+	}
+	if ((blob = sqlite3_value_blob(argv[0])) == NULL ||
+	    (out = sql_inflate_alloc(blob, sqlite3_value_bytes(argv[0]), &size)) == NULL) {
+		sqlite3_result_null(ctx);
+		return;
+	}
+	sqlite3_result_blob(ctx, out, size, free);
+}
+
+/* Register q3_uncompress on a connection */
+int
+sql_register_compress(sqlite3 *db)
+{
+	return sqlite3_create_function(db, "q3_uncompress", 2, SQLITE_UTF8, NULL,
+	    sql_func_uncompress, NULL, NULL);
+}
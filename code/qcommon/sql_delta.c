@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../sqlite3/sqlite3.h"
+
+/* Delta coding for large structures that are logged over and over
+   (snapshots, gamestate).  This only depends on SQLite3 so the same file
+   is linked into the engine and the sqlite3 shell.
+
+   Every blob starts with a tag byte:
+
+     'K' <raw bytes>               a keyframe, the full structure
+     'D' { <skip> <len> <bytes> }  a delta against the previous blob of the
+                                   same msgid
+
+   In a delta, skip is the number of bytes unchanged from the previous
+   blob and len is the number of literal bytes that follow.  Both are
+   LEB128 varints.  A delta is always the same size as its base.
+*/
+
+#define SQL_DELTA_KEYFRAME	'K'
+#define SQL_DELTA_DELTA		'D'
+
+/* Don't break a literal run for fewer unchanged bytes than this, the
+   two varints would cost more than they save */
+#define SQL_DELTA_MIN_SKIP	4
+
+static unsigned char *
+sql_delta_put_varint(unsigned char *out, unsigned int value)
+{
+	while (value >= 0x80) {
+		*out++ = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (unsigned char)value;
+	return out;
+}
+
+static const unsigned char *
+sql_delta_get_varint(const unsigned char *in, const unsigned char *end, unsigned int *value)
+{
+	unsigned int shift = 0;
+
+	*value = 0;
+	while (in < end && shift < 32) {
+		*value |= (unsigned int)(*in & 0x7f) << shift;
+		if (! (*in++ & 0x80)) {
+			return in;
+		}
+		shift += 7;
+	}
+	return NULL;
+}
+
+/* Worst case encoded size for a structure of size bytes */
+int
+sql_delta_bound(int size)
+{
+	return 1 + size + 2 * 5 * (size / SQL_DELTA_MIN_SKIP + 1);
+}
+
+/* Write a keyframe (prev == NULL) or a delta of cur against prev into out,
+   which must hold sql_delta_bound(size) bytes.  A delta that wouldn't be
+   smaller than the keyframe is written as a keyframe.  Returns the number
+   of bytes written.
+*/
+int
+sql_delta_encode(const unsigned char *prev, const unsigned char *cur, int size, unsigned char *out)
+{
+	unsigned char *p = out;
+	int i = 0;
+
+	if (prev != NULL) {
+		*p++ = SQL_DELTA_DELTA;
+
+		while (i < size) {
+			int skip = i;
+			int lit;
+
+			while (i < size && prev[i] == cur[i]) {
+				i++;
+			}
+			skip = i - skip;
+			if (i == size) {
+				break;
+			}
+
+			/* Literal run up to the next stretch of unchanged bytes */
+			lit = i;
+			while (i < size) {
+				int same = 0;
+
+				while (i + same < size && same < SQL_DELTA_MIN_SKIP && prev[i + same] == cur[i + same]) {
+					same++;
+				}
+				if (same == SQL_DELTA_MIN_SKIP || i + same == size) {
+					break;
+				}
+				i += same + 1;
+			}
+			lit = i - lit;
+
+			p = sql_delta_put_varint(p, skip);
+			p = sql_delta_put_varint(p, lit);
+			memcpy(p, cur + i - lit, lit);
+			p += lit;
+
+			if (p - out >= 1 + size) {
+				break;
+			}
+		}
+
+		if (p - out < 1 + size) {
+			return p - out;
+		}
+		p = out;
+	}
+
+	*p++ = SQL_DELTA_KEYFRAME;
+	memcpy(p, cur, size);
+	return 1 + size;
+}
+
+/* Apply a delta in place.  Returns 0 on a corrupt or mismatched delta. */
+int
+sql_delta_apply(unsigned char *base, int size, const unsigned char *in, int len)
+{
+	const unsigned char *end = in + len;
+	unsigned int pos = 0;
+
+	in++;
+	while (in < end) {
+		unsigned int skip, lit;
+
+		if ((in = sql_delta_get_varint(in, end, &skip)) == NULL ||
+		    (in = sql_delta_get_varint(in, end, &lit)) == NULL) {
+			return 0;
+		}
+		if (skip > size - pos || lit > size - pos - skip || lit > end - in) {
+			return 0;
+		}
+		pos += skip;
+		memcpy(base + pos, in, lit);
+		pos += lit;
+		in += lit;
+	}
+	return 1;
+}
+
+/* q3_keyframe(value): 1 if the blob is a keyframe */
+static void
+sql_func_keyframe(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+	const unsigned char *blob = sqlite3_value_blob(argv[0]);
+
+	sqlite3_result_int(ctx, blob != NULL && sqlite3_value_bytes(argv[0]) > 0 && blob[0] == SQL_DELTA_KEYFRAME);
+}
+
+typedef struct {
+	unsigned char	*base;
+	int		size;
+	int		broken;
+} sql_undelta_t;
+
+/* q3_undelta(value): aggregate that replays a keyframe and the deltas
+   after it, in rowid order, and returns the full structure */
+static void
+sql_func_undelta_step(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+	sql_undelta_t *state = sqlite3_aggregate_context(ctx, sizeof(sql_undelta_t));
+	const unsigned char *blob = sqlite3_value_blob(argv[0]);
+	int len = sqlite3_value_bytes(argv[0]);
+
+	if (state == NULL || state->broken || blob == NULL || len < 1) {
+		return;
+	}
+
+	if (blob[0] == SQL_DELTA_KEYFRAME) {
+		unsigned char *base = realloc(state->base, len - 1 > 0 ? len - 1 : 1);
+		if (base == NULL) {
+			state->broken = 1;
+			return;
+		}
+		state->base = base;
+		state->size = len - 1;
+		memcpy(state->base, blob + 1, state->size);
+	} else if (blob[0] != SQL_DELTA_DELTA || state->base == NULL ||
+	    ! sql_delta_apply(state->base, state->size, blob, len)) {
+		state->broken = 1;
+	}
+}
+
+static void
+sql_func_undelta_final(sqlite3_context *ctx)
+{
+	sql_undelta_t *state = sqlite3_aggregate_context(ctx, 0);
+
+	if (state == NULL) {
+		sqlite3_result_null(ctx);
+		return;
+	}
+	if (state->broken || state->base == NULL) {
+		sqlite3_result_null(ctx);
+	} else {
+		sqlite3_result_blob(ctx, state->base, state->size, SQLITE_TRANSIENT);
+	}
+	free(state->base);
+}
+
+/* Register the q3log SQL functions on a connection */
+int
+sql_register_functions(sqlite3 *db)
+{
+	if (sqlite3_create_function(db, "q3_keyframe", 1, SQLITE_UTF8, NULL,
+	    sql_func_keyframe, NULL, NULL) != SQLITE_OK) {
+		return SQLITE_ERROR;
+	}
+	if (sqlite3_create_function(db, "q3_undelta", 1, SQLITE_UTF8, NULL,
+	    NULL, sql_func_undelta_step, sql_func_undelta_final) != SQLITE_OK) {
+		return SQLITE_ERROR;
+	}
+	return SQLITE_OK;
+}
@@ -0,0 +1,487 @@
+#include <string.h>
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+/* Deferred printf for sql_insert_var_text.
+
+   Formatting a row on the game thread costs more than queueing it, so in
+   async mode the caller only walks the format and packs the raw arguments
+   next to the record.  The writer thread expands them into the same text
+   vsnprintf would have produced.  The format itself is not copied, it must
+   be a string literal (every call site passes one).
+
+   Packed arguments, in the order they are consumed:
+
+     '*' width or precision   int
+     d i o u x X c            64 bit integer
+     e E f F g G a A          double
+     p                        void *
+     s                        int length, then the bytes (already cut to
+                              the precision, no terminator)
+
+   Anything else (%n, wide strings, long double, ...) is refused and the
+   caller formats it right away.
+*/
+
+typedef enum {
+	SQL_FMT_LEN_NONE,	/* also h and hh, promoted to int */
+	SQL_FMT_LEN_L,
+	SQL_FMT_LEN_LL,
+	SQL_FMT_LEN_Z
+} sql_fmt_len_t;
+
+typedef struct {
+	const char	*start;		/* the '%' */
+	const char	*prec;		/* the '.' or whatever follows the width */
+	const char	*end;		/* one past the conversion */
+	int		stars;		/* number of '*' */
+	qboolean	widthStar;
+	int		precision;	/* -1 none, -2 from the arguments */
+	sql_fmt_len_t	len;
+	char		conv;
+} sql_fmt_spec_t;
+
+/* Longest conversion that is passed on to Q_vsnprintf */
+#define SQL_FMT_MAX_SPEC	32
+
+static int
+sql_format_spec(const char *p, sql_fmt_spec_t *spec)
+{
+	spec->start = p++;
+	spec->stars = 0;
+	spec->widthStar = qfalse;
+	spec->precision = -1;
+	spec->len = SQL_FMT_LEN_NONE;
+
+	while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+		p++;
+	}
+
+	if (*p == '*') {
+		spec->stars++;
+		spec->widthStar = qtrue;
+		p++;
+	} else {
+		while (*p >= '0' && *p <= '9') {
+			p++;
+		}
+	}
+
+	spec->prec = p;
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->stars++;
+			spec->precision = -2;
+			p++;
+		} else {
+			spec->precision = 0;
+			while (*p >= '0' && *p <= '9') {
+				spec->precision = spec->precision * 10 + (*p++ - '0');
+			}
+		}
+	}
+
+	switch (*p) {
+	case 'h':
+		if (*++p == 'h') {
+			p++;
+		}
+		break;
+	case 'l':
+		if (*++p == 'l') {
+			spec->len = SQL_FMT_LEN_LL;
+			p++;
+		} else {
+			spec->len = SQL_FMT_LEN_L;
+		}
+		break;
+	case 'z':
+		spec->len = SQL_FMT_LEN_Z;
+		p++;
+		break;
+	}
+
+	spec->conv = *p;
+	spec->end = p + 1;
+
+	if (spec->end - spec->start >= SQL_FMT_MAX_SPEC - 4) {
+		return 0;
+	}
+
+	switch (spec->conv) {
+	case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+		return 1;
+	case 'c': case 's':
+		return spec->len == SQL_FMT_LEN_NONE;
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+	case 'p':
+		return spec->len == SQL_FMT_LEN_NONE || spec->len == SQL_FMT_LEN_L;
+	case '%':
+		return spec->stars == 0;
+	default:
+		return 0;
+	}
+}
+
+static void
+sql_format_put(byte *out, int max, int *pos, const void *src, int size)
+{
+	if (*pos + size <= max) {
+		memcpy(out + *pos, src, size);
+	}
+	*pos += size;
+}
+
+static int
+sql_format_get(const byte *args, int size, int *pos, void *dst, int len)
+{
+	if (len < 0 || *pos + len > size) {
+		return 0;
+	}
+	memcpy(dst, args + *pos, len);
+	*pos += len;
+	return 1;
+}
+
+/* Pack the arguments fmt consumes from ap into out.  Returns the packed
+   size, which can be more than max (nothing past max is written), or -1
+   when fmt has a conversion that can't be deferred.
+*/
+int
+sql_format_capture(byte *out, int max, const char *fmt, va_list ap)
+{
+	sql_fmt_spec_t spec;
+	int pos = 0;
+	const char *p;
+
+	for (p = fmt; (p = strchr(p, '%')) != NULL; p = spec.end) {
+		int star[2] = { 0, 0 };
+		int i;
+
+		if (! sql_format_spec(p, &spec)) {
+			return -1;
+		}
+
+		for (i = 0; i < spec.stars; i++) {
+			star[i] = va_arg(ap, int);
+			sql_format_put(out, max, &pos, &star[i], sizeof(int));
+		}
+
+		switch (spec.conv) {
+		case 'd': case 'i': case 'c':
+		case 'o': case 'u': case 'x': case 'X': {
+			long long v;
+			qboolean sign = (spec.conv == 'd' || spec.conv == 'i' || spec.conv == 'c');
+
+			switch (spec.len) {
+			case SQL_FMT_LEN_L:
+				v = sign ? (long long)va_arg(ap, long) : (long long)va_arg(ap, unsigned long);
+				break;
+			case SQL_FMT_LEN_LL:
+				v = va_arg(ap, long long);
+				break;
+			case SQL_FMT_LEN_Z:
+				v = (long long)va_arg(ap, size_t);
+				break;
+			default:
+				v = sign ? (long long)va_arg(ap, int) : (long long)va_arg(ap, unsigned int);
+				break;
+			}
+			sql_format_put(out, max, &pos, &v, sizeof(v));
+			break;
+		}
+		case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A': {
+			double v = va_arg(ap, double);
+
+			sql_format_put(out, max, &pos, &v, sizeof(v));
+			break;
+		}
+		case 'p': {
+			void *v = va_arg(ap, void *);
+
+			sql_format_put(out, max, &pos, &v, sizeof(v));
+			break;
+		}
+		case 's': {
+			const char *s = va_arg(ap, const char *);
+			int precision = spec.precision == -2 ? star[spec.stars - 1] : spec.precision;
+			int len;
+
+			if (s == NULL) {
+				s = "(null)";
+			}
+			if (precision >= 0) {
+				const char *nul = memchr(s, '\0', precision);
+				len = nul != NULL ? nul - s : precision;
+			} else {
+				len = strlen(s);
+			}
+			sql_format_put(out, max, &pos, &len, sizeof(len));
+			sql_format_put(out, max, &pos, s, len);
+			break;
+		}
+		}
+	}
+
+	return pos;
+}
+
+static int sql_format_print(char *out, int max, const char *spec, ...) __attribute__ ((format (printf, 3, 4)));
+
+static int
+sql_format_print(char *out, int max, const char *spec, ...)
+{
+	va_list argptr;
+	int len;
+
+	va_start(argptr, spec);
+	len = Q_vsnprintf(out, max, spec, argptr);
+	va_end(argptr);
+	return len;
+}
+
+#define SQL_FMT_PRINT(out, max, spec, spec_, star, v) \
+	((spec_).stars == 0 ? sql_format_print(out, max, spec, v) : \
+	 (spec_).stars == 1 ? sql_format_print(out, max, spec, (star)[0], v) : \
+	 sql_format_print(out, max, spec, (star)[0], (star)[1], v))
+
+/* Expand arguments packed by sql_format_capture.  out is always
+   terminated, the text is cut short like vsnprintf would.  Returns the
+   length of the text or -1 if the packed arguments don't match fmt.
+*/
+int
+sql_format_replay(char *out, int max, const char *fmt, const byte *args, int size)
+{
+	sql_fmt_spec_t spec;
+	char conv[SQL_FMT_MAX_SPEC];
+	int pos = 0;
+	int in = 0;
+	const char *p = fmt;
+
+	if (max < 1) {
+		return -1;
+	}
+
+	while (*p != '\0' && pos < max - 1) {
+		int star[2] = { 0, 0 };
+		int len = 0;
+		int i;
+
+		if (*p != '%') {
+			out[pos++] = *p++;
+			continue;
+		}
+
+		if (! sql_format_spec(p, &spec)) {
+			return -1;
+		}
+		p = spec.end;
+
+		for (i = 0; i < spec.stars; i++) {
+			if (! sql_format_get(args, size, &in, &star[i], sizeof(int))) {
+				return -1;
+			}
+		}
+
+		if (spec.conv == 's') {
+			/* The string was already cut to the precision and isn't
+			   terminated, so always pass its length as the precision */
+			Com_Memcpy(conv, spec.start, spec.prec - spec.start);
+			strcpy(conv + (spec.prec - spec.start), ".*s");
+		} else {
+			Com_Memcpy(conv, spec.start, spec.end - spec.start);
+			conv[spec.end - spec.start] = '\0';
+		}
+
+		switch (spec.conv) {
+		case 'd': case 'i': case 'c':
+		case 'o': case 'u': case 'x': case 'X': {
+			long long v;
+
+			if (! sql_format_get(args, size, &in, &v, sizeof(v))) {
+				return -1;
+			}
+			switch (spec.len) {
+			case SQL_FMT_LEN_L:
+				len = SQL_FMT_PRINT(out + pos, max - pos, conv, spec, star, (long)v);
+				break;
+			case SQL_FMT_LEN_LL:
+				len = SQL_FMT_PRINT(out + pos, max - pos, conv, spec, star, v);
+				break;
+			case SQL_FMT_LEN_Z:
+				len = SQL_FMT_PRINT(out + pos, max - pos, conv, spec, star, (size_t)v);
+				break;
+			default:
+				len = SQL_FMT_PRINT(out + pos, max - pos, conv, spec, star, (int)v);
+				break;
+			}
+			break;
+		}
+		case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A': {
+			double v;
+
+			if (! sql_format_get(args, size, &in, &v, sizeof(v))) {
+				return -1;
+			}
+			len = SQL_FMT_PRINT(out + pos, max - pos, conv, spec, star, v);
+			break;
+		}
+		case 'p': {
+			void *v;
+
+			if (! sql_format_get(args, size, &in, &v, sizeof(v))) {
+				return -1;
+			}
+			len = SQL_FMT_PRINT(out + pos, max - pos, conv, spec, star, v);
+			break;
+		}
+		case 's': {
+			int slen;
+
+			if (! sql_format_get(args, size, &in, &slen, sizeof(slen)) || slen > size - in) {
+				return -1;
+			}
+			if (spec.widthStar) {
+				len = sql_format_print(out + pos, max - pos, conv, star[0], slen, (const char *)args + in);
+			} else {
+				len = sql_format_print(out + pos, max - pos, conv, slen, (const char *)args + in);
+			}
+			in += slen;
+			break;
+		}
+		case '%':
+			out[pos] = '%';
+			len = 1;
+			break;
+		}
+
+		if (len < 0) {
+			return -1;
+		}
+		pos += len;
+		if (pos > max - 1) {
+			pos = max - 1;
+		}
+	}
+
+	out[pos] = '\0';
+	return pos;
+}
+
+/* Rows made of typed values (sql_insert_values) are joined into text with
+   a space between the values.  In async mode the values are packed next to
+   the record as the sql_arg_t array followed by the bytes of the strings,
+   and the writer thread unpacks and joins them.
+*/
+
+/* Longest text sql_format_values makes for one value that isn't a string */
+#define SQL_FMT_NUMBER_MAX	32
+
+/* Room sql_format_values needs for all of the values */
+int
+sql_format_values_size(const sql_arg_t *values, int count)
+{
+	int size = 1;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		size += 1 + (values[i].type == 's' ? values[i].size : SQL_FMT_NUMBER_MAX);
+	}
+	return size;
+}
+
+/* Join values into out, which is always terminated.  Strings must have
+   their size set.  Returns the length of the text.
+*/
+int
+sql_format_values(char *out, int max, const sql_arg_t *values, int count)
+{
+	char number[SQL_FMT_NUMBER_MAX];
+	int pos = 0;
+	int i;
+
+	if (max < 1) {
+		return 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		const char *text = number;
+		int len;
+
+		switch (values[i].type) {
+		case 'i':
+			len = Com_sprintf(number, sizeof(number), "%d", values[i].u.i);
+			break;
+		case 'f':
+			len = Com_sprintf(number, sizeof(number), "%f", values[i].u.d);
+			break;
+		case 's':
+			text = values[i].u.p;
+			len = text != NULL ? values[i].size : 0;
+			break;
+		default:
+			continue;
+		}
+
+		if (pos > 0 && pos < max - 1) {
+			out[pos++] = ' ';
+		}
+		if (len > max - 1 - pos) {
+			len = max - 1 - pos;
+		}
+		Com_Memcpy(out + pos, text, len);
+		pos += len;
+	}
+
+	out[pos] = '\0';
+	return pos;
+}
+
+/* Copy values and the strings they point to into out.  Returns the
+   packed size, which can be more than max (nothing past max is written).
+*/
+int
+sql_format_pack(byte *out, int max, const sql_arg_t *values, int count)
+{
+	int pos = 0;
+	int i;
+
+	sql_format_put(out, max, &pos, &count, sizeof(count));
+	sql_format_put(out, max, &pos, values, count * sizeof(*values));
+	for (i = 0; i < count; i++) {
+		if (values[i].type == 's' && values[i].u.p != NULL) {
+			sql_format_put(out, max, &pos, values[i].u.p, values[i].size);
+		}
+	}
+	return pos;
+}
+
+/* Undo sql_format_pack.  The strings point into packed.  Returns the
+   number of values or -1 if packed is cut short or has more than max.
+*/
+int
+sql_format_unpack(sql_arg_t *values, int max, const byte *packed, int size)
+{
+	int count;
+	int in = 0;
+	int i;
+
+	if (! sql_format_get(packed, size, &in, &count, sizeof(count)) ||
+	    count < 0 || count > max ||
+	    ! sql_format_get(packed, size, &in, values, count * sizeof(*values))) {
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (values[i].type == 's' && values[i].u.p != NULL) {
+			if (values[i].size < 0 || values[i].size > size - in) {
+				return -1;
+			}
+			values[i].u.p = packed + in;
+			in += values[i].size;
+		}
+	}
+	return count;
+}
@@ -3,17 +3,199 @@
 
 #include "q_shared.h"
 #include "qcommon.h"
+#include "sql_trace.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef USE_SQLITE3_ASYNC
+#ifdef _WIN32
+typedef HANDLE sql_thread_t;
+typedef DWORD sql_thread_ret_t;
+#define SQL_THREAD_CALL WINAPI
+#else
+#include <pthread.h>
+typedef pthread_t sql_thread_t;
+typedef void *sql_thread_ret_t;
+#define SQL_THREAD_CALL
+#endif
+#endif
 
 /* Dead simple schema = spreadsheet style
    <autoincrement> <timestamp> <requester> <provider> <type|trap|cmd> <blob or string arg>
+
+   requester, provider and type are integer keys into the small endpoint
+   and msgtype tables.  The q3log view joins the names back in.
+*/
+
+sql_data *sql_logs[SQL_LOG_MAX];
+sql_context_t sql_context = { NULL, NULL, NULL, -1 };
+
+/* Rows per transaction, see sql_commit.  The limit starts at
+   SQL_BATCH_START and adapts between SQL_BATCH_MIN and SQL_BATCH_MAX.
+   Without sql_frame calls a transaction is committed at SQL_BATCH_MAX. */
+#define SQL_BATCH_START	10000
+#define SQL_BATCH_MIN	100
+#define SQL_BATCH_MAX	100000
+
+/* Rows per multi-row INSERT.  Each has 9 parameters, well under the 999
+   SQLite3 allows in a statement by default. */
+#define SQL_BATCH_ROWS	64
+#define SQL_COLUMNS	9
+
+/* Where each logger writes with sql_split 1, and with 0 the name of the
+   shared database if it is the first one opened */
+static const struct {
+	const char *name;
+	const char *file;
+	const char *shared;
+} sql_logFiles[SQL_LOG_MAX] = {
+	[SQL_LOG_QAGAME] = { "qagame", "server_qvm_log.db", "server_qvm_log.db" },
+	[SQL_LOG_CGAME] = { "cgame", "cgame_qvm_log.db", "client_qvm_log.db" },
+	[SQL_LOG_UI] = { "ui", "ui_qvm_log.db", "client_qvm_log.db" },
+	[SQL_LOG_NETCHAN] = { "netchan", "netchan_log.db", "client_qvm_log.db" }
+};
+
+/* sql_logs of each VM namespace, the engine's own messages go to whichever
+   logger the caller uses */
+static const sqlLog_t sql_nsLogs[SQL_NS_MAX] = {
+	[SQL_NS_ENGINE] = SQL_LOG_MAX,
+	[SQL_NS_GAME_IMPORT] = SQL_LOG_QAGAME,
+	[SQL_NS_GAME_EXPORT] = SQL_LOG_QAGAME,
+	[SQL_NS_CGAME_IMPORT] = SQL_LOG_CGAME,
+	[SQL_NS_CGAME_EXPORT] = SQL_LOG_CGAME,
+	[SQL_NS_UI_IMPORT] = SQL_LOG_UI,
+	[SQL_NS_UI_EXPORT] = SQL_LOG_UI
+};
+
+#define SQL_LOGS_SCRIPT "qvm_logs.attach.sql"
+
+/* Open databases and trace files, the commands exist while there are any */
+static int sql_numOpen;
+
+/* Counts every time sql_logs changed, see sql_syscall_generation */
+static int sql_logsChanged;
+
+/* Longest sql_insert_var_text row, anything past this is cut off */
+#define SQL_TEXT_MAX (128 * 1024)
+
+/* Rules for sql_want, see sql_filter_parse */
+static cvar_t *sql_filter;
+
+/* What a row's value column holds */
+typedef enum {
+	SQL_VALUE_NULL,
+	SQL_VALUE_INT,
+	SQL_VALUE_DOUBLE,
+	SQL_VALUE_TEXT,
+	SQL_VALUE_BLOB,
+	SQL_VALUE_FORMAT,	/* u.fmt and arguments packed by sql_format_capture */
+	SQL_VALUE_LIST,		/* sql_insert_values values packed by sql_format_pack */
+	SQL_VALUE_TRAPSTATS,	/* a trap_stats row, the payload is a sql_trap_stats_t */
+	SQL_VALUE_ROTATE,	/* start a new segment, u.i is the sqlRotate_t, the payload the old label */
+	SQL_VALUE_PAD		/* filler at the end of the async ring, never written */
+} sql_value_t;
+
+/* One row of q3log_data.  Text and blob payloads are passed next to the
+   record (or follow it in the async ring).  The time and game state are
+   taken when the record is made, on the calling thread.
+*/
+typedef struct {
+	long long	time;		/* sql_clock */
+	int		frame;
+	int		serverTime;	/* SQL_UNSET when there's no server or client */
+	int		client;		/* -1 for none */
+	int		caller;
+	int		target;
+	int		msgID;
+	int		type;
+	int		size;
+	union {
+		int		i;
+		double		d;
+		const char	*fmt;
+	} u;
+} sql_record_t;
+
+/* How long a payload passed to sql_write_record stays where it is */
+typedef enum {
+	SQL_PAYLOAD_CALL,	/* only during the call */
+	SQL_PAYLOAD_BATCH	/* until the batch is flushed, it's in the async ring */
+} sql_payload_t;
+
+/* SQL_PAYLOAD_CALL payloads this large aren't copied into the batch, the
+   batch is written right away with the row bound where it is */
+#define SQL_BORROW_MIN	4096
+
+/* Rows are staged here and inserted SQL_BATCH_ROWS at a time by logBatch,
+   so SQLite3 runs one statement instead of 64.  Payloads are bound with
+   SQLITE_STATIC, either from where they already are (borrowed) or from a
+   copy in data.
 */
+struct sql_batch_s {
+	int		rows;
+	sql_record_t	rec[SQL_BATCH_ROWS];
+	const void	*borrowed[SQL_BATCH_ROWS];	/* NULL when it was copied */
+	int		offset[SQL_BATCH_ROWS];		/* of the copy in data */
+	int		flags[SQL_BATCH_ROWS];		/* SQL_FLAG_ZLIB when it was compressed */
+	byte		*data;
+	int		used;
+	int		size;
+};
+
+#define SQL_BATCH_PAYLOAD(batch, i) \
+	((batch)->borrowed[i] != NULL ? (batch)->borrowed[i] : (const void *)((batch)->data + (batch)->offset[i]))
 
-sql_data *sql;
+#define SQL_UNSET SQL_TRACE_UNSET
 
-/* How many inserts to do before a transaction ends */
-#define LOG_TRANSACTION_LIMIT 10000
+#define SQL_RECORD(rec, c, t, m, ty, sz) do { \
+	sql_stamp(&(rec), (c), (t)); \
+	(rec).caller = (c); \
+	(rec).target = (t); \
+	(rec).msgID = (m); \
+	(rec).type = (ty); \
+	(rec).size = (sz); \
+} while (0)
 
-static int sql_prep_common(sql_data *newSql, const char *caller, const char *target, const char *msgID);
+static int sql_open_db(sql_data *newSql, const char *filename);
+static int sql_trace_open(sql_data *newSql, const char *filename);
+static int sql_trace_write(sql_trace_t *trace, const sql_record_t *rec, const void *payload);
+static void sql_trace_close(sql_data *newSql);
+static void sql_stamp(sql_record_t *rec, int caller, int target);
+static int sql_bind_row(sqlite3_stmt *stmt, int index, const sql_record_t *rec, const void *payload, int flags);
+static qboolean sql_batch_reserve(sql_batch_t *batch, int size);
+static int sql_batch_add(sql_data *newSql, const sql_record_t *rec, const void *payload, sql_payload_t lifetime);
+static int sql_batch_flush(sql_data *newSql);
+static int sql_write_record(sql_data *newSql, const sql_record_t *rec, const void *payload, sql_payload_t lifetime);
+static int sql_submit(sql_data *newSql, const sql_record_t *rec, const void *payload);
+static int sql_write_trap_stats(sql_data *newSql, const sql_record_t *rec, const sql_trap_stats_t *stats);
+static qboolean sql_scratch(sql_data *newSql, int size);
+static void sql_close_db(sql_data *newSql, qboolean vacuum);
+static int sql_rotate_db(sql_data *newSql, int reason, const char *label, int size);
+static void sql_rotate_warn(sql_data *newSql);
+static void sql_rotate_count(sql_data *newSql, const sql_record_t *rec);
+static void sql_rotate_f(void);
+static void sql_stats_f(void);
+static int sql_commit(sql_data *newSql);
+static qboolean sql_commit_due(const sql_data *newSql);
+
+#ifdef USE_SQLITE3_ASYNC
+static int sql_async_start(sql_data *newSql);
+static void sql_async_stop(sql_data *newSql);
+static byte *sql_async_reserve(sql_async_t *async, int size);
+static void sql_async_publish(sql_async_t *async, const sql_record_t *rec);
+static int sql_async_push(sql_async_t *async, const sql_record_t *rec, const void *payload);
+static void sql_async_release(sql_async_t *async, size_t tail);
+static int sql_async_push_wait(sql_async_t *async, const sql_record_t *rec, const void *payload);
+static int sql_async_format(sql_async_t *async, const sql_record_t *rec);
+static sql_thread_ret_t SQL_THREAD_CALL sql_async_writer(void *arg);
+static void sql_async_stats(const sql_async_t *async);
+#endif
 
 /* If the variable already exists, then increment instance tracking.
    Otherwise, create a new one.
@@ -25,6 +207,9 @@ static int sql_prep_common(sql_data *newSql, const char *caller, const char *tar
 int
 sql_init(sql_data **newSql, const char *filename)
 {
+	const char *profile;
+	int level;
+
 	if (newSql != NULL && *newSql != NULL) {
 		DEBUG_PRINT("This is already an instance");
 		(*newSql)->numInstances++;
@@ -41,73 +226,231 @@ sql_init(sql_data **newSql, const char *filename)
 		return -1;
 	}
 
-	/* Open the database */
-	if (sqlite3_open(filename, &(*newSql)->db) != SQLITE_OK) {
-		SQL_FAIL((*newSql), "Failed to open it");
-		return -1;
+	(*newSql)->keyframeInterval = Cvar_Get("sql_keyframeInterval", "32", CVAR_ARCHIVE)->integer;
+
+	profile = Cvar_Get("sql_profile", "fast", CVAR_ARCHIVE)->string;
+	if (((*newSql)->profile = sql_profile_find(profile)) == NULL) {
+		Com_Printf(S_COLOR_YELLOW "WARNING: unknown sql_profile %s, using safe\n", profile);
+		(*newSql)->profile = sql_profile_find("safe");
+	}
+	sql_filter = Cvar_Get("sql_filter", "", CVAR_ARCHIVE);
+
+	(*newSql)->batchLimit = SQL_BATCH_START;
+	(*newSql)->commitInterval = Cvar_Get("sql_commitInterval", "1000", CVAR_ARCHIVE)->integer * 1000000LL;
+	(*newSql)->commitBudget = Cvar_Get("sql_commitBudget", "4", CVAR_ARCHIVE)->value * 1000000.0;
+
+	/* sql_compress is a zlib level, 0 stores every blob as it is */
+	level = Cvar_Get("sql_compress", "0", CVAR_ARCHIVE)->integer;
+	(*newSql)->compressMin = Cvar_Get("sql_compressMin", "1024", CVAR_ARCHIVE)->integer;
+#ifdef USE_SQLITE3_DEFLATE
+	if (level > 0 && ((*newSql)->deflate = sql_deflate_open(level > 9 ? 9 : level)) == NULL) {
+		DEBUG_PRINT("Failed to start zlib, storing blobs as they are");
+	}
+#else
+	if (level > 0) {
+		Com_Printf(S_COLOR_YELLOW "WARNING: sql_compress needs a build with USE_INTERNAL_ZLIB=0\n");
 	}
+#endif
+
+	Q_strncpyz((*newSql)->filename, filename, sizeof((*newSql)->filename));
+	(*newSql)->rotateRows = Cvar_Get("sql_rotateRows", "0", CVAR_ARCHIVE)->integer;
+	(*newSql)->rotateBytes = Cvar_Get("sql_rotateSize", "0", CVAR_ARCHIVE)->integer * 1024LL * 1024LL;
+	(*newSql)->rotateMap = Cvar_Get("sql_rotateMap", "0", CVAR_ARCHIVE)->integer ? qtrue : qfalse;
+	(*newSql)->rotateVacuum = Cvar_Get("sql_rotateVacuum", "0", CVAR_ARCHIVE)->integer ? qtrue : qfalse;
 
-	/* Create a table to store the data */
-	if (sqlite3_prepare_v2((*newSql)->db,
-	    "CREATE TABLE IF NOT EXISTS q3log"
-	    "("
-	    "  id INTEGER PRIMARY KEY AUTOINCREMENT," /* alias to rowid */
-	    "  tstamp TEXT DEFAULT (strftime('%Y-%m-%dT%H:%M:%f','now')),"
-	    "  caller TEXT NOT NULL,"
-	    "  target TEXT NOT NULL,"
-	    "  msgid  TEXT NOT NULL,"
-	    "  value  BLOB"
-	    ")",
-	    -1,  &(*newSql)->table, NULL) != SQLITE_OK) {
-		SQL_FAIL((*newSql), "Failed to prepare the table statement");
+	/* Either a database or a q3trace file for q3trace2sqlite */
+	if (Cvar_Get("sql_trace", "0", CVAR_ARCHIVE)->integer) {
+		if (! sql_trace_open(*newSql, filename)) {
+			SQL_FAIL((*newSql), "Failed to open the trace file");
+			return -1;
+		}
+	} else if (! sql_open_db(*newSql, filename)) {
+		SQL_FAIL((*newSql), "Failed to open the database");
 		return -1;
+	} else {
+		char report[256];
+
+		if (sql_profile_report((*newSql)->db, (*newSql)->profile, report, sizeof(report)) > 0) {
+			Com_Printf(S_COLOR_YELLOW "WARNING: SQLite3 profile %s didn't fully apply: %s\n", (*newSql)->profile->name, report);
+		} else {
+			Com_Printf("SQLite3 profile %s: %s\n", (*newSql)->profile->name, report);
+		}
+	}
+
+#ifdef USE_SQLITE3_ASYNC
+	/* Everything after this point goes through the writer thread */
+	if (Cvar_Get("sql_async", "1", CVAR_ARCHIVE)->integer) {
+		if (! sql_async_start(*newSql)) {
+			DEBUG_PRINT("Falling back to synchronous inserts");
+		}
 	}
+#endif
+	if (sql_numOpen++ == 0) {
+		sql_stats_init();
+		Cmd_AddCommand("sql_rotate", sql_rotate_f);
+		Cmd_AddCommand("sql_stats", sql_stats_f);
+	}
+
+	(*newSql)->numInstances = 1;
+	return 0;
+}
+
+/* Start logging for a subsystem.  With sql_split 1 (the default) every
+   logger gets a database of its own and qvm_logs.attach.sql is rewritten to
+   attach all the open ones for querying.  With 0 they are references to
+   whichever one is already open.
+
+   Same exit codes as sql_init.
+*/
+int
+sql_open_log(sqlLog_t log)
+{
+	const char *names[SQL_LOG_MAX], *files[SQL_LOG_MAX];
+	qboolean split = Cvar_Get("sql_split", "1", CVAR_ARCHIVE)->integer ? qtrue : qfalse;
+	int i, count, rc;
 
-	/* Execute the prepared statement and free it since we don't need it */
-	if (sqlite3_step((*newSql)->table) != SQLITE_DONE) {
-		SQL_FAIL((*newSql), "Failed to execute the table prepared statement");
+	if (log < 0 || log >= SQL_LOG_MAX) {
+		DEBUG_PRINT("Unknown logger");
 		return -1;
 	}
-	if (sqlite3_finalize((*newSql)->table) != SQLITE_OK) {
-		SQL_FAIL((*newSql), "Failed to finalize table prepared statement");
+	sql_logsChanged++;
+
+	for (i = 0; i < SQL_LOG_MAX && ! split && sql_logs[log] == NULL; i++) {
+		sql_logs[log] = sql_logs[i];
+	}
+	if ((rc = sql_init(&sql_logs[log], split ? sql_logFiles[log].file : sql_logFiles[log].shared)) != 0 || ! split) {
+		return rc;
+	}
+
+	for (i = 0, count = 0; i < SQL_LOG_MAX; i++) {
+		if (sql_logs[i] != NULL && sql_logs[i]->db != NULL) {
+			names[count] = sql_logFiles[i].name;
+			files[count++] = sql_logFiles[i].file;
+		}
+	}
+	sql_write_logs_script(SQL_LOGS_SCRIPT, names, files, count);
+	return rc;
+}
+
+/* Same exit codes as sql_close */
+int
+sql_close_log(sqlLog_t log)
+{
+	int rc;
+
+	if (log < 0 || log >= SQL_LOG_MAX || sql_logs[log] == NULL) {
 		return -1;
 	}
-	(*newSql)->table = NULL;
+	rc = sql_close(&sql_logs[log]);
+	sql_logs[log] = NULL;
+	sql_logsChanged++;
+	return rc;
+}
+
+/* The logger for the messages of a VM namespace, NULL if it isn't open
+   or a write to it failed */
+sql_data *
+sql_log_ns(int ns)
+{
+	sql_data *log;
+
+	if (ns < 0 || ns >= SQL_NS_MAX || sql_nsLogs[ns] == SQL_LOG_MAX) {
+		return NULL;
+	}
+	log = sql_logs[sql_nsLogs[ns]];
+	return log != NULL && ! log->failed ? log : NULL;
+}
+
+/* Open the database, apply the profile, create the schema, prepare the
+   statements and start the first transaction
+*/
+static int
+sql_open_db(sql_data *newSql, const char *filename)
+{
+	char insert[4096];
+	int i;
+
+	/* Open the database */
+	if (sqlite3_open(filename, &newSql->db) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to open it");
+		return 0;
+	}
+
+	/* Before the schema, page_size only applies to an empty database */
+	if (! sql_profile_apply(newSql->db, newSql->profile)) {
+		DEBUG_PRINT("Failed to apply the profile");
+		return 0;
+	}
+
+	if (! sql_create_schema(newSql->db)) {
+		DEBUG_PRINT("Failed to create the schema");
+		return 0;
+	}
+
+	if (! sql_add_session(newSql->db, (double)time(NULL), sql_clock())) {
+		DEBUG_PRINT("Failed to start the session");
+		return 0;
+	}
 
 	/* Create SQL statement with placeholders for inserting data */
-	if (sqlite3_prepare_v2((*newSql)->db,
-	    "INSERT INTO q3log (caller, target, msgid, value)"
-	    "VALUES (?, ?, ?, ?)",
-	    -1, &(*newSql)->log, NULL) != SQLITE_OK) {
-		SQL_FAIL((*newSql), "Failed to prepare the log statement");
-		return -1;
+	if (sqlite3_prepare_v2(newSql->db,
+	    "INSERT INTO q3log_data (tstamp, frame, svtime, client, caller, target, msgid, value, flags)"
+	    "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
+	    -1, &newSql->log, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to prepare the log statement");
+		return 0;
 	}
 
-	if (sqlite3_prepare_v2((*newSql)->db, "BEGIN TRANSACTION", -1, &(*newSql)->begin, NULL) != SQLITE_OK) {
-		SQL_FAIL((*newSql), "Failed to prepare the begin statement");
-		return -1;
+	/* And the same with SQL_BATCH_ROWS rows of values */
+	Q_strncpyz(insert, "INSERT INTO q3log_data (tstamp, frame, svtime, client, caller, target, msgid, value, flags) VALUES ",
+	    sizeof(insert));
+	for (i = 0; i < SQL_BATCH_ROWS; i++) {
+		Q_strcat(insert, sizeof(insert), i > 0 ? ", (?, ?, ?, ?, ?, ?, ?, ?, ?)" : "(?, ?, ?, ?, ?, ?, ?, ?, ?)");
 	}
-	if (sqlite3_prepare_v2((*newSql)->db, "END TRANSACTION", -1, &(*newSql)->end, NULL) != SQLITE_OK) {
-		SQL_FAIL((*newSql), "Failed to prepare the end statement");
-		return -1;
+	if (sqlite3_prepare_v2(newSql->db, insert, -1, &newSql->logBatch, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to prepare the batch log statement");
+		return 0;
 	}
-	if (sqlite3_step((*newSql)->begin) != SQLITE_DONE) {
-		SQL_FAIL((*newSql), "Failed to execute the begin prepared statement");
-		return -1;
+	if (newSql->batch == NULL && (newSql->batch = calloc(1, sizeof(sql_batch_t))) == NULL) {
+		DEBUG_PRINT("Failed to malloc the batch");
+		return 0;
 	}
 
-	(*newSql)->numInstances = 1;
-	return 0;
+	if (sqlite3_prepare_v2(newSql->db,
+	    "INSERT INTO trap_stats (tstamp, msgid, count, total, p50, p99, max)"
+	    "VALUES (?, ?, ?, ?, ?, ?, ?)",
+	    -1, &newSql->stats, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to prepare the trap_stats statement");
+		return 0;
+	}
+
+	if (sqlite3_prepare_v2(newSql->db, "BEGIN TRANSACTION", -1, &newSql->begin, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to prepare the begin statement");
+		return 0;
+	}
+	if (sqlite3_prepare_v2(newSql->db, "END TRANSACTION", -1, &newSql->end, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to prepare the end statement");
+		return 0;
+	}
+	if (sqlite3_step(newSql->begin) != SQLITE_DONE) {
+		DEBUG_PRINT("Failed to execute the begin prepared statement");
+		return 0;
+	}
+	newSql->lastCommit = sql_clock();
+
+	return 1;
 }
 
-/* Close the global symbol if the reference tracking is 1
+/* Close the global symbol if the reference tracking is 1.  A log a
+   rotation left without a database is still open, see sql_rotate_db.
 
    -1 = failure.  0 = closed database.  >= 1 is the reference tracking
 */
 int
 sql_close(sql_data **newSql)
 {
-	if (newSql != NULL && *newSql != NULL && (*newSql)->db != NULL) {
+	if (newSql != NULL && *newSql != NULL && ((*newSql)->db != NULL || (*newSql)->trace != NULL ||
+	    (*newSql)->rotateFailed)) {
 		if ((*newSql)->numInstances > 1) {
 			(*newSql)->numInstances--;
 			DEBUG_PRINT("There are more references out there...");
@@ -125,50 +468,50 @@ sql_close(sql_data **newSql)
 int
 sql_close_local(sql_data **newSql)
 {
-	if (newSql != NULL && *newSql != NULL && (*newSql)->db != NULL) {
+	int i;
+
+	if (newSql != NULL && *newSql != NULL && ((*newSql)->db != NULL || (*newSql)->trace != NULL ||
+	    (*newSql)->rotateFailed)) {
 		if ((*newSql)->numInstances != 1) {
 			DEBUG_PRINT("Call this when there is only one instance left");
 			return -1;
 		}
 
-		// Must finalize all prepared statements and close BLOB handles
-		if ((*newSql)->log != NULL) {
-			if (sqlite3_finalize((*newSql)->log) != SQLITE_OK) {
-				DEBUG_PRINT("Failed to finalize the log");
-			}
-			(*newSql)->log = NULL;
-		}
-		if ((*newSql)->table != NULL) {
-			if (sqlite3_finalize((*newSql)->table) != SQLITE_OK) {
-				DEBUG_PRINT("Fialed to finalize the table");
-			}
-			(*newSql)->table = NULL;
+#ifdef USE_SQLITE3_ASYNC
+		// The writer thread owns the connection until the queue is flushed
+		if ((*newSql)->async != NULL) {
+			sql_async_stop(*newSql);
 		}
-		if ((*newSql)->begin != NULL) {
-			if (sqlite3_finalize((*newSql)->begin) != SQLITE_OK) {
-				DEBUG_PRINT("Fialed to finalize the begin");
-			}
-			(*newSql)->begin = NULL;
+#endif
+		if (--sql_numOpen == 0) {
+			sql_stats_shutdown();
+			Cmd_RemoveCommand("sql_rotate");
+			Cmd_RemoveCommand("sql_stats");
 		}
-		if ((*newSql)->end != NULL) {
-			if (sqlite3_step((*newSql)->end) != SQLITE_DONE) {
-				DEBUG_PRINT("Failed to execute the end prepared statement");
-			}
-			if (sqlite3_finalize((*newSql)->end) != SQLITE_OK) {
-				DEBUG_PRINT("Fialed to finalize the end");
-			}
-			(*newSql)->end = NULL;
+
+		if ((*newSql)->trace != NULL) {
+			sql_trace_close(*newSql);
 		}
 		if ((*newSql)->db != NULL) {
-			if (sqlite3_close((*newSql)->db) != SQLITE_OK) {
-				DEBUG_PRINT("Failed to close the SQLite3 file");
-			}
+			sql_close_db(*newSql, qfalse);
+		}
 
-			(*newSql)->db = NULL;
+		for (i = 0; i < SQL_DELTA_STREAMS; i++) {
+			free((*newSql)->delta[i].prev);
+			free((*newSql)->delta[i].scratch);
+		}
+		free((*newSql)->scratch);
+#ifdef USE_SQLITE3_DEFLATE
+		sql_deflate_close((*newSql)->deflate);
+#endif
+		if ((*newSql)->batch != NULL) {
+			free((*newSql)->batch->data);
+			free((*newSql)->batch);
 		}
 
 		free(*newSql);
 		*newSql = NULL;
+		sql_logsChanged++;
 		return 0;
 
 	} else {
@@ -177,201 +520,1741 @@ sql_close_local(sql_data **newSql)
 	}
 }
 
-int
-sql_insert_var_text(sql_data *newSql, const char *caller, const char *target, const char *msgID, const char *msg, ...)
+/* Finalize the statements, commit and close the database.  vacuum runs
+   VACUUM between the commit and the close.
+*/
+static void
+sql_close_db(sql_data *newSql, qboolean vacuum)
 {
-	int		next_index;
-        va_list         argptr;
-        char            text[128 * 1024];
-
-	if (msg == NULL) {
-		SQL_FAIL(newSql, "Invalid input");
-		return 0;
+	if (newSql->batch != NULL && ! sql_batch_flush(newSql)) {
+		DEBUG_PRINT("Failed to write the last rows");
 	}
 
-        va_start (argptr, msg);
-        Q_vsnprintf (text, sizeof(text), msg, argptr);
-        va_end (argptr);
-
-	if ((next_index = sql_prep_common(newSql, caller, target, msgID)) < 1) {
-		SQL_FAIL(newSql, "Failed to prep");
-		return 0;
+	// Must finalize all prepared statements and close BLOB handles
+	if (newSql->logBatch != NULL) {
+		if (sqlite3_finalize(newSql->logBatch) != SQLITE_OK) {
+			DEBUG_PRINT("Failed to finalize the batch log");
+		}
+		newSql->logBatch = NULL;
 	}
-
-	if (sqlite3_bind_text(newSql->log, next_index, text, strlen(text), SQLITE_TRANSIENT) != SQLITE_OK) {
-		SQL_FAIL(newSql, "Couldn't execute the prepared statement");
-		return 0;
+	if (newSql->log != NULL) {
+		if (sqlite3_finalize(newSql->log) != SQLITE_OK) {
+			DEBUG_PRINT("Failed to finalize the log");
+		}
+		newSql->log = NULL;
 	}
-	if (sqlite3_step(newSql->log) != SQLITE_DONE) {
-		SQL_FAIL(newSql, "Couldn't execute the prepared statement");
-		return 0;
+	if (newSql->stats != NULL) {
+		if (sqlite3_finalize(newSql->stats) != SQLITE_OK) {
+			DEBUG_PRINT("Failed to finalize the trap_stats statement");
+		}
+		newSql->stats = NULL;
 	}
-	return 1;
+	if (newSql->table != NULL) {
+		if (sqlite3_finalize(newSql->table) != SQLITE_OK) {
+			DEBUG_PRINT("Fialed to finalize the table");
+		}
+		newSql->table = NULL;
+	}
+	if (newSql->begin != NULL) {
+		if (sqlite3_finalize(newSql->begin) != SQLITE_OK) {
+			DEBUG_PRINT("Fialed to finalize the begin");
+		}
+		newSql->begin = NULL;
+	}
+	if (newSql->end != NULL) {
+		if (sqlite3_step(newSql->end) != SQLITE_DONE) {
+			DEBUG_PRINT("Failed to execute the end prepared statement");
+		}
+		if (sqlite3_finalize(newSql->end) != SQLITE_OK) {
+			DEBUG_PRINT("Fialed to finalize the end");
+		}
+		newSql->end = NULL;
+	}
+	if (vacuum && sqlite3_exec(newSql->db, "VACUUM", NULL, NULL, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to vacuum the database");
+	}
+	if (sqlite3_close(newSql->db) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to close the SQLite3 file");
+	}
+	newSql->db = NULL;
+	newSql->numInserts = 0;
 }
 
+/* Log segments.
+
+   With sql_rotateRows, sql_rotateSize or sql_rotateMap set the database is
+   closed every so often and renamed to <name>.<id>.db, and a new one is
+   started under the old name, so the live database is always in the same
+   place.  The segment table of the live database lists every closed
+   segment and <name>.attach.sql attaches the newest of them (see
+   sql_write_attach_script).
+
+   The limits are counted on the game thread when rows are queued, and
+   the rotation is queued like a row so the writer thread does it between
+   the right two rows.  Delta streams start over with a keyframe so every
+   segment can be decoded on its own.
+*/
+static const char *sql_rotateReasons[] = {
+	"rows",
+	"size",
+	"map",
+	"command"
+};
+
+/* Start a new segment, or only relabel this one if nothing was logged to
+   it yet.  label is the map the new segment is for, NULL keeps the
+   current one.
+*/
 int
-sql_insert_null(sql_data *newSql, const char *caller, const char *target, const char *msgID)
+sql_rotate(sql_data *newSql, sqlRotate_t reason, const char *label)
 {
-	int next_index = sql_prep_common(newSql, caller, target, msgID);
-	if (next_index < 1) {
-		SQL_FAIL(newSql, "Failed to prep");
+	sql_record_t rec;
+	int i, ok = 1;
+
+	if (newSql == NULL || newSql->trace != NULL || (reason == SQL_ROTATE_MAP && ! newSql->rotateMap)) {
 		return 0;
 	}
-	if (sqlite3_bind_null(newSql->log, next_index) != SQLITE_OK) {
-		SQL_FAIL(newSql, "Couldn't execute the prepared statement");
-		return 0;
+
+	if (newSql->queuedRows > 0) {
+		SQL_RECORD(rec, SQL_EP_SERVER, SQL_EP_SERVER, 0, SQL_VALUE_ROTATE, strlen(newSql->label));
+		rec.u.i = reason;
+#ifdef USE_SQLITE3_ASYNC
+		if (newSql->async != NULL) {
+			ok = sql_async_push_wait(newSql->async, &rec, newSql->label);
+		} else
+#endif
+		ok = sql_rotate_db(newSql, reason, newSql->label, rec.size);
+		sql_rotate_warn(newSql);
+
+		for (i = 0; i < SQL_DELTA_STREAMS; i++) {
+			newSql->delta[i].count = 0;
+		}
+		newSql->queuedRows = 0;
+		newSql->queuedBytes = 0;
 	}
-	if (sqlite3_step(newSql->log) != SQLITE_DONE) {
-		SQL_FAIL(newSql, "Couldn't execute the prepared statement");
-		return 0;
+
+	if (label != NULL) {
+		Q_strncpyz(newSql->label, label, sizeof(newSql->label));
 	}
-	return 1;
+	return ok;
 }
 
-int
-sql_insert_double_ptr(sql_data *newSql, const char *caller, const char *target, const char *msgID, double *value)
+/* Count a queued row towards sql_rotateRows and sql_rotateSize.  The size
+   is the values plus the record, close to what SQLite3 stores.
+*/
+static void
+sql_rotate_count(sql_data *newSql, const sql_record_t *rec)
 {
-	if (value == NULL) {
-		SQL_FAIL(newSql, "Invalid input");
-		return 0;
+	if (rec->type == SQL_VALUE_ROTATE) {
+		return;
 	}
 
-	return sql_insert_double(newSql, caller, target, msgID, *value);
+	newSql->queuedRows++;
+	newSql->queuedBytes += sizeof(*rec) + rec->size;
+
+	if (newSql->rotateRows > 0 && newSql->queuedRows >= newSql->rotateRows) {
+		sql_rotate(newSql, SQL_ROTATE_ROWS, NULL);
+	} else if (newSql->rotateBytes > 0 && newSql->queuedBytes >= newSql->rotateBytes) {
+		sql_rotate(newSql, SQL_ROTATE_SIZE, NULL);
+	}
 }
 
-int
-sql_insert_double(sql_data *newSql, const char *caller, const char *target, const char *msgID, double value)
+/* Tell the console once when rotations start failing, from the game
+   thread since the writer thread can't print */
+static void
+sql_rotate_warn(sql_data *newSql)
 {
-	int next_index;
-	next_index = sql_prep_common(newSql, caller, target, msgID);
-	if (next_index < 1) {
-		SQL_FAIL(newSql, "Failed to prep");
-		return 0;
-	}
-	if (sqlite3_bind_double(newSql->log, next_index, value) != SQLITE_OK) {
-		SQL_FAIL(newSql, "Couldn't execute the prepared statement");
-		return 0;
-	}
-	if (sqlite3_step(newSql->log) != SQLITE_DONE) {
-		SQL_FAIL(newSql, "Couldn't execute the prepared statement");
-		return 0;
+	if (! newSql->rotateFailed) {
+		newSql->rotateWarned = qfalse;
+	} else if (! newSql->rotateWarned) {
+		Com_Printf(S_COLOR_YELLOW "WARNING: %s: couldn't start a new log segment, "
+		    "trying again at the next one\n", newSql->filename);
+		newSql->rotateWarned = qtrue;
 	}
-	return 1;
 }
 
-int
-sql_insert_int(sql_data *newSql, const char *caller, const char *target, const char *msgID, int value)
+/* Open the live database again after a rotation went wrong.  If that
+   fails too, rows are dropped until the next rotation tries again.
+*/
+static int
+sql_rotate_reopen(sql_data *newSql)
 {
-	int next_index;
-
-	next_index = sql_prep_common(newSql, caller, target, msgID);
-	if (next_index < 1) {
-		SQL_FAIL(newSql, "Failed to prep");
-		return 0;
-	}
-	if (sqlite3_bind_int(newSql->log, next_index, value) != SQLITE_OK) {
-		SQL_FAIL(newSql, "Couldn't execute the prepared statement");
-		return 0;
-	}
-	if (sqlite3_step(newSql->log) != SQLITE_DONE) {
-		SQL_FAIL(newSql, "Couldn't execute the prepared statement");
-		return 0;
+	if (sql_open_db(newSql, newSql->filename)) {
+		return 1;
 	}
-	return 1;
+	DEBUG_PRINT("Failed to open the database again, dropping rows");
+	sql_close_db(newSql, qfalse);
+	return 0;
 }
 
-int
-sql_insert_text(sql_data *newSql, const char *caller, const char *target, const char *msgID, const char *value)
+/* Close and rename the database, then start a new one with the segment
+   table carried over.  When that fails, rows keep going to the current
+   database and the next rotation tries again.
+*/
+static int
+sql_rotate_segment(sql_data *newSql, int reason, const char *label, int size)
 {
-	int next_index = sql_prep_common(newSql, caller, target, msgID);
-	if (next_index < 1) {
-		SQL_FAIL(newSql, "Failed to prep");
-		return 0;
+	char base[MAX_OSPATH], file[MAX_OSPATH], script[MAX_OSPATH], name[MAX_QPATH];
+	int id;
+	FILE *f;
+
+	if (newSql->db == NULL) {
+		if (! sql_rotate_reopen(newSql)) {
+			return 0;
+		}
 	}
 
-	if (sqlite3_bind_text(newSql->log, next_index, value, -1, SQLITE_TRANSIENT) != SQLITE_OK) {
-		SQL_FAIL(newSql, "Couldn't execute the prepared statement");
-		return 0;
+	Q_strncpyz(name, label, size + 1 < sizeof(name) ? size + 1 : sizeof(name));
+	COM_StripExtension(newSql->filename, base, sizeof(base));
+
+	/* The id is only known to the manifest, skip files that are in the way */
+	for (id = sql_next_segment(newSql->db); id > 0; id++) {
+		Com_sprintf(file, sizeof(file), "%s.%04d.db", base, id);
+		if ((f = fopen(file, "rb")) == NULL) {
+			break;
+		}
+		fclose(f);
 	}
-	if (sqlite3_step(newSql->log) != SQLITE_DONE) {
-		SQL_FAIL(newSql, "Couldn't execute the prepared statement");
+	if (id <= 0) {
+		DEBUG_PRINT("Failed to read the segment table");
 		return 0;
 	}
-	return 1;
-}
 
-int
-sql_insert_blob(sql_data *newSql, const char *caller, const char *target, const char *msgID, void *value, int size)
-{
-	int next_index;
-	if (value == NULL && size > 0) {
-		SQL_FAIL(newSql, "Invalid input");
+	sql_close_db(newSql, newSql->rotateVacuum);
+
+	if (rename(newSql->filename, file) != 0) {
+		DEBUG_PRINT("Failed to rename the closed segment, appending to it");
+		sql_rotate_reopen(newSql);
 		return 0;
 	}
-	next_index = sql_prep_common(newSql, caller, target, msgID);
-	if (next_index < 1) {
-		SQL_FAIL(newSql, "Failed to prep");
+	if (! sql_open_db(newSql, newSql->filename)) {
+		DEBUG_PRINT("Failed to start a new segment, appending to the closed one");
+		sql_close_db(newSql, qfalse);
+		if (rename(file, newSql->filename) != 0) {
+			DEBUG_PRINT("Failed to put the closed segment back");
+		}
+		sql_rotate_reopen(newSql);
 		return 0;
 	}
 
-	if (sqlite3_bind_blob(newSql->log, next_index, value, size, SQLITE_TRANSIENT) != SQLITE_OK) {
-		SQL_FAIL(newSql, "Couldn't bind the blob");
-		return 0;
-	}
-	if (sqlite3_step(newSql->log) != SQLITE_DONE) {
-		SQL_FAIL(newSql, "Couldn't execute the prepared statement");
+	/* ATTACH can't be run inside the transaction sql_open_db started */
+	if (sqlite3_step(newSql->end) != SQLITE_DONE ||
+	    ! sql_add_segment(newSql->db, id, file, name, sql_rotateReasons[reason]) ||
+	    sqlite3_reset(newSql->begin) != SQLITE_OK ||
+	    sqlite3_step(newSql->begin) != SQLITE_DONE) {
+		DEBUG_PRINT("Failed to add the closed segment");
+
+		/* The new segment is open, it only isn't listed */
+		sqlite3_reset(newSql->end);
+		if (sqlite3_get_autocommit(newSql->db)) {
+			sqlite3_reset(newSql->begin);
+			sqlite3_step(newSql->begin);
+		}
 		return 0;
 	}
+	sqlite3_reset(newSql->end);
+
+	Com_sprintf(script, sizeof(script), "%s.attach.sql", base);
+	sql_write_attach_script(newSql->db, script);
 	return 1;
 }
 
+/* This runs wherever the database is written */
 static int
-sql_prep_common(sql_data *newSql, const char *caller, const char *target, const char *msgID)
+sql_rotate_db(sql_data *newSql, int reason, const char *label, int size)
 {
-	if (newSql->numInserts > LOG_TRANSACTION_LIMIT) {
-		if (sqlite3_step(newSql->end) != SQLITE_DONE) {
-			SQL_FAIL(newSql, "Failed to execute the prepared statement");
-			return 0;
+	int ok = sql_rotate_segment(newSql, reason, label, size);
+
+	newSql->rotateFailed = ! ok;
+	return ok;
+}
+
+/* sql_rotate: start a new segment of every log now */
+static void
+sql_rotate_f(void)
+{
+	int i, j;
+
+	for (i = 0; i < SQL_LOG_MAX; i++) {
+		sql_data *log = sql_logs[i];
+
+		for (j = 0; j < i && sql_logs[j] != log; j++) {
 		}
-		if (sqlite3_step(newSql->begin) != SQLITE_DONE) {
-			SQL_FAIL(newSql, "Failed to execute the prepared statement");
-			return 0;
+		if (log == NULL || j < i) {
+			continue;
 		}
-		newSql->numInserts = 0;
-	} else {
-		newSql->numInserts++;
-	}
 
-	if (sqlite3_reset(newSql->log) != SQLITE_OK) {
-		SQL_FAIL(newSql, "Couldn't reset the prepared statement");
-		return 0;
+		if (log->trace != NULL) {
+			Com_Printf("%s: only a database can be rotated\n", log->filename);
+		} else if (log->queuedRows == 0) {
+			Com_Printf("%s: nothing has been logged to this segment yet\n", log->filename);
+		} else {
+			sql_rotate(log, SQL_ROTATE_COMMAND, NULL);
+		}
 	}
-	// Don't need this since we are rebinding everything but here for a sanity check
-	if (sqlite3_clear_bindings(newSql->log) != SQLITE_OK) {
-		SQL_FAIL(newSql, "Couldn't clear the bindings");
-		return 0;
+}
+
+/* Per message filtering, checked before anything is formatted or copied.
+
+   The sql_filter cvar is a list of rules separated by spaces, applied in order on
+   top of the quiet defaults from sql_names.c:
+
+     NAME      log every call
+     -NAME     don't log it
+     NAME/N    log 1 in N calls
+     NAME@N    log at most N calls per second
+
+   NAME is a msgtype name, a prefix ending in '*' or '*' for everything.
+*/
+typedef enum {
+	SQL_FILTER_ALLOW,
+	SQL_FILTER_DENY,
+	SQL_FILTER_SAMPLE,
+	SQL_FILTER_RATE
+} sql_filter_action_t;
+
+typedef struct {
+	int	action;
+	int	arg;		/* N for sampling, calls per second for rate */
+	int	counter;	/* calls seen, or calls logged this second */
+	int	second;		/* start of the rate window */
+} sql_filter_t;
+
+static sql_filter_t	*sql_filters[SQL_NS_MAX];
+static int		sql_filterModified = -1;
+
+static void
+sql_filter_set(int msgID, int action, int arg)
+{
+	sql_filter_t *f = &sql_filters[SQL_MSG_NS(msgID)][SQL_MSG_NUM(msgID)];
+
+	f->action = action;
+	f->arg = arg;
+	f->counter = 0;
+	f->second = 0;
+}
+
+static void
+sql_filter_parse(void)
+{
+	const char *rules;
+	char *token;
+	int ns, num;
+
+	sql_filterModified = sql_filter->modificationCount;
+
+	for (ns = 0; ns < SQL_NS_MAX; ns++) {
+		if (sql_filters[ns] == NULL) {
+			sql_filters[ns] = calloc(sql_msg_count(ns) + 1, sizeof(sql_filter_t));
+			if (sql_filters[ns] == NULL) {
+				Com_Error(ERR_FATAL, "Failed to malloc the SQLite3 filters");
+			}
+		} else {
+			Com_Memset(sql_filters[ns], 0, (sql_msg_count(ns) + 1) * sizeof(sql_filter_t));
+		}
 	}
 
-	int index = 1;
-	if (sqlite3_bind_text(newSql->log, index, caller, -1, SQLITE_TRANSIENT) != SQLITE_OK) {
-		SQL_FAIL(newSql, "Couldn't reset the prepared statement");
-		return 0;
+	for (ns = 0; ns < SQL_NS_MAX; ns++) {
+		for (num = 0; num < sql_msg_count(ns); num++) {
+			const sql_msg_t *m = sql_msg(SQL_MSG(ns, num));
+			if (m != NULL && m->quiet) {
+				sql_filter_set(SQL_MSG(ns, num), SQL_FILTER_DENY, 0);
+			}
+		}
 	}
-	index++;
 
-	if (sqlite3_bind_text(newSql->log, index, target, -1, SQLITE_TRANSIENT) != SQLITE_OK) {
-		SQL_FAIL(newSql, "Couldn't reset the prepared statement");
-		return 0;
+	rules = sql_filter->string;
+	while (*(token = COM_ParseExt((char **)&rules, qfalse)) != '\0') {
+		int action = SQL_FILTER_ALLOW;
+		int arg = 0;
+		int matched = 0;
+		char name[MAX_TOKEN_CHARS];
+		char *p;
+		size_t len;
+
+		if (token[0] == '-') {
+			action = SQL_FILTER_DENY;
+			token++;
+		}
+		Q_strncpyz(name, token, sizeof(name));
+		if ((p = strchr(name, '/')) != NULL) {
+			action = SQL_FILTER_SAMPLE;
+			*p++ = '\0';
+			arg = atoi(p);
+		} else if ((p = strchr(name, '@')) != NULL) {
+			action = SQL_FILTER_RATE;
+			*p++ = '\0';
+			arg = atoi(p);
+		}
+		if (action == SQL_FILTER_SAMPLE && arg <= 1) {
+			action = arg == 1 ? SQL_FILTER_ALLOW : SQL_FILTER_DENY;
+		} else if (action == SQL_FILTER_RATE && arg <= 0) {
+			action = SQL_FILTER_DENY;
+		}
+
+		len = strlen(name);
+		if (len > 0 && name[len - 1] == '*') {
+			len--;
+		} else {
+			len++;	/* match the terminator too */
+		}
+
+		for (ns = 0; ns < SQL_NS_MAX; ns++) {
+			for (num = 0; num < sql_msg_count(ns); num++) {
+				const char *msgName = sql_msg_name(SQL_MSG(ns, num));
+				if (msgName != NULL && ! Q_strncmp(msgName, name, len)) {
+					sql_filter_set(SQL_MSG(ns, num), action, arg);
+					matched++;
+				}
+			}
+		}
+		if (! matched) {
+			Com_Printf(S_COLOR_YELLOW "WARNING: sql_filter rule '%s' doesn't match any message\n", token);
+		}
 	}
-	index++;
+}
 
-	if (sqlite3_bind_text(newSql->log, index, msgID, -1, SQLITE_TRANSIENT) != SQLITE_OK) {
-		SQL_FAIL(newSql, "Couldn't reset the prepared statement");
-		return 0;
+/* Should a row with this msgID be logged right now?  This also advances
+   the sampling and rate counters so only call it once per row.
+*/
+qboolean
+sql_want(int msgID)
+{
+	int ns = SQL_MSG_NS(msgID);
+	int num = SQL_MSG_NUM(msgID);
+	sql_filter_t *f;
+
+	if (sql_filter == NULL) {
+		return qtrue;
+	}
+	if (sql_filter->modificationCount != sql_filterModified) {
+		sql_filter_parse();
+	}
+	if (ns >= SQL_NS_MAX || num >= sql_msg_count(ns)) {
+		return qtrue;
+	}
+
+	f = &sql_filters[ns][num];
+	switch (f->action) {
+	case SQL_FILTER_DENY:
+		return qfalse;
+	case SQL_FILTER_SAMPLE:
+		return (f->counter++ % f->arg) == 0;
+	case SQL_FILTER_RATE:
+	{
+		int second = Sys_Milliseconds() / 1000;
+		if (second != f->second) {
+			f->second = second;
+			f->counter = 0;
+		}
+		return f->counter++ < f->arg;
+	}
+	default:
+		return qtrue;
+	}
+}
+
+/* Whether sql_want turns down every call of msgID.  Unlike sql_want it
+   doesn't count the call against a sampling or rate rule. */
+qboolean
+sql_unwanted(int msgID)
+{
+	int ns = SQL_MSG_NS(msgID);
+	int num = SQL_MSG_NUM(msgID);
+
+	if (sql_filter == NULL) {
+		return qfalse;
+	}
+	if (sql_filter->modificationCount != sql_filterModified) {
+		sql_filter_parse();
+	}
+	if (ns >= SQL_NS_MAX || num >= sql_msg_count(ns)) {
+		return qfalse;
+	}
+	return sql_filters[ns][num].action == SQL_FILTER_DENY;
+}
+
+/* Changes whenever sql_syscall_logged could answer differently: a log was
+   opened or closed, or sql_filter or sql_trapStats was set.  VM_Call only
+   looks at which traps compiled code can call directly when it does. */
+int
+sql_syscall_generation(void)
+{
+	return sql_logsChanged + (sql_filter != NULL ? sql_filter->modificationCount : 0) + sql_stats_generation();
+}
+
+int
+sql_insert_var_text(sql_data *newSql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, const char *msg, ...)
+{
+	sql_record_t	rec;
+	va_list		argptr;
+	int		len;
+
+	if (msg == NULL) {
+		SQL_FAILED(newSql, "Invalid input");
+		return 0;
+	}
+
+	if (newSql == NULL || ! sql_want(msgID)) {
+		return 0;
+	}
+
+	if (newSql->scratch == NULL && ! sql_scratch(newSql, 1)) {
+		return 0;
+	}
+
+#ifdef USE_SQLITE3_ASYNC
+	/* Leave the formatting to the writer thread, just pack the arguments */
+	if (newSql->async != NULL) {
+		for (;;) {
+			va_start(argptr, msg);
+			len = sql_format_capture(newSql->scratch, newSql->scratchSize, msg, argptr);
+			va_end(argptr);
+
+			if (len <= newSql->scratchSize) {
+				break;
+			}
+			if (! sql_scratch(newSql, len)) {
+				return 0;
+			}
+		}
+
+		if (len >= 0) {
+			SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_FORMAT, len);
+			rec.u.fmt = msg;
+			return sql_async_push(newSql->async, &rec, newSql->scratch);
+		}
+		/* Something sql_format_capture can't defer, format it here */
+	}
+#endif
+
+	for (;;) {
+		va_start(argptr, msg);
+		len = Q_vsnprintf((char *)newSql->scratch, newSql->scratchSize, msg, argptr);
+		va_end(argptr);
+
+		if (len >= 0 && len < newSql->scratchSize) {
+			break;
+		}
+		if (newSql->scratchSize >= SQL_TEXT_MAX) {
+			len = newSql->scratchSize - 1;
+			break;
+		}
+		if (! sql_scratch(newSql, len < 0 || len >= SQL_TEXT_MAX ? SQL_TEXT_MAX : len + 1)) {
+			return 0;
+		}
+	}
+
+	SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_TEXT, len);
+	return sql_submit(newSql, &rec, newSql->scratch);
+}
+
+int
+sql_insert_null(sql_data *newSql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID)
+{
+	sql_record_t rec;
+
+	if (! sql_want(msgID)) {
+		return 0;
+	}
+
+	SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_NULL, 0);
+	return sql_submit(newSql, &rec, NULL);
+}
+
+int
+sql_insert_double_ptr(sql_data *newSql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, double *value)
+{
+	if (value == NULL) {
+		SQL_FAILED(newSql, "Invalid input");
+		return 0;
+	}
+
+	return sql_insert_double(newSql, caller, target, msgID, *value);
+}
+
+int
+sql_insert_double(sql_data *newSql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, double value)
+{
+	sql_record_t rec;
+
+	if (! sql_want(msgID)) {
+		return 0;
+	}
+
+	SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_DOUBLE, 0);
+	rec.u.d = value;
+	return sql_submit(newSql, &rec, NULL);
+}
+
+int
+sql_insert_int(sql_data *newSql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, int value)
+{
+	sql_record_t rec;
+
+	if (! sql_want(msgID)) {
+		return 0;
+	}
+
+	SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_INT, 0);
+	rec.u.i = value;
+	return sql_submit(newSql, &rec, NULL);
+}
+
+int
+sql_insert_text(sql_data *newSql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, const char *value)
+{
+	sql_record_t rec;
+
+	if (value == NULL) {
+		SQL_FAILED(newSql, "Invalid input");
+		return 0;
+	}
+
+	if (! sql_want(msgID)) {
+		return 0;
+	}
+
+	SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_TEXT, strlen(value));
+	return sql_submit(newSql, &rec, value);
+}
+
+int
+sql_insert_blob(sql_data *newSql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, void *value, int size)
+{
+	sql_record_t rec;
+
+	if ((value == NULL && size > 0) || size < 0) {
+		SQL_FAILED(newSql, "Invalid input");
+		return 0;
+	}
+
+	if (! sql_want(msgID)) {
+		return 0;
+	}
+
+	SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_BLOB, size);
+	return sql_submit(newSql, &rec, value);
+}
+
+/* Log the arguments (and results) of a trap.  A single value is stored
+   as itself, several are joined into text with spaces between them.  A
+   blob is stored on its own, the other values are dropped.
+*/
+int
+sql_insert_values(sql_data *newSql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, sql_arg_t *values, int count)
+{
+	sql_record_t rec;
+	int i, len;
+
+	if ((values == NULL && count > 0) || count < 0 || count > SQL_ARGS_MAX) {
+		SQL_FAILED(newSql, "Invalid input");
+		return 0;
+	}
+
+	if (newSql == NULL || ! sql_want(msgID)) {
+		return 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (values[i].type == 'b') {
+			if (values[i].u.p == NULL) {
+				break;
+			}
+			SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_BLOB, values[i].size);
+			return sql_submit(newSql, &rec, values[i].u.p);
+		}
+		if (values[i].type == 's' && values[i].size < 0) {
+			values[i].size = values[i].u.p != NULL ? strlen(values[i].u.p) : 0;
+		}
+	}
+
+	if (i < count || count == 0) {
+		SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_NULL, 0);
+		return sql_submit(newSql, &rec, NULL);
+	}
+
+	if (count == 1) {
+		switch (values[0].type) {
+		case 'i':
+			SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_INT, 0);
+			rec.u.i = values[0].u.i;
+			return sql_submit(newSql, &rec, NULL);
+		case 'f':
+			SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_DOUBLE, 0);
+			rec.u.d = values[0].u.d;
+			return sql_submit(newSql, &rec, NULL);
+		default:
+			SQL_RECORD(rec, caller, target, msgID, values[0].u.p != NULL ? SQL_VALUE_TEXT : SQL_VALUE_NULL,
+			    values[0].u.p != NULL ? values[0].size : 0);
+			return sql_submit(newSql, &rec, values[0].u.p);
+		}
+	}
+
+	if (newSql->scratch == NULL && ! sql_scratch(newSql, 1)) {
+		return 0;
+	}
+
+#ifdef USE_SQLITE3_ASYNC
+	/* Leave the joining to the writer thread, like sql_insert_var_text */
+	if (newSql->async != NULL) {
+		while ((len = sql_format_pack(newSql->scratch, newSql->scratchSize, values, count)) > newSql->scratchSize) {
+			if (! sql_scratch(newSql, len)) {
+				return 0;
+			}
+		}
+		SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_LIST, len);
+		return sql_async_push(newSql->async, &rec, newSql->scratch);
+	}
+#endif
+
+	len = sql_format_values_size(values, count);
+	if (len > newSql->scratchSize && ! sql_scratch(newSql, len < SQL_TEXT_MAX ? len : SQL_TEXT_MAX)) {
+		return 0;
+	}
+	len = sql_format_values((char *)newSql->scratch, newSql->scratchSize, values, count);
+
+	SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_TEXT, len);
+	return sql_submit(newSql, &rec, newSql->scratch);
+}
+
+/* Log a structure that changes a little at a time.  Every
+   sql_keyframeInterval-th value of a msgID is stored in full, the rest
+   as a delta against the previous one (see sql_delta.c).  The q3_undelta
+   SQL function in the bundled sqlite3 shell rebuilds them.
+*/
+int
+sql_insert_delta(sql_data *newSql, sqlEndpoint_t caller, sqlEndpoint_t target, int msgID, const void *value, int size)
+{
+	sql_delta_t *stream = NULL;
+	const unsigned char *prev;
+	sql_record_t rec;
+	int i, len;
+
+	if (value == NULL || size <= 0) {
+		SQL_FAILED(newSql, "Invalid input");
+		return 0;
+	}
+	if (newSql == NULL || newSql->failed) {
+		return 0;
+	}
+
+	if (! sql_want(msgID)) {
+		return 0;
+	}
+
+	/* The stream for msgID wherever it is, a failed malloc can leave
+	   a free slot ahead of it */
+	for (i = 0; i < SQL_DELTA_STREAMS; i++) {
+		if (newSql->delta[i].prev != NULL && newSql->delta[i].msgID == msgID) {
+			stream = &newSql->delta[i];
+			break;
+		}
+	}
+	for (i = 0; stream == NULL && i < SQL_DELTA_STREAMS; i++) {
+		if (newSql->delta[i].prev == NULL) {
+			stream = &newSql->delta[i];
+		}
+	}
+	if (stream == NULL) {
+		DEBUG_PRINT("Out of delta streams, storing it in full");
+		return sql_insert_blob(newSql, caller, target, msgID, (void *)value, size);
+	}
+
+	if (stream->size != size) {
+		free(stream->prev);
+		free(stream->scratch);
+		stream->prev = malloc(size);
+		stream->scratch = malloc(sql_delta_bound(size));
+		if (stream->prev == NULL || stream->scratch == NULL) {
+			free(stream->prev);
+			free(stream->scratch);
+			Com_Memset(stream, 0, sizeof(*stream));
+			SQL_FAILED(newSql, "Failed to malloc");
+			return 0;
+		}
+		stream->msgID = msgID;
+		stream->size = size;
+		stream->count = 0;
+	}
+
+	if (stream->count == 0 || newSql->keyframeInterval <= 1 ||
+	    stream->count % newSql->keyframeInterval == 0) {
+		prev = NULL;
+	} else {
+		prev = stream->prev;
+	}
+
+#ifdef USE_SQLITE3_ASYNC
+	if (newSql->async != NULL) {
+		unsigned char *out;
+
+		/* Encode it straight into the queue.  A row dropped from a full
+		   queue breaks the chain, start over. */
+		if ((out = sql_async_reserve(newSql->async, sql_delta_bound(size))) == NULL) {
+			stream->count = 0;
+			return 0;
+		}
+		len = sql_delta_encode(prev, value, size, out);
+		Com_Memcpy(stream->prev, value, size);
+		stream->count++;
+
+		SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_BLOB, len);
+		sql_async_publish(newSql->async, &rec);
+		return 1;
+	}
+#endif
+
+	len = sql_delta_encode(prev, value, size, stream->scratch);
+	Com_Memcpy(stream->prev, value, size);
+	stream->count++;
+
+	SQL_RECORD(rec, caller, target, msgID, SQL_VALUE_BLOB, len);
+	return sql_submit(newSql, &rec, stream->scratch);
+}
+
+int
+sql_insert_trap_stats(sql_data *newSql, int msgID, const sql_trap_stats_t *stats)
+{
+	sql_record_t rec;
+
+	if (stats == NULL) {
+		SQL_FAILED(newSql, "Invalid input");
+		return 0;
+	}
+
+	SQL_RECORD(rec, SQL_EP_SERVER, SQL_EP_SERVER, msgID, SQL_VALUE_TRAPSTATS, sizeof(*stats));
+	return sql_submit(newSql, &rec, stats);
+}
+
+/* Either queue the record for the writer thread or write it right now */
+static int
+sql_submit(sql_data *newSql, const sql_record_t *rec, const void *payload)
+{
+	if (newSql == NULL || newSql->failed) {
+		return 0;
+	}
+
+#ifdef USE_SQLITE3_ASYNC
+	if (newSql->async != NULL) {
+		return sql_async_push(newSql->async, rec, payload);
+	}
+#endif
+
+	if (! sql_write_record(newSql, rec, payload, SQL_PAYLOAD_CALL)) {
+		SQL_FAILED(newSql, "Couldn't execute the prepared statement");
+		return 0;
+	}
+	sql_rotate_count(newSql, rec);
+	return 1;
+}
+
+/* Make the sql_insert_var_text scratch buffer at least size bytes */
+static qboolean
+sql_scratch(sql_data *newSql, int size)
+{
+	int newSize = newSql->scratchSize > 0 ? newSql->scratchSize : 1024;
+	byte *scratch;
+
+	while (newSize < size) {
+		newSize *= 2;
+	}
+	if ((scratch = realloc(newSql->scratch, newSize)) == NULL) {
+		DEBUG_PRINT("Failed to grow the scratch buffer");
+		return qfalse;
+	}
+	newSql->scratch = scratch;
+	newSql->scratchSize = newSize;
+	return qtrue;
+}
+
+/* Write a single row, or stage it for the next multi-row insert.  This
+   never closes the database on failure since it also runs on the writer
+   thread.
+*/
+static int
+sql_write_record(sql_data *newSql, const sql_record_t *rec, const void *payload, sql_payload_t lifetime)
+{
+	if (newSql->trace != NULL) {
+		return sql_trace_write(newSql->trace, rec, payload);
+	}
+
+	if (rec->type == SQL_VALUE_ROTATE) {
+		return sql_rotate_db(newSql, rec->u.i, payload, rec->size);
+	}
+	if (newSql->db == NULL) {
+		/* A rotation left nothing open, see sql_rotate_db */
+		newSql->numLost++;
+		return 1;
+	}
+
+	if (rec->type == SQL_VALUE_TRAPSTATS) {
+		return sql_write_trap_stats(newSql, rec, payload);
+	}
+
+	return sql_batch_add(newSql, rec, payload, lifetime);
+}
+
+/* Bind the SQL_COLUMNS values of a row starting at parameter index.  Every
+   parameter is bound for every row, so neither statement needs
+   sqlite3_clear_bindings.  The payload is bound with SQLITE_STATIC and has
+   to stay put until the statement is stepped.  flags is NULL when it's 0.
+*/
+static int
+sql_bind_row(sqlite3_stmt *stmt, int index, const sql_record_t *rec, const void *payload, int flags)
+{
+	int rc;
+
+	if (sqlite3_bind_int64(stmt, index, rec->time) != SQLITE_OK ||
+	    sqlite3_bind_int(stmt, index + 1, rec->frame) != SQLITE_OK ||
+	    (rec->serverTime == SQL_UNSET ? sqlite3_bind_null(stmt, index + 2) :
+	    sqlite3_bind_int(stmt, index + 2, rec->serverTime)) != SQLITE_OK ||
+	    (rec->client < 0 ? sqlite3_bind_null(stmt, index + 3) :
+	    sqlite3_bind_int(stmt, index + 3, rec->client)) != SQLITE_OK ||
+	    sqlite3_bind_int(stmt, index + 4, rec->caller) != SQLITE_OK ||
+	    sqlite3_bind_int(stmt, index + 5, rec->target) != SQLITE_OK ||
+	    sqlite3_bind_int(stmt, index + 6, rec->msgID) != SQLITE_OK ||
+	    (flags == 0 ? sqlite3_bind_null(stmt, index + 8) :
+	    sqlite3_bind_int(stmt, index + 8, flags)) != SQLITE_OK) {
+		DEBUG_PRINT("Couldn't bind the row");
+		return 0;
+	}
+
+	index += 7;
+	switch (rec->type) {
+	case SQL_VALUE_NULL:
+		rc = sqlite3_bind_null(stmt, index);
+		break;
+	case SQL_VALUE_INT:
+		rc = sqlite3_bind_int(stmt, index, rec->u.i);
+		break;
+	case SQL_VALUE_DOUBLE:
+		rc = sqlite3_bind_double(stmt, index, rec->u.d);
+		break;
+	case SQL_VALUE_TEXT:
+		rc = sqlite3_bind_text(stmt, index, payload, rec->size, SQLITE_STATIC);
+		break;
+	case SQL_VALUE_BLOB:
+		rc = sqlite3_bind_blob(stmt, index, payload, rec->size, SQLITE_STATIC);
+		break;
+	default:
+		DEBUG_PRINT("Unknown record type");
+		return 0;
+	}
+
+	if (rc != SQLITE_OK) {
+		DEBUG_PRINT("Couldn't bind the value");
+		return 0;
+	}
+	return 1;
+}
+
+/* Make room for size more bytes of payload copies in the batch */
+static qboolean
+sql_batch_reserve(sql_batch_t *batch, int size)
+{
+	int newSize = batch->size > 0 ? batch->size : 64 * 1024;
+	byte *data;
+
+	if (batch->used + size <= batch->size) {
+		return qtrue;
+	}
+	while (newSize < batch->used + size) {
+		newSize *= 2;
+	}
+	if ((data = realloc(batch->data, newSize)) == NULL) {
+		DEBUG_PRINT("Failed to grow the batch");
+		return qfalse;
+	}
+	batch->data = data;
+	batch->size = newSize;
+	return qtrue;
+}
+
+/* Stage a row, inserting the batch when it's full.  The payload is only
+   copied when it's small and won't be around until the batch is written,
+   or compressed into the batch when it's a large enough blob.
+*/
+static int
+sql_batch_add(sql_data *newSql, const sql_record_t *rec, const void *payload, sql_payload_t lifetime)
+{
+	sql_batch_t *batch = newSql->batch;
+	int size = rec->type == SQL_VALUE_TEXT || rec->type == SQL_VALUE_BLOB ? rec->size : 0;
+	qboolean borrow = size > 0 && (lifetime == SQL_PAYLOAD_BATCH || size >= SQL_BORROW_MIN);
+	int flags = 0;
+
+	if (rec->type > SQL_VALUE_BLOB) {
+		DEBUG_PRINT("Unknown record type");
+		return 0;
+	}
+
+	/* Only when nothing calls sql_frame, like during a long map load */
+	if (newSql->numInserts >= SQL_BATCH_MAX && ! sql_commit(newSql)) {
+		return 0;
+	}
+
+#ifdef USE_SQLITE3_DEFLATE
+	if (newSql->deflate != NULL && rec->type == SQL_VALUE_BLOB && size >= newSql->compressMin) {
+		int len;
+
+		if (! sql_batch_reserve(batch, size)) {
+			return 0;
+		}
+		if ((len = sql_deflate(newSql->deflate, payload, size, batch->data + batch->used)) > 0) {
+			newSql->compressIn += size;
+			newSql->compressOut += len;
+			flags = SQL_FLAG_ZLIB;
+			size = len;
+			borrow = qfalse;
+		}
+	}
+#endif
+
+	if (! borrow && ! sql_batch_reserve(batch, size)) {
+		return 0;
+	}
+
+	batch->rec[batch->rows] = *rec;
+	batch->rec[batch->rows].size = size;
+	batch->borrowed[batch->rows] = borrow ? payload : NULL;
+	batch->offset[batch->rows] = batch->used;
+	batch->flags[batch->rows] = flags;
+	if (! borrow && size > 0) {
+		if (! (flags & SQL_FLAG_ZLIB)) {
+			Com_Memcpy(batch->data + batch->used, payload, size);
+		}
+		batch->used += size;
+	}
+	batch->rows++;
+	newSql->numInserts++;
+
+	if (batch->rows == SQL_BATCH_ROWS || (borrow && lifetime == SQL_PAYLOAD_CALL)) {
+		return sql_batch_flush(newSql);
+	}
+	return 1;
+}
+
+/* Insert the staged rows.  A full batch is one logBatch statement, what's
+   left before a commit goes through the single row statement.  The rows
+   are dropped either way.
+*/
+static int
+sql_batch_flush(sql_data *newSql)
+{
+	sql_batch_t *batch = newSql->batch;
+	int i, ok = 1;
+
+	if (batch->rows == SQL_BATCH_ROWS) {
+		if (sqlite3_reset(newSql->logBatch) != SQLITE_OK) {
+			DEBUG_PRINT("Couldn't reset the batch statement");
+			ok = 0;
+		}
+		for (i = 0; i < batch->rows && ok; i++) {
+			ok = sql_bind_row(newSql->logBatch, i * SQL_COLUMNS + 1, &batch->rec[i], SQL_BATCH_PAYLOAD(batch, i),
+			    batch->flags[i]);
+		}
+		if (ok && sqlite3_step(newSql->logBatch) != SQLITE_DONE) {
+			DEBUG_PRINT("Couldn't execute the batch statement");
+			ok = 0;
+		}
+	} else {
+		for (i = 0; i < batch->rows && ok; i++) {
+			if (sqlite3_reset(newSql->log) != SQLITE_OK) {
+				DEBUG_PRINT("Couldn't reset the prepared statement");
+				ok = 0;
+			} else if (! sql_bind_row(newSql->log, 1, &batch->rec[i], SQL_BATCH_PAYLOAD(batch, i), batch->flags[i])) {
+				ok = 0;
+			} else if (sqlite3_step(newSql->log) != SQLITE_DONE) {
+				DEBUG_PRINT("Couldn't execute the prepared statement");
+				ok = 0;
+			}
+		}
+	}
+
+	batch->rows = 0;
+	batch->used = 0;
+	return ok;
+}
+
+static int
+sql_write_trap_stats(sql_data *newSql, const sql_record_t *rec, const sql_trap_stats_t *stats)
+{
+	sql_trap_stats_t row;
+
+	/* The payload may not be aligned in the async ring */
+	Com_Memcpy(&row, stats, sizeof(row));
+
+	if (sqlite3_reset(newSql->stats) != SQLITE_OK ||
+	    sqlite3_bind_int64(newSql->stats, 1, rec->time) != SQLITE_OK ||
+	    sqlite3_bind_int(newSql->stats, 2, rec->msgID) != SQLITE_OK ||
+	    sqlite3_bind_int64(newSql->stats, 3, row.count) != SQLITE_OK ||
+	    sqlite3_bind_int64(newSql->stats, 4, row.total) != SQLITE_OK ||
+	    sqlite3_bind_int64(newSql->stats, 5, row.p50) != SQLITE_OK ||
+	    sqlite3_bind_int64(newSql->stats, 6, row.p99) != SQLITE_OK ||
+	    sqlite3_bind_int64(newSql->stats, 7, row.max) != SQLITE_OK ||
+	    sqlite3_step(newSql->stats) != SQLITE_DONE) {
+		DEBUG_PRINT("Couldn't write the trap_stats row");
+		return 0;
+	}
+	return 1;
+}
+
+/* Commit policy.
+
+   Rows are committed once sql_commitInterval ms have passed since the last
+   commit or there are batchLimit of them, whichever comes first.  Without
+   the writer thread this is only checked by sql_frame, so the game never
+   stalls in the middle of a frame for a commit.  The writer thread checks
+   it between batches of rows.
+
+   Every commit is timed and batchLimit moves a quarter of the way towards
+   the number of rows that would have fit in sql_commitBudget ms, so a
+   busy server commits smaller batches more often instead of hitching.
+*/
+static int
+sql_commit(sql_data *newSql)
+{
+	long long start = sql_clock();
+	long long took, fit;
+
+	if (! sql_batch_flush(newSql)) {
+		DEBUG_PRINT("Failed to write the batch");
+	}
+	if (sqlite3_step(newSql->end) != SQLITE_DONE) {
+		DEBUG_PRINT("Failed to execute the end prepared statement");
+		return 0;
+	}
+	sqlite3_reset(newSql->end);
+	if (sqlite3_reset(newSql->begin) != SQLITE_OK || sqlite3_step(newSql->begin) != SQLITE_DONE) {
+		DEBUG_PRINT("Failed to execute the begin prepared statement");
+		return 0;
+	}
+	newSql->lastCommit = sql_clock();
+	took = newSql->lastCommit - start;
+
+	if (newSql->commitBudget > 0 && newSql->numInserts > 0) {
+		fit = (long long)newSql->numInserts * newSql->commitBudget / (took > 0 ? took : 1);
+		if (fit > SQL_BATCH_MAX) {
+			fit = SQL_BATCH_MAX;
+		}
+		newSql->batchLimit += (fit - newSql->batchLimit) / 4;
+		if (newSql->batchLimit < SQL_BATCH_MIN) {
+			newSql->batchLimit = SQL_BATCH_MIN;
+		} else if (newSql->batchLimit > SQL_BATCH_MAX) {
+			newSql->batchLimit = SQL_BATCH_MAX;
+		}
+	}
+	newSql->lastCommitTime = took;
+	newSql->numInserts = 0;
+	return 1;
+}
+
+static qboolean
+sql_commit_due(const sql_data *newSql)
+{
+	return newSql->db != NULL && newSql->numInserts > 0 &&
+	    (newSql->numInserts >= newSql->batchLimit ||
+	    sql_clock() - newSql->lastCommit >= newSql->commitInterval);
+}
+
+/* Called from Com_Frame once the server and client frames are done.  A
+   shared logger is checked once per reference, which doesn't matter.
+*/
+void
+sql_frame(void)
+{
+	int i;
+
+	for (i = 0; i < SQL_LOG_MAX; i++) {
+		sql_data *log = sql_logs[i];
+
+		/* Every reference is closed, the last one frees it */
+		if (log != NULL && log->failed) {
+			sql_close_log(i);
+			continue;
+		}
+		if (log == NULL || log->trace != NULL) {
+			continue;
+		}
+		sql_rotate_warn(log);
+#ifdef USE_SQLITE3_ASYNC
+		if (log->async != NULL) {
+			continue;
+		}
+#endif
+		if (sql_commit_due(log) && ! sql_commit(log)) {
+			SQL_FAILED(log, "Failed to commit");
+			sql_close_log(i);
+		}
+	}
+}
+
+/* The commit policy, and the queue when there's a writer thread, of every
+   log.  Read without a lock while the writer may be changing it, which is
+   fine for a console report. */
+static void
+sql_stats_f(void)
+{
+	int i, j;
+
+	for (i = 0; i < SQL_LOG_MAX; i++) {
+		sql_data *log = sql_logs[i];
+
+		for (j = 0; j < i && sql_logs[j] != log; j++) {
+		}
+		if (log == NULL || log->trace != NULL || j < i) {
+			continue;
+		}
+		Com_Printf("%s: %d rows pending, batch limit %d rows, last commit took %.2f ms\n",
+		    log->filename, (int)log->numInserts, log->batchLimit, log->lastCommitTime / 1e6);
+		if (log->numLost > 0) {
+			Com_Printf("  %lu rows dropped with no database open\n", (unsigned long)log->numLost);
+		}
+		if (log->compressIn > 0) {
+			Com_Printf("  compressed %.1f MB of blobs to %.1f MB\n",
+			    log->compressIn / (1024.0 * 1024.0), log->compressOut / (1024.0 * 1024.0));
+		}
+#ifdef USE_SQLITE3_ASYNC
+		if (log->async != NULL) {
+			sql_async_stats(log->async);
+		}
+#endif
+	}
+}
+
+/* Monotonic nanoseconds, only differences between two values mean anything */
+long long
+sql_clock(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	if (freq.QuadPart == 0) {
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&now);
+	return (now.QuadPart / freq.QuadPart) * 1000000000LL +
+	    (now.QuadPart % freq.QuadPart) * 1000000000LL / freq.QuadPart;
+#elif defined(__APPLE__)
+	static mach_timebase_info_data_t timebase;
+
+	if (timebase.denom == 0) {
+		mach_timebase_info(&timebase);
+	}
+	return (long long)(mach_absolute_time() * timebase.numer / timebase.denom);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+/* Take the time and the game state for a new record */
+static void
+sql_stamp(sql_record_t *rec, int caller, int target)
+{
+	qboolean client = (caller == SQL_EP_CLIENT || caller == SQL_EP_CGAME_QVM || caller == SQL_EP_UI_QVM ||
+	    target == SQL_EP_CLIENT || target == SQL_EP_CGAME_QVM || target == SQL_EP_UI_QVM);
+	const int *serverTime = client ? sql_context.clientTime : sql_context.serverTime;
+
+	rec->time = sql_clock();
+	rec->frame = com_frameNumber;
+	rec->serverTime = serverTime != NULL ? *serverTime : SQL_UNSET;
+	if (client) {
+		rec->client = sql_context.localClient != NULL ? *sql_context.localClient : -1;
+	} else {
+		rec->client = sql_context.serverClient;
+	}
+}
+
+#ifdef USE_SQLITE3_ASYNC
+/* Single producer (game thread) / single consumer (writer thread) ring.
+
+   Records are a sql_record_t header followed by the text/blob payload,
+   padded to SQL_ASYNC_ALIGN.  A record never wraps; the producer fills
+   the tail end of the buffer with an SQL_VALUE_PAD record instead.
+   head and tail only grow and are masked on access.
+*/
+#define SQL_ASYNC_ALIGN		8
+#define SQL_ASYNC_PAD(x)	(((x) + SQL_ASYNC_ALIGN - 1) & ~(size_t)(SQL_ASYNC_ALIGN - 1))
+
+#if defined(__GNUC__)
+#define SQL_ATOMIC_LOAD(p)	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SQL_ATOMIC_STORE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+/* x86 doesn't reorder loads with loads or stores with stores */
+#define SQL_ATOMIC_LOAD(p)	(*(volatile size_t *)(p))
+#define SQL_ATOMIC_STORE(p, v)	(*(volatile size_t *)(p) = (v))
+#endif
+
+struct sql_async_s {
+	byte		*buffer;
+	size_t		size;		/* power of two */
+	size_t		head;		/* written by the producer only */
+	size_t		tail;		/* written by the consumer only */
+	size_t		running;
+	qboolean	block;		/* wait for room instead of dropping */
+
+	/* producer side counters */
+	size_t		numQueued;
+	size_t		numDropped;
+	size_t		numStalls;
+	size_t		highWater;
+	size_t		reserved;	/* where sql_async_reserve put the record */
+	size_t		reservedUsed;
+
+	/* consumer side counters */
+	size_t		numWritten;
+	size_t		numFailed;
+	char		*text;		/* SQL_VALUE_FORMAT and SQL_VALUE_LIST rows are expanded here */
+
+	sql_data	*owner;
+	sql_thread_t	thread;
+};
+
+static void
+sql_async_sleep(int usec)
+{
+#ifdef _WIN32
+	Sleep(usec / 1000);
+#else
+	struct timespec ts;
+
+	ts.tv_sec = 0;
+	ts.tv_nsec = usec * 1000;
+	nanosleep(&ts, NULL);
+#endif
+}
+
+/* Make room for a record with up to size bytes of payload and return
+   where the payload goes, or NULL when there's no room and it's dropped.
+   Nothing is queued until sql_async_publish, so the payload can be built
+   in place.
+*/
+static byte *
+sql_async_reserve(sql_async_t *async, int size)
+{
+	size_t need = SQL_ASYNC_PAD(sizeof(sql_record_t) + size);
+	size_t head = async->head;
+	size_t offset = head & (async->size - 1);
+	size_t pad = 0;
+	size_t used;
+	qboolean stalled = qfalse;
+
+	/* Anything this large would starve everything else, drop it */
+	if (need > async->size / 2) {
+		async->numDropped++;
+		return NULL;
+	}
+
+	if (offset + need > async->size) {
+		pad = async->size - offset;
+	}
+
+	while ((used = head - SQL_ATOMIC_LOAD(&async->tail)) + pad + need > async->size) {
+		if (! async->block) {
+			if (async->numDropped++ == 0) {
+				Com_Printf(S_COLOR_YELLOW "WARNING: SQLite3 queue is full, dropping log records\n");
+			}
+			return NULL;
+		}
+		if (! stalled) {
+			async->numStalls++;
+			stalled = qtrue;
+		}
+		sql_async_sleep(50);
+	}
+
+	if (pad > 0) {
+		if (pad >= sizeof(sql_record_t)) {
+			((sql_record_t *)(async->buffer + offset))->type = SQL_VALUE_PAD;
+		}
+		head += pad;
+		offset = 0;
+	}
+
+	async->reserved = head;
+	async->reservedUsed = used + pad;
+	return async->buffer + offset + sizeof(sql_record_t);
+}
+
+/* Queue the record sql_async_reserve made room for.  rec->size can be less
+   than what was reserved. */
+static void
+sql_async_publish(sql_async_t *async, const sql_record_t *rec)
+{
+	size_t need = SQL_ASYNC_PAD(sizeof(*rec) + rec->size);
+
+	Com_Memcpy(async->buffer + (async->reserved & (async->size - 1)), rec, sizeof(*rec));
+	SQL_ATOMIC_STORE(&async->head, async->reserved + need);
+
+	async->numQueued++;
+	if (async->reservedUsed + need > async->highWater) {
+		async->highWater = async->reservedUsed + need;
+	}
+
+	sql_rotate_count(async->owner, rec);
+}
+
+static int
+sql_async_push(sql_async_t *async, const sql_record_t *rec, const void *payload)
+{
+	byte *out;
+
+	if ((out = sql_async_reserve(async, rec->size)) == NULL) {
+		return 0;
+	}
+	if (rec->size > 0) {
+		Com_Memcpy(out, payload, rec->size);
+	}
+	sql_async_publish(async, rec);
+	return 1;
+}
+
+/* Push a record that can't be dropped, waiting for room even without
+   sql_asyncBlock */
+static int
+sql_async_push_wait(sql_async_t *async, const sql_record_t *rec, const void *payload)
+{
+	qboolean block = async->block;
+	int ok;
+
+	async->block = qtrue;
+	ok = sql_async_push(async, rec, payload);
+	async->block = block;
+	return ok;
+}
+
+/* Expand a deferred sql_insert_var_text or sql_insert_values row and
+   write it as text */
+static int
+sql_async_format(sql_async_t *async, const sql_record_t *rec)
+{
+	sql_record_t text = *rec;
+	sql_arg_t values[SQL_ARGS_MAX];
+	int len, count;
+
+	if (rec->type == SQL_VALUE_LIST) {
+		if ((count = sql_format_unpack(values, SQL_ARGS_MAX, (const byte *)(rec + 1), rec->size)) < 0) {
+			DEBUG_PRINT("Packed values are cut short");
+			return 0;
+		}
+		len = sql_format_values(async->text, SQL_TEXT_MAX, values, count);
+	} else if ((len = sql_format_replay(async->text, SQL_TEXT_MAX, rec->u.fmt, (const byte *)(rec + 1), rec->size)) < 0) {
+		DEBUG_PRINT("Packed arguments don't match the format");
+		return 0;
+	}
+	text.type = SQL_VALUE_TEXT;
+	text.size = len;
+	return sql_write_record(async->owner, &text, async->text, SQL_PAYLOAD_CALL);
+}
+
+/* Write the batch, so no row points into the ring before tail any more,
+   and hand that space back to the producer */
+static void
+sql_async_release(sql_async_t *async, size_t tail)
+{
+	sql_batch_t *batch = async->owner->batch;
+
+	if (batch != NULL && batch->rows > 0 && ! sql_batch_flush(async->owner)) {
+		async->numFailed++;
+	}
+	SQL_ATOMIC_STORE(&async->tail, tail);
+}
+
+/* Drain the ring into the database until asked to stop and the ring is empty.
+
+   Rows are staged with their payloads left in the ring, so the ring space
+   is only handed back once the batch holding them has been written.  When
+   the writer has caught up, or the batch holds half the ring, it's written
+   early.
+*/
+static sql_thread_ret_t SQL_THREAD_CALL
+sql_async_writer(void *arg)
+{
+	sql_async_t *async = arg;
+	size_t tail = async->tail;
+
+	for (;;) {
+		size_t head = SQL_ATOMIC_LOAD(&async->head);
+
+		/* Between batches is as close to between frames as this gets */
+		if (sql_commit_due(async->owner)) {
+			if (! sql_commit(async->owner)) {
+				/* Those rows are gone, don't stop writing new ones */
+				async->owner->numInserts = 0;
+				async->numFailed++;
+			}
+			sql_async_release(async, tail);
+		}
+
+		if (tail == head) {
+			sql_async_release(async, tail);
+			if (! SQL_ATOMIC_LOAD(&async->running)) {
+				break;
+			}
+			sql_async_sleep(1000);
+			continue;
+		}
+
+		while (tail != head && async->owner->numInserts < async->owner->batchLimit) {
+			size_t offset = tail & (async->size - 1);
+			const sql_record_t *rec = (const sql_record_t *)(async->buffer + offset);
+			const sql_batch_t *batch = async->owner->batch;
+
+			if (async->size - offset < sizeof(sql_record_t) || rec->type == SQL_VALUE_PAD) {
+				tail += async->size - offset;
+			} else {
+				if (rec->type == SQL_VALUE_FORMAT || rec->type == SQL_VALUE_LIST ? sql_async_format(async, rec) :
+				    sql_write_record(async->owner, rec, rec + 1, SQL_PAYLOAD_BATCH)) {
+					async->numWritten++;
+				} else {
+					async->numFailed++;
+				}
+				tail += SQL_ASYNC_PAD(sizeof(*rec) + rec->size);
+			}
+
+			if (batch == NULL || batch->rows == 0) {
+				SQL_ATOMIC_STORE(&async->tail, tail);
+			} else if (tail - async->tail > async->size / 2) {
+				sql_async_release(async, tail);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int
+sql_async_start(sql_data *newSql)
+{
+	sql_async_t *async;
+	size_t size = 1;
+	size_t want = Cvar_Get("sql_asyncBufferSize", "4096", CVAR_ARCHIVE)->integer;
+
+	/* Round the size in KB up to a power of two */
+	want = (want < 64 ? 64 : want) * 1024;
+	while (size < want) {
+		size <<= 1;
+	}
+
+	if ((async = calloc(sizeof(sql_async_t), 1)) == NULL) {
+		DEBUG_PRINT("Failed to malloc the queue");
+		return 0;
+	}
+	if ((async->buffer = malloc(size)) == NULL || (async->text = malloc(SQL_TEXT_MAX)) == NULL) {
+		DEBUG_PRINT("Failed to malloc the queue buffer");
+		free(async->buffer);
+		free(async);
+		return 0;
+	}
+	async->size = size;
+	async->block = Cvar_Get("sql_asyncBlock", "0", CVAR_ARCHIVE)->integer ? qtrue : qfalse;
+	async->owner = newSql;
+	async->running = 1;
+
+#ifdef _WIN32
+	async->thread = CreateThread(NULL, 0, sql_async_writer, async, 0, NULL);
+	if (async->thread == NULL) {
+#else
+	if (pthread_create(&async->thread, NULL, sql_async_writer, async) != 0) {
+#endif
+		DEBUG_PRINT("Failed to start the writer thread");
+		free(async->text);
+		free(async->buffer);
+		free(async);
+		return 0;
+	}
+
+	newSql->async = async;
+	Com_Printf("SQLite3 writer thread started with a %d KB queue\n", (int)(size / 1024));
+	return 1;
+}
+
+static void
+sql_async_stats(const sql_async_t *async)
+{
+	Com_Printf("SQLite3 queue: %lu queued, %lu written, %lu failed, %lu dropped, %lu stalls, "
+	    "high water %lu of %lu KB\n",
+	    (unsigned long)async->numQueued, (unsigned long)async->numWritten,
+	    (unsigned long)async->numFailed, (unsigned long)async->numDropped,
+	    (unsigned long)async->numStalls, (unsigned long)(async->highWater / 1024),
+	    (unsigned long)(async->size / 1024));
+}
+
+/* Let the writer drain everything that was queued and wait for it to exit */
+static void
+sql_async_stop(sql_data *newSql)
+{
+	sql_async_t *async = newSql->async;
+
+	SQL_ATOMIC_STORE(&async->running, 0);
+#ifdef _WIN32
+	WaitForSingleObject(async->thread, INFINITE);
+	CloseHandle(async->thread);
+#else
+	pthread_join(async->thread, NULL);
+#endif
+	newSql->async = NULL;
+
+	sql_async_stats(async);
+	free(async->text);
+	free(async->buffer);
+	free(async);
+}
+#endif /* USE_SQLITE3_ASYNC */
+
+/*
+ * Trace backend: length-prefixed records appended to a q3trace file (see
+ * sql_trace.h) instead of a database.  Records are copied into a large
+ * buffer that is written out when it fills, so an insert costs a memcpy.
+ * q3trace2sqlite loads the file into the usual schema afterwards.
+ */
+
+#define SQL_TRACE_BUFFER (1024 * 1024)
+
+struct sql_trace_s {
+	FILE		*file;
+	byte		*buffer;
+	int		used;
+	size_t		numRecords;
+	size_t		numBytes;
+};
+
+static int
+sql_trace_flush(sql_trace_t *trace)
+{
+	if (trace->used > 0 && fwrite(trace->buffer, 1, trace->used, trace->file) != trace->used) {
+		DEBUG_PRINT("Failed to write the trace file");
+		trace->used = 0;
+		return 0;
+	}
+	trace->used = 0;
+	return 1;
+}
+
+static int
+sql_trace_open(sql_data *newSql, const char *filename)
+{
+	sql_trace_t *trace;
+	sqlTraceHeader_t header;
+	char name[MAX_OSPATH];
+
+	COM_StripExtension(filename, name, sizeof(name));
+	Q_strcat(name, sizeof(name), ".q3trace");
+
+	if ((trace = calloc(sizeof(sql_trace_t), 1)) == NULL ||
+	    (trace->buffer = malloc(SQL_TRACE_BUFFER)) == NULL) {
+		DEBUG_PRINT("Failed to malloc the trace buffer");
+		free(trace);
+		return 0;
+	}
+	if ((trace->file = fopen(name, "wb")) == NULL) {
+		DEBUG_PRINT("Failed to open the trace file");
+		free(trace->buffer);
+		free(trace);
+		return 0;
+	}
+
+	Com_Memset(&header, 0, sizeof(header));
+	Q_strncpyz(header.magic, SQL_TRACE_MAGIC, sizeof(header.magic));
+	header.version = SQL_TRACE_VERSION;
+	header.byteOrder = SQL_TRACE_BYTE_ORDER;
+	header.startTime = (double)time(NULL);
+	header.startClock = sql_clock();
+
+	Com_Memcpy(trace->buffer, &header, sizeof(header));
+	trace->used = sizeof(header);
+
+	newSql->trace = trace;
+	Com_Printf("SQLite3 logging to the trace file %s\n", name);
+	return 1;
+}
+
+static int
+sql_trace_write(sql_trace_t *trace, const sql_record_t *rec, const void *payload)
+{
+	sqlTraceRecord_t out;
+
+	out.time = rec->time;
+	out.size = rec->size;
+	out.caller = rec->caller;
+	out.target = rec->target;
+	out.msgID = rec->msgID;
+	out.frame = rec->frame;
+	out.serverTime = rec->serverTime;
+	out.client = rec->client;
+
+	switch (rec->type) {
+	case SQL_VALUE_NULL:
+		out.type = SQL_TRACE_NULL;
+		out.size = 0;
+		break;
+	case SQL_VALUE_INT:
+		out.type = SQL_TRACE_INT;
+		out.size = sizeof(rec->u.i);
+		payload = &rec->u.i;
+		break;
+	case SQL_VALUE_DOUBLE:
+		out.type = SQL_TRACE_DOUBLE;
+		out.size = sizeof(rec->u.d);
+		payload = &rec->u.d;
+		break;
+	case SQL_VALUE_TEXT:
+		out.type = SQL_TRACE_TEXT;
+		break;
+	case SQL_VALUE_BLOB:
+		out.type = SQL_TRACE_BLOB;
+		break;
+	case SQL_VALUE_TRAPSTATS:
+		/* Not part of the trace format, sql_trapstats still works */
+		return 1;
+	default:
+		DEBUG_PRINT("Unknown record type");
+		return 0;
+	}
+
+	if (trace->used + sizeof(out) + out.size > SQL_TRACE_BUFFER && ! sql_trace_flush(trace)) {
+		return 0;
+	}
+
+	if (sizeof(out) + out.size > SQL_TRACE_BUFFER) {
+		/* Too big to buffer, write it straight through */
+		if (fwrite(&out, sizeof(out), 1, trace->file) != 1 ||
+		    fwrite(payload, 1, out.size, trace->file) != out.size) {
+			DEBUG_PRINT("Failed to write the trace file");
+			return 0;
+		}
+	} else {
+		Com_Memcpy(trace->buffer + trace->used, &out, sizeof(out));
+		if (out.size > 0) {
+			Com_Memcpy(trace->buffer + trace->used + sizeof(out), payload, out.size);
+		}
+		trace->used += sizeof(out) + out.size;
+	}
+
+	trace->numRecords++;
+	trace->numBytes += sizeof(out) + out.size;
+	return 1;
+}
+
+static void
+sql_trace_close(sql_data *newSql)
+{
+	sql_trace_t *trace = newSql->trace;
+
+	sql_trace_flush(trace);
+	if (fclose(trace->file) != 0) {
+		DEBUG_PRINT("Failed to close the trace file");
 	}
-	index++;
+	Com_Printf("SQLite3 trace: %lu records, %lu KB\n",
+	    (unsigned long)trace->numRecords, (unsigned long)(trace->numBytes / 1024));
 
-	return index;
+	free(trace->buffer);
+	free(trace);
+	newSql->trace = NULL;
 }
 
 #if 0
@@ -385,7 +2268,7 @@ main(void)
 		exit(EXIT_FAILURE);
 	}
 
-	if (! sql_insert_text(dat, "cgame_QVM", "client", "CG_PRINTF", "test")) {
+	if (! sql_insert_text(dat, SQL_EP_CGAME_QVM, SQL_EP_CLIENT, SQL_ENGINE(SQL_MSG_COMMANDSTRING), "test")) {
 		SQL_FAIL(dat, "Failed to insert an entry");
 		exit(EXIT_FAILURE);
 	}
@@ -0,0 +1,565 @@
+/* Names for the endpoint and msgtype dictionary tables, and what
+   sql_syscall logs for every trap.
+
+   The msgtype IDs are SQL_MSG(namespace, number) where number is the trap
+   or export number from g_public.h, cg_public.h and ui_public.h, so the
+   tables below are indexed by those same enums and the names are made
+   from them.
+
+   The args of a trap has one letter per args[] slot, starting at args[1]:
+
+     i   int
+     f   float
+     s   string
+     n   string, no longer than the int in the next slot
+     S   string buffer the trap fills in
+     I   pointer to an int the trap fills in
+     b   size bytes
+     B   size bytes the trap fills in
+     L   list of ints the trap fills in, as many as it returns
+     .   not logged
+
+   followed by an optional return value: =i for an int, =f for a float or
+   =q for a qboolean that says whether the buffers were filled in (the row
+   is NULL when it's qfalse).  A trap with a b, B or L only logs those bytes,
+   a single value is stored as that type and anything else as the values
+   separated by spaces.  Quiet traps aren't logged unless a sql_filter rule
+   asks for them.
+*/
+
+#include "q_shared.h"
+#include "qcommon.h"
+#include "../renderer/tr_types.h"
+#include "../game/g_public.h"
+#include "../cgame/cg_public.h"
+#include "../ui/ui_public.h"
+
+#define SQL_NAME(num)				[num] = { #num }
+#define SQL_TRAP(num, args)			[num] = { #num, args, 0, qfalse }
+#define SQL_QUIET(num, args)			[num] = { #num, args, 0, qtrue }
+#define SQL_TRAP_BLOB(num, args, type)		[num] = { #num, args, sizeof(type), qfalse }
+#define SQL_QUIET_BLOB(num, args, type)		[num] = { #num, args, sizeof(type), qtrue }
+
+static const char *sql_endpointNames[SQL_EP_MAX] = {
+	[SQL_EP_SERVER] = "server",
+	[SQL_EP_CLIENT] = "client",
+	[SQL_EP_QAGAME_QVM] = "qagame_QVM",
+	[SQL_EP_CGAME_QVM] = "cgame_QVM",
+	[SQL_EP_UI_QVM] = "ui_QVM"
+};
+
+/* Messages that don't map to a VM trap or export */
+static const sql_msg_t sql_engineMsgs[] = {
+	[SQL_MSG_SNAPSHOT] = { "snapshot" },
+	[SQL_MSG_GAMESTATE] = { "gamestate" },
+	[SQL_MSG_COMMANDSTRING] = { "commandString" },
+	[SQL_MSG_VM_CREATE] = { "VM_Create" },
+	[SQL_MSG_VM_RESTART] = { "VM_Restart" },
+	[SQL_MSG_VM_CALL] = { "VM_Call" }
+};
+
+/* gameImport_t and the shared TRAP_ numbers */
+static const sql_msg_t sql_gameImportMsgs[] = {
+	SQL_TRAP(G_PRINT, "s"),
+	SQL_TRAP(G_ERROR, "s"),
+	SQL_TRAP(G_MILLISECONDS, "=i"),
+	SQL_TRAP(G_CVAR_REGISTER, ".ssi"),
+	SQL_QUIET(G_CVAR_UPDATE, ""),
+	SQL_TRAP(G_CVAR_SET, "ss"),
+	SQL_TRAP(G_CVAR_VARIABLE_INTEGER_VALUE, "s=i"),
+	SQL_TRAP(G_CVAR_VARIABLE_STRING_BUFFER, "sS"),
+	SQL_TRAP(G_ARGC, "=i"),
+	SQL_TRAP(G_ARGV, "iS"),
+	SQL_QUIET(G_FS_FOPEN_FILE, "s"),
+	SQL_QUIET(G_FS_READ, ".i"),
+	SQL_QUIET(G_FS_WRITE, ".i"),
+	SQL_QUIET(G_FS_FCLOSE_FILE, "i"),
+	SQL_TRAP(G_SEND_CONSOLE_COMMAND, "is"),
+	SQL_TRAP(G_LOCATE_GAME_DATA, ".ii.i"),
+	SQL_TRAP(G_DROP_CLIENT, "is"),
+	SQL_TRAP(G_SEND_SERVER_COMMAND, "is"),
+	SQL_TRAP(G_SET_CONFIGSTRING, "is"),
+	SQL_TRAP(G_GET_CONFIGSTRING, "iS"),
+	SQL_TRAP(G_GET_USERINFO, "iS"),
+	SQL_TRAP(G_SET_USERINFO, "is"),
+	SQL_TRAP(G_GET_SERVERINFO, "S"),
+	SQL_TRAP(G_SET_BRUSH_MODEL, ".s"),
+	SQL_TRAP_BLOB(G_TRACE, "B", trace_t),
+	SQL_TRAP(G_POINT_CONTENTS, ".i=i"),
+	SQL_TRAP(G_IN_PVS, "=i"),
+	SQL_TRAP(G_IN_PVS_IGNORE_PORTALS, "=i"),
+	SQL_TRAP_BLOB(G_ADJUST_AREA_PORTAL_STATE, "b", sharedEntity_t),
+	SQL_TRAP(G_AREAS_CONNECTED, "ii=i"),
+	SQL_TRAP_BLOB(G_LINKENTITY, "B", sharedEntity_t),
+	SQL_TRAP_BLOB(G_UNLINKENTITY, "b", sharedEntity_t),
+	SQL_TRAP(G_ENTITIES_IN_BOX, "..L"),
+	SQL_TRAP(G_ENTITY_CONTACT, "=i"),
+	SQL_TRAP(G_BOT_ALLOCATE_CLIENT, "=i"),
+	SQL_TRAP(G_BOT_FREE_CLIENT, "i"),
+	SQL_TRAP_BLOB(G_GET_USERCMD, ".B", usercmd_t),
+	SQL_TRAP(G_GET_ENTITY_TOKEN, "S=i"),
+	SQL_QUIET(G_FS_GETFILELIST, "ss"),
+	SQL_QUIET(G_DEBUG_POLYGON_CREATE, ""),
+	SQL_QUIET(G_DEBUG_POLYGON_DELETE, ""),
+	SQL_TRAP(G_REAL_TIME, "=i"),
+	SQL_QUIET(G_SNAPVECTOR, ""),
+	SQL_TRAP_BLOB(G_TRACECAPSULE, "B", trace_t),
+	SQL_TRAP(G_ENTITY_CONTACTCAPSULE, "=i"),
+	SQL_QUIET(G_FS_SEEK, "iii"),
+	SQL_QUIET(TRAP_MEMSET, "..i"),
+	SQL_QUIET(TRAP_MEMCPY, "..i"),
+	SQL_TRAP(TRAP_STRNCPY, ".ni"),
+	SQL_QUIET(TRAP_SIN, "f"),
+	SQL_QUIET(TRAP_COS, "f"),
+	SQL_QUIET(TRAP_ATAN2, "ff"),
+	SQL_QUIET(TRAP_SQRT, "f"),
+	SQL_QUIET(TRAP_MATRIXMULTIPLY, ""),
+	SQL_QUIET(TRAP_ANGLEVECTORS, ""),
+	SQL_QUIET(TRAP_PERPENDICULARVECTOR, ""),
+	SQL_QUIET(TRAP_FLOOR, "f"),
+	SQL_QUIET(TRAP_CEIL, "f"),
+	SQL_TRAP(TRAP_TESTPRINTINT, ""),
+	SQL_TRAP(TRAP_TESTPRINTFLOAT, ""),
+	SQL_QUIET(BOTLIB_SETUP, ""),
+	SQL_QUIET(BOTLIB_SHUTDOWN, ""),
+	SQL_QUIET(BOTLIB_LIBVAR_SET, ""),
+	SQL_QUIET(BOTLIB_LIBVAR_GET, ""),
+	SQL_QUIET(BOTLIB_PC_ADD_GLOBAL_DEFINE, ""),
+	SQL_QUIET(BOTLIB_START_FRAME, ""),
+	SQL_QUIET(BOTLIB_LOAD_MAP, ""),
+	SQL_QUIET(BOTLIB_UPDATENTITY, ""),
+	SQL_QUIET(BOTLIB_TEST, ""),
+	SQL_QUIET(BOTLIB_GET_SNAPSHOT_ENTITY, ""),
+	SQL_QUIET(BOTLIB_GET_CONSOLE_MESSAGE, ""),
+	SQL_QUIET(BOTLIB_USER_COMMAND, ""),
+	SQL_QUIET(BOTLIB_AAS_ENABLE_ROUTING_AREA, ""),
+	SQL_QUIET(BOTLIB_AAS_BBOX_AREAS, ""),
+	SQL_QUIET(BOTLIB_AAS_AREA_INFO, ""),
+	SQL_QUIET(BOTLIB_AAS_ENTITY_INFO, ""),
+	SQL_QUIET(BOTLIB_AAS_INITIALIZED, ""),
+	SQL_QUIET(BOTLIB_AAS_PRESENCE_TYPE_BOUNDING_BOX, ""),
+	SQL_QUIET(BOTLIB_AAS_TIME, ""),
+	SQL_QUIET(BOTLIB_AAS_POINT_AREA_NUM, ""),
+	SQL_QUIET(BOTLIB_AAS_TRACE_AREAS, ""),
+	SQL_QUIET(BOTLIB_AAS_POINT_CONTENTS, ""),
+	SQL_QUIET(BOTLIB_AAS_NEXT_BSP_ENTITY, ""),
+	SQL_QUIET(BOTLIB_AAS_VALUE_FOR_BSP_EPAIR_KEY, ""),
+	SQL_QUIET(BOTLIB_AAS_VECTOR_FOR_BSP_EPAIR_KEY, ""),
+	SQL_QUIET(BOTLIB_AAS_FLOAT_FOR_BSP_EPAIR_KEY, ""),
+	SQL_QUIET(BOTLIB_AAS_INT_FOR_BSP_EPAIR_KEY, ""),
+	SQL_QUIET(BOTLIB_AAS_AREA_REACHABILITY, ""),
+	SQL_QUIET(BOTLIB_AAS_AREA_TRAVEL_TIME_TO_GOAL_AREA, ""),
+	SQL_QUIET(BOTLIB_AAS_SWIMMING, ""),
+	SQL_QUIET(BOTLIB_AAS_PREDICT_CLIENT_MOVEMENT, ""),
+	SQL_QUIET(BOTLIB_EA_SAY, ""),
+	SQL_QUIET(BOTLIB_EA_SAY_TEAM, ""),
+	SQL_QUIET(BOTLIB_EA_COMMAND, ""),
+	SQL_QUIET(BOTLIB_EA_ACTION, ""),
+	SQL_QUIET(BOTLIB_EA_GESTURE, ""),
+	SQL_QUIET(BOTLIB_EA_TALK, ""),
+	SQL_QUIET(BOTLIB_EA_ATTACK, ""),
+	SQL_QUIET(BOTLIB_EA_USE, ""),
+	SQL_QUIET(BOTLIB_EA_RESPAWN, ""),
+	SQL_QUIET(BOTLIB_EA_CROUCH, ""),
+	SQL_QUIET(BOTLIB_EA_MOVE_UP, ""),
+	SQL_QUIET(BOTLIB_EA_MOVE_DOWN, ""),
+	SQL_QUIET(BOTLIB_EA_MOVE_FORWARD, ""),
+	SQL_QUIET(BOTLIB_EA_MOVE_BACK, ""),
+	SQL_QUIET(BOTLIB_EA_MOVE_LEFT, ""),
+	SQL_QUIET(BOTLIB_EA_MOVE_RIGHT, ""),
+	SQL_QUIET(BOTLIB_EA_SELECT_WEAPON, ""),
+	SQL_QUIET(BOTLIB_EA_JUMP, ""),
+	SQL_QUIET(BOTLIB_EA_DELAYED_JUMP, ""),
+	SQL_QUIET(BOTLIB_EA_MOVE, ""),
+	SQL_QUIET(BOTLIB_EA_VIEW, ""),
+	SQL_QUIET(BOTLIB_EA_END_REGULAR, ""),
+	SQL_QUIET(BOTLIB_EA_GET_INPUT, ""),
+	SQL_QUIET(BOTLIB_EA_RESET_INPUT, ""),
+	SQL_QUIET(BOTLIB_AI_LOAD_CHARACTER, ""),
+	SQL_QUIET(BOTLIB_AI_FREE_CHARACTER, ""),
+	SQL_QUIET(BOTLIB_AI_CHARACTERISTIC_FLOAT, ""),
+	SQL_QUIET(BOTLIB_AI_CHARACTERISTIC_BFLOAT, ""),
+	SQL_QUIET(BOTLIB_AI_CHARACTERISTIC_INTEGER, ""),
+	SQL_QUIET(BOTLIB_AI_CHARACTERISTIC_BINTEGER, ""),
+	SQL_QUIET(BOTLIB_AI_CHARACTERISTIC_STRING, ""),
+	SQL_QUIET(BOTLIB_AI_ALLOC_CHAT_STATE, ""),
+	SQL_QUIET(BOTLIB_AI_FREE_CHAT_STATE, ""),
+	SQL_QUIET(BOTLIB_AI_QUEUE_CONSOLE_MESSAGE, ""),
+	SQL_QUIET(BOTLIB_AI_REMOVE_CONSOLE_MESSAGE, ""),
+	SQL_QUIET(BOTLIB_AI_NEXT_CONSOLE_MESSAGE, ""),
+	SQL_QUIET(BOTLIB_AI_NUM_CONSOLE_MESSAGE, ""),
+	SQL_QUIET(BOTLIB_AI_INITIAL_CHAT, ""),
+	SQL_QUIET(BOTLIB_AI_REPLY_CHAT, ""),
+	SQL_QUIET(BOTLIB_AI_CHAT_LENGTH, ""),
+	SQL_QUIET(BOTLIB_AI_ENTER_CHAT, ""),
+	SQL_QUIET(BOTLIB_AI_STRING_CONTAINS, ""),
+	SQL_QUIET(BOTLIB_AI_FIND_MATCH, ""),
+	SQL_QUIET(BOTLIB_AI_MATCH_VARIABLE, ""),
+	SQL_QUIET(BOTLIB_AI_UNIFY_WHITE_SPACES, ""),
+	SQL_QUIET(BOTLIB_AI_REPLACE_SYNONYMS, ""),
+	SQL_QUIET(BOTLIB_AI_LOAD_CHAT_FILE, ""),
+	SQL_QUIET(BOTLIB_AI_SET_CHAT_GENDER, ""),
+	SQL_QUIET(BOTLIB_AI_SET_CHAT_NAME, ""),
+	SQL_QUIET(BOTLIB_AI_RESET_GOAL_STATE, ""),
+	SQL_QUIET(BOTLIB_AI_RESET_AVOID_GOALS, ""),
+	SQL_QUIET(BOTLIB_AI_PUSH_GOAL, ""),
+	SQL_QUIET(BOTLIB_AI_POP_GOAL, ""),
+	SQL_QUIET(BOTLIB_AI_EMPTY_GOAL_STACK, ""),
+	SQL_QUIET(BOTLIB_AI_DUMP_AVOID_GOALS, ""),
+	SQL_QUIET(BOTLIB_AI_DUMP_GOAL_STACK, ""),
+	SQL_QUIET(BOTLIB_AI_GOAL_NAME, ""),
+	SQL_QUIET(BOTLIB_AI_GET_TOP_GOAL, ""),
+	SQL_QUIET(BOTLIB_AI_GET_SECOND_GOAL, ""),
+	SQL_QUIET(BOTLIB_AI_CHOOSE_LTG_ITEM, ""),
+	SQL_QUIET(BOTLIB_AI_CHOOSE_NBG_ITEM, ""),
+	SQL_QUIET(BOTLIB_AI_TOUCHING_GOAL, ""),
+	SQL_QUIET(BOTLIB_AI_ITEM_GOAL_IN_VIS_BUT_NOT_VISIBLE, ""),
+	SQL_QUIET(BOTLIB_AI_GET_LEVEL_ITEM_GOAL, ""),
+	SQL_QUIET(BOTLIB_AI_AVOID_GOAL_TIME, ""),
+	SQL_QUIET(BOTLIB_AI_INIT_LEVEL_ITEMS, ""),
+	SQL_QUIET(BOTLIB_AI_UPDATE_ENTITY_ITEMS, ""),
+	SQL_QUIET(BOTLIB_AI_LOAD_ITEM_WEIGHTS, ""),
+	SQL_QUIET(BOTLIB_AI_FREE_ITEM_WEIGHTS, ""),
+	SQL_QUIET(BOTLIB_AI_SAVE_GOAL_FUZZY_LOGIC, ""),
+	SQL_QUIET(BOTLIB_AI_ALLOC_GOAL_STATE, ""),
+	SQL_QUIET(BOTLIB_AI_FREE_GOAL_STATE, ""),
+	SQL_QUIET(BOTLIB_AI_RESET_MOVE_STATE, ""),
+	SQL_QUIET(BOTLIB_AI_MOVE_TO_GOAL, ""),
+	SQL_QUIET(BOTLIB_AI_MOVE_IN_DIRECTION, ""),
+	SQL_QUIET(BOTLIB_AI_RESET_AVOID_REACH, ""),
+	SQL_QUIET(BOTLIB_AI_RESET_LAST_AVOID_REACH, ""),
+	SQL_QUIET(BOTLIB_AI_REACHABILITY_AREA, ""),
+	SQL_QUIET(BOTLIB_AI_MOVEMENT_VIEW_TARGET, ""),
+	SQL_QUIET(BOTLIB_AI_ALLOC_MOVE_STATE, ""),
+	SQL_QUIET(BOTLIB_AI_FREE_MOVE_STATE, ""),
+	SQL_QUIET(BOTLIB_AI_INIT_MOVE_STATE, ""),
+	SQL_QUIET(BOTLIB_AI_CHOOSE_BEST_FIGHT_WEAPON, ""),
+	SQL_QUIET(BOTLIB_AI_GET_WEAPON_INFO, ""),
+	SQL_QUIET(BOTLIB_AI_LOAD_WEAPON_WEIGHTS, ""),
+	SQL_QUIET(BOTLIB_AI_ALLOC_WEAPON_STATE, ""),
+	SQL_QUIET(BOTLIB_AI_FREE_WEAPON_STATE, ""),
+	SQL_QUIET(BOTLIB_AI_RESET_WEAPON_STATE, ""),
+	SQL_QUIET(BOTLIB_AI_GENETIC_PARENTS_AND_CHILD_SELECTION, ""),
+	SQL_QUIET(BOTLIB_AI_INTERBREED_GOAL_FUZZY_LOGIC, ""),
+	SQL_QUIET(BOTLIB_AI_MUTATE_GOAL_FUZZY_LOGIC, ""),
+	SQL_QUIET(BOTLIB_AI_GET_NEXT_CAMP_SPOT_GOAL, ""),
+	SQL_QUIET(BOTLIB_AI_GET_MAP_LOCATION_GOAL, ""),
+	SQL_QUIET(BOTLIB_AI_NUM_INITIAL_CHATS, ""),
+	SQL_QUIET(BOTLIB_AI_GET_CHAT_MESSAGE, ""),
+	SQL_QUIET(BOTLIB_AI_REMOVE_FROM_AVOID_GOALS, ""),
+	SQL_QUIET(BOTLIB_AI_PREDICT_VISIBLE_POSITION, ""),
+	SQL_QUIET(BOTLIB_AI_SET_AVOID_GOAL_TIME, ""),
+	SQL_QUIET(BOTLIB_AI_ADD_AVOID_SPOT, ""),
+	SQL_QUIET(BOTLIB_AAS_ALTERNATIVE_ROUTE_GOAL, ""),
+	SQL_QUIET(BOTLIB_AAS_PREDICT_ROUTE, ""),
+	SQL_QUIET(BOTLIB_AAS_POINT_REACHABILITY_AREA_INDEX, ""),
+	SQL_QUIET(BOTLIB_PC_LOAD_SOURCE, ""),
+	SQL_QUIET(BOTLIB_PC_FREE_SOURCE, ""),
+	SQL_QUIET(BOTLIB_PC_READ_TOKEN, ""),
+	SQL_QUIET(BOTLIB_PC_SOURCE_FILE_AND_LINE, "")
+};
+
+/* gameExport_t */
+static const sql_msg_t sql_gameExportMsgs[] = {
+	SQL_NAME(GAME_INIT),
+	SQL_NAME(GAME_SHUTDOWN),
+	SQL_NAME(GAME_CLIENT_CONNECT),
+	SQL_NAME(GAME_CLIENT_BEGIN),
+	SQL_NAME(GAME_CLIENT_USERINFO_CHANGED),
+	SQL_NAME(GAME_CLIENT_DISCONNECT),
+	SQL_NAME(GAME_CLIENT_COMMAND),
+	SQL_NAME(GAME_CLIENT_THINK),
+	SQL_NAME(GAME_RUN_FRAME),
+	SQL_NAME(GAME_CONSOLE_COMMAND),
+	SQL_NAME(BOTAI_START_FRAME)
+};
+
+/* cgameImport_t */
+static const sql_msg_t sql_cgameImportMsgs[] = {
+	SQL_TRAP(CG_PRINT, "s"),
+	SQL_TRAP(CG_ERROR, "s"),
+	SQL_TRAP(CG_MILLISECONDS, "=i"),
+	SQL_TRAP(CG_CVAR_REGISTER, ".ssi"),
+	SQL_QUIET(CG_CVAR_UPDATE, ""),
+	SQL_TRAP(CG_CVAR_SET, "ss"),
+	SQL_TRAP(CG_CVAR_VARIABLESTRINGBUFFER, "sS"),
+	SQL_TRAP(CG_ARGC, "=i"),
+	SQL_TRAP(CG_ARGV, "iS"),
+	SQL_TRAP(CG_ARGS, "S"),
+	SQL_QUIET(CG_FS_FOPENFILE, "s"),
+	SQL_QUIET(CG_FS_READ, ".i"),
+	SQL_QUIET(CG_FS_WRITE, ".i"),
+	SQL_QUIET(CG_FS_FCLOSEFILE, "i"),
+	SQL_TRAP(CG_SENDCONSOLECOMMAND, "s"),
+	SQL_TRAP(CG_ADDCOMMAND, "s"),
+	SQL_TRAP(CG_SENDCLIENTCOMMAND, "s"),
+	SQL_TRAP(CG_UPDATESCREEN, ""),
+	SQL_TRAP(CG_CM_LOADMAP, "s"),
+	SQL_QUIET(CG_CM_NUMINLINEMODELS, "=i"),
+	SQL_QUIET(CG_CM_INLINEMODEL, "i"),
+	SQL_TRAP(CG_CM_LOADMODEL, ""),
+	SQL_QUIET(CG_CM_TEMPBOXMODEL, ""),
+	SQL_QUIET(CG_CM_POINTCONTENTS, ""),
+	SQL_QUIET(CG_CM_TRANSFORMEDPOINTCONTENTS, ""),
+	SQL_QUIET_BLOB(CG_CM_BOXTRACE, "B", trace_t),
+	SQL_QUIET_BLOB(CG_CM_TRANSFORMEDBOXTRACE, "B", trace_t),
+	SQL_QUIET(CG_CM_MARKFRAGMENTS, ""),
+	SQL_TRAP(CG_S_STARTSOUND, "...i"),
+	SQL_QUIET(CG_S_STARTLOCALSOUND, "i"),
+	SQL_QUIET(CG_S_CLEARLOOPINGSOUNDS, "i"),
+	SQL_QUIET(CG_S_ADDLOOPINGSOUND, "...i"),
+	SQL_QUIET(CG_S_UPDATEENTITYPOSITION, "i"),
+	SQL_QUIET(CG_S_RESPATIALIZE, "i"),
+	SQL_TRAP(CG_S_REGISTERSOUND, "si"),
+	SQL_QUIET(CG_S_STARTBACKGROUNDTRACK, "ss"),
+	SQL_TRAP(CG_R_LOADWORLDMAP, "s"),
+	SQL_QUIET(CG_R_REGISTERMODEL, "s"),
+	SQL_QUIET(CG_R_REGISTERSKIN, "s"),
+	SQL_QUIET(CG_R_REGISTERSHADER, "s"),
+	SQL_QUIET(CG_R_CLEARSCENE, ""),
+	SQL_QUIET_BLOB(CG_R_ADDREFENTITYTOSCENE, "b", refEntity_t),
+	SQL_QUIET(CG_R_ADDPOLYTOSCENE, "i"),
+	SQL_QUIET(CG_R_ADDLIGHTTOSCENE, ""),
+	SQL_QUIET_BLOB(CG_R_RENDERSCENE, "b", refdef_t),
+	SQL_QUIET(CG_R_SETCOLOR, ""),
+	SQL_QUIET(CG_R_DRAWSTRETCHPIC, ""),
+	SQL_QUIET(CG_R_MODELBOUNDS, ""),
+	SQL_QUIET(CG_R_LERPTAG, ""),
+	SQL_QUIET(CG_GETGLCONFIG, ""),
+	SQL_TRAP_BLOB(CG_GETGAMESTATE, "B", gameState_t),
+	SQL_TRAP(CG_GETCURRENTSNAPSHOTNUMBER, "II"),
+	SQL_TRAP_BLOB(CG_GETSNAPSHOT, ".B=q", snapshot_t),
+	SQL_TRAP(CG_GETSERVERCOMMAND, "i=i"),
+	SQL_TRAP(CG_GETCURRENTCMDNUMBER, "=i"),
+	SQL_TRAP_BLOB(CG_GETUSERCMD, ".B=q", usercmd_t),
+	SQL_TRAP(CG_SETUSERCMDVALUE, "if"),
+	SQL_QUIET(CG_R_REGISTERSHADERNOMIP, "s"),
+	SQL_TRAP(CG_MEMORY_REMAINING, "=i"),
+	SQL_QUIET(CG_R_REGISTERFONT, "si"),
+	SQL_QUIET(CG_KEY_ISDOWN, "i=i"),
+	SQL_QUIET(CG_KEY_GETCATCHER, "=i"),
+	SQL_QUIET(CG_KEY_SETCATCHER, "i"),
+	SQL_QUIET(CG_KEY_GETKEY, "s=i"),
+	SQL_QUIET(CG_PC_ADD_GLOBAL_DEFINE, "s"),
+	SQL_QUIET(CG_PC_LOAD_SOURCE, "s"),
+	SQL_QUIET(CG_PC_FREE_SOURCE, "i"),
+	SQL_QUIET(CG_PC_READ_TOKEN, "i"),
+	SQL_QUIET(CG_PC_SOURCE_FILE_AND_LINE, "iSI"),
+	SQL_QUIET(CG_S_STOPBACKGROUNDTRACK, ""),
+	SQL_TRAP(CG_REAL_TIME, "=i"),
+	SQL_QUIET(CG_SNAPVECTOR, ""),
+	SQL_TRAP(CG_REMOVECOMMAND, "s"),
+	SQL_QUIET(CG_R_LIGHTFORPOINT, ""),
+	SQL_QUIET(CG_CIN_PLAYCINEMATIC, "s"),
+	SQL_QUIET(CG_CIN_STOPCINEMATIC, "i"),
+	SQL_QUIET(CG_CIN_RUNCINEMATIC, "i"),
+	SQL_QUIET(CG_CIN_DRAWCINEMATIC, "i"),
+	SQL_QUIET(CG_CIN_SETEXTENTS, "i"),
+	SQL_QUIET(CG_R_REMAP_SHADER, "sss"),
+	SQL_QUIET(CG_S_ADDREALLOOPINGSOUND, "...i"),
+	SQL_QUIET(CG_S_STOPLOOPINGSOUND, "i"),
+	SQL_QUIET(CG_CM_TEMPCAPSULEMODEL, ""),
+	SQL_QUIET_BLOB(CG_CM_CAPSULETRACE, "B", trace_t),
+	SQL_QUIET_BLOB(CG_CM_TRANSFORMEDCAPSULETRACE, "B", trace_t),
+	SQL_QUIET(CG_R_ADDADDITIVELIGHTTOSCENE, ""),
+	SQL_QUIET(CG_GET_ENTITY_TOKEN, "S=i"),
+	SQL_QUIET(CG_R_ADDPOLYSTOSCENE, "i"),
+	SQL_QUIET(CG_R_INPVS, ""),
+	SQL_QUIET(CG_FS_SEEK, "iii"),
+	SQL_QUIET(CG_MEMSET, "..i"),
+	SQL_QUIET(CG_MEMCPY, "..i"),
+	SQL_TRAP(CG_STRNCPY, ".ni"),
+	SQL_QUIET(CG_SIN, "f"),
+	SQL_QUIET(CG_COS, "f"),
+	SQL_QUIET(CG_ATAN2, "ff"),
+	SQL_QUIET(CG_SQRT, "f"),
+	SQL_QUIET(CG_FLOOR, "f"),
+	SQL_QUIET(CG_CEIL, "f"),
+	SQL_TRAP(CG_TESTPRINTINT, ""),
+	SQL_TRAP(CG_TESTPRINTFLOAT, ""),
+	SQL_QUIET(CG_ACOS, "f")
+};
+
+/* cgameExport_t */
+static const sql_msg_t sql_cgameExportMsgs[] = {
+	SQL_NAME(CG_INIT),
+	SQL_NAME(CG_SHUTDOWN),
+	SQL_NAME(CG_CONSOLE_COMMAND),
+	SQL_NAME(CG_DRAW_ACTIVE_FRAME),
+	SQL_NAME(CG_CROSSHAIR_PLAYER),
+	SQL_NAME(CG_LAST_ATTACKER),
+	SQL_NAME(CG_KEY_EVENT),
+	SQL_NAME(CG_MOUSE_EVENT),
+	SQL_NAME(CG_EVENT_HANDLING)
+};
+
+/* uiImport_t */
+static const sql_msg_t sql_uiImportMsgs[] = {
+	SQL_TRAP(UI_ERROR, "s"),
+	SQL_TRAP(UI_PRINT, "s"),
+	SQL_TRAP(UI_MILLISECONDS, "=i"),
+	SQL_TRAP(UI_CVAR_SET, "ss"),
+	SQL_TRAP(UI_CVAR_VARIABLEVALUE, "s=f"),
+	SQL_TRAP(UI_CVAR_VARIABLESTRINGBUFFER, "sS"),
+	SQL_TRAP(UI_CVAR_SETVALUE, "sf"),
+	SQL_TRAP(UI_CVAR_RESET, "s"),
+	SQL_TRAP(UI_CVAR_CREATE, "ssi"),
+	SQL_TRAP(UI_CVAR_INFOSTRINGBUFFER, "iS"),
+	SQL_TRAP(UI_ARGC, "=i"),
+	SQL_TRAP(UI_ARGV, "iS"),
+	SQL_TRAP(UI_CMD_EXECUTETEXT, "is"),
+	SQL_QUIET(UI_FS_FOPENFILE, "s"),
+	SQL_QUIET(UI_FS_READ, ".i"),
+	SQL_QUIET(UI_FS_WRITE, ".i"),
+	SQL_QUIET(UI_FS_FCLOSEFILE, "i"),
+	SQL_QUIET(UI_FS_GETFILELIST, "ss"),
+	SQL_QUIET(UI_R_REGISTERMODEL, "s"),
+	SQL_QUIET(UI_R_REGISTERSKIN, "s"),
+	SQL_QUIET(UI_R_REGISTERSHADERNOMIP, "s"),
+	SQL_QUIET(UI_R_CLEARSCENE, ""),
+	SQL_QUIET_BLOB(UI_R_ADDREFENTITYTOSCENE, "b", refEntity_t),
+	SQL_QUIET(UI_R_ADDPOLYTOSCENE, "i"),
+	SQL_QUIET(UI_R_ADDLIGHTTOSCENE, ""),
+	SQL_QUIET_BLOB(UI_R_RENDERSCENE, "b", refdef_t),
+	SQL_QUIET(UI_R_SETCOLOR, ""),
+	SQL_QUIET(UI_R_DRAWSTRETCHPIC, ""),
+	SQL_TRAP(UI_UPDATESCREEN, ""),
+	SQL_QUIET(UI_CM_LERPTAG, ""),
+	SQL_TRAP(UI_CM_LOADMODEL, ""),
+	SQL_TRAP(UI_S_REGISTERSOUND, "si"),
+	SQL_QUIET(UI_S_STARTLOCALSOUND, "i"),
+	SQL_TRAP(UI_KEY_KEYNUMTOSTRINGBUF, "iS"),
+	SQL_QUIET(UI_KEY_GETBINDINGBUF, "iS"),
+	SQL_TRAP(UI_KEY_SETBINDING, "is"),
+	SQL_QUIET(UI_KEY_ISDOWN, "i=i"),
+	SQL_TRAP(UI_KEY_GETOVERSTRIKEMODE, "=i"),
+	SQL_TRAP(UI_KEY_SETOVERSTRIKEMODE, "i"),
+	SQL_TRAP(UI_KEY_CLEARSTATES, ""),
+	SQL_QUIET(UI_KEY_GETCATCHER, "=i"),
+	SQL_QUIET(UI_KEY_SETCATCHER, "i"),
+	SQL_TRAP(UI_GETCLIPBOARDDATA, "S"),
+	SQL_QUIET(UI_GETGLCONFIG, ""),
+	SQL_TRAP_BLOB(UI_GETCLIENTSTATE, "B", uiClientState_t),
+	SQL_TRAP(UI_GETCONFIGSTRING, "iS"),
+	SQL_TRAP(UI_LAN_GETPINGQUEUECOUNT, "=i"),
+	SQL_TRAP(UI_LAN_CLEARPING, "i"),
+	SQL_TRAP(UI_LAN_GETPING, "iS.I"),
+	SQL_TRAP(UI_LAN_GETPINGINFO, "iS"),
+	SQL_TRAP(UI_CVAR_REGISTER, ".ssi"),
+	SQL_QUIET(UI_CVAR_UPDATE, ""),
+	SQL_TRAP(UI_MEMORY_REMAINING, "=i"),
+	SQL_TRAP(UI_GET_CDKEY, ""),		/* the key is never logged */
+	SQL_TRAP(UI_SET_CDKEY, ""),		/* the key is never logged */
+	SQL_TRAP(UI_R_REGISTERFONT, "si"),
+	SQL_QUIET(UI_R_MODELBOUNDS, ""),
+	SQL_QUIET(UI_PC_ADD_GLOBAL_DEFINE, "s"),
+	SQL_QUIET(UI_PC_LOAD_SOURCE, "s"),
+	SQL_QUIET(UI_PC_FREE_SOURCE, "i"),
+	SQL_QUIET(UI_PC_READ_TOKEN, "i"),
+	SQL_QUIET(UI_PC_SOURCE_FILE_AND_LINE, "iSI"),
+	SQL_QUIET(UI_S_STOPBACKGROUNDTRACK, ""),
+	SQL_TRAP(UI_S_STARTBACKGROUNDTRACK, "ss"),
+	SQL_TRAP(UI_REAL_TIME, "=i"),
+	SQL_TRAP(UI_LAN_GETSERVERCOUNT, "i=i"),
+	SQL_TRAP(UI_LAN_GETSERVERADDRESSSTRING, "iiS"),
+	SQL_TRAP(UI_LAN_GETSERVERINFO, "iiS"),
+	SQL_TRAP(UI_LAN_MARKSERVERVISIBLE, "iii"),
+	SQL_TRAP(UI_LAN_UPDATEVISIBLEPINGS, "i"),
+	SQL_TRAP(UI_LAN_RESETPINGS, "i"),
+	SQL_TRAP(UI_LAN_LOADCACHEDSERVERS, ""),
+	SQL_TRAP(UI_LAN_SAVECACHEDSERVERS, ""),
+	SQL_TRAP(UI_LAN_ADDSERVER, "iss"),
+	SQL_TRAP(UI_LAN_REMOVESERVER, "is"),
+	SQL_QUIET(UI_CIN_PLAYCINEMATIC, "s"),
+	SQL_QUIET(UI_CIN_STOPCINEMATIC, "i"),
+	SQL_QUIET(UI_CIN_RUNCINEMATIC, "i"),
+	SQL_QUIET(UI_CIN_DRAWCINEMATIC, "i"),
+	SQL_QUIET(UI_CIN_SETEXTENTS, "i"),
+	SQL_QUIET(UI_R_REMAP_SHADER, "sss"),
+	SQL_TRAP(UI_VERIFY_CDKEY, ""),		/* the key is never logged */
+	SQL_TRAP(UI_LAN_SERVERSTATUS, "sS=i"),
+	SQL_TRAP(UI_LAN_GETSERVERPING, "ii=i"),
+	SQL_TRAP(UI_LAN_SERVERISVISIBLE, "ii"),
+	SQL_TRAP(UI_LAN_COMPARESERVERS, "iiiii"),
+	SQL_QUIET(UI_FS_SEEK, "iii"),
+	SQL_TRAP(UI_SET_PBCLSTATUS, ""),
+	SQL_QUIET(UI_MEMSET, "..i"),
+	SQL_QUIET(UI_MEMCPY, "..i"),
+	SQL_TRAP(UI_STRNCPY, ".ni"),
+	SQL_QUIET(UI_SIN, "f"),
+	SQL_QUIET(UI_COS, "f"),
+	SQL_QUIET(UI_ATAN2, "ff"),
+	SQL_QUIET(UI_SQRT, "f"),
+	SQL_QUIET(UI_FLOOR, "f"),
+	SQL_QUIET(UI_CEIL, "f")
+};
+
+/* uiExport_t */
+static const sql_msg_t sql_uiExportMsgs[] = {
+	SQL_NAME(UI_GETAPIVERSION),
+	SQL_NAME(UI_INIT),
+	SQL_NAME(UI_SHUTDOWN),
+	SQL_NAME(UI_KEY_EVENT),
+	SQL_NAME(UI_MOUSE_EVENT),
+	SQL_NAME(UI_REFRESH),
+	SQL_NAME(UI_IS_FULLSCREEN),
+	SQL_NAME(UI_SET_ACTIVE_MENU),
+	SQL_NAME(UI_CONSOLE_COMMAND),
+	SQL_NAME(UI_DRAW_CONNECT_SCREEN),
+	SQL_NAME(UI_HASUNIQUECDKEY)
+};
+
+typedef struct {
+	const sql_msg_t	*msgs;
+	int		count;
+} sqlMsgTable_t;
+
+static const sqlMsgTable_t sql_msgTables[SQL_NS_MAX] = {
+	[SQL_NS_ENGINE] = { sql_engineMsgs, ARRAY_LEN(sql_engineMsgs) },
+	[SQL_NS_GAME_IMPORT] = { sql_gameImportMsgs, ARRAY_LEN(sql_gameImportMsgs) },
+	[SQL_NS_GAME_EXPORT] = { sql_gameExportMsgs, ARRAY_LEN(sql_gameExportMsgs) },
+	[SQL_NS_CGAME_IMPORT] = { sql_cgameImportMsgs, ARRAY_LEN(sql_cgameImportMsgs) },
+	[SQL_NS_CGAME_EXPORT] = { sql_cgameExportMsgs, ARRAY_LEN(sql_cgameExportMsgs) },
+	[SQL_NS_UI_IMPORT] = { sql_uiImportMsgs, ARRAY_LEN(sql_uiImportMsgs) },
+	[SQL_NS_UI_EXPORT] = { sql_uiExportMsgs, ARRAY_LEN(sql_uiExportMsgs) }
+};
+
+const char *
+sql_endpoint_name(int endpoint)
+{
+	if (endpoint < 0 || endpoint >= SQL_EP_MAX) {
+		return NULL;
+	}
+	return sql_endpointNames[endpoint];
+}
+
+/* Number of slots in a namespace.  Not every slot has a name. */
+int
+sql_msg_count(int ns)
+{
+	if (ns < 0 || ns >= SQL_NS_MAX) {
+		return 0;
+	}
+	return sql_msgTables[ns].count;
+}
+
+/* The descriptor of a message, NULL if this build doesn't know it */
+const sql_msg_t *
+sql_msg(int msgID)
+{
+	int ns = SQL_MSG_NS(msgID);
+	int num = SQL_MSG_NUM(msgID);
+
+	if (num >= sql_msg_count(ns) || sql_msgTables[ns].msgs[num].name == NULL) {
+		return NULL;
+	}
+	return &sql_msgTables[ns].msgs[num];
+}
+
+const char *
+sql_msg_name(int msgID)
+{
+	const sql_msg_t *msg = sql_msg(msgID);
+
+	return msg != NULL ? msg->name : NULL;
+}
@@ -0,0 +1,122 @@
+/* Durability profiles for the log databases.
+
+   sql_profile picks one of these and sql_open_db applies it before the
+   schema is created, since page_size only takes on an empty database.
+   Shared with the offline tools, so this only needs SQLite3.
+
+     safe - WAL, every commit is synced to disk
+     fast - WAL, synced at checkpoints only.  A power cut can lose the last
+            transactions but never corrupts the database
+     bulk - journal in memory and no syncing, for data that can be made
+            again.  A crash in the middle of a commit can corrupt it
+*/
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+static const sql_profile_t sql_profiles[] = {
+	/* name    journal   sync  page   cache KB  mmap                 temp_store */
+	{ "safe",  "wal",    2,    4096,  -2000,    0,                   0 },
+	{ "fast",  "wal",    1,    4096,  -16384,   64 * 1024 * 1024,    2 },
+	{ "bulk",  "memory", 0,    65536, -65536,   256 * 1024 * 1024,   2 }
+};
+
+/* NULL if there's no profile with that name */
+const sql_profile_t *
+sql_profile_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_LEN(sql_profiles); i++) {
+		if (sqlite3_stricmp(sql_profiles[i].name, name) == 0) {
+			return &sql_profiles[i];
+		}
+	}
+	return NULL;
+}
+
+/* The n-th profile, NULL past the last one */
+const sql_profile_t *
+sql_profile_get(int n)
+{
+	return n >= 0 && n < ARRAY_LEN(sql_profiles) ? &sql_profiles[n] : NULL;
+}
+
+/* Set the PRAGMAs of a profile.  page_size comes first, it has to be set
+   before anything is written.  Returns 0 if a statement failed, settings
+   that SQLite3 quietly ignored are found by sql_profile_report.
+*/
+int
+sql_profile_apply(sqlite3 *db, const sql_profile_t *profile)
+{
+	char *pragmas;
+	int rc;
+
+	pragmas = sqlite3_mprintf(
+	    "PRAGMA page_size = %d;"
+	    "PRAGMA journal_mode = %s;"
+	    "PRAGMA synchronous = %d;"
+	    "PRAGMA cache_size = %d;"
+	    "PRAGMA mmap_size = %lld;"
+	    "PRAGMA temp_store = %d;",
+	    profile->pageSize, profile->journalMode, profile->synchronous,
+	    profile->cacheSize, profile->mmapSize, profile->tempStore);
+	if (pragmas == NULL) {
+		return 0;
+	}
+
+	rc = sqlite3_exec(db, pragmas, NULL, NULL, NULL);
+	sqlite3_free(pragmas);
+	if (rc != SQLITE_OK) {
+		DEBUG_PRINT("Failed to apply the profile");
+		return 0;
+	}
+	return 1;
+}
+
+/* Read the settings back into out as name=value pairs, with what the
+   profile asked for after the ones that differ, like a page_size on a
+   database that already existed or an mmap_size above what SQLite3 was
+   built to allow.  Returns how many differ.
+*/
+int
+sql_profile_report(sqlite3 *db, const sql_profile_t *profile, char *out, int size)
+{
+	static const char *names[] = {
+		"journal_mode", "synchronous", "page_size", "cache_size", "mmap_size", "temp_store"
+	};
+	char wanted[ARRAY_LEN(names)][32];
+	char value[32];
+	sqlite3_stmt *stmt;
+	int i, len, differ = 0;
+
+	sqlite3_snprintf(sizeof(wanted[0]), wanted[0], "%s", profile->journalMode);
+	sqlite3_snprintf(sizeof(wanted[1]), wanted[1], "%d", profile->synchronous);
+	sqlite3_snprintf(sizeof(wanted[2]), wanted[2], "%d", profile->pageSize);
+	sqlite3_snprintf(sizeof(wanted[3]), wanted[3], "%d", profile->cacheSize);
+	sqlite3_snprintf(sizeof(wanted[4]), wanted[4], "%lld", profile->mmapSize);
+	sqlite3_snprintf(sizeof(wanted[5]), wanted[5], "%d", profile->tempStore);
+
+	out[0] = '\0';
+	for (i = 0; i < ARRAY_LEN(names); i++) {
+		char *pragma = sqlite3_mprintf("PRAGMA %s", names[i]);
+
+		sqlite3_snprintf(sizeof(value), value, "?");
+		if (pragma != NULL && sqlite3_prepare_v2(db, pragma, -1, &stmt, NULL) == SQLITE_OK) {
+			if (sqlite3_step(stmt) == SQLITE_ROW) {
+				sqlite3_snprintf(sizeof(value), value, "%s", (const char *)sqlite3_column_text(stmt, 0));
+			}
+			sqlite3_finalize(stmt);
+		}
+		sqlite3_free(pragma);
+
+		len = strlen(out);
+		if (sqlite3_stricmp(value, wanted[i]) == 0) {
+			sqlite3_snprintf(size - len, out + len, "%s%s=%s", len > 0 ? " " : "", names[i], value);
+		} else {
+			sqlite3_snprintf(size - len, out + len, "%s%s=%s (wanted %s)", len > 0 ? " " : "", names[i], value, wanted[i]);
+			differ++;
+		}
+	}
+	return differ;
+}
@@ -0,0 +1,841 @@
+/* Replay a log into a VM.
+
+   sql_replay loads a QVM and makes the VM_Call rows of a log (see
+   sql_vm_call) into it again, in order.  Its traps never reach the engine.
+   Each one takes the next row of that trap from the log and gets back the
+   buffers, ints and return value sql_syscall logged for it, so the VM runs
+   the same code as when it was recorded without a map, clients or a
+   renderer.  The rows are loaded before the replay starts and the replay
+   is timed, which makes it a benchmark of the VM on its own.
+
+   Traps that don't depend on the game state run here instead: memory and
+   math, cvars and reading files.  Traps that weren't logged (quiet ones, or
+   ones a sql_filter left out) return 0 and empty strings.  When the VM
+   makes a trap the log doesn't have next, the following
+   SQL_REPLAY_LOOKAHEAD rows are searched for it and the rows passed over
+   are counted as skipped, so a replay that went its own way says so.
+
+     sql_replay <qagame|cgame|ui> <log.db>...
+
+   When the VM was compiled, the calls are made again with the interpreter
+   and each one has to return the same value and make the same traps, and
+   the QVM's memory has to end up the same.  The first call that doesn't
+   stops the replay with an error.
+
+   The files are replayed one after the other, for a log that was split
+   into segments.  This only runs on a dedicated server with no map loaded,
+   since the VM is loaded on the hunk and the hunk is cleared afterwards.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "q_shared.h"
+#include "qcommon.h"
+#include "../renderer/tr_types.h"
+#include "../game/g_public.h"
+#include "../cgame/cg_public.h"
+#include "../ui/ui_public.h"
+
+#define SQL_REPLAY_ARGS		13	/* MAX_VMMAIN_ARGS */
+#define SQL_REPLAY_LOOKAHEAD	16
+
+/* flags is NULL for a log from before the column */
+#define SQL_REPLAY_QUERY(flags) \
+	"SELECT msgid, value, " flags " FROM q3log_data " \
+	"WHERE (caller = ?1 AND msgid >> 16 = ?2) OR (target = ?1 AND msgid = ?3) ORDER BY rowid"
+
+/* Traps that are run instead of replayed */
+typedef enum {
+	SQL_LOCAL_NONE,
+	SQL_LOCAL_ERROR,
+	SQL_LOCAL_CVAR_REGISTER,
+	SQL_LOCAL_CVAR_UPDATE,
+	SQL_LOCAL_FS_OPEN,
+	SQL_LOCAL_FS_READ,
+	SQL_LOCAL_FS_CLOSE,
+	SQL_LOCAL_FS_LIST,
+	SQL_LOCAL_FS_SEEK,
+	SQL_LOCAL_MEMSET,
+	SQL_LOCAL_MEMCPY,
+	SQL_LOCAL_STRNCPY,
+	SQL_LOCAL_SIN,
+	SQL_LOCAL_COS,
+	SQL_LOCAL_ATAN2,
+	SQL_LOCAL_SQRT,
+	SQL_LOCAL_FLOOR,
+	SQL_LOCAL_CEIL,
+	SQL_LOCAL_ACOS,
+	SQL_LOCAL_MATRIXMULTIPLY,
+	SQL_LOCAL_ANGLEVECTORS,
+	SQL_LOCAL_PERPENDICULARVECTOR
+} sqlLocal_t;
+
+/* How many arguments each one reads, for VM_RegisterSyscalls */
+static const byte sql_localArgs[] = {
+	[SQL_LOCAL_ERROR] = 1,
+	[SQL_LOCAL_CVAR_REGISTER] = 4,
+	[SQL_LOCAL_CVAR_UPDATE] = 1,
+	[SQL_LOCAL_FS_OPEN] = 3,
+	[SQL_LOCAL_FS_READ] = 3,
+	[SQL_LOCAL_FS_CLOSE] = 1,
+	[SQL_LOCAL_FS_LIST] = 4,
+	[SQL_LOCAL_FS_SEEK] = 3,
+	[SQL_LOCAL_MEMSET] = 3,
+	[SQL_LOCAL_MEMCPY] = 3,
+	[SQL_LOCAL_STRNCPY] = 3,
+	[SQL_LOCAL_SIN] = 1,
+	[SQL_LOCAL_COS] = 1,
+	[SQL_LOCAL_ATAN2] = 2,
+	[SQL_LOCAL_SQRT] = 1,
+	[SQL_LOCAL_FLOOR] = 1,
+	[SQL_LOCAL_CEIL] = 1,
+	[SQL_LOCAL_ACOS] = 1,
+	[SQL_LOCAL_MATRIXMULTIPLY] = 3,
+	[SQL_LOCAL_ANGLEVECTORS] = 4,
+	[SQL_LOCAL_PERPENDICULARVECTOR] = 2
+};
+
+/* And the ones the compiler can do inline */
+static const byte sql_localInline[ARRAY_LEN(sql_localArgs)] = {
+	[SQL_LOCAL_MEMSET] = VM_INLINE_MEMSET,
+	[SQL_LOCAL_MEMCPY] = VM_INLINE_MEMCPY,
+	[SQL_LOCAL_STRNCPY] = VM_INLINE_STRNCPY,
+	[SQL_LOCAL_SIN] = VM_INLINE_SIN,
+	[SQL_LOCAL_COS] = VM_INLINE_COS,
+	[SQL_LOCAL_SQRT] = VM_INLINE_SQRT
+};
+
+static const byte sql_gameLocal[] = {
+	[G_ERROR] = SQL_LOCAL_ERROR,
+	[G_CVAR_REGISTER] = SQL_LOCAL_CVAR_REGISTER,
+	[G_CVAR_UPDATE] = SQL_LOCAL_CVAR_UPDATE,
+	[G_FS_FOPEN_FILE] = SQL_LOCAL_FS_OPEN,
+	[G_FS_READ] = SQL_LOCAL_FS_READ,
+	[G_FS_FCLOSE_FILE] = SQL_LOCAL_FS_CLOSE,
+	[G_FS_GETFILELIST] = SQL_LOCAL_FS_LIST,
+	[G_FS_SEEK] = SQL_LOCAL_FS_SEEK,
+	[TRAP_MEMSET] = SQL_LOCAL_MEMSET,
+	[TRAP_MEMCPY] = SQL_LOCAL_MEMCPY,
+	[TRAP_STRNCPY] = SQL_LOCAL_STRNCPY,
+	[TRAP_SIN] = SQL_LOCAL_SIN,
+	[TRAP_COS] = SQL_LOCAL_COS,
+	[TRAP_ATAN2] = SQL_LOCAL_ATAN2,
+	[TRAP_SQRT] = SQL_LOCAL_SQRT,
+	[TRAP_MATRIXMULTIPLY] = SQL_LOCAL_MATRIXMULTIPLY,
+	[TRAP_ANGLEVECTORS] = SQL_LOCAL_ANGLEVECTORS,
+	[TRAP_PERPENDICULARVECTOR] = SQL_LOCAL_PERPENDICULARVECTOR,
+	[TRAP_FLOOR] = SQL_LOCAL_FLOOR,
+	[TRAP_CEIL] = SQL_LOCAL_CEIL
+};
+
+static const byte sql_cgameLocal[] = {
+	[CG_ERROR] = SQL_LOCAL_ERROR,
+	[CG_CVAR_REGISTER] = SQL_LOCAL_CVAR_REGISTER,
+	[CG_CVAR_UPDATE] = SQL_LOCAL_CVAR_UPDATE,
+	[CG_FS_FOPENFILE] = SQL_LOCAL_FS_OPEN,
+	[CG_FS_READ] = SQL_LOCAL_FS_READ,
+	[CG_FS_FCLOSEFILE] = SQL_LOCAL_FS_CLOSE,
+	[CG_FS_SEEK] = SQL_LOCAL_FS_SEEK,
+	[CG_MEMSET] = SQL_LOCAL_MEMSET,
+	[CG_MEMCPY] = SQL_LOCAL_MEMCPY,
+	[CG_STRNCPY] = SQL_LOCAL_STRNCPY,
+	[CG_SIN] = SQL_LOCAL_SIN,
+	[CG_COS] = SQL_LOCAL_COS,
+	[CG_ATAN2] = SQL_LOCAL_ATAN2,
+	[CG_SQRT] = SQL_LOCAL_SQRT,
+	[CG_FLOOR] = SQL_LOCAL_FLOOR,
+	[CG_CEIL] = SQL_LOCAL_CEIL,
+	[CG_ACOS] = SQL_LOCAL_ACOS
+};
+
+static const byte sql_uiLocal[] = {
+	[UI_ERROR] = SQL_LOCAL_ERROR,
+	[UI_CVAR_REGISTER] = SQL_LOCAL_CVAR_REGISTER,
+	[UI_CVAR_UPDATE] = SQL_LOCAL_CVAR_UPDATE,
+	[UI_FS_FOPENFILE] = SQL_LOCAL_FS_OPEN,
+	[UI_FS_READ] = SQL_LOCAL_FS_READ,
+	[UI_FS_FCLOSEFILE] = SQL_LOCAL_FS_CLOSE,
+	[UI_FS_GETFILELIST] = SQL_LOCAL_FS_LIST,
+	[UI_FS_SEEK] = SQL_LOCAL_FS_SEEK,
+	[UI_MEMSET] = SQL_LOCAL_MEMSET,
+	[UI_MEMCPY] = SQL_LOCAL_MEMCPY,
+	[UI_STRNCPY] = SQL_LOCAL_STRNCPY,
+	[UI_SIN] = SQL_LOCAL_SIN,
+	[UI_COS] = SQL_LOCAL_COS,
+	[UI_ATAN2] = SQL_LOCAL_ATAN2,
+	[UI_SQRT] = SQL_LOCAL_SQRT,
+	[UI_FLOOR] = SQL_LOCAL_FLOOR,
+	[UI_CEIL] = SQL_LOCAL_CEIL
+};
+
+/* What it takes to replay each kind of VM, by import namespace */
+typedef struct {
+	const char *interpret;	/* the vm_ cvar */
+	sqlEndpoint_t endpoint;
+	const byte *local;
+	int numLocal;
+} sql_replay_vm_t;
+
+static const sql_replay_vm_t sql_replayVMs[SQL_NS_MAX] = {
+	[SQL_NS_GAME_IMPORT] = { "vm_game", SQL_EP_QAGAME_QVM, sql_gameLocal, ARRAY_LEN(sql_gameLocal) },
+	[SQL_NS_CGAME_IMPORT] = { "vm_cgame", SQL_EP_CGAME_QVM, sql_cgameLocal, ARRAY_LEN(sql_cgameLocal) },
+	[SQL_NS_UI_IMPORT] = { "vm_ui", SQL_EP_UI_QVM, sql_uiLocal, ARRAY_LEN(sql_uiLocal) }
+};
+
+typedef struct {
+	int msgID;
+	int type;		/* SQLITE_BLOB, SQLITE_NULL or text for the rest */
+	int size;		/* of a blob, or the text's length */
+	int offset;		/* of the value in data */
+} sql_replay_row_t;
+
+/* What a VM_Call did, for the run that checks against it */
+typedef struct {
+	int ret;
+	unsigned traps;		/* see sql_replay_digest */
+} sql_replay_call_t;
+
+typedef struct {
+	int ns;
+	const sql_replay_vm_t *info;
+	vm_t *vm;
+
+	sql_replay_row_t *rows;
+	int numRows;
+	int maxRows;
+	char *data;		/* blobs, and text with a terminator */
+	int used;
+	int size;
+	int next;		/* where the next trap starts looking */
+
+	sql_replay_call_t *record;	/* of each VM_Call in the first run */
+	int numRecord;
+	vmInterpret_t interpret;	/* how the last run's VM was loaded */
+	qboolean compare;	/* this run checks against record */
+	unsigned traps;		/* of the VM_Call being made */
+	qboolean files[MAX_FILE_HANDLES];	/* the VM opened and hasn't closed */
+
+	int calls;
+	int logged;		/* traps answered from the log */
+	int local;		/* traps run here */
+	int unlogged;		/* traps that were never logged */
+	int missing;		/* traps that should have been logged but weren't found */
+	int skipped;		/* rows no trap asked for */
+} sql_replay_t;
+
+/* The syscall handler has no other way to find it */
+static sql_replay_t sql_replay;
+
+static int
+sql_replay_float(float f)
+{
+	floatint_t fi;
+
+	fi.f = f;
+	return fi.i;
+}
+
+/* How a trap of the replayed VM is run here, if it is */
+static sqlLocal_t
+sql_replay_runs(const sql_replay_t *replay, int trapNum)
+{
+	if (trapNum < 0 || trapNum >= replay->info->numLocal) {
+		return SQL_LOCAL_NONE;
+	}
+	return replay->info->local[trapNum];
+}
+
+/* Unload the VM and close the files it left open, so the next run starts
+   from the same engine state */
+static void
+sql_replay_unload(sql_replay_t *replay)
+{
+	int i;
+
+	if (replay->vm != NULL) {
+		VM_Forced_Unload_Start();
+		VM_Free(replay->vm);
+		VM_Forced_Unload_Done();
+		replay->vm = NULL;
+	}
+	for (i = 0; i < MAX_FILE_HANDLES; i++) {
+		if (replay->files[i]) {
+			FS_FCloseFile(i);
+			replay->files[i] = qfalse;
+		}
+	}
+}
+
+/* Throw away the rows and the VM, even in the middle of a call from
+   Com_Error.  The hunk is left alone. */
+static void
+sql_replay_free(void)
+{
+	sql_replay_unload(&sql_replay);
+	free(sql_replay.rows);
+	free(sql_replay.data);
+	free(sql_replay.record);
+	Com_Memset(&sql_replay, 0, sizeof(sql_replay));
+}
+
+/* Append the rows of one log file */
+static int
+sql_replay_load(sql_replay_t *replay, const char *filename)
+{
+	sqlite3 *db;
+	sqlite3_stmt *stmt;
+	int rc;
+
+	if (sqlite3_open_v2(filename, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK ||
+	    (sqlite3_prepare_v2(db, SQL_REPLAY_QUERY("flags"), -1, &stmt, NULL) != SQLITE_OK &&
+	    sqlite3_prepare_v2(db, SQL_REPLAY_QUERY("NULL"), -1, &stmt, NULL) != SQLITE_OK)) {
+		Com_Printf("Can't read %s: %s\n", filename, sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 0;
+	}
+	sqlite3_bind_int(stmt, 1, replay->info->endpoint);
+	sqlite3_bind_int(stmt, 2, replay->ns);
+	sqlite3_bind_int(stmt, 3, SQL_ENGINE(SQL_MSG_VM_CALL));
+
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		sql_replay_row_t *row;
+		const void *value;
+		void *inflated = NULL;
+		int msgID = sqlite3_column_int(stmt, 0);
+		int type = sqlite3_column_type(stmt, 1);
+		int size, stored;
+
+		/* The traps that run here never take their rows */
+		if (msgID >> 16 == replay->ns && sql_replay_runs(replay, msgID & 0xffff) != SQL_LOCAL_NONE) {
+			continue;
+		}
+		if (type == SQLITE_BLOB) {
+			value = sqlite3_column_blob(stmt, 1);
+		} else {
+			value = sqlite3_column_text(stmt, 1);
+		}
+		size = sqlite3_column_bytes(stmt, 1);
+		if ((sqlite3_column_int(stmt, 2) & SQL_FLAG_ZLIB) && value != NULL &&
+		    (value = inflated = sql_inflate_alloc(value, size, &size)) == NULL) {
+			Com_Printf("Skipping a corrupt compressed row in %s\n", filename);
+			continue;
+		}
+		stored = type == SQLITE_BLOB ? size : size + 1;
+
+		if (replay->numRows == replay->maxRows) {
+			int maxRows = replay->maxRows > 0 ? replay->maxRows * 2 : 64 * 1024;
+			sql_replay_row_t *rows = realloc(replay->rows, maxRows * sizeof(*rows));
+
+			if (rows == NULL) {
+				free(inflated);
+				break;
+			}
+			replay->rows = rows;
+			replay->maxRows = maxRows;
+		}
+		if (replay->used + stored > replay->size) {
+			int newSize = replay->size > 0 ? replay->size : 1024 * 1024;
+			char *data;
+
+			while (replay->used + stored > newSize) {
+				newSize *= 2;
+			}
+			if ((data = realloc(replay->data, newSize)) == NULL) {
+				free(inflated);
+				break;
+			}
+			replay->data = data;
+			replay->size = newSize;
+		}
+
+		row = &replay->rows[replay->numRows++];
+		row->msgID = msgID;
+		row->type = value != NULL ? type : SQLITE_NULL;
+		row->size = size;
+		row->offset = replay->used;
+		if (value != NULL) {
+			Com_Memcpy(replay->data + replay->used, value, size);
+			if (type != SQLITE_BLOB) {
+				replay->data[replay->used + size] = '\0';
+			}
+			replay->used += stored;
+		}
+		free(inflated);
+	}
+	if (rc != SQLITE_DONE) {
+		Com_Printf("Failed to read %s: %s\n", filename, rc == SQLITE_ROW ? "out of memory" : sqlite3_errmsg(db));
+	}
+
+	sqlite3_finalize(stmt);
+	sqlite3_close(db);
+	return rc == SQLITE_DONE;
+}
+
+/* The next row of a trap, if it's close enough.  A VM_Call row ends the
+   search, the call the VM is in has to return first. */
+static const sql_replay_row_t *
+sql_replay_find(sql_replay_t *replay, int msgID)
+{
+	int i;
+
+	for (i = replay->next; i < replay->numRows && i < replay->next + SQL_REPLAY_LOOKAHEAD; i++) {
+		if (replay->rows[i].msgID == msgID) {
+			replay->skipped += i - replay->next;
+			replay->next = i + 1;
+			return &replay->rows[i];
+		}
+		if (replay->rows[i].msgID == SQL_ENGINE(SQL_MSG_VM_CALL)) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+/* Give the VM what sql_syscall logged for the trap: the buffers it filled
+   in and what it returned.  The values are read back the way
+   sql_format_values joined them, a string can only have spaces in it when
+   it's the last one.
+*/
+static intptr_t
+sql_replay_answer(const sql_replay_t *replay, const sql_msg_t *trap, const sql_replay_row_t *row, intptr_t *args)
+{
+	const char *value = replay->data + row->offset;
+	const char *token[SQL_ARGS_MAX + 1];
+	int length[SQL_ARGS_MAX + 1];
+	char kinds[SQL_ARGS_MAX + 1];
+	int slots[SQL_ARGS_MAX + 1];
+	const char *kind, *p, *end;
+	char ret = '\0';
+	int i, count = 0, last = -1, n = 1;
+
+	for (kind = trap->args; *kind != '\0' && *kind != '=' && count < SQL_ARGS_MAX; kind++, n++) {
+		if (*kind == '.') {
+			continue;
+		}
+		kinds[count] = *kind;
+		slots[count++] = n;
+	}
+	if (*kind == '=') {
+		ret = kind[1];
+	}
+
+	/* A trap with a blob only logs the blob */
+	for (i = 0; i < count; i++) {
+		if (kinds[i] == 'b' || kinds[i] == 'B' || kinds[i] == 'L') {
+			break;
+		}
+	}
+	if (i < count) {
+		if (row->type != SQLITE_BLOB) {
+			return 0;
+		}
+		for (i = 0; i < count; i++) {
+			if (kinds[i] == 'B') {
+				Com_Memcpy(VMA(slots[i]), value, row->size < trap->size ? row->size : trap->size);
+			} else if (kinds[i] == 'L') {
+				int num = row->size / sizeof(int);
+
+				if (num > args[slots[i] + 1]) {
+					num = args[slots[i] + 1];
+				}
+				Com_Memcpy(VMA(slots[i]), value, num * sizeof(int));
+				return num;
+			}
+		}
+		return ret == 'q';
+	}
+
+	if (row->type == SQLITE_NULL) {
+		return 0;
+	}
+	if (ret == 'i' || ret == 'f') {
+		kinds[count++] = ret;
+	}
+	if (count == 0) {
+		return ret == 'q';
+	}
+
+	/* Strings take one word each, except the last one which takes what the
+	   values after it leave over */
+	for (i = 0; i < count; i++) {
+		if (kinds[i] == 's' || kinds[i] == 'n' || kinds[i] == 'S') {
+			last = i;
+		}
+	}
+	if (last < 0) {
+		last = count - 1;
+	}
+	p = value;
+	end = value + strlen(value);
+	for (i = 0; i < last; i++) {
+		token[i] = p;
+		length[i] = strcspn(p, " ");
+		p += length[i];
+		if (*p == ' ') {
+			p++;
+		}
+	}
+	for (i = count - 1; i > last; i--) {
+		const char *start = end;
+
+		while (start > p && start[-1] != ' ') {
+			start--;
+		}
+		token[i] = start;
+		length[i] = end - start;
+		end = start > p ? start - 1 : start;
+	}
+	token[last] = p;
+	length[last] = end - p;
+
+	for (i = 0; i < count; i++) {
+		if (kinds[i] == 'S' && args[slots[i] + 1] > 0) {
+			int len = length[i] < args[slots[i] + 1] - 1 ? length[i] : args[slots[i] + 1] - 1;
+			char *out = VMA(slots[i]);
+
+			Com_Memcpy(out, token[i], len);
+			out[len] = '\0';
+		} else if (kinds[i] == 'I') {
+			*(int *)VMA(slots[i]) = atoi(token[i]);
+		}
+	}
+
+	switch (ret) {
+	case 'i':
+		return atoi(token[count - 1]);
+	case 'f':
+		return sql_replay_float(atof(token[count - 1]));
+	case 'q':
+		return 1;
+	}
+	return 0;
+}
+
+/* A trap that isn't in the log gets empty strings and zeros, like an
+   engine that has nothing to say */
+static void
+sql_replay_empty(const sql_msg_t *trap, intptr_t *args)
+{
+	const char *kind;
+	int n = 1;
+
+	if (trap == NULL || trap->args == NULL) {
+		return;
+	}
+	for (kind = trap->args; *kind != '\0' && *kind != '='; kind++, n++) {
+		if (*kind == 'S' && args[n + 1] > 0) {
+			*(char *)VMA(n) = '\0';
+		} else if (*kind == 'I') {
+			*(int *)VMA(n) = 0;
+		}
+	}
+}
+
+/* The traps in sql_*Local, done the way the engine does them */
+static intptr_t
+sql_replay_local(sql_replay_t *replay, sqlLocal_t local, intptr_t *args)
+{
+	fileHandle_t f;
+	int ret;
+
+	switch (local) {
+	case SQL_LOCAL_ERROR:
+		Com_Error(ERR_DROP, "Replay stopped by the VM: %s", (const char *)VMA(1));
+		return 0;
+	case SQL_LOCAL_CVAR_REGISTER:
+		Cvar_Register(VMA(1), VMA(2), VMA(3), args[4]);
+		return 0;
+	case SQL_LOCAL_CVAR_UPDATE:
+		Cvar_Update(VMA(1));
+		return 0;
+	case SQL_LOCAL_FS_OPEN:
+		ret = FS_FOpenFileByMode(VMA(1), &f, args[3]);
+		if (f > 0 && f < MAX_FILE_HANDLES) {
+			replay->files[f] = qtrue;
+		}
+		*(fileHandle_t *)VMA(2) = f;
+		return ret;
+	case SQL_LOCAL_FS_READ:
+		FS_Read2(VMA(1), args[2], args[3]);
+		return 0;
+	case SQL_LOCAL_FS_CLOSE:
+		if (args[1] > 0 && args[1] < MAX_FILE_HANDLES) {
+			replay->files[args[1]] = qfalse;
+		}
+		FS_FCloseFile(args[1]);
+		return 0;
+	case SQL_LOCAL_FS_LIST:
+		return FS_GetFileList(VMA(1), VMA(2), VMA(3), args[4]);
+	case SQL_LOCAL_FS_SEEK:
+		return FS_Seek(args[1], args[2], args[3]);
+	case SQL_LOCAL_MEMSET:
+		Com_Memset(VMA(1), args[2], args[3]);
+		return 0;
+	case SQL_LOCAL_MEMCPY:
+		Com_Memcpy(VMA(1), VMA(2), args[3]);
+		return 0;
+	case SQL_LOCAL_STRNCPY:
+		strncpy(VMA(1), VMA(2), args[3]);
+		return args[1];
+	case SQL_LOCAL_SIN:
+		return sql_replay_float(sin(VMF(1)));
+	case SQL_LOCAL_COS:
+		return sql_replay_float(cos(VMF(1)));
+	case SQL_LOCAL_ATAN2:
+		return sql_replay_float(atan2(VMF(1), VMF(2)));
+	case SQL_LOCAL_SQRT:
+		return sql_replay_float(sqrt(VMF(1)));
+	case SQL_LOCAL_FLOOR:
+		return sql_replay_float(floor(VMF(1)));
+	case SQL_LOCAL_CEIL:
+		return sql_replay_float(ceil(VMF(1)));
+	case SQL_LOCAL_ACOS:
+		return sql_replay_float(Q_acos(VMF(1)));
+	case SQL_LOCAL_MATRIXMULTIPLY:
+		MatrixMultiply(VMA(1), VMA(2), VMA(3));
+		return 0;
+	case SQL_LOCAL_ANGLEVECTORS:
+		AngleVectors(VMA(1), VMA(2), VMA(3), VMA(4));
+		return 0;
+	case SQL_LOCAL_PERPENDICULARVECTOR:
+		PerpendicularVector(VMA(1), VMA(2));
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+/* Fold a trap and what it returned into the digest of the VM_Call it was
+   made in.  Traps the compiler can do inline are left out, since compiled
+   code only calls them on the slow path. */
+static void
+sql_replay_digest(sql_replay_t *replay, int trapNum, intptr_t ret)
+{
+	if (sql_localInline[sql_replay_runs(replay, trapNum)] != VM_INLINE_NONE) {
+		return;
+	}
+	replay->traps = (replay->traps * 33 + trapNum) * 33 + (unsigned)ret;
+}
+
+/* A trap, answered from the log or run here */
+static intptr_t
+sql_replay_trap(sql_replay_t *replay, intptr_t *args)
+{
+	int msgID = SQL_MSG(replay->ns, (int)args[0]);
+	const sql_msg_t *trap = args[0] >= 0 ? sql_msg(msgID) : NULL;
+	const sql_replay_row_t *row = NULL;
+	sqlLocal_t local = sql_replay_runs(replay, args[0]);
+
+	if (local != SQL_LOCAL_NONE) {
+		replay->local++;
+		return sql_replay_local(replay, local, args);
+	}
+
+	/* Quiet traps are rarely in the log, don't look for every sin() */
+	if (trap != NULL && trap->args != NULL && ! trap->quiet) {
+		row = sql_replay_find(replay, msgID);
+	}
+	if (row != NULL) {
+		replay->logged++;
+		return sql_replay_answer(replay, trap, row, args);
+	}
+
+	if (trap == NULL || trap->args == NULL || trap->quiet || strpbrk(trap->args, "SIBL=") == NULL) {
+		replay->unlogged++;
+	} else {
+		replay->missing++;
+	}
+	sql_replay_empty(trap, args);
+	return 0;
+}
+
+/* The system call handler of the replayed VM */
+static intptr_t
+sql_replay_syscall(intptr_t *args)
+{
+	intptr_t ret = sql_replay_trap(&sql_replay, args);
+
+	sql_replay_digest(&sql_replay, args[0], ret);
+	return ret;
+}
+
+/* A trap that runs here, called by compiled code without going through
+   sql_replay_syscall */
+static intptr_t
+sql_replay_direct(intptr_t *args)
+{
+	intptr_t ret;
+
+	sql_replay.local++;
+	ret = sql_replay_local(&sql_replay, sql_replay.info->local[args[0]], args);
+	sql_replay_digest(&sql_replay, args[0], ret);
+	return ret;
+}
+
+/* The traps that run here never take a row from the log, so they can skip
+   sql_replay_syscall.  Compare vm_directSyscalls 0 and 1 to see what that
+   saves, and vm_inlineSyscalls 0 and 1 for the ones the compiler does
+   inline.  Those aren't counted as run here, and the interpreter's run
+   checks them against sql_replay_local. */
+static void
+sql_replay_register(const sql_replay_t *replay)
+{
+	static vmSyscall_t syscalls[256];
+	int i;
+
+	Com_Memset(syscalls, 0, sizeof(syscalls));
+	for (i = 0; i < replay->info->numLocal && i < ARRAY_LEN(syscalls); i++) {
+		if (replay->info->local[i] != SQL_LOCAL_NONE) {
+			syscalls[i].func = sql_replay_direct;
+			syscalls[i].numArgs = sql_localArgs[replay->info->local[i]];
+			syscalls[i].inlined = sql_localInline[replay->info->local[i]];
+		}
+	}
+	VM_RegisterSyscalls(sql_replay_syscall, syscalls, i, NULL);
+}
+
+/* Make every VM_Call in the rows, with the VM loaded the way interpret
+   says.  The first run records what each call did, a run with compare set
+   stops at the first call that did something else.  data is the checksum
+   of the QVM's memory afterwards, and the VM is unloaded. */
+static qboolean
+sql_replay_run(sql_replay_t *replay, const char *module, vmInterpret_t interpret, unsigned *data)
+{
+	long long start, elapsed;
+	const char *mode;
+
+	replay->next = 0;
+	replay->calls = 0;
+	replay->logged = replay->local = replay->unlogged = replay->missing = replay->skipped = 0;
+
+	replay->vm = VM_Create(module, sql_replay_syscall, interpret);
+	if (replay->vm == NULL) {
+		Com_Printf("Couldn't load %s\n", module);
+		return qfalse;
+	}
+	replay->interpret = VM_Interpret(replay->vm);
+	mode = replay->interpret == VMI_NATIVE ? "the native library" :
+	    replay->interpret == VMI_COMPILED ? "compiled code" : "the interpreter";
+
+	start = sql_clock();
+	while (replay->next < replay->numRows) {
+		const sql_replay_row_t *row = &replay->rows[replay->next++];
+		sql_replay_call_t *record = &replay->record[replay->calls];
+		int call[SQL_REPLAY_ARGS];
+		int ret;
+
+		if (row->msgID != SQL_ENGINE(SQL_MSG_VM_CALL) || row->type != SQLITE_BLOB ||
+		    row->size < sizeof(int) || row->size > sizeof(call)) {
+			replay->skipped++;
+			continue;
+		}
+		Com_Memset(call, 0, sizeof(call));
+		Com_Memcpy(call, replay->data + row->offset, row->size);
+
+		replay->traps = 0;
+		ret = VM_Call(replay->vm, call[0], call[1], call[2], call[3], call[4], call[5], call[6],
+		    call[7], call[8], call[9], call[10], call[11], call[12]);
+		if (! replay->compare) {
+			record->ret = ret;
+			record->traps = replay->traps;
+		} else if (record->ret != ret) {
+			Com_Error(ERR_DROP, "VM_Call %d (export %d) returned %d with %s, not %d",
+			    replay->calls, call[0], ret, mode, record->ret);
+		} else if (record->traps != replay->traps) {
+			Com_Error(ERR_DROP, "VM_Call %d (export %d) made other traps with %s",
+			    replay->calls, call[0], mode);
+		}
+		replay->calls++;
+	}
+	elapsed = sql_clock() - start;
+	*data = VM_DataChecksum(replay->vm);
+
+	Com_Printf("Replayed %d VM calls with %s in %.2f ms, %.0f calls/s\n", replay->calls, mode,
+	    elapsed / 1e6, elapsed > 0 ? replay->calls * 1e9 / elapsed : 0);
+
+	sql_replay_unload(replay);
+	return qtrue;
+}
+
+/* sql_replay <qagame|cgame|ui> <log.db>... */
+void
+sql_replay_f(void)
+{
+	sql_replay_t *replay = &sql_replay;
+	unsigned data, check;
+	int i;
+
+	if (Cmd_Argc() < 3) {
+		Com_Printf("usage: sql_replay <qagame|cgame|ui> <log.db>...\n");
+		return;
+	}
+	if (! com_dedicated->integer || com_sv_running->integer) {
+		Com_Printf("sql_replay only runs on a dedicated server with no map loaded\n");
+		return;
+	}
+
+	/* Left over from a replay that Com_Error cut short */
+	sql_replay_free();
+
+	replay->ns = sql_syscall_module(Cmd_Argv(1));
+	if (replay->ns < 0 || sql_replayVMs[replay->ns].interpret == NULL) {
+		Com_Printf("Can't replay %s, only qagame, cgame and ui\n", Cmd_Argv(1));
+		return;
+	}
+	replay->info = &sql_replayVMs[replay->ns];
+
+	for (i = 2; i < Cmd_Argc(); i++) {
+		if (! sql_replay_load(replay, Cmd_Argv(i))) {
+			sql_replay_free();
+			return;
+		}
+	}
+	Com_Printf("Loaded %d rows\n", replay->numRows);
+
+	for (i = 0; i < replay->numRows; i++) {
+		if (replay->rows[i].msgID == SQL_ENGINE(SQL_MSG_VM_CALL)) {
+			replay->numRecord++;
+		}
+	}
+	replay->record = malloc((replay->numRecord + 1) * sizeof(*replay->record));
+	if (replay->record == NULL) {
+		Com_Printf("Not enough memory to replay %d calls\n", replay->numRecord);
+		sql_replay_free();
+		return;
+	}
+
+	sql_replay_register(replay);
+	if (! sql_replay_run(replay, Cmd_Argv(1), Cvar_VariableIntegerValue(replay->info->interpret), &data)) {
+		sql_replay_free();
+		return;
+	}
+	Com_Printf("Traps: %d from the log, %d run here, %d not logged, %d missing.  %d rows skipped\n",
+	    replay->logged, replay->local, replay->unlogged, replay->missing, replay->skipped);
+
+	if (replay->interpret == VMI_COMPILED) {
+		replay->compare = qtrue;
+		if (! sql_replay_run(replay, Cmd_Argv(1), VMI_BYTECODE, &check)) {
+			sql_replay_free();
+			Hunk_Clear();
+			return;
+		}
+		if (check != data) {
+			Com_Error(ERR_DROP, "The QVM's memory is %08x with the interpreter, not %08x", check, data);
+		}
+		Com_Printf("The interpreter made the same calls and traps, data %08x\n", data);
+	} else {
+		Com_Printf("Data %08x\n", data);
+	}
+
+	sql_replay_free();
+	Hunk_Clear();
+}
+
+/* Com_Error calls this so a replay that was cut short doesn't leave a
+   running VM behind for the next VM_Clear */
+void
+sql_replay_abort(void)
+{
+	sql_replay_free();
+}
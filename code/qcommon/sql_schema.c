@@ -0,0 +1,475 @@
+/* The q3log schema.
+
+   Shared by the engine and the offline tools (q3trace2sqlite and
+   sqllog_index), so this only needs SQLite3 and the names in sql_names.c.
+*/
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+/* PRAGMA user_version of the current layout.  0 is the original layout
+   with a TEXT tstamp and no game time columns, 1 has no flags column. */
+#define SQL_SCHEMA_VERSION 2
+
+static int
+sql_schema_exec(sqlite3 *db, const char *statement)
+{
+	if (sqlite3_exec(db, statement, NULL, NULL, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to execute the statement");
+		return 0;
+	}
+	return 1;
+}
+
+/* Return the single integer a query selects, or -1 */
+static int
+sql_schema_query_int(sqlite3 *db, const char *query)
+{
+	sqlite3_stmt *stmt;
+	int value = -1;
+
+	if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to prepare the query");
+		return -1;
+	}
+	if (sqlite3_step(stmt) == SQLITE_ROW) {
+		value = sqlite3_column_int(stmt, 0);
+	}
+	sqlite3_finalize(stmt);
+	return value;
+}
+
+/* Rows logged by an older build don't fit the new columns.  Keep them
+   under another name instead of failing every insert.  A layout without
+   the flags column only needs it added, its rows are all uncompressed.
+   The first builds logged into a q3log table, which would keep the view
+   of the same name from being made.
+*/
+static int
+sql_schema_upgrade(sqlite3 *db)
+{
+	int version = sql_schema_query_int(db, "PRAGMA user_version");
+
+	if (sql_schema_query_int(db,
+	    "SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = 'q3log'") == 1) {
+		fprintf(stderr, "Moving rows from the original q3log table to q3log_v0\n");
+		if (! sql_schema_exec(db, "ALTER TABLE q3log RENAME TO q3log_v0")) {
+			return 0;
+		}
+	}
+
+	if (version >= SQL_SCHEMA_VERSION ||
+	    sql_schema_query_int(db, "SELECT COUNT(*) FROM sqlite_master WHERE name = 'q3log_data'") != 1) {
+		return 1;
+	}
+
+	if (version == 1) {
+		return sql_schema_exec(db, "DROP VIEW IF EXISTS q3log") &&
+		    sql_schema_exec(db, "ALTER TABLE q3log_data ADD COLUMN flags INTEGER");
+	}
+
+	fprintf(stderr, "Moving rows from an older log layout to q3log_data_v0\n");
+	return sql_schema_exec(db, "DROP VIEW IF EXISTS q3log") &&
+	    sql_schema_exec(db, "ALTER TABLE q3log_data RENAME TO q3log_data_v0");
+}
+
+/* Bind an id and a name and run the dictionary insert */
+static int
+sql_schema_fill_row(sqlite3_stmt *stmt, int id, const char *name)
+{
+	if (sqlite3_reset(stmt) != SQLITE_OK ||
+	    sqlite3_bind_int(stmt, 1, id) != SQLITE_OK ||
+	    sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC) != SQLITE_OK ||
+	    sqlite3_step(stmt) != SQLITE_DONE) {
+		DEBUG_PRINT("Failed to insert a dictionary row");
+		return 0;
+	}
+	return 1;
+}
+
+/* (Re)write every endpoint and message name this build knows about.
+   Rows are replaced so a database reused across builds keeps the
+   newest names.
+*/
+static int
+sql_schema_fill_dictionaries(sqlite3 *db)
+{
+	static const char *statements[] = {
+		"INSERT OR REPLACE INTO endpoint (id, name) VALUES (?, ?)",
+		"INSERT OR REPLACE INTO msgtype (id, name) VALUES (?, ?)"
+	};
+	sqlite3_stmt *stmt;
+	int i, ns, num;
+	int ok = 1;
+
+	for (i = 0; i < ARRAY_LEN(statements) && ok; i++) {
+		if (sqlite3_prepare_v2(db, statements[i], -1, &stmt, NULL) != SQLITE_OK) {
+			DEBUG_PRINT("Failed to prepare the dictionary statement");
+			return 0;
+		}
+
+		if (i == 0) {
+			for (num = 0; num < SQL_EP_MAX && ok; num++) {
+				ok = sql_schema_fill_row(stmt, num, sql_endpoint_name(num));
+			}
+		} else {
+			for (ns = 0; ns < SQL_NS_MAX && ok; ns++) {
+				for (num = 0; num < sql_msg_count(ns) && ok; num++) {
+					const char *name = sql_msg_name(SQL_MSG(ns, num));
+					if (name != NULL) {
+						ok = sql_schema_fill_row(stmt, SQL_MSG(ns, num), name);
+					}
+				}
+			}
+		}
+
+		if (sqlite3_finalize(stmt) != SQLITE_OK) {
+			DEBUG_PRINT("Failed to finalize the dictionary statement");
+			ok = 0;
+		}
+	}
+	return ok;
+}
+
+/* Create the dictionaries, the table to store the data and a view
+   that looks like the old all-TEXT q3log table, then fill the
+   dictionaries.
+*/
+int
+sql_create_schema(sqlite3 *db)
+{
+	if (! sql_schema_upgrade(db)) {
+		return 0;
+	}
+
+	if (! sql_schema_exec(db,
+	    "CREATE TABLE IF NOT EXISTS endpoint"
+	    "("
+	    "  id   INTEGER PRIMARY KEY,"
+	    "  name TEXT NOT NULL"
+	    ")") ||
+	    ! sql_schema_exec(db,
+	    "CREATE TABLE IF NOT EXISTS msgtype"
+	    "("
+	    "  id   INTEGER PRIMARY KEY," /* SQL_MSG(namespace, number) */
+	    "  name TEXT NOT NULL"
+	    ")") ||
+	    ! sql_schema_exec(db,
+	    "CREATE TABLE IF NOT EXISTS q3log_data"
+	    "("
+	    "  id INTEGER PRIMARY KEY AUTOINCREMENT," /* alias to rowid */
+	    "  tstamp INTEGER NOT NULL,"	/* sql_clock nanoseconds, see session */
+	    "  frame  INTEGER,"		/* com_frameNumber */
+	    "  svtime INTEGER,"		/* svs.time or cl.serverTime */
+	    "  client INTEGER,"		/* client number */
+	    "  caller INTEGER NOT NULL REFERENCES endpoint(id),"
+	    "  target INTEGER NOT NULL REFERENCES endpoint(id),"
+	    "  msgid  INTEGER NOT NULL REFERENCES msgtype(id),"
+	    "  value  BLOB,"
+	    "  flags  INTEGER"		/* SQL_FLAG_ bits, NULL for none */
+	    ")") ||
+	    ! sql_schema_exec(db,
+	    "CREATE TABLE IF NOT EXISTS trap_stats"
+	    "("
+	    "  id     INTEGER PRIMARY KEY,"
+	    "  tstamp INTEGER NOT NULL,"
+	    "  msgid  INTEGER NOT NULL REFERENCES msgtype(id),"
+	    "  count  INTEGER NOT NULL,"	/* since the start or sql_trapstats reset */
+	    "  total  INTEGER NOT NULL,"	/* nanoseconds */
+	    "  p50    INTEGER NOT NULL,"
+	    "  p99    INTEGER NOT NULL,"
+	    "  max    INTEGER NOT NULL"
+	    ")") ||
+	    ! sql_schema_exec(db,
+	    "CREATE TABLE IF NOT EXISTS session"
+	    "("
+	    "  id      INTEGER PRIMARY KEY,"
+	    "  started TEXT NOT NULL,"		/* wall clock */
+	    "  tstamp  INTEGER NOT NULL"	/* sql_clock at the same moment */
+	    ")") ||
+	    ! sql_schema_exec(db,
+	    "CREATE TABLE IF NOT EXISTS segment"
+	    "("
+	    "  id     INTEGER PRIMARY KEY,"
+	    "  file   TEXT NOT NULL,"		/* what the closed segment was renamed to */
+	    "  label  TEXT,"			/* the map it was started for */
+	    "  reason TEXT NOT NULL,"		/* rows, size, map or command */
+	    "  first  INTEGER,"		/* tstamp of its first and last row */
+	    "  last   INTEGER,"
+	    "  rows   INTEGER NOT NULL"
+	    ")") ||
+	    ! sql_schema_exec(db,
+	    "CREATE VIEW IF NOT EXISTS q3log AS"
+	    "  SELECT l.id AS id, l.tstamp AS tstamp,"
+	    "         l.frame AS frame, l.svtime AS svtime, l.client AS client,"
+	    "         c.name AS caller, t.name AS target, m.name AS msgid,"
+	    "         l.value AS value, l.flags AS flags"
+	    "  FROM q3log_data l"
+	    "  LEFT JOIN endpoint c ON c.id = l.caller"
+	    "  LEFT JOIN endpoint t ON t.id = l.target"
+	    "  LEFT JOIN msgtype m ON m.id = l.msgid") ||
+	    ! sql_schema_exec(db, "PRAGMA user_version = " XSTRING(SQL_SCHEMA_VERSION))) {
+		return 0;
+	}
+
+	return sql_schema_fill_dictionaries(db);
+}
+
+/* Record which wall clock time (seconds since the Unix epoch) matches a
+   sql_clock value, so tstamp can be turned back into a date */
+int
+sql_add_session(sqlite3 *db, double started, long long clock)
+{
+	sqlite3_stmt *stmt;
+	int ok;
+
+	if (sqlite3_prepare_v2(db,
+	    "INSERT INTO session (started, tstamp) "
+	    "VALUES (strftime('%Y-%m-%dT%H:%M:%f', ?, 'unixepoch'), ?)",
+	    -1, &stmt, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to prepare the session insert");
+		return 0;
+	}
+	ok = sqlite3_bind_double(stmt, 1, started) == SQLITE_OK &&
+	    sqlite3_bind_int64(stmt, 2, clock) == SQLITE_OK &&
+	    sqlite3_step(stmt) == SQLITE_DONE;
+	sqlite3_finalize(stmt);
+
+	if (! ok) {
+		DEBUG_PRINT("Failed to insert the session");
+	}
+	return ok;
+}
+
+/* The id the segment being written now will get when it's closed */
+int
+sql_next_segment(sqlite3 *db)
+{
+	return sql_schema_query_int(db, "SELECT coalesce(max(id), 0) + 1 FROM segment");
+}
+
+/* Add the closed segment in file to the segment table of db, along with
+   every segment file listed.  This has to run outside a transaction.
+*/
+int
+sql_add_segment(sqlite3 *db, int id, const char *file, const char *label, const char *reason)
+{
+	sqlite3_stmt *stmt;
+	int ok;
+
+	if (sqlite3_prepare_v2(db, "ATTACH ? AS prev", -1, &stmt, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to prepare the attach");
+		return 0;
+	}
+	ok = sqlite3_bind_text(stmt, 1, file, -1, SQLITE_STATIC) == SQLITE_OK &&
+	    sqlite3_step(stmt) == SQLITE_DONE;
+	sqlite3_finalize(stmt);
+	if (! ok) {
+		DEBUG_PRINT("Failed to attach the closed segment");
+		return 0;
+	}
+
+	/* Rows are never deleted, so the ids tell how many there are */
+	ok = sql_schema_exec(db, "INSERT OR IGNORE INTO segment SELECT * FROM prev.segment") &&
+	    sqlite3_prepare_v2(db,
+	    "INSERT OR REPLACE INTO segment (id, file, label, reason, first, last, rows) "
+	    "VALUES (?, ?, ?, ?,"
+	    "  (SELECT tstamp FROM prev.q3log_data ORDER BY id LIMIT 1),"
+	    "  (SELECT tstamp FROM prev.q3log_data ORDER BY id DESC LIMIT 1),"
+	    "  (SELECT coalesce(max(id) - min(id) + 1, 0) FROM prev.q3log_data))",
+	    -1, &stmt, NULL) == SQLITE_OK;
+	if (ok) {
+		ok = sqlite3_bind_int(stmt, 1, id) == SQLITE_OK &&
+		    sqlite3_bind_text(stmt, 2, file, -1, SQLITE_STATIC) == SQLITE_OK &&
+		    sqlite3_bind_text(stmt, 3, label, -1, SQLITE_STATIC) == SQLITE_OK &&
+		    sqlite3_bind_text(stmt, 4, reason, -1, SQLITE_STATIC) == SQLITE_OK &&
+		    sqlite3_step(stmt) == SQLITE_DONE;
+		sqlite3_finalize(stmt);
+	}
+	if (! ok) {
+		DEBUG_PRINT("Failed to add the segment");
+	}
+
+	sql_schema_exec(db, "DETACH prev");
+	return ok;
+}
+
+/* Most segments the attach script attaches.  SQLite allows 10 attached
+   databases by default and the script's view runs in the live one. */
+#define SQL_ATTACH_MAX 9
+
+/* Write a script for the sqlite3 shell's .read that attaches the newest
+   closed segments and makes a q3log_all view over them and the live
+   database.
+*/
+int
+sql_write_attach_script(sqlite3 *db, const char *filename)
+{
+	sqlite3_stmt *stmt;
+	FILE *out;
+
+	if (sqlite3_prepare_v2(db,
+	    "SELECT id, file FROM (SELECT id, file FROM segment ORDER BY id DESC LIMIT "
+	    XSTRING(SQL_ATTACH_MAX) ") ORDER BY id",
+	    -1, &stmt, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to prepare the segment query");
+		return 0;
+	}
+	if ((out = fopen(filename, "w")) == NULL) {
+		DEBUG_PRINT("Failed to open the attach script");
+		sqlite3_finalize(stmt);
+		return 0;
+	}
+
+	fprintf(out, "-- Written when the log rotates.  Run .read on this in the live database.\n");
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		char *attach = sqlite3_mprintf("ATTACH %Q AS seg%d;\n",
+		    (const char *)sqlite3_column_text(stmt, 1), sqlite3_column_int(stmt, 0));
+
+		fputs(attach, out);
+		sqlite3_free(attach);
+	}
+
+	fprintf(out, "DROP VIEW IF EXISTS temp.q3log_all;\nCREATE TEMP VIEW q3log_all AS\n");
+	sqlite3_reset(stmt);
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		fprintf(out, "  SELECT %d AS segment, * FROM seg%d.q3log_data UNION ALL\n",
+		    sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 0));
+	}
+	fprintf(out, "  SELECT NULL AS segment, * FROM main.q3log_data;\n");
+	sqlite3_finalize(stmt);
+
+	if (fclose(out) != 0) {
+		DEBUG_PRINT("Failed to write the attach script");
+		return 0;
+	}
+	return 1;
+}
+
+/* Write a script for the sqlite3 shell's .read that attaches the database
+   of each logger under its name and makes a q3log_logs view over all of
+   them.  The tstamps come from one clock, so ORDER BY tstamp interleaves
+   the logs the way the calls happened.
+*/
+int
+sql_write_logs_script(const char *filename, const char * const *names, const char * const *files, int count)
+{
+	FILE *out;
+	int i;
+
+	if (count <= 0) {
+		return 0;
+	}
+	if ((out = fopen(filename, "w")) == NULL) {
+		DEBUG_PRINT("Failed to open the logs script");
+		return 0;
+	}
+
+	fprintf(out, "-- Written when a log is opened.  Run .read on this in a new sqlite3 shell.\n");
+	for (i = 0; i < count; i++) {
+		char *attach = sqlite3_mprintf("ATTACH %Q AS %s;\n", files[i], names[i]);
+
+		fputs(attach, out);
+		sqlite3_free(attach);
+	}
+
+	fprintf(out, "DROP VIEW IF EXISTS temp.q3log_logs;\nCREATE TEMP VIEW q3log_logs AS\n");
+	for (i = 0; i < count; i++) {
+		fprintf(out, "  SELECT '%s' AS log, * FROM %s.q3log_data%s\n", names[i], names[i],
+		    i < count - 1 ? " UNION ALL" : ";");
+	}
+
+	if (fclose(out) != 0) {
+		DEBUG_PRINT("Failed to write the logs script");
+		return 0;
+	}
+	return 1;
+}
+
+/* Indexes for reading a finished log.  The engine never makes these, every
+   insert would have to update them.  Both cover the queries they are for
+   without touching q3log_data: (msgid, tstamp) for counting a message or
+   finding it in a time range, (caller, target, msgid) for who talks to
+   whom.  ANALYZE lets the planner know they are there.
+*/
+int
+sql_create_indexes(sqlite3 *db)
+{
+	return sql_schema_exec(db,
+	    "CREATE INDEX IF NOT EXISTS q3log_msgid_tstamp ON q3log_data (msgid, tstamp)") &&
+	    sql_schema_exec(db,
+	    "CREATE INDEX IF NOT EXISTS q3log_caller_target ON q3log_data (caller, target, msgid)") &&
+	    sql_schema_exec(db, "ANALYZE");
+}
+
+/* Add the rows logged since the last call to the summary table, which
+   counts each msgid per second of tstamp.  summary_state remembers the last
+   q3log_data id that was counted, so this can run again on a log that is
+   still growing.  Returns how many rows were added, or -1.
+*/
+long long
+sql_update_summary(sqlite3 *db)
+{
+	sqlite3_stmt *stmt;
+	long long last = 0, rows = -1;
+
+	if (! sql_schema_exec(db,
+	    "CREATE TABLE IF NOT EXISTS summary"
+	    "("
+	    "  msgid  INTEGER NOT NULL REFERENCES msgtype(id),"
+	    "  second INTEGER NOT NULL,"	/* tstamp / 1000000000 */
+	    "  rows   INTEGER NOT NULL,"
+	    "  bytes  INTEGER NOT NULL,"	/* sum of length(value) */
+	    "  PRIMARY KEY (msgid, second)"
+	    ")") ||
+	    ! sql_schema_exec(db,
+	    "CREATE TABLE IF NOT EXISTS summary_state"
+	    "("
+	    "  id   INTEGER PRIMARY KEY CHECK (id = 1),"
+	    "  last INTEGER NOT NULL"		/* q3log_data id counted up to */
+	    ")") ||
+	    ! sql_schema_exec(db, "INSERT OR IGNORE INTO summary_state (id, last) VALUES (1, 0)")) {
+		return -1;
+	}
+
+	if (sqlite3_prepare_v2(db, "SELECT last FROM summary_state", -1, &stmt, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to prepare the summary query");
+		return -1;
+	}
+	if (sqlite3_step(stmt) == SQLITE_ROW) {
+		last = sqlite3_column_int64(stmt, 0);
+	}
+	sqlite3_finalize(stmt);
+
+	if (sqlite3_prepare_v2(db,
+	    "CREATE TEMP TABLE summary_new AS"
+	    "  SELECT msgid, tstamp / 1000000000 AS second, count(*) AS rows,"
+	    "         coalesce(sum(length(value)), 0) AS bytes, max(id) AS last"
+	    "  FROM q3log_data WHERE id > ? GROUP BY msgid, second",
+	    -1, &stmt, NULL) != SQLITE_OK) {
+		DEBUG_PRINT("Failed to prepare the summary");
+		return -1;
+	}
+	if (sqlite3_bind_int64(stmt, 1, last) != SQLITE_OK || sqlite3_step(stmt) != SQLITE_DONE) {
+		DEBUG_PRINT("Failed to count the new rows");
+		sqlite3_finalize(stmt);
+		return -1;
+	}
+	sqlite3_finalize(stmt);
+
+	/* Seconds that were already counted get the new rows added to them */
+	if (sql_schema_exec(db,
+	    "UPDATE summary SET"
+	    "  rows = rows + (SELECT n.rows FROM summary_new n WHERE n.msgid = summary.msgid AND n.second = summary.second),"
+	    "  bytes = bytes + (SELECT n.bytes FROM summary_new n WHERE n.msgid = summary.msgid AND n.second = summary.second)"
+	    "  WHERE EXISTS (SELECT 1 FROM summary_new n WHERE n.msgid = summary.msgid AND n.second = summary.second)") &&
+	    sql_schema_exec(db,
+	    "INSERT OR IGNORE INTO summary (msgid, second, rows, bytes)"
+	    "  SELECT msgid, second, rows, bytes FROM summary_new") &&
+	    sql_schema_exec(db,
+	    "UPDATE summary_state SET last = (SELECT coalesce(max(last), summary_state.last) FROM summary_new)")) {
+		rows = sql_schema_query_int(db, "SELECT coalesce(sum(rows), 0) FROM summary_new");
+	}
+	sql_schema_exec(db, "DROP TABLE temp.summary_new");
+	return rows;
+}
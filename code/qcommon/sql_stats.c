@@ -0,0 +1,304 @@
+/* Per-trap latency histograms.
+
+   sql_syscall runs SV_GameSystemCalls, CL_CgameSystemCalls and
+   CL_UISystemCalls through sql_stats_syscall, which times every trap with
+   sql_clock and adds it to a histogram for that trap number.  Nothing is logged per call, the
+   histograms are printed by the sql_trapstats command and written to the
+   trap_stats table of each VM's log every sql_trapStatsInterval seconds.
+
+   The histograms are log-linear like HdrHistogram: values below
+   2 * SQL_STATS_SUB are exact, above that each power of two is split into
+   SQL_STATS_SUB buckets, so percentiles are within 1 / SQL_STATS_SUB.
+*/
+
+#include <stdlib.h>
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+#define SQL_STATS_SUB_BITS	3
+#define SQL_STATS_SUB		(1 << SQL_STATS_SUB_BITS)
+#define SQL_STATS_MAX_BITS	40	/* about 18 minutes in nanoseconds */
+#define SQL_STATS_BUCKETS	(2 * SQL_STATS_SUB + (SQL_STATS_MAX_BITS - SQL_STATS_SUB_BITS - 1) * SQL_STATS_SUB)
+
+typedef struct {
+	int		msgID;
+	unsigned int	buckets[SQL_STATS_BUCKETS];
+	unsigned int	count;
+	long long	total;
+	long long	max;
+} sql_histogram_t;
+
+/* The VM import namespaces that are timed */
+static const int sql_statsNamespaces[] = {
+	SQL_NS_GAME_IMPORT,
+	SQL_NS_CGAME_IMPORT,
+	SQL_NS_UI_IMPORT
+};
+
+/* Allocated on the first call of each trap */
+static sql_histogram_t **sql_histograms[SQL_NS_MAX];
+
+static cvar_t *sql_trapStats;
+static cvar_t *sql_trapStatsInterval;
+static long long sql_nextSnapshot;
+
+static int
+sql_stats_bucket(long long value)
+{
+	int bits = 0;
+
+	if (value < 2 * SQL_STATS_SUB) {
+		return value < 0 ? 0 : (int)value;
+	}
+
+#ifdef __GNUC__
+	bits = 63 - __builtin_clzll((unsigned long long)value);
+#else
+	{
+		unsigned long long v = value;
+		while (v >>= 1) {
+			bits++;
+		}
+	}
+#endif
+	if (bits >= SQL_STATS_MAX_BITS) {
+		return SQL_STATS_BUCKETS - 1;
+	}
+
+	return 2 * SQL_STATS_SUB + (bits - SQL_STATS_SUB_BITS - 1) * SQL_STATS_SUB +
+	    (int)((value >> (bits - SQL_STATS_SUB_BITS)) & (SQL_STATS_SUB - 1));
+}
+
+/* Highest value that lands in a bucket */
+static long long
+sql_stats_bucket_value(int bucket)
+{
+	int bits;
+	long long low;
+
+	if (bucket < 2 * SQL_STATS_SUB) {
+		return bucket;
+	}
+
+	bits = (bucket - 2 * SQL_STATS_SUB) / SQL_STATS_SUB + SQL_STATS_SUB_BITS + 1;
+	low = (long long)(SQL_STATS_SUB + (bucket - 2 * SQL_STATS_SUB) % SQL_STATS_SUB) << (bits - SQL_STATS_SUB_BITS);
+	return low + (1LL << (bits - SQL_STATS_SUB_BITS)) - 1;
+}
+
+static long long
+sql_stats_percentile(const sql_histogram_t *h, double fraction)
+{
+	unsigned int want = (unsigned int)(h->count * fraction);
+	unsigned int seen = 0;
+	int i;
+
+	if (want < 1) {
+		want = 1;
+	}
+	for (i = 0; i < SQL_STATS_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= want) {
+			long long value = sql_stats_bucket_value(i);
+			return value < h->max ? value : h->max;
+		}
+	}
+	return h->max;
+}
+
+static void
+sql_stats_add(int ns, int num, long long elapsed)
+{
+	sql_histogram_t *h;
+
+	if (num < 0 || num >= sql_msg_count(ns)) {
+		return;
+	}
+
+	if (sql_histograms[ns] == NULL &&
+	    (sql_histograms[ns] = calloc(sql_msg_count(ns), sizeof(sql_histogram_t *))) == NULL) {
+		return;
+	}
+	if ((h = sql_histograms[ns][num]) == NULL) {
+		if ((h = sql_histograms[ns][num] = calloc(1, sizeof(sql_histogram_t))) == NULL) {
+			return;
+		}
+		h->msgID = SQL_MSG(ns, num);
+	}
+
+	h->buckets[sql_stats_bucket(elapsed)]++;
+	h->count++;
+	h->total += elapsed;
+	if (elapsed > h->max) {
+		h->max = elapsed;
+	}
+}
+
+static void
+sql_stats_reset(void)
+{
+	int i, num;
+
+	for (i = 0; i < ARRAY_LEN(sql_statsNamespaces); i++) {
+		int ns = sql_statsNamespaces[i];
+
+		if (sql_histograms[ns] == NULL) {
+			continue;
+		}
+		for (num = 0; num < sql_msg_count(ns); num++) {
+			free(sql_histograms[ns][num]);
+		}
+		free(sql_histograms[ns]);
+		sql_histograms[ns] = NULL;
+	}
+}
+
+/* Queue a trap_stats row for every trap that has been called */
+static void
+sql_stats_snapshot(void)
+{
+	sql_trap_stats_t row;
+	sql_data *log;
+	int i, num;
+
+	for (i = 0; i < ARRAY_LEN(sql_statsNamespaces); i++) {
+		int ns = sql_statsNamespaces[i];
+
+		if (sql_histograms[ns] == NULL) {
+			continue;
+		}
+		for (num = 0; num < sql_msg_count(ns); num++) {
+			const sql_histogram_t *h = sql_histograms[ns][num];
+
+			if (h == NULL || h->count == 0) {
+				continue;
+			}
+			row.count = h->count;
+			row.total = h->total;
+			row.p50 = sql_stats_percentile(h, 0.50);
+			row.p99 = sql_stats_percentile(h, 0.99);
+			row.max = h->max;
+			if ((log = sql_log_ns(ns)) != NULL) {
+				sql_insert_trap_stats(log, h->msgID, &row);
+			}
+		}
+	}
+}
+
+/* Run a VM system call, timing it if sql_trapStats is set */
+intptr_t
+sql_stats_syscall(int ns, intptr_t (*syscall)(intptr_t *), intptr_t *args)
+{
+	long long start, end;
+	intptr_t ret;
+	int num;
+
+	if (sql_trapStats == NULL || ! sql_trapStats->integer) {
+		return syscall(args);
+	}
+
+	num = args[0];
+	start = sql_clock();
+	ret = syscall(args);
+	end = sql_clock();
+
+	sql_stats_add(ns, num, end - start);
+
+	if (sql_log_ns(ns) != NULL && sql_trapStatsInterval->integer > 0 && end >= sql_nextSnapshot) {
+		if (sql_nextSnapshot != 0) {
+			sql_stats_snapshot();
+		}
+		sql_nextSnapshot = end + sql_trapStatsInterval->integer * 1000000000LL;
+	}
+	return ret;
+}
+
+/* Whether sql_stats_syscall times the traps */
+int
+sql_stats_active(void)
+{
+	return sql_trapStats != NULL && sql_trapStats->integer;
+}
+
+/* Changes whenever sql_trapStats is set */
+int
+sql_stats_generation(void)
+{
+	return sql_trapStats != NULL ? sql_trapStats->modificationCount : 0;
+}
+
+static int
+sql_stats_compare(const void *a, const void *b)
+{
+	const sql_histogram_t *ha = *(sql_histogram_t * const *)a;
+	const sql_histogram_t *hb = *(sql_histogram_t * const *)b;
+
+	return ha->total < hb->total ? 1 : ha->total > hb->total ? -1 : 0;
+}
+
+/* sql_trapstats [reset]: traps by the total time spent in them */
+static void
+sql_stats_f(void)
+{
+	sql_histogram_t **sorted;
+	int i, num, count = 0, total = 0;
+
+	if (! Q_stricmp(Cmd_Argv(1), "reset")) {
+		sql_stats_reset();
+		Com_Printf("Trap statistics cleared\n");
+		return;
+	}
+
+	if (sql_trapStats == NULL || ! sql_trapStats->integer) {
+		Com_Printf("Trap timing is off, set sql_trapStats 1\n");
+	}
+
+	for (i = 0; i < ARRAY_LEN(sql_statsNamespaces); i++) {
+		total += sql_msg_count(sql_statsNamespaces[i]);
+	}
+	if ((sorted = malloc(total * sizeof(*sorted))) == NULL) {
+		return;
+	}
+
+	for (i = 0; i < ARRAY_LEN(sql_statsNamespaces); i++) {
+		int ns = sql_statsNamespaces[i];
+
+		if (sql_histograms[ns] == NULL) {
+			continue;
+		}
+		for (num = 0; num < sql_msg_count(ns); num++) {
+			if (sql_histograms[ns][num] != NULL && sql_histograms[ns][num]->count > 0) {
+				sorted[count++] = sql_histograms[ns][num];
+			}
+		}
+	}
+	qsort(sorted, count, sizeof(*sorted), sql_stats_compare);
+
+	Com_Printf("%-32s %10s %10s %9s %9s %9s %9s\n", "trap", "count", "total ms", "avg us", "p50 us", "p99 us", "max us");
+	for (i = 0; i < count; i++) {
+		const sql_histogram_t *h = sorted[i];
+		const char *name = sql_msg_name(h->msgID);
+
+		Com_Printf("%-32s %10u %10.2f %9.2f %9.2f %9.2f %9.2f\n", name != NULL ? name : "?",
+		    h->count, h->total / 1e6, h->total / 1e3 / h->count,
+		    sql_stats_percentile(h, 0.50) / 1e3, sql_stats_percentile(h, 0.99) / 1e3, h->max / 1e3);
+	}
+	Com_Printf("%d traps\n", count);
+
+	free(sorted);
+}
+
+void
+sql_stats_init(void)
+{
+	sql_trapStats = Cvar_Get("sql_trapStats", "0", CVAR_ARCHIVE);
+	sql_trapStatsInterval = Cvar_Get("sql_trapStatsInterval", "60", CVAR_ARCHIVE);
+	sql_nextSnapshot = 0;
+	Cmd_AddCommand("sql_trapstats", sql_stats_f);
+}
+
+void
+sql_stats_shutdown(void)
+{
+	Cmd_RemoveCommand("sql_trapstats");
+}
@@ -0,0 +1,195 @@
+/* Logging for the VM system calls.
+
+   SV_GameSystemCalls, CL_CgameSystemCalls and CL_UISystemCalls don't log
+   anything themselves.  The VMs call them through sql_syscall, which looks
+   the trap up in sql_names.c and logs the arguments its args string asks
+   for.  Traps that only take inputs are logged before they run so a trap
+   that doesn't return (G_ERROR) is still in the log.  Traps that fill in
+   buffers or return something are logged afterwards.
+
+   The call itself goes through sql_stats_syscall, so it is timed the same
+   way whether it's logged or not.
+
+   VM_Call logs the other direction through sql_vm_call, so sql_replay.c
+   can make the same calls into a VM and answer its traps from the log.
+*/
+
+#include <string.h>
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+/* The VM making the call and the engine side answering it */
+typedef struct {
+	const char *module;	/* as passed to VM_Create */
+	sqlEndpoint_t caller;
+	sqlEndpoint_t target;
+} sql_syscall_endpoints_t;
+
+static const sql_syscall_endpoints_t sql_syscallEndpoints[SQL_NS_MAX] = {
+	[SQL_NS_GAME_IMPORT] = { "qagame", SQL_EP_QAGAME_QVM, SQL_EP_SERVER },
+	[SQL_NS_CGAME_IMPORT] = { "cgame", SQL_EP_CGAME_QVM, SQL_EP_CLIENT },
+	[SQL_NS_UI_IMPORT] = { "ui", SQL_EP_UI_QVM, SQL_EP_CLIENT }
+};
+
+/* Fill values from args as described by trap->args.  Returns the number
+   of values or -1 when the row should be NULL.
+*/
+static int
+sql_syscall_values(const sql_msg_t *trap, intptr_t *args, intptr_t ret, sql_arg_t *values)
+{
+	const char *kind;
+	int count = 0;
+	int n = 1;
+
+	for (kind = trap->args; *kind != '\0' && *kind != '=' && count < SQL_ARGS_MAX; kind++, n++) {
+		sql_arg_t *v = &values[count];
+
+		switch (*kind) {
+		case 'i':
+			v->type = 'i';
+			v->u.i = args[n];
+			break;
+		case 'f':
+			v->type = 'f';
+			v->u.d = _vmf(args[n]);
+			break;
+		case 's':
+		case 'S':
+			v->type = 's';
+			v->size = -1;
+			v->u.p = VMA(n);
+			break;
+		case 'n':
+		{
+			const char *end;
+
+			v->type = 's';
+			v->u.p = VMA(n);
+			v->size = args[n + 1] > 0 ? args[n + 1] : 0;
+			if ((end = memchr(v->u.p, '\0', v->size)) != NULL) {
+				v->size = end - (const char *)v->u.p;
+			}
+			break;
+		}
+		case 'I':
+			v->type = 'i';
+			v->u.i = *(int *)VMA(n);
+			break;
+		case 'b':
+		case 'B':
+			v->type = 'b';
+			v->size = trap->size;
+			v->u.p = VMA(n);
+			break;
+		case 'L':
+			v->type = 'b';
+			v->size = ret > 0 ? ret * sizeof(int) : 0;
+			v->u.p = VMA(n);
+			break;
+		default:
+			continue;
+		}
+		count++;
+	}
+
+	if (*kind == '=' && count < SQL_ARGS_MAX) {
+		switch (kind[1]) {
+		case 'i':
+			values[count].type = 'i';
+			values[count++].u.i = ret;
+			break;
+		case 'f':
+			values[count].type = 'f';
+			values[count++].u.d = _vmf(ret);
+			break;
+		case 'q':
+			if (! ret) {
+				return -1;
+			}
+			break;
+		}
+	}
+	return count;
+}
+
+/* Run a VM system call, logging it as sql_names.c describes */
+intptr_t
+sql_syscall(int ns, intptr_t (*syscall)(intptr_t *), intptr_t *args)
+{
+	sql_arg_t values[SQL_ARGS_MAX];
+	const sql_msg_t *trap;
+	const sql_syscall_endpoints_t *ep;
+	sql_data *log = sql_log_ns(ns);
+	intptr_t ret = 0;
+	int count;
+
+	if (log == NULL || args == NULL || args[0] < 0 ||
+	    (trap = sql_msg(SQL_MSG(ns, (int)args[0]))) == NULL || trap->args == NULL) {
+		return sql_stats_syscall(ns, syscall, args);
+	}
+
+	ep = &sql_syscallEndpoints[ns];
+	if (strpbrk(trap->args, "SIBL=") == NULL) {
+		if ((count = sql_syscall_values(trap, args, 0, values)) >= 0) {
+			sql_insert_values(log, ep->caller, ep->target, SQL_MSG(ns, (int)args[0]), values, count);
+		}
+		return sql_stats_syscall(ns, syscall, args);
+	}
+
+	ret = sql_stats_syscall(ns, syscall, args);
+	count = sql_syscall_values(trap, args, ret, values);
+	sql_insert_values(log, ep->caller, ep->target, SQL_MSG(ns, (int)args[0]), values, count < 0 ? 0 : count);
+	return ret;
+}
+
+/* The import namespace of a VM module, or -1 */
+int
+sql_syscall_module(const char *module)
+{
+	int ns;
+
+	for (ns = 0; ns < SQL_NS_MAX; ns++) {
+		if (sql_syscallEndpoints[ns].module != NULL && ! Q_stricmp(sql_syscallEndpoints[ns].module, module)) {
+			return ns;
+		}
+	}
+	return -1;
+}
+
+/* Whether a trap goes anywhere but the VM's own systemCall: into a log
+   whose sql_filter doesn't deny it, or into the sql_trapStats histograms.
+   Its VM_RegisterSyscalls entry can't be called directly then. */
+qboolean
+sql_syscall_logged(int ns, int num)
+{
+	const sql_msg_t *trap;
+
+	if (sql_stats_active()) {
+		return qtrue;
+	}
+	if (sql_log_ns(ns) == NULL || (trap = sql_msg(SQL_MSG(ns, num))) == NULL || trap->args == NULL) {
+		return qfalse;
+	}
+	return ! sql_unwanted(SQL_MSG(ns, num));
+}
+
+/* Log a call into a VM: the export number followed by its arguments,
+   without the trailing zeros */
+void
+sql_vm_call(const char *module, const int *args, int count)
+{
+	const sql_syscall_endpoints_t *ep;
+	sql_data *log;
+	int ns;
+
+	if ((ns = sql_syscall_module(module)) < 0 || (log = sql_log_ns(ns)) == NULL) {
+		return;
+	}
+
+	while (count > 1 && args[count - 1] == 0) {
+		count--;
+	}
+	ep = &sql_syscallEndpoints[ns];
+	sql_insert_blob(log, ep->target, ep->caller, SQL_ENGINE(SQL_MSG_VM_CALL), (void *)args, count * sizeof(int));
+}
@@ -0,0 +1,56 @@
+#ifndef __SQL_TRACE_H__
+#define __SQL_TRACE_H__
+
+/* q3trace: the append-only binary log written by the trace backend of
+   sql_log.c (sql_trace 1) and bulk-loaded into the q3log schema by
+   q3trace2sqlite.
+
+   A file is one sqlTraceHeader_t followed by records.  Each record is a
+   sqlTraceRecord_t and then size bytes of payload:
+
+     SQL_TRACE_NULL     nothing
+     SQL_TRACE_INT      a 32 bit int
+     SQL_TRACE_DOUBLE   a double
+     SQL_TRACE_TEXT     the text, not terminated
+     SQL_TRACE_BLOB     the bytes
+
+   Everything is in the byte order of the machine that wrote it, the
+   header's byteOrder tells the reader if that's not its own.  A file cut
+   short by a crash is valid up to the last whole record.
+*/
+
+#define SQL_TRACE_MAGIC		"Q3TRACE"
+#define SQL_TRACE_VERSION	2
+#define SQL_TRACE_BYTE_ORDER	0x01020304
+
+typedef enum {
+	SQL_TRACE_NULL,
+	SQL_TRACE_INT,
+	SQL_TRACE_DOUBLE,
+	SQL_TRACE_TEXT,
+	SQL_TRACE_BLOB
+} sqlTraceType_t;
+
+typedef struct {
+	char		magic[8];
+	int		version;
+	int		byteOrder;
+	double		startTime;	/* seconds since the Unix epoch when the file was opened */
+	long long	startClock;	/* sql_clock at the same moment */
+} sqlTraceHeader_t;
+
+typedef struct {
+	long long	time;		/* sql_clock nanoseconds */
+	int		size;		/* payload bytes that follow */
+	int		caller;		/* endpoint */
+	int		target;		/* endpoint */
+	int		msgID;		/* msgtype */
+	int		type;		/* sqlTraceType_t */
+	int		frame;		/* com_frameNumber */
+	int		serverTime;	/* svs.time or cl.serverTime, SQL_TRACE_UNSET for none */
+	int		client;		/* client number, -1 for none */
+} sqlTraceRecord_t;
+
+#define SQL_TRACE_UNSET		(-0x7fffffff - 1)
+
+#endif
@@ -43,12 +43,12 @@ int		vm_debugLevel;
 // used by Com_Error to get rid of running vm's before longjmp
 static int forced_unload;
 
-#define	MAX_VM		3
 vm_t	vmTable[MAX_VM];
 
 
 void VM_VmInfo_f( void );
 void VM_VmProfile_f( void );
+void VM_Test_f( void );
 
 
 
@@ -73,9 +73,15 @@ void VM_Init( void ) {
 	Cvar_Get( "vm_cgame", "2", CVAR_ARCHIVE );	// !@# SHIP WITH SET TO 2
 	Cvar_Get( "vm_game", "2", CVAR_ARCHIVE );	// !@# SHIP WITH SET TO 2
 	Cvar_Get( "vm_ui", "2", CVAR_ARCHIVE );		// !@# SHIP WITH SET TO 2
+	Cvar_Get( "vm_threaded", "1", CVAR_ARCHIVE );	// interpreter dispatch, see vm_interpreted.c
+	Cvar_Get( "vm_directSyscalls", "1", CVAR_ARCHIVE );	// see VM_RegisterSyscalls
+	Cvar_Get( "vm_inlineSyscalls", "1", CVAR_ARCHIVE );	// see EmitCallConst in vm_x86.c
+	Cvar_Get( "vm_compileCache", "1", CVAR_ARCHIVE );	// see VM_LoadCompiled in vm_x86.c
 
 	Cmd_AddCommand ("vmprofile", VM_VmProfile_f );
 	Cmd_AddCommand ("vminfo", VM_VmInfo_f );
+	Cmd_AddCommand ("vmsample", VM_Sample_f );
+	Cmd_AddCommand ("vmtest", VM_Test_f );
 
 	Com_Memset( vmTable, 0, sizeof( vmTable ) );
 }
@@ -451,7 +457,7 @@ vmHeader_t *VM_LoadQVM( vm_t *vm, qboolean alloc, qboolean unpure)
 	if(alloc)
 	{
 		// allocate zero filled space for initialized and uninitialized data
-		vm->dataBase = Hunk_Alloc(dataLength, h_high);
+		vm->dataBase = Hunk_Alloc(dataLength + VM_DATA_GUARD, h_high);
 		vm->dataMask = dataLength - 1;
 	}
 	else
@@ -563,6 +569,98 @@ vm_t *VM_Restart(vm_t *vm, qboolean unpure)
 	return vm;
 }
 
+/*
+================
+VM_RegisterSyscalls
+
+syscalls is indexed by trap number.  Compiled code calls the traps that
+have a func straight from the generated code instead of through
+systemCalls, or does the ones marked inlined itself, as long as logged
+says the trap doesn't have to be logged.  Has to be called before
+VM_Create, the compiler only makes direct calls to the traps that are
+registered when it runs.
+================
+*/
+#define	MAX_SYSCALL_TABLES	4
+
+typedef struct {
+	intptr_t	(*systemCalls)( intptr_t * );
+	const vmSyscall_t	*syscalls;
+	int			numSyscalls;
+	qboolean	(*logged)( int trap );
+} vmSyscallTable_t;
+
+static vmSyscallTable_t vmSyscallTables[MAX_SYSCALL_TABLES];
+
+void VM_RegisterSyscalls( intptr_t (*systemCalls)(intptr_t *), const vmSyscall_t *syscalls,
+				int numSyscalls, qboolean (*logged)( int trap ) ) {
+	vmSyscallTable_t	*table;
+	int		i;
+
+	for ( i = 0 ; i < MAX_SYSCALL_TABLES ; i++ ) {
+		table = &vmSyscallTables[i];
+		if ( table->systemCalls == systemCalls || !table->systemCalls ) {
+			break;
+		}
+	}
+
+	if ( i == MAX_SYSCALL_TABLES ) {
+		Com_Error( ERR_FATAL, "VM_RegisterSyscalls: too many tables" );
+	}
+
+	table->systemCalls = systemCalls;
+	table->syscalls = syscalls;
+	table->numSyscalls = numSyscalls;
+	table->logged = logged;
+}
+
+/*
+================
+VM_SetSyscallDirect
+
+Mark the traps compiled code can call without systemCall, the ones with a
+function that nothing logs or times right now
+================
+*/
+static void VM_SetSyscallDirect( vm_t *vm ) {
+	int		i;
+
+#ifdef USE_SQLITE3
+	vm->syscallsGeneration = sql_syscall_generation();
+#endif
+	for ( i = 0 ; i < vm->numSyscalls ; i++ ) {
+		vm->syscallDirect[i] = vm->syscalls[i].func && !( vm->syscallsLogged && vm->syscallsLogged( i ) );
+	}
+}
+
+/*
+================
+VM_FindSyscalls
+
+Give the vm the traps registered for its systemCall
+================
+*/
+static void VM_FindSyscalls( vm_t *vm ) {
+	vmSyscallTable_t	*table;
+	int		i;
+
+	if ( !Cvar_VariableIntegerValue( "vm_directSyscalls" ) ) {
+		return;
+	}
+
+	for ( i = 0 ; i < MAX_SYSCALL_TABLES ; i++ ) {
+		table = &vmSyscallTables[i];
+		if ( table->systemCalls == vm->systemCall ) {
+			vm->syscalls = table->syscalls;
+			vm->numSyscalls = table->numSyscalls;
+			vm->syscallsLogged = table->logged;
+			vm->syscallDirect = Hunk_Alloc( vm->numSyscalls, h_high );
+			VM_SetSyscallDirect( vm );
+			return;
+		}
+	}
+}
+
 /*
 ================
 VM_Create
@@ -641,11 +739,17 @@ vm_t *VM_Create( const char *module, intptr_t (*systemCalls)(intptr_t *),
 		return NULL;
 
 	vm->systemCall = systemCalls;
+	VM_FindSyscalls( vm );
 
 	// allocate space for the jump targets, which will be filled in by the compile/prep functions
 	vm->instructionCount = header->instructionCount;
 	vm->instructionPointers = Hunk_Alloc(vm->instructionCount * sizeof(*vm->instructionPointers), h_high);
 
+	// the stack is implicitly at the end of the image, the compiler
+	// checks programStack against it
+	vm->programStack = vm->dataMask + 1;
+	vm->stackBottom = vm->programStack - PROGRAM_STACK_SIZE;
+
 	// copy or compile the instructions
 	vm->codeLength = header->codeLength;
 
@@ -669,16 +773,15 @@ vm_t *VM_Create( const char *module, intptr_t (*systemCalls)(intptr_t *),
 		VM_PrepareInterpreter( vm, header );
 	}
 
+	// find the functions for the sampling profiler
+	VM_SampleFunctions( vm, header );
+
 	// free the original file
 	FS_FreeFile( header );
 
 	// load the map file
 	VM_LoadSymbols( vm );
 
-	// the stack is implicitly at the end of the image
-	vm->programStack = vm->dataMask + 1;
-	vm->stackBottom = vm->programStack - PROGRAM_STACK_SIZE;
-
 	Com_Printf("%s loaded in %d bytes on the hunk\n", module, remaining - Hunk_MemoryRemaining());
 
 	return vm;
@@ -704,6 +807,9 @@ void VM_Free( vm_t *vm ) {
 		}
 	}
 
+	// samples can't be put down to functions once the code is gone
+	VM_SampleFree(vm);
+
 	if(vm->destroy)
 		vm->destroy(vm);
 
@@ -777,6 +883,35 @@ void *VM_ExplicitArgPtr( vm_t *vm, intptr_t intValue ) {
 	}
 }
 
+/*
+==============
+VM_DataChecksum
+
+Of the data segment below the program stack, which is the same whether
+the VM was interpreted or compiled, so the two can be compared
+==============
+*/
+unsigned VM_DataChecksum( vm_t *vm ) {
+	int	length;
+
+	length = vm->stackBottom > 0 ? vm->stackBottom : 0;
+	return Com_BlockChecksum( vm->dataBase, length );
+}
+
+/*
+==============
+VM_Interpret
+
+How the VM was loaded, which isn't always what VM_Create was asked for
+==============
+*/
+vmInterpret_t VM_Interpret( vm_t *vm ) {
+	if ( vm->dllHandle ) {
+		return VMI_NATIVE;
+	}
+	return vm->compiled ? VMI_COMPILED : VMI_BYTECODE;
+}
+
 
 /*
 ==============
@@ -806,6 +941,8 @@ intptr_t QDECL VM_Call( vm_t *vm, int callnum, ... )
 {
 	vm_t	*oldVM;
 	intptr_t r;
+	int args[MAX_VMMAIN_ARGS];	// callnum followed by its arguments
+	va_list ap;
 	int i;
 
 	if(!vm || !vm->name[0])
@@ -819,49 +956,40 @@ intptr_t QDECL VM_Call( vm_t *vm, int callnum, ... )
 	  Com_Printf( "VM_Call( %d )\n", callnum );
 	}
 
+	//rcg010207 -  see dissertation at top of VM_DllSyscall() in this file.
+	args[0] = callnum;
+	va_start(ap, callnum);
+	for (i = 1; i < ARRAY_LEN(args); i++) {
+		args[i] = va_arg(ap, int);
+	}
+	va_end(ap);
+
+#ifdef USE_SQLITE3
+	// the call and its arguments are logged so sql_replay can make it again
+	sql_vm_call( vm->name, args, ARRAY_LEN(args) );
+#endif
+
+#ifdef USE_SQLITE3
+	// traps that are logged have to go through systemCall, which only
+	// changes when a log is opened or closed or sql_filter or sql_trapStats is set
+	if ( vm->compiled && vm->syscallDirect && vm->syscallsGeneration != sql_syscall_generation() ) {
+		VM_SetSyscallDirect( vm );
+	}
+#endif
+
 	++vm->callLevel;
 	// if we have a dll loaded, call it directly
 	if ( vm->entryPoint ) {
-		//rcg010207 -  see dissertation at top of VM_DllSyscall() in this file.
-		int args[MAX_VMMAIN_ARGS-1];
-		va_list ap;
-		va_start(ap, callnum);
-		for (i = 0; i < ARRAY_LEN(args); i++) {
-			args[i] = va_arg(ap, int);
-		}
-		va_end(ap);
-
-		r = vm->entryPoint( callnum,  args[0],  args[1],  args[2], args[3],
-                            args[4],  args[5],  args[6], args[7],
-                            args[8],  args[9], args[10], args[11]);
+		r = vm->entryPoint( args[0],  args[1],  args[2],  args[3], args[4],
+                            args[5],  args[6],  args[7], args[8],
+                            args[9],  args[10], args[11], args[12]);
 	} else {
-#if ( id386 || idsparc ) && !defined __clang__ // calling convention doesn't need conversion in some cases
-#ifndef NO_VM_COMPILED
-		if ( vm->compiled )
-			r = VM_CallCompiled( vm, (int*)&callnum );
-		else
-#endif
-			r = VM_CallInterpreted( vm, (int*)&callnum );
-#else
-		struct {
-			int callnum;
-			int args[MAX_VMMAIN_ARGS-1];
-		} a;
-		va_list ap;
-
-		a.callnum = callnum;
-		va_start(ap, callnum);
-		for (i = 0; i < ARRAY_LEN(a.args); i++) {
-			a.args[i] = va_arg(ap, int);
-		}
-		va_end(ap);
 #ifndef NO_VM_COMPILED
 		if ( vm->compiled )
-			r = VM_CallCompiled( vm, &a.callnum );
+			r = VM_CallCompiled( vm, args );
 		else
 #endif
-			r = VM_CallInterpreted( vm, &a.callnum );
-#endif
+			r = VM_CallInterpreted( vm, args );
 	}
 	--vm->callLevel;
 
@@ -870,6 +998,240 @@ intptr_t QDECL VM_Call( vm_t *vm, int callnum, ... )
 	return r;
 }
 
+/*
+==============
+VM_TrapMemset
+
+The memory and math traps every module has, in their syscall tables
+==============
+*/
+intptr_t VM_TrapMemset( intptr_t *args ) {
+	Com_Memset( VMA(1), args[2], args[3] );
+	return 0;
+}
+
+intptr_t VM_TrapMemcpy( intptr_t *args ) {
+	Com_Memcpy( VMA(1), VMA(2), args[3] );
+	return 0;
+}
+
+intptr_t VM_TrapStrncpy( intptr_t *args ) {
+	strncpy( VMA(1), VMA(2), args[3] );
+	return args[1];
+}
+
+static int VM_FloatAsInt( float f ) {
+	floatint_t fi;
+	fi.f = f;
+	return fi.i;
+}
+
+intptr_t VM_TrapSqrt( intptr_t *args ) {
+	return VM_FloatAsInt( sqrt( VMF(1) ) );
+}
+
+intptr_t VM_TrapSin( intptr_t *args ) {
+	return VM_FloatAsInt( sin( VMF(1) ) );
+}
+
+intptr_t VM_TrapCos( intptr_t *args ) {
+	return VM_FloatAsInt( cos( VMF(1) ) );
+}
+
+/*
+==============
+VM_Test_f
+
+vmtest: checks the memory traps the compiler does inline against the
+engine's functions.  For each one a QVM whose vmMain makes the trap with
+its own arguments is written to the home path and run compiled, with
+vm_inlineSyscalls on, and interpreted, which always makes the call.  Every
+case has to return the same and leave the same bytes around the
+destination.  The VMs are loaded on the hunk, so like sql_replay this only
+runs on a dedicated server with no map loaded.
+==============
+*/
+#define VMTEST_DEST		0x020	// not 0, VM_ArgPtr makes that NULL
+#define VMTEST_SOURCES		0x100	// strings of 0, 3, 8 and 32 characters
+#define VMTEST_DEST_SIZE	48
+#define VMTEST_DATA		0x200
+#define VMTEST_FRAME		24
+
+static const char *vmTestStrings[] = { "", "abc", "abcdefgh", "abcdefghijklmnopqrstuvwxyz012345" };
+static const int vmTestCounts[] = { 0, 1, 3, 4, 8, 9, 40 };
+
+static const vmSyscall_t vmTestSyscalls[] = {
+	[TRAP_MEMSET] = { VM_TrapMemset, 3, VM_INLINE_MEMSET },
+	[TRAP_MEMCPY] = { VM_TrapMemcpy, 3, VM_INLINE_MEMCPY },
+	[TRAP_STRNCPY] = { VM_TrapStrncpy, 3, VM_INLINE_STRNCPY }
+};
+
+static intptr_t VM_TestSyscall( intptr_t *args ) {
+	if ( args[0] < 0 || args[0] >= ARRAY_LEN( vmTestSyscalls ) || !vmTestSyscalls[args[0]].func ) {
+		Com_Error( ERR_DROP, "vmtest: unexpected trap %d", (int)args[0] );
+	}
+	return vmTestSyscalls[args[0]].func( args );
+}
+
+/*
+==============
+VM_TestWrite
+
+vmMain( dest, src, count ) { return trap( dest, src, count ); }
+==============
+*/
+static void VM_TestWrite( const char *filename, int trap ) {
+	static const int program[][2] = {
+		{ OP_ENTER, VMTEST_FRAME },
+		{ OP_LOCAL, VMTEST_FRAME + 8 }, { OP_LOAD4, 0 }, { OP_ARG, 8 },
+		{ OP_LOCAL, VMTEST_FRAME + 12 }, { OP_LOAD4, 0 }, { OP_ARG, 12 },
+		{ OP_LOCAL, VMTEST_FRAME + 16 }, { OP_LOAD4, 0 }, { OP_ARG, 16 },
+		{ OP_CONST, 0 }, { OP_CALL, 0 },	// the trap
+		{ OP_LEAVE, VMTEST_FRAME }
+	};
+	byte		image[sizeof( vmHeader_t ) + 256 + VMTEST_DATA + 4];
+	vmHeader_t	*header = (vmHeader_t *)image;
+	byte		*code = image + sizeof( *header );
+	byte		*data;
+	int			i, length, operand;
+
+	Com_Memset( image, 0, sizeof( image ) );
+
+	length = 0;
+	for ( i = 0 ; i < ARRAY_LEN( program ) ; i++ ) {
+		code[length++] = program[i][0];
+		operand = program[i][0] == OP_CONST ? -1 - trap : program[i][1];
+		if ( program[i][0] == OP_ARG ) {
+			code[length++] = operand;
+		} else if ( program[i][0] == OP_ENTER || program[i][0] == OP_LEAVE ||
+			program[i][0] == OP_LOCAL || program[i][0] == OP_CONST ) {
+			code[length++] = operand & 0xff;
+			code[length++] = ( operand >> 8 ) & 0xff;
+			code[length++] = ( operand >> 16 ) & 0xff;
+			code[length++] = ( operand >> 24 ) & 0xff;
+		}
+	}
+	length = ( length + 3 ) & ~3;
+
+	header->vmMagic = LittleLong( VM_MAGIC_VER2 );
+	header->instructionCount = LittleLong( ARRAY_LEN( program ) );
+	header->codeOffset = LittleLong( sizeof( *header ) );
+	header->codeLength = LittleLong( length );
+	header->dataOffset = LittleLong( sizeof( *header ) + length );
+	// all lit, so the strings aren't byte swapped
+	header->dataLength = 0;
+	header->litLength = LittleLong( VMTEST_DATA );
+	header->bssLength = LittleLong( PROGRAM_STACK_SIZE );
+	// a jump table target is what lets the compiler merge the CONST and CALL
+	header->jtrgLength = LittleLong( 4 );
+
+	data = code + length;
+	for ( i = 0 ; i < ARRAY_LEN( vmTestStrings ) ; i++ ) {
+		strcpy( (char *)data + VMTEST_SOURCES + i * 64, vmTestStrings[i] );
+	}
+
+	FS_WriteFile( filename, image, sizeof( *header ) + length + VMTEST_DATA + 4 );
+}
+
+/*
+==============
+VM_TestRun
+
+Runs every case in one VM, and keeps what each left behind
+==============
+*/
+static qboolean VM_TestRun( int trap, vmInterpret_t interpret, byte *results ) {
+	vm_t	*vm;
+	byte	*dest;
+	int		i, j, src;
+
+	vm = VM_Create( "vmtest", VM_TestSyscall, interpret );
+	if ( !vm ) {
+		return qfalse;
+	}
+	if ( interpret == VMI_COMPILED && !vm->compiled ) {
+		Com_Printf( "vmtest: the QVM wasn't compiled\n" );
+		VM_Free( vm );
+		return qfalse;
+	}
+
+	dest = vm->dataBase + VMTEST_DEST;
+	for ( i = 0 ; i < ARRAY_LEN( vmTestStrings ) ; i++ ) {
+		for ( j = 0 ; j < ARRAY_LEN( vmTestCounts ) ; j++ ) {
+			// memset gets a value instead, with bits above the byte
+			src = trap == TRAP_MEMSET ? 0x141 + i : VMTEST_SOURCES + i * 64;
+
+			Com_Memset( dest, 0x55, VMTEST_DEST_SIZE );
+			*(int *)results = VM_Call( vm, VMTEST_DEST, src, vmTestCounts[j] );
+			Com_Memcpy( results + 4, dest, VMTEST_DEST_SIZE );
+			results += 4 + VMTEST_DEST_SIZE;
+		}
+	}
+
+	VM_Free( vm );
+	return qtrue;
+}
+
+void VM_Test_f( void ) {
+	static const struct {
+		int		trap;
+		const char	*name;
+	} traps[] = {
+		{ TRAP_MEMSET, "memset" },
+		{ TRAP_MEMCPY, "memcpy" },
+		{ TRAP_STRNCPY, "strncpy" }
+	};
+	const char	*filename = "vm/vmtest.qvm";
+	byte		compiled[ARRAY_LEN( vmTestStrings ) * ARRAY_LEN( vmTestCounts ) * ( 4 + VMTEST_DEST_SIZE )];
+	byte		interpreted[sizeof( compiled )];
+	char		cache[MAX_CVAR_VALUE_STRING];
+	int			t, i, j, n, failed;
+
+	if ( !com_dedicated->integer || com_sv_running->integer ) {
+		Com_Printf( "vmtest only runs on a dedicated server with no map loaded\n" );
+		return;
+	}
+	if ( !Cvar_VariableIntegerValue( "vm_directSyscalls" ) || !Cvar_VariableIntegerValue( "vm_inlineSyscalls" ) ) {
+		Com_Printf( "vmtest needs vm_directSyscalls and vm_inlineSyscalls on\n" );
+		return;
+	}
+#ifdef NO_VM_COMPILED
+	Com_Printf( "Architecture doesn't have a bytecode compiler\n" );
+	return;
+#endif
+
+	// the test QVM shouldn't be left in the compile cache
+	Cvar_VariableStringBuffer( "vm_compileCache", cache, sizeof( cache ) );
+	Cvar_Set( "vm_compileCache", "0" );
+	VM_RegisterSyscalls( VM_TestSyscall, vmTestSyscalls, ARRAY_LEN( vmTestSyscalls ), NULL );
+
+	for ( t = 0 ; t < ARRAY_LEN( traps ) ; t++ ) {
+		VM_TestWrite( filename, traps[t].trap );
+		if ( !VM_TestRun( traps[t].trap, VMI_COMPILED, compiled ) ||
+			!VM_TestRun( traps[t].trap, VMI_BYTECODE, interpreted ) ) {
+			break;
+		}
+
+		failed = 0;
+		n = 0;
+		for ( i = 0 ; i < ARRAY_LEN( vmTestStrings ) ; i++ ) {
+			for ( j = 0 ; j < ARRAY_LEN( vmTestCounts ) ; j++, n++ ) {
+				if ( memcmp( compiled + n * ( 4 + VMTEST_DEST_SIZE ),
+					interpreted + n * ( 4 + VMTEST_DEST_SIZE ), 4 + VMTEST_DEST_SIZE ) ) {
+					Com_Printf( S_COLOR_RED "vmtest: %s of \"%s\" with count %d differs from the trap\n",
+						traps[t].name, vmTestStrings[i], vmTestCounts[j] );
+					failed++;
+				}
+			}
+		}
+		Com_Printf( "vmtest: %s, %d of %d cases the same inline\n", traps[t].name, n - failed, n );
+	}
+
+	FS_HomeRemove( filename );
+	Cvar_Set( "vm_compileCache", cache );
+	Hunk_Clear();
+}
+
 //=================================================================
 
 static int QDECL VM_ProfileSort( const void *a, const void *b ) {
@@ -955,8 +1317,12 @@ void VM_VmInfo_f( void ) {
 			Com_Printf( "native\n" );
 			continue;
 		}
-		if ( vm->compiled ) {
+		if ( vm->compiled && vm->syscalls ) {
+			Com_Printf( "compiled on load, direct syscalls\n" );
+		} else if ( vm->compiled ) {
 			Com_Printf( "compiled on load\n" );
+		} else if ( vm->threadedCode ) {
+			Com_Printf( "interpreted, threaded\n" );
 		} else {
 			Com_Printf( "interpreted\n" );
 		}
@@ -21,6 +21,27 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 #include "vm_local.h"
 
+// The threaded interpreter needs labels as values, which GCC and clang have.
+// The switch loop is still there for other compilers, DEBUG_VM and
+// vm_threaded 0.
+#if defined( __GNUC__ ) && !defined( DEBUG_VM )
+#define	VM_THREADED
+
+// Superinstructions for common pairs of opcodes, only in threaded code.
+// They replace the first opcode of the pair and leave the second in place,
+// so a jump to the second instruction still runs it on its own.
+enum {
+	OP_LOCAL_LOAD4 = OP_CVFI + 1,	// LOCAL n, LOAD4
+	OP_CONST_CALL,					// CONST n, CALL to a VM function, n is a code offset
+	OP_CONST_SYSCALL,				// CONST n, CALL with n < 0
+	OP_END,							// one past the last instruction
+
+	OP_MAX_THREADED
+};
+
+static int VM_CallThreaded( vm_t *vm, int *args, const void * const **handlers );
+#endif
+
 //#define	DEBUG_VM
 #ifdef DEBUG_VM
 static char	*opnames[256] = {
@@ -162,6 +183,77 @@ void VM_StackTrace( vm_t *vm, int programCounter, int programStack ) {
 }
 
 
+#ifdef VM_THREADED
+/*
+====================
+VM_PrepareThreaded
+
+Translates the expanded code into direct threaded code.  Every opcode
+becomes the address of its handler in VM_CallThreaded, so each handler
+jumps straight to the next one instead of going back through a switch.
+Operands stay where they are, so instruction offsets, jump targets and
+saved program counters are the same as in codeBase.
+====================
+*/
+static void VM_PrepareThreaded( vm_t *vm, int codeWords ) {
+	const void * const	*handlers;
+	int			*codeBase;
+	intptr_t	*code;
+	int			instruction;
+	int			start, end;
+	int			op, n;
+	int			fused;
+
+	VM_CallThreaded( NULL, NULL, &handlers );
+
+	codeBase = (int *)vm->codeBase;
+	code = Hunk_Alloc( ( codeWords + 1 ) * sizeof( *code ), h_high );
+	fused = 0;
+
+	for ( instruction = 0; instruction < vm->instructionCount; instruction++ ) {
+		start = vm->instructionPointers[ instruction ];
+		end = instruction + 1 < vm->instructionCount ? vm->instructionPointers[ instruction + 1 ] : codeWords;
+
+		for ( n = start + 1; n < end; n++ ) {
+			code[n] = codeBase[n];
+		}
+
+		// unknown opcodes do nothing, like in the switch loop
+		op = codeBase[start];
+		if ( op < 0 || op > OP_CVFI ) {
+			op = OP_UNDEF;
+		}
+
+		if ( end < codeWords ) {
+			if ( op == OP_LOCAL && codeBase[end] == OP_LOAD4 ) {
+				op = OP_LOCAL_LOAD4;
+			} else if ( op == OP_CONST && codeBase[end] == OP_CALL ) {
+				n = codeBase[start + 1];
+				if ( n < 0 ) {
+					op = OP_CONST_SYSCALL;
+				} else if ( n < vm->instructionCount ) {
+					// a bad call is left for OP_CALL to catch when it runs
+					op = OP_CONST_CALL;
+					code[start + 1] = vm->instructionPointers[ n ];
+				}
+			}
+		}
+		if ( op > OP_CVFI ) {
+			fused++;
+		}
+
+		code[start] = (intptr_t)handlers[op];
+	}
+
+	// catches falling off the end of the code
+	code[codeWords] = (intptr_t)handlers[OP_END];
+
+	vm->threadedCode = code;
+
+	Com_DPrintf( "%s: threaded code with %i superinstructions\n", vm->name, fused );
+}
+#endif
+
 /*
 ====================
 VM_PrepareInterpreter
@@ -274,9 +366,14 @@ void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 
 		// These opcodes have an operand that isn't an instruction index
 		case OP_ENTER:
+		case OP_LEAVE:
+			if ( !VM_VALID_FRAME( codeBase[int_pc] ) )
+				Com_Error( ERR_DROP, "VM_PrepareInterpreter: frame of %d bytes at instruction %d",
+					codeBase[int_pc], instruction - 1 );
+			int_pc++;
+			break;
 		case OP_CONST:
 		case OP_LOCAL:
-		case OP_LEAVE:
 		case OP_BLOCK_COPY:
 		case OP_ARG:
 			int_pc++;
@@ -287,6 +384,12 @@ void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 		}
 
 	}
+
+#ifdef VM_THREADED
+	if ( Cvar_VariableIntegerValue( "vm_threaded" ) ) {
+		VM_PrepareThreaded( vm, int_pc );
+	}
+#endif
 }
 
 /*
@@ -331,6 +434,12 @@ int	VM_CallInterpreted( vm_t *vm, int *args ) {
 	vmSymbol_t	*profileSymbol;
 #endif
 
+#ifdef VM_THREADED
+	if ( vm->threadedCode ) {
+		return VM_CallThreaded( vm, args, NULL );
+	}
+#endif
+
 	// interpret the code
 	vm->currentlyInterpreting = qtrue;
 
@@ -358,6 +467,10 @@ int	VM_CallInterpreted( vm_t *vm, int *args ) {
 	*(int *)&image[ programStack + 4 ] = 0;	// return stack
 	*(int *)&image[ programStack ] = -1;	// will terminate the loop on return
 
+	// nothing for the sampling profiler until the first OP_ENTER
+	vm->samplePC = -1;
+	vm->sampleTrap = 0;
+
 	VM_Debug(0);
 
 	// leave a free spot at start of stack so
@@ -496,6 +609,7 @@ nextInstruction2:
 				stomped = *(int *)&image[ programStack + 4 ];
 #endif
 				*(int *)&image[ programStack + 4 ] = -1 - programCounter;
+				vm->sampleTrap = -programCounter;
 
 //VM_LogSyscalls( (int *)&image[ programStack + 4 ] );
 				{
@@ -526,6 +640,11 @@ nextInstruction2:
 				opStack[opStackOfs] = r;
 				programCounter = *(int *)&image[ programStack ];
 //				vm->callLevel = temp;
+
+				// a call back into this VM from the trap changed these
+				vm->samplePC = programCounter;
+				vm->sampleStack = programStack;
+				vm->sampleTrap = 0;
 #ifdef DEBUG_VM
 				if ( vm_debugLevel ) {
 					Com_Printf( "%s<--- %s\n", DEBUGSTR, VM_ValueToSymbol( vm, programCounter ) );
@@ -556,6 +675,8 @@ nextInstruction2:
 
 			programCounter += 1;
 			programStack -= v1;
+			vm->samplePC = programCounter;
+			vm->sampleStack = programStack;
 #ifdef DEBUG_VM
 			// save old stack frame for debugging traces
 			*(int *)&image[programStack+4] = programStack + v1;
@@ -579,6 +700,8 @@ nextInstruction2:
 
 			// grab the saved program counter
 			programCounter = *(int *)&image[ programStack ];
+			vm->samplePC = programCounter;
+			vm->sampleStack = programStack;
 #ifdef DEBUG_VM
 			profileSymbol = VM_ValueToFunctionSymbol( vm, programCounter );
 			if ( vm_debugLevel ) {
@@ -899,3 +1022,453 @@ done:
 	// return the result
 	return opStack[opStackOfs];
 }
+
+#ifdef VM_THREADED
+/*
+==============
+VM_CallThreaded
+
+The same machine as VM_CallInterpreted, running the threaded code from
+VM_PrepareThreaded.  programCounter is an offset into the threaded code;
+after a handler is dispatched it points at the operand.  Called with a
+NULL vm, it hands back its handler table instead.
+==============
+*/
+
+// reload the cached top of the op stack, then run the next instruction
+#define	DISPATCH() \
+	do { \
+		r0 = opStack[opStackOfs]; \
+		r1 = opStack[(uint8_t) (opStackOfs - 1)]; \
+		goto *(void *)code[programCounter++]; \
+	} while ( 0 )
+
+// r0 and r1 are already up to date
+#define	DISPATCH2()	goto *(void *)code[programCounter++]
+
+#define	OPERAND		code[programCounter]
+#define	FLOAT(ofs)	((float *) opStack)[(uint8_t) (opStackOfs + (ofs))]
+
+// pops both operands, the condition reads them as r1, r0 or FLOAT(1), FLOAT(2)
+#define	BRANCH(cond) \
+	do { \
+		opStackOfs -= 2; \
+		if ( cond ) { \
+			programCounter = OPERAND; \
+		} else { \
+			programCounter += 1; \
+		} \
+		DISPATCH(); \
+	} while ( 0 )
+
+static int VM_CallThreaded( vm_t *vm, int *args, const void * const **handlers ) {
+	static const void * const	table[OP_MAX_THREADED] = {
+		[OP_UNDEF] = &&op_undef,
+		[OP_IGNORE] = &&op_undef,
+		[OP_BREAK] = &&op_break,
+		[OP_ENTER] = &&op_enter,
+		[OP_LEAVE] = &&op_leave,
+		[OP_CALL] = &&op_call,
+		[OP_PUSH] = &&op_push,
+		[OP_POP] = &&op_pop,
+		[OP_CONST] = &&op_const,
+		[OP_LOCAL] = &&op_local,
+		[OP_JUMP] = &&op_jump,
+		[OP_EQ] = &&op_eq,
+		[OP_NE] = &&op_ne,
+		[OP_LTI] = &&op_lti,
+		[OP_LEI] = &&op_lei,
+		[OP_GTI] = &&op_gti,
+		[OP_GEI] = &&op_gei,
+		[OP_LTU] = &&op_ltu,
+		[OP_LEU] = &&op_leu,
+		[OP_GTU] = &&op_gtu,
+		[OP_GEU] = &&op_geu,
+		[OP_EQF] = &&op_eqf,
+		[OP_NEF] = &&op_nef,
+		[OP_LTF] = &&op_ltf,
+		[OP_LEF] = &&op_lef,
+		[OP_GTF] = &&op_gtf,
+		[OP_GEF] = &&op_gef,
+		[OP_LOAD1] = &&op_load1,
+		[OP_LOAD2] = &&op_load2,
+		[OP_LOAD4] = &&op_load4,
+		[OP_STORE1] = &&op_store1,
+		[OP_STORE2] = &&op_store2,
+		[OP_STORE4] = &&op_store4,
+		[OP_ARG] = &&op_arg,
+		[OP_BLOCK_COPY] = &&op_block_copy,
+		[OP_SEX8] = &&op_sex8,
+		[OP_SEX16] = &&op_sex16,
+		[OP_NEGI] = &&op_negi,
+		[OP_ADD] = &&op_add,
+		[OP_SUB] = &&op_sub,
+		[OP_DIVI] = &&op_divi,
+		[OP_DIVU] = &&op_divu,
+		[OP_MODI] = &&op_modi,
+		[OP_MODU] = &&op_modu,
+		[OP_MULI] = &&op_muli,
+		[OP_MULU] = &&op_mulu,
+		[OP_BAND] = &&op_band,
+		[OP_BOR] = &&op_bor,
+		[OP_BXOR] = &&op_bxor,
+		[OP_BCOM] = &&op_bcom,
+		[OP_LSH] = &&op_lsh,
+		[OP_RSHI] = &&op_rshi,
+		[OP_RSHU] = &&op_rshu,
+		[OP_NEGF] = &&op_negf,
+		[OP_ADDF] = &&op_addf,
+		[OP_SUBF] = &&op_subf,
+		[OP_DIVF] = &&op_divf,
+		[OP_MULF] = &&op_mulf,
+		[OP_CVIF] = &&op_cvif,
+		[OP_CVFI] = &&op_cvfi,
+
+		[OP_LOCAL_LOAD4] = &&op_local_load4,
+		[OP_CONST_CALL] = &&op_const_call,
+		[OP_CONST_SYSCALL] = &&op_const_syscall,
+		[OP_END] = &&op_end
+	};
+	byte		stack[OPSTACK_SIZE + 15];
+	register int		*opStack;
+	register uint8_t 	opStackOfs;
+	int		programCounter;
+	int		programStack;
+	int		stackOnEntry;
+	byte	*image;
+	const intptr_t	*code;
+	int		dataMask;
+	int		arg;
+	int		r0, r1;
+
+	if ( !vm ) {
+		*handlers = table;
+		return 0;
+	}
+
+	vm->currentlyInterpreting = qtrue;
+
+	// we might be called recursively, so this might not be the very top
+	programStack = stackOnEntry = vm->programStack;
+
+	image = vm->dataBase;
+	code = vm->threadedCode;
+	dataMask = vm->dataMask;
+
+	programCounter = 0;
+
+	programStack -= ( 8 + 4 * MAX_VMMAIN_ARGS );
+
+	for ( arg = 0; arg < MAX_VMMAIN_ARGS; arg++ )
+		*(int *)&image[ programStack + 8 + arg * 4 ] = args[ arg ];
+
+	*(int *)&image[ programStack + 4 ] = 0;	// return stack
+	*(int *)&image[ programStack ] = -1;	// will terminate the loop on return
+
+	// nothing for the sampling profiler until the first OP_ENTER
+	vm->samplePC = -1;
+	vm->sampleTrap = 0;
+
+	// leave a free spot at start of stack so
+	// that as long as opStack is valid, opStack-1 will
+	// not corrupt anything
+	opStack = PADP(stack, 16);
+	*opStack = 0xDEADBEEF;
+	opStackOfs = 0;
+
+	DISPATCH();
+
+op_undef:
+	DISPATCH();
+op_end:
+	Com_Error( ERR_DROP, "VM program counter out of range" );
+	return 0;
+
+op_break:
+	vm->breakCount++;
+	DISPATCH2();
+op_const:
+	opStackOfs++;
+	r1 = r0;
+	r0 = opStack[opStackOfs] = OPERAND;
+	programCounter += 1;
+	DISPATCH2();
+op_local:
+	opStackOfs++;
+	r1 = r0;
+	r0 = opStack[opStackOfs] = OPERAND + programStack;
+	programCounter += 1;
+	DISPATCH2();
+op_local_load4:
+	opStackOfs++;
+	r1 = r0;
+	r0 = opStack[opStackOfs] = *(int *) &image[ (OPERAND + programStack) & dataMask & ~3 ];
+	programCounter += 2;	// over the LOAD4 too
+	DISPATCH2();
+
+op_load4:
+	r0 = opStack[opStackOfs] = *(int *) &image[ r0 & dataMask & ~3 ];
+	DISPATCH2();
+op_load2:
+	r0 = opStack[opStackOfs] = *(unsigned short *)&image[ r0 & dataMask & ~1 ];
+	DISPATCH2();
+op_load1:
+	r0 = opStack[opStackOfs] = image[ r0 & dataMask ];
+	DISPATCH2();
+
+op_store4:
+	*(int *)&image[ r1 & ( dataMask & ~3 ) ] = r0;
+	opStackOfs -= 2;
+	DISPATCH();
+op_store2:
+	*(short *)&image[ r1 & ( dataMask & ~1 ) ] = r0;
+	opStackOfs -= 2;
+	DISPATCH();
+op_store1:
+	image[ r1 & dataMask ] = r0;
+	opStackOfs -= 2;
+	DISPATCH();
+
+op_arg:
+	// single byte offset from programStack
+	*(int *)&image[ ( OPERAND + programStack ) & dataMask & ~3 ] = r0;
+	opStackOfs--;
+	programCounter += 1;
+	DISPATCH();
+
+op_block_copy:
+	VM_BlockCopy( r1, r0, OPERAND );
+	programCounter += 1;
+	opStackOfs -= 2;
+	DISPATCH();
+
+op_call:
+	// save current program counter
+	*(int *)&image[ programStack ] = programCounter;
+
+	// jump to the location on the stack
+	programCounter = r0;
+	opStackOfs--;
+	if ( programCounter < 0 ) {
+		goto systemCall;
+	} else if ( (unsigned)programCounter >= vm->instructionCount ) {
+		Com_Error( ERR_DROP, "VM program counter out of range in OP_CALL" );
+		return 0;
+	}
+	programCounter = vm->instructionPointers[ programCounter ];
+	DISPATCH();
+op_const_call:
+	// return past the CALL, the operand is already a code offset
+	*(int *)&image[ programStack ] = programCounter + 2;
+	programCounter = OPERAND;
+	DISPATCH();
+op_const_syscall:
+	*(int *)&image[ programStack ] = programCounter + 2;
+	programCounter = OPERAND;
+	// fall through
+
+systemCall:
+	{
+		int		r;
+
+		// save the stack to allow recursive VM entry
+		vm->programStack = programStack - 4;
+		*(int *)&image[ programStack + 4 ] = -1 - programCounter;
+		vm->sampleTrap = -programCounter;
+
+		// the vm has ints on the stack, we expect
+		// pointers so we might have to convert it
+		if (sizeof(intptr_t) != sizeof(int)) {
+			intptr_t argarr[ MAX_VMSYSCALL_ARGS ];
+			int *imagePtr = (int *)&image[ programStack ];
+			int i;
+			for (i = 0; i < ARRAY_LEN(argarr); ++i) {
+				argarr[i] = *(++imagePtr);
+			}
+			r = vm->systemCall( argarr );
+		} else {
+			intptr_t* argptr = (intptr_t *)&image[ programStack + 4 ];
+			r = vm->systemCall( argptr );
+		}
+
+		// save return value
+		opStackOfs++;
+		opStack[opStackOfs] = r;
+		programCounter = *(int *)&image[ programStack ];
+
+		// a call back into this VM from the trap changed these
+		vm->samplePC = programCounter;
+		vm->sampleStack = programStack;
+		vm->sampleTrap = 0;
+	}
+	DISPATCH();
+
+// push and pop are only needed for discarded or bad function return values
+op_push:
+	opStackOfs++;
+	DISPATCH();
+op_pop:
+	opStackOfs--;
+	DISPATCH();
+
+op_enter:
+	// get size of stack frame
+	programStack -= OPERAND;
+	programCounter += 1;
+	vm->samplePC = programCounter;
+	vm->sampleStack = programStack;
+	DISPATCH();
+op_leave:
+	// remove our stack frame
+	programStack += OPERAND;
+
+	// grab the saved program counter
+	programCounter = *(int *)&image[ programStack ];
+	vm->samplePC = programCounter;
+	vm->sampleStack = programStack;
+
+	// check for leaving the VM
+	if ( programCounter == -1 ) {
+		goto done;
+	} else if ( (unsigned)programCounter >= vm->codeLength ) {
+		Com_Error( ERR_DROP, "VM program counter out of range in OP_LEAVE" );
+		return 0;
+	}
+	DISPATCH();
+
+op_jump:
+	if ( (unsigned)r0 >= vm->instructionCount ) {
+		Com_Error( ERR_DROP, "VM program counter out of range in OP_JUMP" );
+		return 0;
+	}
+	programCounter = vm->instructionPointers[ r0 ];
+	opStackOfs--;
+	DISPATCH();
+
+op_eq:	BRANCH( r1 == r0 );
+op_ne:	BRANCH( r1 != r0 );
+op_lti:	BRANCH( r1 < r0 );
+op_lei:	BRANCH( r1 <= r0 );
+op_gti:	BRANCH( r1 > r0 );
+op_gei:	BRANCH( r1 >= r0 );
+op_ltu:	BRANCH( (unsigned) r1 < (unsigned) r0 );
+op_leu:	BRANCH( (unsigned) r1 <= (unsigned) r0 );
+op_gtu:	BRANCH( (unsigned) r1 > (unsigned) r0 );
+op_geu:	BRANCH( (unsigned) r1 >= (unsigned) r0 );
+op_eqf:	BRANCH( FLOAT(1) == FLOAT(2) );
+op_nef:	BRANCH( FLOAT(1) != FLOAT(2) );
+op_ltf:	BRANCH( FLOAT(1) < FLOAT(2) );
+op_lef:	BRANCH( FLOAT(1) <= FLOAT(2) );
+op_gtf:	BRANCH( FLOAT(1) > FLOAT(2) );
+op_gef:	BRANCH( FLOAT(1) >= FLOAT(2) );
+
+op_negi:
+	opStack[opStackOfs] = -r0;
+	DISPATCH();
+op_add:
+	opStackOfs--;
+	opStack[opStackOfs] = r1 + r0;
+	DISPATCH();
+op_sub:
+	opStackOfs--;
+	opStack[opStackOfs] = r1 - r0;
+	DISPATCH();
+op_divi:
+	opStackOfs--;
+	opStack[opStackOfs] = r1 / r0;
+	DISPATCH();
+op_divu:
+	opStackOfs--;
+	opStack[opStackOfs] = ((unsigned) r1) / ((unsigned) r0);
+	DISPATCH();
+op_modi:
+	opStackOfs--;
+	opStack[opStackOfs] = r1 % r0;
+	DISPATCH();
+op_modu:
+	opStackOfs--;
+	opStack[opStackOfs] = ((unsigned) r1) % ((unsigned) r0);
+	DISPATCH();
+op_muli:
+	opStackOfs--;
+	opStack[opStackOfs] = r1 * r0;
+	DISPATCH();
+op_mulu:
+	opStackOfs--;
+	opStack[opStackOfs] = ((unsigned) r1) * ((unsigned) r0);
+	DISPATCH();
+
+op_band:
+	opStackOfs--;
+	opStack[opStackOfs] = ((unsigned) r1) & ((unsigned) r0);
+	DISPATCH();
+op_bor:
+	opStackOfs--;
+	opStack[opStackOfs] = ((unsigned) r1) | ((unsigned) r0);
+	DISPATCH();
+op_bxor:
+	opStackOfs--;
+	opStack[opStackOfs] = ((unsigned) r1) ^ ((unsigned) r0);
+	DISPATCH();
+op_bcom:
+	opStack[opStackOfs] = ~((unsigned) r0);
+	DISPATCH();
+
+op_lsh:
+	opStackOfs--;
+	opStack[opStackOfs] = r1 << r0;
+	DISPATCH();
+op_rshi:
+	opStackOfs--;
+	opStack[opStackOfs] = r1 >> r0;
+	DISPATCH();
+op_rshu:
+	opStackOfs--;
+	opStack[opStackOfs] = ((unsigned) r1) >> r0;
+	DISPATCH();
+
+op_negf:
+	FLOAT(0) = -FLOAT(0);
+	DISPATCH();
+op_addf:
+	opStackOfs--;
+	FLOAT(0) = FLOAT(0) + FLOAT(1);
+	DISPATCH();
+op_subf:
+	opStackOfs--;
+	FLOAT(0) = FLOAT(0) - FLOAT(1);
+	DISPATCH();
+op_divf:
+	opStackOfs--;
+	FLOAT(0) = FLOAT(0) / FLOAT(1);
+	DISPATCH();
+op_mulf:
+	opStackOfs--;
+	FLOAT(0) = FLOAT(0) * FLOAT(1);
+	DISPATCH();
+
+op_cvif:
+	FLOAT(0) = (float) opStack[opStackOfs];
+	DISPATCH();
+op_cvfi:
+	opStack[opStackOfs] = Q_ftol( FLOAT(0) );
+	DISPATCH();
+op_sex8:
+	opStack[opStackOfs] = (signed char) opStack[opStackOfs];
+	DISPATCH();
+op_sex16:
+	opStack[opStackOfs] = (short) opStack[opStackOfs];
+	DISPATCH();
+
+done:
+	vm->currentlyInterpreting = qfalse;
+
+	if (opStackOfs != 1 || *opStack != 0xDEADBEEF)
+		Com_Error(ERR_DROP, "Interpreter error: opStack[0] = %X, opStackOfs = %d", opStack[0], opStackOfs);
+
+	vm->programStack = stackOnEntry;
+
+	// return the result
+	return opStack[opStackOfs];
+}
+#endif
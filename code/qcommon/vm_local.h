@@ -40,6 +40,13 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define	PROGRAM_STACK_SIZE	0x10000
 #define	PROGRAM_STACK_MASK	(PROGRAM_STACK_SIZE-1)
 
+// compiled code reads and writes locals without masking the address, so
+// the data segment is followed by this much room, see LocalOptimize
+#define	VM_DATA_GUARD		0x10000
+
+// what OP_ENTER and OP_LEAVE can move programStack by, checked as the code is loaded
+#define	VM_VALID_FRAME(frame)	((frame) >= 0 && (frame) < PROGRAM_STACK_SIZE)
+
 typedef enum {
 	OP_UNDEF, 
 
@@ -159,6 +166,7 @@ struct vm_s {
 
 	// for interpreted modules
 	qboolean	currentlyInterpreting;
+	intptr_t	*threadedCode;		// codeBase with handler addresses, see vm_interpreted.c
 
 	qboolean	compiled;
 	byte		*codeBase;
@@ -182,9 +190,28 @@ struct vm_s {
 
 	byte		*jumpTableTargets;
 	int			numJumpTableTargets;
+
+	// traps compiled code calls without going through systemCall, see VM_RegisterSyscalls
+	const vmSyscall_t	*syscalls;
+	int			numSyscalls;
+	qboolean	(*syscallsLogged)( int trap );
+	byte		*syscallDirect;		// by trap number, set for the ones that aren't logged
+	int			syscallsGeneration;	// of sql_syscall_generation when syscallDirect was set
+
+	// for the sampling profiler, see vm_sample.c
+	int			*sampleFuncs;		// instruction number of every OP_ENTER
+	int			*sampleFrames;		// and the size of the stack frame it makes
+	int			numSampleFuncs;
+	int			samplePC;			// interpreted: a program counter in the running function
+	int			sampleStack;		// interpreted: its programStack
+	int			sampleTrap;			// trap number + 1 while in a trap, otherwise 0
+	void		*sampleNative;		// compiled: native stack of the VM while in a trap
+	qboolean	sampleNativeStack;	// compiled code only keeps VM return addresses on the native stack
 };
 
 
+#define	MAX_VM		3
+
 extern	vm_t	*currentVM;
 extern	int		vm_debugLevel;
 
@@ -200,3 +227,7 @@ const char *VM_ValueToSymbol( vm_t *vm, int value );
 void VM_LogSyscalls( int *args );
 
 void VM_BlockCopy(unsigned int dest, unsigned int src, size_t n);
+
+void VM_SampleFunctions( vm_t *vm, vmHeader_t *header );
+void VM_SampleFree( vm_t *vm );
+void VM_Sample_f( void );
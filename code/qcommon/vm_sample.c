@@ -0,0 +1,558 @@
+/*
+vm_sample.c -- sampling profiler for QVM code
+
+	vmsample start [rate]
+	vmsample stop [file]
+
+A CPU time timer (Sys_StartSampling) stops the engine rate times a second
+and the call stack of the running VM is put down as a list of functions.
+The functions come from the OP_ENTERs in the bytecode, so no .map file is
+needed; with one (developer 1) they get their names from it.
+
+The interpreter keeps samplePC and sampleStack up to date at every call
+and return.  Every interpreted call saves its return address at the
+bottom of the caller's frame, so the stack is walked with the frame
+sizes from OP_ENTER.  Compiled code is found from the program counter the
+timer stopped, through instructionPointers.  VM calls in compiled code
+are native calls and nothing else goes on the native stack, so the words
+on it up to the first one outside the code are the return addresses.  In
+a trap DoSyscall leaves where those start in sampleNative.
+
+Stopping prints the functions with the most samples and writes every
+stack, root first, in the collapsed format flame graph tools read:
+
+	qagame;vmMain;G_RunFrame;G_RunThink;[G_TRACE] 42
+
+A trap the stack was in is the last frame.  Sampling stops on its own when
+a VM is unloaded, since its functions go with it.
+*/
+
+#include "vm_local.h"
+
+#define	VM_SAMPLE_RATE		100			// default samples a second
+#define	VM_SAMPLE_DEPTH		32			// frames kept, from the leaf up
+#define	VM_SAMPLE_SLOTS		8192		// different stacks, a power of two
+#define	VM_SAMPLE_PROBES	64
+#define	VM_SAMPLE_FLAT		25			// functions printed
+#define	VM_SAMPLE_FILE		"vmsample.txt"
+
+typedef struct {
+	vm_t		*vm;					// NULL for a free slot
+	unsigned	hash;
+	int			count;
+	int			trap;					// trap number + 1, or 0
+	int			depth;
+	int			funcs[VM_SAMPLE_DEPTH];	// indexes into vm->sampleFuncs, leaf first
+} vmStack_t;
+
+static vmStack_t	*vm_stacks;
+static qboolean		vm_sampling;
+static int			vm_samples;
+static int			vm_samplesOutside;		// not in QVM code
+static int			vm_samplesDropped;		// the stack table was full
+
+/*
+===============
+VM_SampleFunctions
+
+Finds the functions of the bytecode for the sampling profiler, from where
+each OP_ENTER is and the size of the frame it makes
+===============
+*/
+void VM_SampleFunctions( vm_t *vm, vmHeader_t *header ) {
+	byte	*code;
+	int		pass, pc, instruction, op;
+	int		count;
+
+	code = (byte *)header + header->codeOffset;
+	count = 0;
+
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		count = 0;
+		pc = 0;
+		for ( instruction = 0 ; instruction < header->instructionCount && pc < header->codeLength ; instruction++ ) {
+			op = code[ pc++ ];
+
+			switch ( op ) {
+			case OP_ENTER:
+				if ( pc + 4 > header->codeLength ) {
+					break;
+				}
+				if ( pass ) {
+					vm->sampleFuncs[ count ] = instruction;
+					vm->sampleFrames[ count ] = code[pc] | ( code[pc+1] << 8 ) | ( code[pc+2] << 16 ) | ( code[pc+3] << 24 );
+				}
+				count++;
+				pc += 4;
+				break;
+			case OP_CONST:
+			case OP_LOCAL:
+			case OP_LEAVE:
+			case OP_EQ:
+			case OP_NE:
+			case OP_LTI:
+			case OP_LEI:
+			case OP_GTI:
+			case OP_GEI:
+			case OP_LTU:
+			case OP_LEU:
+			case OP_GTU:
+			case OP_GEU:
+			case OP_EQF:
+			case OP_NEF:
+			case OP_LTF:
+			case OP_LEF:
+			case OP_GTF:
+			case OP_GEF:
+			case OP_BLOCK_COPY:
+				pc += 4;
+				break;
+			case OP_ARG:
+				pc += 1;
+				break;
+			default:
+				break;
+			}
+		}
+
+		if ( !count ) {
+			break;
+		}
+		if ( !pass ) {
+			vm->sampleFuncs = Hunk_Alloc( count * sizeof( *vm->sampleFuncs ), h_high );
+			vm->sampleFrames = Hunk_Alloc( count * sizeof( *vm->sampleFrames ), h_high );
+		}
+	}
+
+	vm->numSampleFuncs = count;
+}
+
+/*
+===============
+VM_SampleFunction
+
+The function a code offset (interpreted) or address (compiled) is in, -1
+if it's before the first one
+===============
+*/
+static int VM_SampleFunction( const vm_t *vm, intptr_t value ) {
+	int		low, high, mid;
+
+	low = 0;
+	high = vm->numSampleFuncs - 1;
+	if ( high < 0 || value < vm->instructionPointers[ vm->sampleFuncs[0] ] ) {
+		return -1;
+	}
+
+	while ( low < high ) {
+		mid = ( low + high + 1 ) / 2;
+		if ( vm->instructionPointers[ vm->sampleFuncs[mid] ] <= value ) {
+			low = mid;
+		} else {
+			high = mid - 1;
+		}
+	}
+	return low;
+}
+
+/*
+===============
+VM_SampleInterpreted
+===============
+*/
+static int VM_SampleInterpreted( vm_t *vm, int *funcs, int *trap ) {
+	int		pc, stack;
+	int		depth, func;
+
+	pc = vm->samplePC;
+	stack = vm->sampleStack;
+	*trap = vm->sampleTrap;
+
+	// the VM_Call this started from has -1 for its return address
+	for ( depth = 0 ; depth < VM_SAMPLE_DEPTH && pc >= 0 ; depth++ ) {
+		if ( ( func = VM_SampleFunction( vm, pc ) ) < 0 ) {
+			break;
+		}
+		funcs[depth] = func;
+
+		stack += vm->sampleFrames[func];
+		if ( stack < 0 || stack > vm->dataMask - 3 ) {
+			depth++;
+			break;
+		}
+		pc = *(int *)&vm->dataBase[ stack ];
+	}
+	return depth;
+}
+
+/*
+===============
+VM_SampleCompiled
+===============
+*/
+static int VM_SampleCompiled( vm_t *vm, byte *pc, byte **sp, int *funcs, int *trap ) {
+	byte	*start, *end;
+	byte	*ret;
+	int		depth;
+
+	// the stubs EmitCallDoSyscall and EmitCallProcedure make come before the first instruction
+	start = (byte *)vm->instructionPointers[0];
+	end = vm->codeBase + vm->codeLength;
+	depth = 0;
+	*trap = 0;
+
+	if ( !vm->sampleNativeStack ) {
+		return 0;
+	}
+
+	if ( pc >= vm->codeBase && pc < end ) {
+		if ( pc >= start ) {
+			funcs[depth++] = VM_SampleFunction( vm, (intptr_t)pc );
+		}
+	} else if ( vm->sampleNative ) {
+		sp = vm->sampleNative;
+		*trap = vm->sampleTrap;
+	} else if ( !sp || *sp < vm->codeBase || *sp >= end ) {
+		// a helper the code calls directly, like Q_VMftol, has the return address on top
+		return 0;
+	}
+
+	// up to the return address into VM_CallCompiled
+	for ( ; depth < VM_SAMPLE_DEPTH ; sp++ ) {
+		ret = *sp;
+		if ( ret < vm->codeBase || ret >= end ) {
+			break;
+		}
+		// a return address is just past the call
+		if ( ret > start ) {
+			funcs[depth++] = VM_SampleFunction( vm, (intptr_t)ret - 1 );
+		}
+	}
+	return depth;
+}
+
+/*
+===============
+VM_Sample
+
+Called from the timer signal, so it only reads the VM and writes the table
+===============
+*/
+static void VM_Sample( void *pc, void *sp ) {
+	vm_t		*vm;
+	vmStack_t	*stack;
+	int			funcs[VM_SAMPLE_DEPTH];
+	int			depth, trap;
+	unsigned	hash;
+	int			i;
+
+	vm_samples++;
+
+	vm = currentVM;
+	if ( !vm || vm->callLevel <= 0 || !vm->numSampleFuncs ) {
+		vm_samplesOutside++;
+		return;
+	}
+
+	if ( vm->compiled ) {
+		depth = VM_SampleCompiled( vm, pc, sp, funcs, &trap );
+	} else {
+		depth = VM_SampleInterpreted( vm, funcs, &trap );
+	}
+	if ( !depth ) {
+		vm_samplesOutside++;
+		return;
+	}
+
+	hash = 2166136261u ^ trap;
+	for ( i = 0 ; i < depth ; i++ ) {
+		hash = ( hash ^ funcs[i] ) * 16777619u;
+	}
+	hash ^= (unsigned)( (intptr_t)vm >> 4 );
+
+	for ( i = 0 ; i < VM_SAMPLE_PROBES ; i++ ) {
+		stack = &vm_stacks[ ( hash + i ) & ( VM_SAMPLE_SLOTS - 1 ) ];
+
+		if ( !stack->vm ) {
+			stack->hash = hash;
+			stack->trap = trap;
+			stack->depth = depth;
+			memcpy( stack->funcs, funcs, depth * sizeof( funcs[0] ) );
+			stack->count = 1;
+			stack->vm = vm;
+			return;
+		}
+		if ( stack->vm == vm && stack->hash == hash && stack->trap == trap && stack->depth == depth &&
+			!memcmp( stack->funcs, funcs, depth * sizeof( funcs[0] ) ) ) {
+			stack->count++;
+			return;
+		}
+	}
+	vm_samplesDropped++;
+}
+
+/*
+===============
+VM_SampleName
+
+The name of a function from the .map file, or where it is
+===============
+*/
+static void VM_SampleName( vm_t *vm, int func, char *name, int size ) {
+	vmSymbol_t	*sym;
+	int			value;
+
+	// VM_LoadSymbols put them through instructionPointers as well
+	value = vm->instructionPointers[ vm->sampleFuncs[func] ];
+	for ( sym = vm->symbols ; sym ; sym = sym->next ) {
+		if ( sym->symValue == value ) {
+			Q_strncpyz( name, sym->symName, size );
+			return;
+		}
+	}
+	Com_sprintf( name, size, "func_%i", vm->sampleFuncs[func] );
+}
+
+/*
+===============
+VM_SampleTrapName
+===============
+*/
+static void VM_SampleTrapName( vm_t *vm, int trap, char *name, int size ) {
+#ifdef USE_SQLITE3
+	const char	*msg;
+	int			ns;
+
+	if ( ( ns = sql_syscall_module( vm->name ) ) >= 0 &&
+		( msg = sql_msg_name( SQL_MSG( ns, trap - 1 ) ) ) != NULL ) {
+		Com_sprintf( name, size, "[%s]", msg );
+		return;
+	}
+#endif
+	Com_sprintf( name, size, "[trap %i]", trap - 1 );
+}
+
+typedef struct {
+	int		func;		// -1 for a trap
+	int		trap;
+	int		self;
+	int		total;
+} vmSampleRow_t;
+
+static int QDECL VM_SampleSort( const void *a, const void *b ) {
+	return ( (vmSampleRow_t *)b )->self - ( (vmSampleRow_t *)a )->self;
+}
+
+/*
+===============
+VM_SamplePrint
+
+The functions and traps of a VM with the most samples of their own, and
+the samples they were on the stack for
+===============
+*/
+static void VM_SamplePrint( vm_t *vm ) {
+	vmSampleRow_t	*rows;
+	vmStack_t		*stack;
+	char			name[MAX_QPATH];
+	int				numRows, numFuncs, total;
+	int				i, j, k;
+
+	// the functions, then a row for each trap in a sample
+	numFuncs = vm->numSampleFuncs;
+	rows = Z_Malloc( ( numFuncs + VM_SAMPLE_SLOTS ) * sizeof( *rows ) );
+	for ( i = 0 ; i < numFuncs ; i++ ) {
+		rows[i].func = i;
+	}
+	numRows = numFuncs;
+	total = 0;
+
+	for ( i = 0 ; i < VM_SAMPLE_SLOTS ; i++ ) {
+		stack = &vm_stacks[i];
+		if ( stack->vm != vm ) {
+			continue;
+		}
+		total += stack->count;
+
+		if ( stack->trap ) {
+			for ( k = numFuncs ; k < numRows && rows[k].trap != stack->trap ; k++ ) {
+			}
+			if ( k == numRows ) {
+				rows[k].func = -1;
+				rows[k].trap = stack->trap;
+				numRows++;
+			}
+			rows[k].self += stack->count;
+			rows[k].total += stack->count;
+		} else {
+			rows[ stack->funcs[0] ].self += stack->count;
+		}
+
+		// once for each function, however often it recursed
+		for ( j = 0 ; j < stack->depth ; j++ ) {
+			for ( k = 0 ; k < j && stack->funcs[k] != stack->funcs[j] ; k++ ) {
+			}
+			if ( k == j ) {
+				rows[ stack->funcs[j] ].total += stack->count;
+			}
+		}
+	}
+
+	qsort( rows, numRows, sizeof( *rows ), VM_SampleSort );
+
+	Com_Printf( "%s: %i samples\n", vm->name, total );
+	Com_Printf( "  self%%  total%%  samples\n" );
+	for ( i = 0 ; i < numRows && i < VM_SAMPLE_FLAT && rows[i].self ; i++ ) {
+		if ( rows[i].func < 0 ) {
+			VM_SampleTrapName( vm, rows[i].trap, name, sizeof( name ) );
+		} else {
+			VM_SampleName( vm, rows[i].func, name, sizeof( name ) );
+		}
+		Com_Printf( "%6.1f %6.1f %8i  %s\n", 100.0f * rows[i].self / total,
+			100.0f * rows[i].total / total, rows[i].self, name );
+	}
+
+	Z_Free( rows );
+}
+
+/*
+===============
+VM_SampleWrite
+
+Every stack, root first, as collapsed stacks
+===============
+*/
+static void VM_SampleWrite( const char *filename ) {
+	fileHandle_t	f;
+	vmStack_t		*stack;
+	char			line[VM_SAMPLE_DEPTH * MAX_QPATH];
+	char			name[MAX_QPATH];
+	int				i, j;
+
+	f = FS_FOpenFileWrite( filename );
+	if ( !f ) {
+		Com_Printf( "vmsample: couldn't write %s\n", filename );
+		return;
+	}
+
+	for ( i = 0 ; i < VM_SAMPLE_SLOTS ; i++ ) {
+		stack = &vm_stacks[i];
+		if ( !stack->vm ) {
+			continue;
+		}
+
+		Q_strncpyz( line, stack->vm->name, sizeof( line ) );
+		for ( j = stack->depth - 1 ; j >= 0 ; j-- ) {
+			VM_SampleName( stack->vm, stack->funcs[j], name, sizeof( name ) );
+			Q_strcat( line, sizeof( line ), va( ";%s", name ) );
+		}
+		if ( stack->trap ) {
+			VM_SampleTrapName( stack->vm, stack->trap, name, sizeof( name ) );
+			Q_strcat( line, sizeof( line ), va( ";%s", name ) );
+		}
+		FS_Printf( f, "%s %i\n", line, stack->count );
+	}
+
+	FS_FCloseFile( f );
+	Com_Printf( "Wrote %s\n", filename );
+}
+
+/*
+===============
+VM_SampleStart
+===============
+*/
+static void VM_SampleStart( int rate ) {
+	if ( vm_sampling ) {
+		Com_Printf( "vmsample: already running\n" );
+		return;
+	}
+	if ( rate <= 0 ) {
+		rate = VM_SAMPLE_RATE;
+	}
+	if ( rate > 1000 ) {
+		rate = 1000;
+	}
+
+	if ( !vm_stacks ) {
+		vm_stacks = Z_Malloc( VM_SAMPLE_SLOTS * sizeof( *vm_stacks ) );
+	}
+	Com_Memset( vm_stacks, 0, VM_SAMPLE_SLOTS * sizeof( *vm_stacks ) );
+	vm_samples = vm_samplesOutside = vm_samplesDropped = 0;
+
+	if ( !Sys_StartSampling( rate, VM_Sample ) ) {
+		Com_Printf( "vmsample: can't sample on this platform\n" );
+		return;
+	}
+	vm_sampling = qtrue;
+	Com_Printf( "Sampling the VMs %i times a second of CPU time\n", rate );
+}
+
+/*
+===============
+VM_SampleStop
+===============
+*/
+static void VM_SampleStop( const char *filename ) {
+	vm_t	*vms[MAX_VM];
+	int		numVMs;
+	int		i, j;
+
+	if ( !vm_sampling ) {
+		Com_Printf( "vmsample: not running\n" );
+		return;
+	}
+	Sys_StopSampling();
+	vm_sampling = qfalse;
+
+	Com_Printf( "%i samples, %i outside QVM code, %i dropped\n",
+		vm_samples, vm_samplesOutside, vm_samplesDropped );
+
+	numVMs = 0;
+	for ( i = 0 ; i < VM_SAMPLE_SLOTS ; i++ ) {
+		if ( !vm_stacks[i].vm ) {
+			continue;
+		}
+		for ( j = 0 ; j < numVMs && vms[j] != vm_stacks[i].vm ; j++ ) {
+		}
+		if ( j == numVMs && numVMs < MAX_VM ) {
+			vms[ numVMs++ ] = vm_stacks[i].vm;
+		}
+	}
+	for ( i = 0 ; i < numVMs ; i++ ) {
+		VM_SamplePrint( vms[i] );
+	}
+
+	VM_SampleWrite( filename );
+}
+
+/*
+===============
+VM_SampleFree
+
+A VM is being unloaded, stop while its functions can still be named
+===============
+*/
+void VM_SampleFree( vm_t *vm ) {
+	if ( vm_sampling && vm->numSampleFuncs ) {
+		Com_Printf( "vmsample: stopping, %s is being unloaded\n", vm->name );
+		VM_SampleStop( VM_SAMPLE_FILE );
+	}
+}
+
+/*
+===============
+VM_Sample_f
+===============
+*/
+void VM_Sample_f( void ) {
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "start" ) ) {
+		VM_SampleStart( atoi( Cmd_Argv( 2 ) ) );
+	} else if ( !Q_stricmp( Cmd_Argv( 1 ), "stop" ) ) {
+		VM_SampleStop( Cmd_Argc() > 2 ? Cmd_Argv( 2 ) : VM_SAMPLE_FILE );
+	} else {
+		Com_Printf( "usage: vmsample start [rate]\n"
+			"       vmsample stop [file]\n" );
+		Com_Printf( "vmsample is %s\n", vm_sampling ? "running" : "not running" );
+	}
+}
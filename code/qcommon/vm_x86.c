@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 // vm_x86.c -- load time compiler and execution environment for x86
 
 #include "vm_local.h"
+#include <stddef.h> // for offsetof
 
 #ifdef _WIN32
   #include <windows.h>
@@ -58,7 +59,14 @@ x86_64:
 
 */
 
-#define VMFREE_BUFFERS() do {Z_Free(buf); Z_Free(jused);} while(0)
+#define VMFREE_BUFFERS() do {Z_Free(buf); Z_Free(jused); Z_Free(relocs);} while(0)
+
+// room for the procedures VM_Compile emits ahead of the instructions
+#define PRELUDE_LENGTH		512
+// room for the most a single instruction can expand to, an inlined trap with
+// its slow path is the largest
+#define MAX_INSTRUCTION_LENGTH	256
+
 static	byte	*buf = NULL;
 static	byte	*jused = NULL;
 static	int		jusedSize = 0;
@@ -73,6 +81,28 @@ static	int	lastConst = 0;
 static	int	oc0, oc1, pop0, pop1;
 static	int jlabel;
 
+static	int	inlineSyscalls;				// vm_inlineSyscalls when the compile started
+static	int	inlineJumps[8], numInlineJumps;	// jumps to the slow path of an inlined syscall
+
+// addresses in the code that won't be the same next time the VM is loaded,
+// the compile cache stores them relative to what they point into
+typedef enum
+{
+	RELOC_DATA,			// into vm->dataBase
+	RELOC_SYSCALLDIRECT,		// into vm->syscallDirect
+	RELOC_INSTRUCTIONS,		// vm->instructionPointers
+	RELOC_ENGINE			// one of engineAddrs
+} ERelocType;
+
+typedef struct
+{
+	int	ofs;			// of a pointer sized address in the code
+	int	type;
+} vmReloc_t;
+
+static	vmReloc_t	*relocs;
+static	int		numRelocs, maxRelocs, numStubRelocs;
+
 typedef enum 
 {
 	LAST_COMMAND_NONE	= 0,
@@ -84,7 +114,8 @@ typedef enum
 typedef enum
 {
 	VM_JMP_VIOLATION = 0,
-	VM_BLOCK_COPY = 1
+	VM_BLOCK_COPY = 1,
+	VM_STACK_VIOLATION = 2
 } ESysCallType;
 
 static	ELastCommand	LastCommand;
@@ -114,6 +145,27 @@ static int	Constant4( void ) {
 	return v;
 }
 
+/*
+=================
+FrameSize
+The operand of OP_ENTER or OP_LEAVE, which has to fit in the program stack
+=================
+*/
+
+static int FrameSize(void)
+{
+	int v;
+
+	v = Constant4();
+	if(!VM_VALID_FRAME(v))
+	{
+		VMFREE_BUFFERS();
+		Com_Error(ERR_DROP, "VM_CompileX86: frame of %d bytes at instruction %d", v, instruction - 1);
+	}
+
+	return v;
+}
+
 static int	Constant1( void ) {
 	int		v;
 
@@ -158,6 +210,33 @@ static void EmitPtr(void *ptr)
 #endif
 }
 
+/*
+=================
+EmitReloc
+Emit an address the compile cache has to fix up, see VM_LoadCompiled
+=================
+*/
+
+static void EmitReloc(int type, void *ptr)
+{
+	vmReloc_t *old;
+
+	if(numRelocs == maxRelocs)
+	{
+		old = relocs;
+		maxRelocs *= 2;
+		relocs = Z_Malloc(maxRelocs * sizeof(*relocs));
+		Com_Memcpy(relocs, old, numRelocs * sizeof(*relocs));
+		Z_Free(old);
+	}
+
+	relocs[numRelocs].ofs = compiledOfs;
+	relocs[numRelocs].type = type;
+	numRelocs++;
+
+	EmitPtr(ptr);
+}
+
 static int Hex( int c ) {
 	if ( c >= 'a' && c <= 'f' ) {
 		return 10 + c - 'a';
@@ -401,16 +480,32 @@ int vm_programStack;
 int *vm_opStackBase;
 uint8_t vm_opStackOfs;
 intptr_t vm_arg;
+intptr_t *vm_nativeStack;
+
+// registers EmitCallDoSyscall pushes before it saves the stack pointer
+#if idx64
+  #define SYSCALL_PUSHED	5
+#else
+  #define SYSCALL_PUSHED	3
+#endif
 
 static void DoSyscall(void)
 {
 	vm_t *savedVM;
+	void *savedNative;
+	int savedTrap;
 
 	// save currentVM so as to allow for recursive VM entry
 	savedVM = currentVM;
 	// modify VM stack pointer for recursive VM entry
 	currentVM->programStack = vm_programStack - 4;
 
+	// the sampling profiler walks the VM's return addresses from here
+	savedNative = savedVM->sampleNative;
+	savedTrap = savedVM->sampleTrap;
+	savedVM->sampleNative = vm_nativeStack + SYSCALL_PUSHED;
+	savedVM->sampleTrap = vm_syscallNum < 0 ? ~vm_syscallNum + 1 : 0;
+
 	if(vm_syscallNum < 0)
 	{
 		int *data;
@@ -445,12 +540,74 @@ static void DoSyscall(void)
 			
 			VM_BlockCopy(vm_opStackBase[(vm_opStackOfs - 1)], vm_opStackBase[vm_opStackOfs], vm_arg);
 		break;
+		case VM_STACK_VIOLATION:
+			Com_Error(ERR_DROP, "VM program stack out of range");
+		break;
 		default:
 			Com_Error(ERR_DROP, "Unknown VM operation %d", vm_syscallNum);
 		break;
 		}
 	}
 
+	savedVM->sampleNative = savedNative;
+	savedVM->sampleTrap = savedTrap;
+
+	currentVM = savedVM;
+}
+
+/*
+=================
+DoDirectSyscall
+
+Calls a trap from VM_RegisterSyscalls without going through systemCall.
+Only the arguments it reads are copied.  While the trap has to be logged
+this is the same as DoSyscall.
+=================
+*/
+
+static void DoDirectSyscall(void)
+{
+	vm_t *savedVM;
+	const vmSyscall_t *syscall;
+	void *savedNative;
+	int savedTrap;
+	int *data;
+#if idx64
+	int index;
+	intptr_t args[MAX_VMSYSCALL_ARGS];
+#endif
+
+	if(!currentVM->syscallDirect[~vm_syscallNum])
+	{
+		DoSyscall();
+		return;
+	}
+
+	savedVM = currentVM;
+	syscall = &savedVM->syscalls[~vm_syscallNum];
+	savedVM->programStack = vm_programStack - 4;
+
+	savedNative = savedVM->sampleNative;
+	savedTrap = savedVM->sampleTrap;
+	savedVM->sampleNative = vm_nativeStack + SYSCALL_PUSHED;
+	savedVM->sampleTrap = ~vm_syscallNum + 1;
+
+	data = (int *) (savedVM->dataBase + vm_programStack + 4);
+
+#if idx64
+	args[0] = ~vm_syscallNum;
+	for(index = 1; index <= syscall->numArgs; index++)
+		args[index] = data[index];
+
+	vm_opStackBase[vm_opStackOfs + 1] = syscall->func(args);
+#else
+	data[0] = ~vm_syscallNum;
+	vm_opStackBase[vm_opStackOfs + 1] = syscall->func((intptr_t *) data);
+#endif
+
+	savedVM->sampleNative = savedNative;
+	savedVM->sampleTrap = savedTrap;
+
 	currentVM = savedVM;
 }
 
@@ -470,15 +627,15 @@ void EmitCallRel(vm_t *vm, int callOfs)
 /*
 =================
 EmitCallDoSyscall
-Call to DoSyscall()
+Call to DoSyscall() or DoDirectSyscall()
 =================
 */
 
-int EmitCallDoSyscall(vm_t *vm)
+int EmitCallDoSyscall(vm_t *vm, void (*doSyscall)(void))
 {
 	// use edx register to store DoSyscall address
 	EmitRexString(0x48, "BA");		// mov edx, DoSyscall
-	EmitPtr(DoSyscall);
+	EmitReloc(RELOC_ENGINE, doSyscall);
 
 	// Push important registers to stack as we can't really make
 	// any assumptions about calling conventions.
@@ -493,23 +650,27 @@ int EmitCallDoSyscall(vm_t *vm)
 	// write arguments to global vars
 	// syscall number
 	EmitString("A3");			// mov [0x12345678], eax
-	EmitPtr(&vm_syscallNum);
+	EmitReloc(RELOC_ENGINE, &vm_syscallNum);
 	// vm_programStack value
 	EmitString("89 F0");			// mov eax, esi
 	EmitString("A3");			// mov [0x12345678], eax
-	EmitPtr(&vm_programStack);
+	EmitReloc(RELOC_ENGINE, &vm_programStack);
 	// vm_opStackOfs 
 	EmitString("88 D8");			// mov al, bl
 	EmitString("A2");			// mov [0x12345678], al
-	EmitPtr(&vm_opStackOfs);
+	EmitReloc(RELOC_ENGINE, &vm_opStackOfs);
 	// vm_opStackBase
 	EmitRexString(0x48, "89 F8");		// mov eax, edi
 	EmitRexString(0x48, "A3");		// mov [0x12345678], eax
-	EmitPtr(&vm_opStackBase);
+	EmitReloc(RELOC_ENGINE, &vm_opStackBase);
 	// vm_arg
 	EmitString("89 C8");			// mov eax, ecx
 	EmitString("A3");			// mov [0x12345678], eax
-	EmitPtr(&vm_arg);
+	EmitReloc(RELOC_ENGINE, &vm_arg);
+	// vm_nativeStack
+	EmitRexString(0x48, "89 E0");		// mov eax, esp
+	EmitRexString(0x48, "A3");		// mov [0x12345678], eax
+	EmitReloc(RELOC_ENGINE, &vm_nativeStack);
 	
 	// align the stack pointer to a 16-byte-boundary
 	EmitString("55");			// push ebp
@@ -585,7 +746,7 @@ int EmitCallProcedure(vm_t *vm, int sysCallOfs)
 	EmitRexString(0x49, "FF 14 C0");	// call qword ptr [r8 + eax * 8]
 #else
 	EmitString("FF 14 85");			// call dword ptr [vm->instructionPointers + eax * 4]
-	Emit4((intptr_t) vm->instructionPointers);
+	EmitReloc(RELOC_INSTRUCTIONS, vm->instructionPointers);
 #endif
 	EmitString("8B 04 9F");			// mov eax, dword ptr [edi + ebx * 4]
 	EmitString("C3");			// ret
@@ -649,6 +810,222 @@ void EmitCallIns(vm_t *vm, int cdest)
 		compiledOfs += 4;
 }
 
+/*
+=================
+EmitLocalOp
+Instruction with the program stack as its memory operand:
+op reg, dword ptr [dataBase + esi + ofs].  There's no mask, OP_ENTER and
+OP_LEAVE keep esi inside the data, and ofs has to be less than VM_DATA_GUARD.
+=================
+*/
+
+static void EmitLocalOp(vm_t *vm, const char *op, int reg, int ofs)
+{
+#if idx64
+	EmitRexString(0x41, op);
+	if(iss8(ofs))
+	{
+		Emit1(0x44 | (reg << 3));	// [r9 + esi + disp8]
+		Emit1(0x31);
+		Emit1(ofs);
+	}
+	else
+	{
+		Emit1(0x84 | (reg << 3));	// [r9 + esi + disp32]
+		Emit1(0x31);
+		Emit4(ofs);
+	}
+#else
+	EmitString(op);
+	Emit1(0x86 | (reg << 3));		// [esi + disp32]
+	EmitReloc(RELOC_DATA, vm->dataBase + ofs);
+#endif
+}
+
+/*
+=================
+EmitArgOp
+Instruction with argument n of the syscall being made as its memory operand,
+where DoSyscall reads it
+=================
+*/
+
+static void EmitArgOp(vm_t *vm, const char *op, int reg, int n)
+{
+	EmitLocalOp(vm, op, reg, 4 + n * 4);
+}
+
+/*
+=================
+EmitLeaData
+lea reg, [dataBase + base]
+=================
+*/
+
+static void EmitLeaData(vm_t *vm, int reg, int base)
+{
+#if idx64
+	EmitRexString(0x49, "8D");
+	Emit1(0x04 | (reg << 3));		// [r9 + base]
+	Emit1(0x01 | (base << 3));
+#else
+	EmitString("8D");
+	Emit1(0x80 | (reg << 3) | base);	// [base + disp32]
+	EmitReloc(RELOC_DATA, vm->dataBase);
+#endif
+}
+
+/*
+=================
+EmitCheckRange
+Jump to the slow path unless the ecx bytes at the VM address in eax are
+all in the data segment, the check VM_BlockCopy makes.  Clobbers edx.
+=================
+*/
+
+static void EmitCheckRange(vm_t *vm)
+{
+	EmitString("A9");			// test eax, ~dataMask
+	Emit4(~vm->dataMask);
+	EmitString("75");			// jnz slow
+	inlineJumps[numInlineJumps++] = compiledOfs++;
+
+	EmitString("BA");			// mov edx, dataMask + 1
+	Emit4(vm->dataMask + 1);
+	EmitString("29 C2");			// sub edx, eax
+	EmitString("39 D1");			// cmp ecx, edx
+	EmitString("77");			// ja slow
+	inlineJumps[numInlineJumps++] = compiledOfs++;
+}
+
+/*
+=================
+EmitInlineSyscall
+Do a memory or math trap in the compiled code instead of calling it.
+The result is pushed on the opStack like a syscall's.  Memory traps with
+a range outside the data segment and sin or cos of an operand the FPU
+can't reduce jump to the slow path, which makes the call.
+=================
+*/
+
+static void EmitInlineSyscall(vm_t *vm, vmInline_t inlined)
+{
+	int loop, jmpDone;
+
+	switch(inlined)
+	{
+	case VM_INLINE_MEMSET:
+		EmitArgOp(vm, "8B", 1, 3);		// mov ecx, count
+		EmitArgOp(vm, "8B", 0, 1);		// mov eax, dest
+		EmitCheckRange(vm);
+		EmitArgOp(vm, "8B", 2, 2);		// mov edx, value
+
+		EmitString("57");			// push edi
+		EmitLeaData(vm, 7, 0);			// lea edi, [dataBase + eax]
+		EmitString("89 D0");			// mov eax, edx
+		EmitString("F3 AA");			// rep stosb
+		EmitString("5F");			// pop edi
+
+		STACK_PUSH(1);				// add bl, 1
+		EmitString("C7 04 9F");			// mov dword ptr [edi + ebx * 4], 0
+		Emit4(0);
+	break;
+	case VM_INLINE_MEMCPY:
+	case VM_INLINE_STRNCPY:
+		EmitArgOp(vm, "8B", 1, 3);		// mov ecx, count
+		EmitArgOp(vm, "8B", 0, 1);		// mov eax, dest
+		EmitCheckRange(vm);
+		EmitArgOp(vm, "8B", 0, 2);		// mov eax, src
+		EmitCheckRange(vm);
+		EmitArgOp(vm, "8B", 2, 1);		// mov edx, dest
+
+		EmitString("56");			// push esi
+		EmitString("57");			// push edi
+		EmitLeaData(vm, 6, 0);			// lea esi, [dataBase + eax]
+		EmitLeaData(vm, 7, 2);			// lea edi, [dataBase + edx]
+
+		if(inlined == VM_INLINE_MEMCPY)
+			EmitString("F3 A4");		// rep movsb
+		else
+		{
+			// copy up to the terminator, then zero the rest
+			loop = compiledOfs;
+			EmitString("85 C9");		// loop: test ecx, ecx
+			EmitString("74");		// jz done
+			jmpDone = compiledOfs++;
+			EmitString("AC");		// lodsb
+			EmitString("AA");		// stosb
+			EmitString("FF C9");		// dec ecx
+			EmitString("84 C0");		// test al, al
+			EmitString("75");		// jnz loop
+			Emit1(loop - (compiledOfs + 1));
+			EmitString("F3 AA");		// rep stosb
+			SET_JMPOFS(jmpDone);		// done:
+		}
+
+		EmitString("5F");			// pop edi
+		EmitString("5E");			// pop esi
+
+		STACK_PUSH(1);				// add bl, 1
+		if(inlined == VM_INLINE_MEMCPY)
+		{
+			EmitString("C7 04 9F");		// mov dword ptr [edi + ebx * 4], 0
+			Emit4(0);
+		}
+		else
+		{
+			EmitArgOp(vm, "8B", 0, 1);	// mov eax, dest
+			EmitString("89 04 9F");		// mov dword ptr [edi + ebx * 4], eax
+		}
+	break;
+	case VM_INLINE_SQRT:
+		EmitArgOp(vm, "D9", 0, 1);		// fld dword ptr [arg]
+		EmitString("D9 FA");			// fsqrt
+		STACK_PUSH(1);				// add bl, 1
+		EmitString("D9 1C 9F");			// fstp dword ptr [edi + ebx * 4]
+	break;
+	case VM_INLINE_SIN:
+	case VM_INLINE_COS:
+		EmitArgOp(vm, "D9", 0, 1);		// fld dword ptr [arg]
+		if(inlined == VM_INLINE_SIN)
+			EmitString("D9 FE");		// fsin
+		else
+			EmitString("D9 FF");		// fcos
+
+		// C2 is set when the operand was too large to reduce
+		EmitString("DF E0");			// fnstsw ax
+		EmitString("F6 C4 04");			// test ah, 4
+		EmitString("74 04");			// jz ok
+		EmitString("DD D8");			// fstp st(0)
+		EmitString("EB");			// jmp slow
+		inlineJumps[numInlineJumps++] = compiledOfs++;
+
+		STACK_PUSH(1);				// ok: add bl, 1
+		EmitString("D9 1C 9F");			// fstp dword ptr [edi + ebx * 4]
+	break;
+	default:
+		break;
+	}
+}
+
+/*
+=================
+EmitCallDirectSyscall
+Call to a trap from VM_RegisterSyscalls through DoDirectSyscall
+=================
+*/
+
+static void EmitCallDirectSyscall(vm_t *vm, int cdest, int callDirectSyscallOfs)
+{
+	EmitString("B8");	// mov eax, cdest
+	Emit4(cdest);
+
+	EmitCallRel(vm, callDirectSyscallOfs);
+
+	// have opStack reg point at return value
+	STACK_PUSH(1);		// add bl, 1
+}
+
 /*
 =================
 EmitCallConst
@@ -656,9 +1033,45 @@ Call to constant instruction number or syscall
 =================
 */
 
-void EmitCallConst(vm_t *vm, int cdest, int callProcOfsSyscall)
+void EmitCallConst(vm_t *vm, int cdest, int callProcOfsSyscall, int callDirectSyscallOfs)
 {
-	if(cdest < 0)
+	int trap = ~cdest;
+	int jmpDone, i;
+
+	if(cdest < 0 && trap < vm->numSyscalls && vm->syscalls[trap].func &&
+	   vm->syscalls[trap].numArgs < MAX_VMSYSCALL_ARGS)
+	{
+		if(inlineSyscalls && vm->syscalls[trap].inlined)
+		{
+			// it has to be called while it's logged
+			numInlineJumps = 0;
+			EmitRexString(0x48, "B8");	// mov eax, &vm->syscallDirect[trap]
+			EmitReloc(RELOC_SYSCALLDIRECT, &vm->syscallDirect[trap]);
+			EmitString("80 38 00");		// cmp byte ptr [eax], 0
+			EmitString("74");		// je slow
+			inlineJumps[numInlineJumps++] = compiledOfs++;
+
+			EmitInlineSyscall(vm, vm->syscalls[trap].inlined);
+
+			EmitString("EB");		// jmp done
+			jmpDone = compiledOfs++;
+
+			// slow:
+			for(i = 0; i < numInlineJumps; i++)
+				SET_JMPOFS(inlineJumps[i]);
+
+			EmitCallDirectSyscall(vm, cdest, callDirectSyscallOfs);
+
+			// done:
+			SET_JMPOFS(jmpDone);
+		}
+		else
+		{
+			// DoDirectSyscall calls it without systemCall
+			EmitCallDirectSyscall(vm, cdest, callDirectSyscallOfs);
+		}
+	}
+	else if(cdest < 0)
 	{
 		EmitString("B8");	// mov eax, cdest
 		Emit4(cdest);
@@ -713,6 +1126,118 @@ void EmitBranchConditions(vm_t *vm, int op)
 }
 
 
+/*
+=================
+LocalOptimize
+Fold OP_LOCAL into the instructions after it that use the address, so it
+never goes on the opStack or gets masked, see EmitLocalOp
+=================
+*/
+
+static qboolean LocalOptimize(vm_t *vm)
+{
+	int v, c;
+	int op1;
+
+	// only if none of the instructions it takes in is a jump label
+	if(!vm->jumpTableTargets || jused[instruction])
+		return qfalse;
+
+	v = NextConstant4();
+	if(v < 0 || v > VM_DATA_GUARD - 4)
+		return qfalse;
+
+	op1 = code[pc+4];
+	switch(op1)
+	{
+	case OP_LOCAL:
+		// LOCAL x, LOCAL x, LOAD4, CONST c, ADD|SUB, STORE4 is x += c
+		if(v != (code[pc+5] | (code[pc+6]<<8) | (code[pc+7]<<16) | (code[pc+8]<<24)) ||
+		   code[pc+9] != OP_LOAD4 || code[pc+10] != OP_CONST ||
+		   (code[pc+15] != OP_ADD && code[pc+15] != OP_SUB) || code[pc+16] != OP_STORE4 ||
+		   instruction + 4 >= vm->instructionCount || jused[instruction+1] || jused[instruction+2] ||
+		   jused[instruction+3] || jused[instruction+4])
+			return qfalse;
+
+		c = code[pc+11] | (code[pc+12]<<8) | (code[pc+13]<<16) | (code[pc+14]<<24);
+		op1 = (code[pc+15] == OP_ADD) ? 0 : 5;		// /0 add, /5 sub
+
+		if(c == 1)
+			EmitLocalOp(vm, "FF", op1 ? 1 : 0, v);	// inc|dec dword ptr [dataBase + esi + v]
+		else if(iss8(c))
+		{
+			EmitLocalOp(vm, "83", op1, v);		// add|sub dword ptr [dataBase + esi + v], c
+			Emit1(c);
+		}
+		else
+		{
+			EmitLocalOp(vm, "81", op1, v);		// add|sub dword ptr [dataBase + esi + v], c
+			Emit4(c);
+		}
+		LastCommand = LAST_COMMAND_NONE;
+
+		pc += 17;					// LOCAL, LOAD4, CONST, ADD|SUB, STORE4
+		instruction += 5;
+		return qtrue;
+
+	case OP_LOAD4:
+	case OP_LOAD2:
+	case OP_LOAD1:
+		// OP_LOAD4 does x += c itself when the address is on the opStack
+		if(code[pc+5] == OP_CONST && (code[pc+10] == OP_ADD || code[pc+10] == OP_SUB) &&
+		   code[pc+11] == OP_STORE4)
+			return qfalse;
+
+		EmitPushStack(vm);
+		if(op1 == OP_LOAD4)
+			EmitLocalOp(vm, "8B", 0, v);		// mov eax, dword ptr [dataBase + esi + v]
+		else if(op1 == OP_LOAD2)
+			EmitLocalOp(vm, "0F B7", 0, v);		// movzx eax, word ptr [dataBase + esi + v]
+		else
+			EmitLocalOp(vm, "0F B6", 0, v);		// movzx eax, byte ptr [dataBase + esi + v]
+		EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
+
+		pc += 5;					// OP_LOAD*
+		instruction += 1;
+		return qtrue;
+
+	case OP_CONST:
+		op1 = code[pc+9];
+		if((op1 != OP_STORE4 && op1 != OP_STORE2 && op1 != OP_STORE1) ||
+		   instruction + 1 >= vm->instructionCount || jused[instruction+1])
+			return qfalse;
+
+		c = code[pc+5] | (code[pc+6]<<8) | (code[pc+7]<<16) | (code[pc+8]<<24);
+
+		if(op1 == OP_STORE4)
+		{
+			EmitLocalOp(vm, "C7", 0, v);		// mov dword ptr [dataBase + esi + v], c
+			Emit4(c);
+		}
+		else if(op1 == OP_STORE2)
+		{
+			Emit1(0x66);
+			EmitLocalOp(vm, "C7", 0, v);		// mov word ptr [dataBase + esi + v], c
+			Emit2(c);
+		}
+		else
+		{
+			EmitLocalOp(vm, "C6", 0, v);		// mov byte ptr [dataBase + esi + v], c
+			Emit1(c);
+		}
+		LastCommand = LAST_COMMAND_NONE;
+
+		pc += 10;					// LOCAL, CONST, STORE*
+		instruction += 2;
+		return qtrue;
+
+	default:
+		break;
+	}
+
+	return qfalse;
+}
+
 /*
 =================
 ConstOptimize
@@ -721,7 +1246,7 @@ instead of opStack operations, which will save expensive operations on memory
 =================
 */
 
-qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
+qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall, int callDirectSyscallOfs)
 {
 	int v;
 	int op1;
@@ -742,7 +1267,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		Emit4(Constant4() & vm->dataMask);
 #else
 		EmitString("B8");				// mov eax, 0x12345678
-		EmitPtr(vm->dataBase + (Constant4() & vm->dataMask));
+		EmitReloc(RELOC_DATA, vm->dataBase + (Constant4() & vm->dataMask));
 		EmitString("8B 00");				// mov eax, dword ptr [eax]
 #endif
 		EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
@@ -758,7 +1283,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		Emit4(Constant4() & vm->dataMask);
 #else
 		EmitString("B8");				// mov eax, 0x12345678
-		EmitPtr(vm->dataBase + (Constant4() & vm->dataMask));
+		EmitReloc(RELOC_DATA, vm->dataBase + (Constant4() & vm->dataMask));
 		EmitString("0F B7 00");				// movzx eax, word ptr [eax]
 #endif
 		EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
@@ -774,7 +1299,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		Emit4(Constant4() & vm->dataMask);
 #else
 		EmitString("B8");				// mov eax, 0x12345678
-		EmitPtr(vm->dataBase + (Constant4() & vm->dataMask));
+		EmitReloc(RELOC_DATA, vm->dataBase + (Constant4() & vm->dataMask));
 		EmitString("0F B6 00");				// movzx eax, byte ptr [eax]
 #endif
 		EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
@@ -790,7 +1315,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		Emit4(Constant4());
 #else
 		EmitString("C7 80");				// mov dword ptr [eax + 0x12345678], 0x12345678
-		Emit4((intptr_t) vm->dataBase);
+		EmitReloc(RELOC_DATA, vm->dataBase);
 		Emit4(Constant4());
 #endif
 		EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
@@ -806,7 +1331,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		Emit2(Constant4());
 #else
 		EmitString("66 C7 80");				// mov word ptr [eax + 0x12345678], 0x1234
-		Emit4((intptr_t) vm->dataBase);
+		EmitReloc(RELOC_DATA, vm->dataBase);
 		Emit2(Constant4());
 #endif
 		EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
@@ -822,7 +1347,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 		Emit1(Constant4());
 #else
 		EmitString("C6 80");				// mov byte ptr [eax + 0x12345678], 0x12
-		Emit4((intptr_t) vm->dataBase);
+		EmitReloc(RELOC_DATA, vm->dataBase);
 		Emit1(Constant4());
 #endif
 		EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
@@ -1043,7 +1568,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 
 	case OP_CALL:
 		v = Constant4();
-		EmitCallConst(vm, v, callProcOfsSyscall);
+		EmitCallConst(vm, v, callProcOfsSyscall, callDirectSyscallOfs);
 
 		pc += 1;                  // OP_CALL
 		instruction += 1;
@@ -1056,6 +1581,380 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 	return qfalse;
 }
 
+/*
+==============
+Compile cache
+
+VM_Compile saves what it compiled, with the instruction offsets and the
+addresses it has to fix up, to vmcache/<game>/<module>.<arch>.jit in the
+home path.  The next VM_Create of the same QVM loads that instead, as long
+as the engine, the QVM and the traps it calls directly haven't changed.
+
+The engine runs that code as it is, so each file has an HMAC keyed with
+vmcache/key, random bytes made the first time, and one without the right
+HMAC is compiled again.  A game can't write there, see FS_InvalidGameDir
+and FS_CheckFilenameIsNotExecutable.
+==============
+*/
+
+#define VM_CACHE_MAGIC		('Q' | ('J' << 8) | ('I' << 16) | ('T' << 24))
+#define VM_CACHE_VERSION	5
+#define VM_CACHE_KEY		VM_CACHE_DIR "/key"
+
+typedef struct
+{
+	int		magic;
+	int		version;
+	char		build[64];		// engine version and when this file was compiled
+	unsigned	checksums[4];		// QVM code, jump table targets, compile settings, traps
+
+	// followed by instructionCount offsets, numRelocs vmReloc_t, then codeLength bytes
+	// of code with the relocated addresses replaced by what VM_LoadCompiled adds to them
+	int		instructionCount;
+	int		numRelocs;
+	int		codeLength;
+	int		entryOfs;
+
+	byte		mac[16];		// Com_MD5HMAC of the whole file with this zeroed
+} vmCacheHeader_t;
+
+static byte cacheKey[32];
+static qboolean cacheKeyLoaded;
+
+// RELOC_ENGINE numbers, Q_VMftol is a variable so this can't be a constant table
+static void *engineAddrs[9];
+
+static void VM_SetEngineAddrs(void)
+{
+	engineAddrs[0] = DoSyscall;
+	engineAddrs[1] = DoDirectSyscall;
+	engineAddrs[2] = &vm_syscallNum;
+	engineAddrs[3] = &vm_programStack;
+	engineAddrs[4] = &vm_opStackOfs;
+	engineAddrs[5] = &vm_opStackBase;
+	engineAddrs[6] = &vm_arg;
+	engineAddrs[7] = &vm_nativeStack;
+	engineAddrs[8] = Q_VMftol;
+}
+
+/*
+=================
+VM_CacheKey
+Everything the compiled code depends on besides the addresses in relocs
+=================
+*/
+
+static void VM_CacheKey(vm_t *vm, vmHeader_t *header, vmCacheHeader_t *key)
+{
+	int settings[5];
+	byte *traps;
+	int i;
+
+	Com_Memset(key, 0, sizeof(*key));
+	key->magic = VM_CACHE_MAGIC;
+	key->version = VM_CACHE_VERSION;
+	Q_strncpyz(key->build, Q3_VERSION " " ARCH_STRING " " __DATE__ " " __TIME__, sizeof(key->build));
+
+	key->checksums[0] = Com_BlockChecksum((byte *) header + header->codeOffset, header->codeLength);
+	if(vm->numJumpTableTargets)
+		key->checksums[1] = Com_BlockChecksum(vm->jumpTableTargets, vm->numJumpTableTargets * sizeof(int));
+
+	settings[0] = header->instructionCount;
+	settings[1] = vm->dataMask;
+	settings[2] = vm->jumpTableTargets != NULL;
+	settings[3] = inlineSyscalls;
+	settings[4] = vm->numSyscalls;
+	key->checksums[2] = Com_BlockChecksum(settings, sizeof(settings));
+
+	if(vm->numSyscalls)
+	{
+		// EmitCallConst only looks at which traps have a function and what it inlines
+		traps = Z_Malloc(vm->numSyscalls);
+		for(i = 0; i < vm->numSyscalls; i++)
+		{
+			traps[i] = (vm->syscalls[i].func && vm->syscalls[i].numArgs < MAX_VMSYSCALL_ARGS) |
+				(vm->syscalls[i].inlined << 1);
+		}
+		key->checksums[3] = Com_BlockChecksum(traps, vm->numSyscalls);
+		Z_Free(traps);
+	}
+
+	key->instructionCount = header->instructionCount;
+}
+
+/*
+=================
+VM_CacheSecret
+Read the key for the cache files' HMAC, or make it if this install has
+none yet, qfalse if there's no key to use
+=================
+*/
+
+static qboolean VM_CacheSecret(void)
+{
+	fileHandle_t f;
+
+	if(cacheKeyLoaded)
+		return qtrue;
+
+	if(FS_VMCacheFOpenFile(VM_CACHE_KEY, &f, FS_READ) == sizeof(cacheKey))
+		cacheKeyLoaded = FS_Read(cacheKey, sizeof(cacheKey), f) == sizeof(cacheKey);
+	if(f)
+		FS_FCloseFile(f);
+
+	if(cacheKeyLoaded)
+		return qtrue;
+
+	if(!Sys_RandomBytes(cacheKey, sizeof(cacheKey)))
+	{
+		Com_Printf(S_COLOR_YELLOW "Warning: can't make %s, not caching compiled code\n", VM_CACHE_KEY);
+		return qfalse;
+	}
+
+	FS_VMCacheFOpenFile(VM_CACHE_KEY, &f, FS_WRITE);
+	if(!f)
+	{
+		Com_Printf(S_COLOR_YELLOW "Warning: couldn't write %s, not caching compiled code\n", VM_CACHE_KEY);
+		return qfalse;
+	}
+
+	cacheKeyLoaded = FS_Write(cacheKey, sizeof(cacheKey), f) == sizeof(cacheKey);
+	FS_FCloseFile(f);
+
+	return cacheKeyLoaded;
+}
+
+/*
+=================
+VM_AllocCompiled
+Writable memory for the code, VM_ProtectCompiled makes it executable
+=================
+*/
+
+static byte *VM_AllocCompiled(int length)
+{
+	byte *base;
+
+#ifdef VM_X86_MMAP
+	base = mmap(NULL, length, PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if(base == MAP_FAILED)
+		Com_Error(ERR_FATAL, "VM_CompileX86: can't mmap memory");
+#elif _WIN32
+	// allocate memory with EXECUTE permissions under windows.
+	base = VirtualAlloc(NULL, length, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+	if(!base)
+		Com_Error(ERR_FATAL, "VM_CompileX86: VirtualAlloc failed");
+#else
+	base = malloc(length);
+	if(!base)
+	        Com_Error(ERR_FATAL, "VM_CompileX86: malloc failed");
+#endif
+
+	return base;
+}
+
+static void VM_ProtectCompiled(vm_t *vm)
+{
+#ifdef VM_X86_MMAP
+	if(mprotect(vm->codeBase, vm->codeLength, PROT_READ|PROT_EXEC))
+		Com_Error(ERR_FATAL, "VM_CompileX86: mprotect failed");
+#elif _WIN32
+	{
+		DWORD oldProtect = 0;
+		
+		// remove write permissions.
+		if(!VirtualProtect(vm->codeBase, vm->codeLength, PAGE_EXECUTE_READ, &oldProtect))
+			Com_Error(ERR_FATAL, "VM_CompileX86: VirtualProtect failed");
+	}
+#endif
+}
+
+/*
+=================
+VM_LoadCompiled
+Load the code VM_SaveCompiled left for this QVM, qfalse if there's none
+or it doesn't match key
+=================
+*/
+
+static qboolean VM_LoadCompiled(vm_t *vm, const char *filename, const vmCacheHeader_t *key, int start)
+{
+	vmCacheHeader_t cached;
+	vmReloc_t *cachedRelocs;
+	int *offsets;
+	byte *image;
+	byte mac[16];
+	fileHandle_t f;
+	long length;
+	intptr_t v;
+	int i;
+
+	length = FS_VMCacheFOpenFile(filename, &f, FS_READ);
+	if(!f)
+		return qfalse;
+
+	if(length < sizeof(cached) || FS_Read(&cached, sizeof(cached), f) != sizeof(cached) ||
+	   memcmp(&cached, key, offsetof(vmCacheHeader_t, numRelocs)) ||
+	   cached.numRelocs < 0 || cached.codeLength <= 0 ||
+	   cached.entryOfs < 0 || cached.entryOfs >= cached.codeLength ||
+	   length != sizeof(cached) + cached.instructionCount * sizeof(*offsets) +
+		(long) cached.numRelocs * sizeof(*cachedRelocs) + cached.codeLength)
+	{
+		FS_FCloseFile(f);
+		Com_Printf("%s doesn't match %s, compiling it\n", filename, vm->name);
+		return qfalse;
+	}
+
+	// nothing in it is used before the HMAC says this install wrote it
+	image = Z_Malloc(length);
+	Com_Memcpy(image, &cached, sizeof(cached));
+	Com_Memset(((vmCacheHeader_t *) image)->mac, 0, sizeof(cached.mac));
+	i = FS_Read(image + sizeof(cached), length - sizeof(cached), f);
+	FS_FCloseFile(f);
+
+	Com_MD5HMAC(cacheKey, sizeof(cacheKey), image, length, mac);
+	if(i != length - sizeof(cached) || memcmp(mac, cached.mac, sizeof(mac)))
+	{
+		Z_Free(image);
+		Com_Printf(S_COLOR_YELLOW "Warning: %s wasn't written by this install, compiling %s\n",
+			filename, vm->name);
+		return qfalse;
+	}
+
+	offsets = (int *) (image + sizeof(cached));
+	cachedRelocs = (vmReloc_t *) (offsets + cached.instructionCount);
+
+	vm->codeLength = cached.codeLength;
+	vm->codeBase = VM_AllocCompiled(vm->codeLength);
+	Com_Memcpy(vm->codeBase, cachedRelocs + cached.numRelocs, vm->codeLength);
+
+	for(i = 0; i < cached.numRelocs; i++)
+	{
+		if(cachedRelocs[i].ofs < 0 || cachedRelocs[i].ofs > vm->codeLength - (int) sizeof(v))
+			break;
+
+		Com_Memcpy(&v, vm->codeBase + cachedRelocs[i].ofs, sizeof(v));
+
+		if(cachedRelocs[i].type == RELOC_DATA)
+			v += (intptr_t) vm->dataBase;
+		else if(cachedRelocs[i].type == RELOC_SYSCALLDIRECT)
+			v += (intptr_t) vm->syscallDirect;
+		else if(cachedRelocs[i].type == RELOC_INSTRUCTIONS)
+			v += (intptr_t) vm->instructionPointers;
+		else if(cachedRelocs[i].type == RELOC_ENGINE && v >= 0 && v < ARRAY_LEN(engineAddrs))
+			v = (intptr_t) engineAddrs[v];
+		else
+			break;
+
+		Com_Memcpy(vm->codeBase + cachedRelocs[i].ofs, &v, sizeof(v));
+	}
+
+	// instructions ConstOptimize merged into the one before are left at 0
+	for(v = 0; i == cached.numRelocs && v < cached.instructionCount; v++)
+	{
+		if(offsets[v] < 0 || offsets[v] >= vm->codeLength)
+			break;
+		vm->instructionPointers[v] = (intptr_t) vm->codeBase + offsets[v];
+	}
+
+	Z_Free(image);
+
+	if(i < cached.numRelocs || v < cached.instructionCount)
+	{
+		VM_Destroy_Compiled(vm);
+		Com_Printf(S_COLOR_YELLOW "Warning: %s is corrupt, compiling %s\n", filename, vm->name);
+		return qfalse;
+	}
+
+	VM_ProtectCompiled(vm);
+	vm->entryOfs = cached.entryOfs;
+	vm->destroy = VM_Destroy_Compiled;
+	vm->sampleNativeStack = qtrue;
+
+	Com_Printf("VM file %s loaded %i bytes of code from %s in %i msec\n", vm->name, vm->codeLength,
+		filename, Sys_Milliseconds() - start);
+
+	return qtrue;
+}
+
+/*
+=================
+VM_SaveCompiled
+Write the code VM_Compile left in buf for VM_LoadCompiled, this replaces the
+relocated addresses in buf
+=================
+*/
+
+static void VM_SaveCompiled(vm_t *vm, const char *filename, vmCacheHeader_t *key)
+{
+	fileHandle_t f;
+	int *offsets;
+	byte *image;
+	long length;
+	intptr_t v;
+	int i, j;
+
+	for(i = 0; i < numRelocs; i++)
+	{
+		Com_Memcpy(&v, buf + relocs[i].ofs, sizeof(v));
+
+		if(relocs[i].type == RELOC_DATA)
+			v -= (intptr_t) vm->dataBase;
+		else if(relocs[i].type == RELOC_SYSCALLDIRECT)
+			v -= (intptr_t) vm->syscallDirect;
+		else if(relocs[i].type == RELOC_INSTRUCTIONS)
+			v -= (intptr_t) vm->instructionPointers;
+		else
+		{
+			for(j = 0; j < ARRAY_LEN(engineAddrs) && (intptr_t) engineAddrs[j] != v; j++)
+				;
+
+			if(j == ARRAY_LEN(engineAddrs))
+			{
+				Com_Printf(S_COLOR_YELLOW "Warning: %s calls something that isn't in engineAddrs, "
+					"not caching it\n", vm->name);
+				return;
+			}
+			v = j;
+		}
+
+		Com_Memcpy(buf + relocs[i].ofs, &v, sizeof(v));
+	}
+
+	FS_VMCacheFOpenFile(filename, &f, FS_WRITE);
+	if(!f)
+	{
+		Com_Printf(S_COLOR_YELLOW "Warning: couldn't write %s\n", filename);
+		return;
+	}
+
+	key->numRelocs = numRelocs;
+	key->codeLength = vm->codeLength;
+	key->entryOfs = vm->entryOfs;
+
+	length = sizeof(*key) + vm->instructionCount * sizeof(*offsets) +
+		numRelocs * sizeof(*relocs) + vm->codeLength;
+	image = Z_Malloc(length);
+	Com_Memcpy(image, key, sizeof(*key));
+
+	// they aren't offset by codeBase yet
+	offsets = (int *) (image + sizeof(*key));
+	for(i = 0; i < vm->instructionCount; i++)
+		offsets[i] = vm->instructionPointers[i];
+
+	Com_Memcpy(offsets + vm->instructionCount, relocs, numRelocs * sizeof(*relocs));
+	Com_Memcpy((vmReloc_t *) (offsets + vm->instructionCount) + numRelocs, buf, vm->codeLength);
+
+	// key's mac is still 0 from VM_CacheKey
+	Com_MD5HMAC(cacheKey, sizeof(cacheKey), image, length, key->mac);
+	Com_Memcpy(image, key, sizeof(*key));
+
+	FS_Write(image, length, f);
+	FS_FCloseFile(f);
+
+	Z_Free(image);
+}
+
 /*
 =================
 VM_Compile
@@ -1067,15 +1966,38 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 	int		maxLength;
 	int		v;
 	int		i;
-        int		callProcOfsSyscall, callProcOfs, callDoSyscallOfs;
+        int		callProcOfsSyscall, callProcOfs, callDoSyscallOfs, callDirectSyscallOfs;
+	int		callStackViolationOfs, stackBottom;
+	int		start, cache, instructionOfs;
+	char		cacheFile[MAX_QPATH];
+	vmCacheHeader_t	key;
+
+	start = Sys_Milliseconds();
+	inlineSyscalls = Cvar_VariableIntegerValue("vm_inlineSyscalls");
+	VM_SetEngineAddrs();
+
+	// use what an earlier VM_Create compiled if nothing changed since
+	cache = Cvar_VariableIntegerValue("vm_compileCache") && VM_CacheSecret();
+	if(cache)
+	{
+		Com_sprintf(cacheFile, sizeof(cacheFile), VM_CACHE_DIR "/%s/%s." ARCH_STRING VM_CACHE_EXT,
+			FS_GetCurrentGameDir(), vm->name);
+		VM_CacheKey(vm, header, &key);
+
+		if(VM_LoadCompiled(vm, cacheFile, &key, start))
+			return;
+	}
 
 	jusedSize = header->instructionCount + 2;
 
 	// allocate a very large temp buffer, we will shrink it later
-	maxLength = header->codeLength * 8 + 64;
+	maxLength = PRELUDE_LENGTH + header->codeLength * 8 + MAX_INSTRUCTION_LENGTH;
 	buf = Z_Malloc(maxLength);
 	jused = Z_Malloc(jusedSize);
 	code = Z_Malloc(header->codeLength+32);
+	maxRelocs = 256;
+	relocs = Z_Malloc(maxRelocs * sizeof(*relocs));
+	numRelocs = 0;
 	
 	Com_Memset(jused, 0, jusedSize);
 	Com_Memset(buf, 0, maxLength);
@@ -1096,9 +2018,26 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 	compiledOfs = 0;
 
 	callDoSyscallOfs = compiledOfs;
-	callProcOfs = EmitCallDoSyscall(vm);
+	callProcOfs = EmitCallDoSyscall(vm, DoSyscall);
 	callProcOfsSyscall = EmitCallProcedure(vm, callDoSyscallOfs);
+	callDirectSyscallOfs = compiledOfs;
+	EmitCallDoSyscall(vm, DoDirectSyscall);
+
+	// OP_ENTER and OP_LEAVE jump here if programStack leaves the stack
+	callStackViolationOfs = compiledOfs;
+	EmitString("B8");			// mov eax, 0x12345678
+	Emit4(VM_STACK_VIOLATION);
+	EmitCallRel(vm, callDoSyscallOfs);
+	stackBottom = vm->stackBottom > 0 ? vm->stackBottom : 0;
+
+	if(compiledOfs > PRELUDE_LENGTH)
+	{
+		VMFREE_BUFFERS();
+		Com_Error(ERR_FATAL, "VM_CompileX86: PRELUDE_LENGTH exceeded");
+	}
+
 	vm->entryOfs = compiledOfs;
+	numStubRelocs = numRelocs;
 
 	for(pass=0; pass < 3; pass++) {
 	oc0 = -23423;
@@ -1111,18 +2050,20 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 	instruction = 0;
 	//code = (byte *)header + header->codeOffset;
 	compiledOfs = vm->entryOfs;
+	numRelocs = numStubRelocs;
 
 	LastCommand = LAST_COMMAND_NONE;
 
 	while(instruction < header->instructionCount)
 	{
-		if(compiledOfs > maxLength - 16)
+		if(compiledOfs > maxLength - MAX_INSTRUCTION_LENGTH)
 		{
 	        	VMFREE_BUFFERS();
 			Com_Error(ERR_DROP, "VM_CompileX86: maxLength exceeded");
 		}
 
 		vm->instructionPointers[ instruction ] = compiledOfs;
+		instructionOfs = compiledOfs;
 
 		if ( !vm->jumpTableTargets )
 			jlabel = 1;
@@ -1147,10 +2088,19 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			break;
 		case OP_ENTER:
 			EmitString("81 EE");				// sub esi, 0x12345678
-			Emit4(Constant4());
+			Emit4(FrameSize());
+			// unsigned, so a programStack that went below 0 is out of range too
+			EmitString("81 FE");				// cmp esi, vm->stackBottom
+			Emit4(stackBottom);
+			EmitString("0F 82");				// jb stackViolation
+			Emit4(callStackViolationOfs - compiledOfs - 4);
+			EmitString("81 FE");				// cmp esi, vm->dataMask + 1
+			Emit4(vm->dataMask + 1);
+			EmitString("0F 87");				// ja stackViolation
+			Emit4(callStackViolationOfs - compiledOfs - 4);
 			break;
 		case OP_CONST:
-			if(ConstOptimize(vm, callProcOfsSyscall))
+			if(ConstOptimize(vm, callProcOfsSyscall, callDirectSyscallOfs))
 				break;
 
 			EmitPushStack(vm);
@@ -1163,6 +2113,13 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 
 			break;
 		case OP_LOCAL:
+			if(LocalOptimize(vm))
+			{
+				// none of it is on the opStack for the OP_LOAD4 patterns
+				op = OP_IGNORE;
+				break;
+			}
+
 			EmitPushStack(vm);
 			EmitString("8D 86");				// lea eax, [0x12345678 + esi]
 			oc0 = oc1;
@@ -1172,16 +2129,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			break;
 		case OP_ARG:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("8B D6");				// mov edx, esi
-			EmitString("81 C2");				// add edx, 0x12345678
-			Emit4((Constant1() & 0xFF));
-			MASK_REG("E2", vm->dataMask);			// and edx, 0x12345678
-#if idx64
-			EmitRexString(0x41, "89 04 11");		// mov dword ptr [r9 + edx], eax
-#else
-			EmitString("89 82");				// mov dword ptr [edx + 0x12345678], eax
-			Emit4((intptr_t) vm->dataBase);
-#endif
+			EmitLocalOp(vm, "89", 0, Constant1() & 0xFF);	// mov dword ptr [dataBase + esi + 0x12], eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
 		case OP_CALL:
@@ -1194,9 +2142,13 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
 		case OP_LEAVE:
-			v = Constant4();
+			v = FrameSize();
 			EmitString("81 C6");				// add	esi, 0x12345678
 			Emit4(v);
+			EmitString("81 FE");				// cmp esi, vm->dataMask + 1
+			Emit4(vm->dataMask + 1);
+			EmitString("0F 87");				// ja stackViolation
+			Emit4(callStackViolationOfs - compiledOfs - 4);
 			EmitString("C3");				// ret
 			break;
 		case OP_LOAD4:
@@ -1218,7 +2170,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 					EmitRexString(0x41, "FF 04 11");	// inc dword ptr [r9 + edx]
 #else
 					EmitString("FF 82");			// inc dword ptr [edx + 0x12345678]
-					Emit4((intptr_t) vm->dataBase);
+					EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 				}
 				else
@@ -1227,7 +2179,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 					EmitRexString(0x41, "8B 04 11");	// mov eax, dword ptr [r9 + edx]
 #else
 					EmitString("8B 82");			// mov eax, dword ptr [edx + 0x12345678]
-					Emit4((intptr_t) vm->dataBase);
+					EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 					EmitString("05");			// add eax, v
 					Emit4(v);
@@ -1238,7 +2190,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 						EmitRexString(0x41, "89 04 11");	// mov dword ptr [r9 + edx], eax
 #else
 						EmitString("89 82");			// mov dword ptr [edx + 0x12345678], eax
-						Emit4((intptr_t) vm->dataBase);
+						EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 					}
 					else
@@ -1250,7 +2202,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 						EmitRexString(0x41, "89 04 11");	// mov dword ptr [r9 + edx], eax
 #else
 						EmitString("89 82");			// mov dword ptr [edx + 0x12345678], eax
-						Emit4((intptr_t) vm->dataBase);
+						EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 					}
 				}
@@ -1280,7 +2232,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 					EmitRexString(0x41, "FF 0C 11");	// dec dword ptr [r9 + edx]
 #else
 					EmitString("FF 8A");			// dec dword ptr [edx + 0x12345678]
-					Emit4((intptr_t) vm->dataBase);
+					EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 				}
 				else
@@ -1289,7 +2241,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 					EmitRexString(0x41, "8B 04 11");	// mov eax, dword ptr [r9 + edx]
 #else
 					EmitString("8B 82");			// mov eax, dword ptr [edx + 0x12345678]
-					Emit4((intptr_t) vm->dataBase);
+					EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 					EmitString("2D");			// sub eax, v
 					Emit4(v);
@@ -1300,7 +2252,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 						EmitRexString(0x41, "89 04 11");	// mov dword ptr [r9 + edx], eax
 #else
 						EmitString("89 82");			// mov dword ptr [edx + 0x12345678], eax
-						Emit4((intptr_t) vm->dataBase);
+						EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 					}
 					else
@@ -1312,7 +2264,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 						EmitRexString(0x41, "89 04 11");	// mov dword ptr [r9 + edx], eax
 #else
 						EmitString("89 82");			// mov dword ptr [edx + 0x12345678], eax
-						Emit4((intptr_t) vm->dataBase);
+						EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 					}
 				}
@@ -1332,7 +2284,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 				EmitRexString(0x41, "8B 04 01");		// mov eax, dword ptr [r9 + eax]
 #else
 				EmitString("8B 80");				// mov eax, dword ptr [eax + 0x1234567]
-				Emit4((intptr_t) vm->dataBase);
+				EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 				EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 				break;
@@ -1343,7 +2295,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "8B 04 01");		// mov eax, dword ptr [r9 + eax]
 #else
 			EmitString("8B 80");				// mov eax, dword ptr [eax + 0x12345678]
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
@@ -1353,7 +2305,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "0F B7 04 01");		// movzx eax, word ptr [r9 + eax]
 #else
 			EmitString("0F B7 80");				// movzx eax, word ptr [eax + 0x12345678]
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
@@ -1363,7 +2315,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "0F B6 04 01");		// movzx eax, byte ptr [r9 + eax]
 #else
 			EmitString("0F B6 80");				// movzx eax, byte ptr [eax + 0x12345678]
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
@@ -1375,7 +2327,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "89 04 11");		// mov dword ptr [r9 + edx], eax
 #else
 			EmitString("89 82");				// mov dword ptr [edx + 0x12345678], eax
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_SUB_BL_2);		// sub bl, 2
 			break;
@@ -1388,7 +2340,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "89 04 11");
 #else
 			EmitString("66 89 82");				// mov word ptr [edx + 0x12345678], eax
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_SUB_BL_2);		// sub bl, 2
 			break;
@@ -1400,7 +2352,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitRexString(0x41, "88 04 11");		// mov byte ptr [r9 + edx], eax
 #else
 			EmitString("88 82");				// mov byte ptr [edx + 0x12345678], eax
-			Emit4((intptr_t) vm->dataBase);
+			EmitReloc(RELOC_DATA, vm->dataBase);
 #endif
 			EmitCommand(LAST_COMMAND_SUB_BL_2);		// sub bl, 2
 			break;
@@ -1467,13 +2419,16 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			break;
 		case OP_ADD:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("01 44 9F FC");			// add dword ptr -4[edi + ebx * 4], eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
+			EmitString("03 04 9F");				// add eax, dword ptr [edi + ebx * 4]
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_SUB:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("29 44 9F FC");			// sub dword ptr -4[edi + ebx * 4], eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
+			EmitString("F7 D8");				// neg eax
+			EmitString("03 04 9F");				// add eax, dword ptr [edi + ebx * 4]
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_DIVI:
 			EmitString("8B 44 9F FC");			// mov eax,dword ptr -4[edi + ebx * 4]
@@ -1504,31 +2459,34 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
 		case OP_MULI:
-			EmitString("8B 44 9F FC");			// mov eax,dword ptr -4[edi + ebx * 4]
-			EmitString("F7 2C 9F");				// imul dword ptr [edi + ebx * 4]
-			EmitString("89 44 9F FC");			// mov dword ptr -4[edi + ebx * 4],eax
+			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
+			EmitString("0F AF 04 9F");			// imul eax, dword ptr [edi + ebx * 4]
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_MULU:
-			EmitString("8B 44 9F FC");			// mov eax,dword ptr -4[edi + ebx * 4]
-			EmitString("F7 24 9F");				// mul dword ptr [edi + ebx * 4]
-			EmitString("89 44 9F FC");			// mov dword ptr -4[edi + ebx * 4],eax
+			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
+			EmitString("0F AF 04 9F");			// imul eax, dword ptr [edi + ebx * 4]
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_BAND:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("21 44 9F FC");			// and dword ptr -4[edi + ebx * 4],eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
+			EmitString("23 04 9F");				// and eax, dword ptr [edi + ebx * 4]
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_BOR:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("09 44 9F FC");			// or dword ptr -4[edi + ebx * 4],eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
+			EmitString("0B 04 9F");				// or eax, dword ptr [edi + ebx * 4]
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_BXOR:
 			EmitMovEAXStack(vm, 0);				// mov eax, dword ptr [edi + ebx * 4]
-			EmitString("31 44 9F FC");			// xor dword ptr -4[edi + ebx * 4],eax
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
+			EmitString("33 04 9F");				// xor eax, dword ptr [edi + ebx * 4]
+			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 			break;
 		case OP_BCOM:
 			EmitString("F7 14 9F");				// not dword ptr [edi + ebx * 4]
@@ -1589,7 +2547,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 #else // FTOL_PTR
 			// call the library conversion function
 			EmitRexString(0x48, "BA");			// mov edx, Q_VMftol
-			EmitPtr(Q_VMftol);
+			EmitReloc(RELOC_ENGINE, Q_VMftol);
 			EmitRexString(0x48, "FF D2");			// call edx
 			EmitCommand(LAST_COMMAND_MOV_STACK_EAX);	// mov dword ptr [edi + ebx * 4], eax
 #endif
@@ -1625,7 +2583,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 #else
 			EmitString("73 07");			// jae +7
 			EmitString("FF 24 85");			// jmp dword ptr [instructionPointers + eax * 4]
-			Emit4((intptr_t) vm->instructionPointers);
+			EmitReloc(RELOC_INSTRUCTIONS, vm->instructionPointers);
 #endif
 			EmitCallErrJump(vm, callDoSyscallOfs);
 			break;
@@ -1633,6 +2591,13 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 		        VMFREE_BUFFERS();
 			Com_Error(ERR_DROP, "VM_CompileX86: bad opcode %i at offset %i", op, pc);
 		}
+
+		if(compiledOfs - instructionOfs > MAX_INSTRUCTION_LENGTH)
+		{
+			VMFREE_BUFFERS();
+			Com_Error(ERR_FATAL, "VM_CompileX86: MAX_INSTRUCTION_LENGTH exceeded");
+		}
+
 		pop0 = pop1;
 		pop1 = op;
 	}
@@ -1640,40 +2605,21 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 
 	// copy to an exact sized buffer with the appropriate permission bits
 	vm->codeLength = compiledOfs;
-#ifdef VM_X86_MMAP
-	vm->codeBase = mmap(NULL, compiledOfs, PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
-	if(vm->codeBase == MAP_FAILED)
-		Com_Error(ERR_FATAL, "VM_CompileX86: can't mmap memory");
-#elif _WIN32
-	// allocate memory with EXECUTE permissions under windows.
-	vm->codeBase = VirtualAlloc(NULL, compiledOfs, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
-	if(!vm->codeBase)
-		Com_Error(ERR_FATAL, "VM_CompileX86: VirtualAlloc failed");
-#else
-	vm->codeBase = malloc(compiledOfs);
-	if(!vm->codeBase)
-	        Com_Error(ERR_FATAL, "VM_CompileX86: malloc failed");
-#endif
+	vm->codeBase = VM_AllocCompiled(compiledOfs);
 
 	Com_Memcpy( vm->codeBase, buf, compiledOfs );
 
-#ifdef VM_X86_MMAP
-	if(mprotect(vm->codeBase, compiledOfs, PROT_READ|PROT_EXEC))
-		Com_Error(ERR_FATAL, "VM_CompileX86: mprotect failed");
-#elif _WIN32
-	{
-		DWORD oldProtect = 0;
-		
-		// remove write permissions.
-		if(!VirtualProtect(vm->codeBase, compiledOfs, PAGE_EXECUTE_READ, &oldProtect))
-			Com_Error(ERR_FATAL, "VM_CompileX86: VirtualProtect failed");
-	}
-#endif
+	VM_ProtectCompiled(vm);
+
+	if(cache)
+		VM_SaveCompiled(vm, cacheFile, &key);
 
 	Z_Free( code );
 	Z_Free( buf );
 	Z_Free( jused );
-	Com_Printf( "VM file %s compiled to %i bytes of code\n", vm->name, compiledOfs );
+	Z_Free( relocs );
+	Com_Printf( "VM file %s compiled to %i bytes of code in %i msec\n", vm->name, compiledOfs,
+		Sys_Milliseconds() - start );
 
 	vm->destroy = VM_Destroy_Compiled;
 
@@ -1681,6 +2627,9 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 	for ( i = 0 ; i < header->instructionCount ; i++ ) {
 		vm->instructionPointers[i] += (intptr_t) vm->codeBase;
 	}
+
+	// VM calls are native calls and nothing else is pushed, see vm_sample.c
+	vm->sampleNativeStack = qtrue;
 }
 
 void VM_Destroy_Compiled(vm_t* self)
@@ -1566,7 +1566,13 @@ void SV_ExecuteClientCommand( client_t *cl, const char *s, qboolean clientOK ) {
 		// pass unknown strings to the game
 		if (!u->name && sv.state == SS_GAME && (cl->state == CS_ACTIVE || cl->state == CS_PRIMED)) {
 			Cmd_Args_Sanitize();
+#ifdef USE_SQLITE3
+			sql_context.serverClient = cl - svs.clients;
+#endif
 			VM_Call( gvm, GAME_CLIENT_COMMAND, cl - svs.clients );
+#ifdef USE_SQLITE3
+			sql_context.serverClient = -1;
+#endif
 		}
 	}
 	else if (!bProcessed)
@@ -1646,7 +1652,13 @@ void SV_ClientThink (client_t *cl, usercmd_t *cmd) {
 		return;		// may have been kicked during the last usercmd
 	}
 
+#ifdef USE_SQLITE3
+	sql_context.serverClient = cl - svs.clients;
+#endif
 	VM_Call( gvm, GAME_CLIENT_THINK, cl - svs.clients );
+#ifdef USE_SQLITE3
+	sql_context.serverClient = -1;
+#endif
 }
 
 /*
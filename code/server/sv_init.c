@@ -290,9 +290,10 @@ static void SV_Startup( void ) {
 
 #ifdef USE_SQLITE3
 	Com_Printf( "Starting SQLite3 database\n" );
-	if (sql_init(&sql, "server_qvm_log.db") < 0) {
+	if (sql_open_log(SQL_LOG_QAGAME) < 0) {
 		Com_Error(ERR_DROP, "Failed to initialize the database");
 	}
+	sql_context.serverTime = &svs.time;
 #endif
 }
 
@@ -447,6 +448,11 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 		}
 	}
 
+#ifdef USE_SQLITE3
+	// start a new log segment for the map if sql_rotateMap is set
+	sql_rotate(sql_logs[SQL_LOG_QAGAME], SQL_ROTATE_MAP, server);
+#endif
+
 	// clear pak references
 	FS_ClearPakReferences(0);
 
@@ -783,7 +789,8 @@ void SV_Shutdown( char *finalmsg ) {
 
 #ifdef USE_SQLITE3
 	Com_Printf( "Stopping SQLite3 database\n" );
-	if (sql_close(&sql) < 0) {
+	sql_context.serverTime = NULL;
+	if (sql_close_log(SQL_LOG_QAGAME) < 0) {
 		Com_Error(ERR_DROP, "Failed to close the database");
 	}
 #endif
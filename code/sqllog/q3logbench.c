@@ -0,0 +1,226 @@
+/* q3logbench: inserts per second for each sql_profile.
+
+   Writes the same mix of rows the engine logs (ints, short text and
+   snapshot sized blobs) into a fresh database per profile, committing
+   every 10000 rows like sql_log.c starts out, and prints the rate and file size.
+
+   Then does the same with the fast profile for each way of inserting the
+   rows: one statement per row with and without sqlite3_clear_bindings, and
+   the BENCH_BATCH rows per statement sql_log.c uses.
+
+     q3logbench [rows] [directory]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "../qcommon/q_shared.h"
+#include "../qcommon/qcommon.h"
+
+#define BENCH_TRANSACTION 10000
+#define BENCH_BLOB 512
+#define BENCH_BATCH 64		/* SQL_BATCH_ROWS */
+
+typedef enum {
+	BENCH_CLEAR,		/* reset, clear_bindings and bind every row */
+	BENCH_SINGLE,		/* reset and bind every row */
+	BENCH_MULTI,		/* BENCH_BATCH rows per statement */
+	BENCH_MODES
+} benchMode_t;
+
+static const char *bench_modes[BENCH_MODES] = { "clear", "single", "multi" };
+
+#define BENCH_INSERT "INSERT INTO q3log_data (tstamp, frame, svtime, client, caller, target, msgid, value) VALUES "
+#define BENCH_ROW "(?, ?, ?, ?, ?, ?, ?, ?)"
+
+static double
+bench_seconds(void)
+{
+#ifdef _WIN32
+	return GetTickCount() / 1000.0;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+/* Bind the 8 columns of a row starting at parameter index */
+static int
+bench_bind(sqlite3_stmt *stmt, int index, int row, const unsigned char *blob)
+{
+	char text[64];
+	int rc;
+
+	sqlite3_bind_int64(stmt, index, row * 1000LL);
+	sqlite3_bind_int(stmt, index + 1, row / 100);
+	sqlite3_bind_int(stmt, index + 2, row * 50);
+	sqlite3_bind_null(stmt, index + 3);
+	sqlite3_bind_int(stmt, index + 4, SQL_EP_QAGAME_QVM);
+	sqlite3_bind_int(stmt, index + 5, SQL_EP_SERVER);
+	sqlite3_bind_int(stmt, index + 6, SQL_GAME_TRAP(row % 64));
+
+	switch (row % 4) {
+	case 0:
+		rc = sqlite3_bind_blob(stmt, index + 7, blob, BENCH_BLOB, SQLITE_TRANSIENT);
+		break;
+	case 1:
+		sqlite3_snprintf(sizeof(text), text, "g_gametype %d sv_hostname bench", row);
+		rc = sqlite3_bind_text(stmt, index + 7, text, -1, SQLITE_TRANSIENT);
+		break;
+	default:
+		rc = sqlite3_bind_int(stmt, index + 7, row);
+		break;
+	}
+	return rc == SQLITE_OK;
+}
+
+static int
+bench_insert(sqlite3_stmt *stmt, benchMode_t mode, int row, const unsigned char *blob)
+{
+	sqlite3_reset(stmt);
+	if (mode == BENCH_CLEAR) {
+		sqlite3_clear_bindings(stmt);
+	}
+	return bench_bind(stmt, 1, row, blob) && sqlite3_step(stmt) == SQLITE_DONE;
+}
+
+/* Rows first to first + BENCH_BATCH - 1 in one statement */
+static int
+bench_insert_multi(sqlite3_stmt *stmt, int first, const unsigned char *blob)
+{
+	int i;
+
+	sqlite3_reset(stmt);
+	for (i = 0; i < BENCH_BATCH; i++) {
+		if (! bench_bind(stmt, i * 8 + 1, first + i, blob)) {
+			return 0;
+		}
+	}
+	return sqlite3_step(stmt) == SQLITE_DONE;
+}
+
+/* Returns the seconds the inserts took, or -1 */
+static double
+bench_profile(const sql_profile_t *profile, benchMode_t mode, const char *filename, int rows, char *report, int size)
+{
+	unsigned char blob[BENCH_BLOB];
+	char multi[BENCH_BATCH * 32 + 128];
+	sqlite3_stmt *stmt, *batch = NULL;
+	sqlite3 *db;
+	double start, elapsed;
+	int i, ok = 1;
+
+	for (i = 0; i < BENCH_BLOB; i++) {
+		blob[i] = i * 7;
+	}
+	sqlite3_snprintf(sizeof(multi), multi, "%s", BENCH_INSERT BENCH_ROW);
+	for (i = 1; i < BENCH_BATCH; i++) {
+		int len = strlen(multi);
+
+		sqlite3_snprintf(sizeof(multi) - len, multi + len, ", " BENCH_ROW);
+	}
+
+	remove(filename);
+	if (sqlite3_open(filename, &db) != SQLITE_OK ||
+	    ! sql_profile_apply(db, profile) ||
+	    ! sql_create_schema(db) ||
+	    sqlite3_prepare_v2(db, BENCH_INSERT BENCH_ROW, -1, &stmt, NULL) != SQLITE_OK ||
+	    (mode == BENCH_MULTI && sqlite3_prepare_v2(db, multi, -1, &batch, NULL) != SQLITE_OK)) {
+		fprintf(stderr, "Failed to set up %s: %s\n", filename, sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return -1;
+	}
+	sql_profile_report(db, profile, report, size);
+
+	start = bench_seconds();
+	sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+	for (i = 0; i < rows && ok; ) {
+		if (mode == BENCH_MULTI && rows - i >= BENCH_BATCH &&
+		    (i % BENCH_TRANSACTION) + BENCH_BATCH <= BENCH_TRANSACTION) {
+			ok = bench_insert_multi(batch, i, blob);
+			i += BENCH_BATCH;
+		} else {
+			ok = bench_insert(stmt, mode, i, blob);
+			i++;
+		}
+		if (i % BENCH_TRANSACTION == 0) {
+			sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
+			blob[i % BENCH_BLOB]++;
+			sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+		}
+	}
+	sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
+	sqlite3_finalize(batch);
+	sqlite3_finalize(stmt);
+	sqlite3_close(db);
+	elapsed = bench_seconds() - start;
+
+	if (! ok) {
+		fprintf(stderr, "Insert %d failed\n", i);
+		return -1;
+	}
+	return elapsed;
+}
+
+static long
+bench_file_size(const char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+	long size = -1;
+
+	if (f != NULL) {
+		fseek(f, 0, SEEK_END);
+		size = ftell(f);
+		fclose(f);
+	}
+	return size;
+}
+
+int
+main(int argc, char **argv)
+{
+	const sql_profile_t *profile;
+	char filename[1024], report[256];
+	const char *dir = argc > 2 ? argv[2] : ".";
+	int rows = argc > 1 ? atoi(argv[1]) : 200000;
+	double seconds;
+	int n;
+
+	if (rows <= 0) {
+		fprintf(stderr, "usage: %s [rows] [directory]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	printf("%d rows, a transaction every %d\n\n", rows, BENCH_TRANSACTION);
+	printf("%-8s %10s %12s %10s\n", "profile", "seconds", "rows/s", "MB");
+	for (n = 0; (profile = sql_profile_get(n)) != NULL; n++) {
+		sqlite3_snprintf(sizeof(filename), filename, "%s/q3logbench_%s.db", dir, profile->name);
+		if ((seconds = bench_profile(profile, BENCH_MULTI, filename, rows, report, sizeof(report))) < 0) {
+			return EXIT_FAILURE;
+		}
+		printf("%-8s %10.2f %12.0f %10.1f\n", profile->name, seconds,
+		    seconds > 0 ? rows / seconds : 0, bench_file_size(filename) / (1024.0 * 1024.0));
+		printf("         %s\n", report);
+		remove(filename);
+	}
+
+	printf("\n%-8s %10s %12s\n", "insert", "seconds", "rows/s");
+	profile = sql_profile_find("fast");
+	for (n = 0; n < BENCH_MODES; n++) {
+		sqlite3_snprintf(sizeof(filename), filename, "%s/q3logbench_%s.db", dir, bench_modes[n]);
+		if ((seconds = bench_profile(profile, n, filename, rows, report, sizeof(report))) < 0) {
+			return EXIT_FAILURE;
+		}
+		printf("%-8s %10.2f %12.0f\n", bench_modes[n], seconds, seconds > 0 ? rows / seconds : 0);
+		remove(filename);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+/* q3trace2sqlite: bulk-load a q3trace file into a q3log database.
+
+   The engine writes q3trace files instead of a database with sql_trace 1
+   (see ../qcommon/sql_trace.h).  This replays the records into the same
+   schema sql_init creates, inside one transaction, so the result can be
+   queried like any other log.
+
+     q3trace2sqlite server_qvm_log.q3trace server_qvm_log.db
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../qcommon/q_shared.h"
+#include "../qcommon/qcommon.h"
+#include "../qcommon/sql_trace.h"
+
+/* Refuse records bigger than this, it's a corrupt file */
+#define TRACE_MAX_PAYLOAD (256 * 1024 * 1024)
+
+static int
+trace_bind_value(sqlite3_stmt *stmt, int index, const sqlTraceRecord_t *rec, const unsigned char *payload)
+{
+	int i;
+	double d;
+
+	switch (rec->type) {
+	case SQL_TRACE_NULL:
+		return sqlite3_bind_null(stmt, index);
+	case SQL_TRACE_INT:
+		if (rec->size != sizeof(i)) {
+			return SQLITE_MISMATCH;
+		}
+		memcpy(&i, payload, sizeof(i));
+		return sqlite3_bind_int(stmt, index, i);
+	case SQL_TRACE_DOUBLE:
+		if (rec->size != sizeof(d)) {
+			return SQLITE_MISMATCH;
+		}
+		memcpy(&d, payload, sizeof(d));
+		return sqlite3_bind_double(stmt, index, d);
+	case SQL_TRACE_TEXT:
+		return sqlite3_bind_text(stmt, index, (const char *)payload, rec->size, SQLITE_STATIC);
+	case SQL_TRACE_BLOB:
+		return sqlite3_bind_blob(stmt, index, payload, rec->size, SQLITE_STATIC);
+	default:
+		return SQLITE_MISMATCH;
+	}
+}
+
+static long
+trace_import(FILE *in, sqlite3 *db)
+{
+	sqlite3_stmt *stmt;
+	sqlTraceRecord_t rec;
+	unsigned char *payload = NULL;
+	int payloadSize = 0;
+	long count = 0;
+
+	if (sqlite3_prepare_v2(db,
+	    "INSERT INTO q3log_data (tstamp, frame, svtime, client, caller, target, msgid, value) "
+	    "VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+	    -1, &stmt, NULL) != SQLITE_OK) {
+		fprintf(stderr, "Failed to prepare the insert: %s\n", sqlite3_errmsg(db));
+		return -1;
+	}
+
+	while (fread(&rec, sizeof(rec), 1, in) == 1) {
+		if (rec.size < 0 || rec.size > TRACE_MAX_PAYLOAD) {
+			fprintf(stderr, "Corrupt record %ld, stopping\n", count);
+			break;
+		}
+		if (rec.size > payloadSize) {
+			unsigned char *grown = realloc(payload, rec.size);
+			if (grown == NULL) {
+				fprintf(stderr, "Out of memory at record %ld\n", count);
+				count = -1;
+				break;
+			}
+			payload = grown;
+			payloadSize = rec.size;
+		}
+		if (rec.size > 0 && fread(payload, 1, rec.size, in) != rec.size) {
+			fprintf(stderr, "Trace is cut short after %ld records\n", count);
+			break;
+		}
+
+		if (sqlite3_reset(stmt) != SQLITE_OK ||
+		    sqlite3_bind_int64(stmt, 1, rec.time) != SQLITE_OK ||
+		    sqlite3_bind_int(stmt, 2, rec.frame) != SQLITE_OK ||
+		    (rec.serverTime == SQL_TRACE_UNSET ? sqlite3_bind_null(stmt, 3) :
+		    sqlite3_bind_int(stmt, 3, rec.serverTime)) != SQLITE_OK ||
+		    (rec.client < 0 ? sqlite3_bind_null(stmt, 4) :
+		    sqlite3_bind_int(stmt, 4, rec.client)) != SQLITE_OK ||
+		    sqlite3_bind_int(stmt, 5, rec.caller) != SQLITE_OK ||
+		    sqlite3_bind_int(stmt, 6, rec.target) != SQLITE_OK ||
+		    sqlite3_bind_int(stmt, 7, rec.msgID) != SQLITE_OK ||
+		    trace_bind_value(stmt, 8, &rec, payload) != SQLITE_OK ||
+		    sqlite3_step(stmt) != SQLITE_DONE) {
+			fprintf(stderr, "Failed to insert record %ld: %s\n", count, sqlite3_errmsg(db));
+			count = -1;
+			break;
+		}
+		count++;
+	}
+
+	sqlite3_finalize(stmt);
+	free(payload);
+	return count;
+}
+
+int
+main(int argc, char **argv)
+{
+	sqlTraceHeader_t header;
+	sqlite3 *db;
+	FILE *in;
+	long count;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <trace.q3trace> <log.db>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if ((in = fopen(argv[1], "rb")) == NULL) {
+		fprintf(stderr, "Can't open %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	if (fread(&header, sizeof(header), 1, in) != 1 ||
+	    memcmp(header.magic, SQL_TRACE_MAGIC, sizeof(SQL_TRACE_MAGIC)) != 0) {
+		fprintf(stderr, "%s is not a q3trace file\n", argv[1]);
+		fclose(in);
+		return EXIT_FAILURE;
+	}
+	if (header.byteOrder != SQL_TRACE_BYTE_ORDER || header.version != SQL_TRACE_VERSION) {
+		fprintf(stderr, "%s was written by a different build or machine\n", argv[1]);
+		fclose(in);
+		return EXIT_FAILURE;
+	}
+
+	if (sqlite3_open(argv[2], &db) != SQLITE_OK) {
+		fprintf(stderr, "Can't open %s: %s\n", argv[2], sqlite3_errmsg(db));
+		fclose(in);
+		return EXIT_FAILURE;
+	}
+
+	/* Nothing to lose if the import dies, it can just be run again */
+	if (! sql_profile_apply(db, sql_profile_find("bulk")) ||
+	    ! sql_create_schema(db) ||
+	    sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL) != SQLITE_OK ||
+	    ! sql_add_session(db, header.startTime, header.startClock)) {
+		fprintf(stderr, "Failed to set up %s: %s\n", argv[2], sqlite3_errmsg(db));
+		sqlite3_close(db);
+		fclose(in);
+		return EXIT_FAILURE;
+	}
+
+	count = trace_import(in, db);
+	fclose(in);
+
+	if (count < 0) {
+		sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+		sqlite3_close(db);
+		return EXIT_FAILURE;
+	}
+	if (sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL) != SQLITE_OK) {
+		fprintf(stderr, "Failed to commit: %s\n", sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return EXIT_FAILURE;
+	}
+
+	sqlite3_close(db);
+	printf("Imported %ld records into %s\n", count, argv[2]);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,30 @@
+/* Entry point for the bundled sqlite3 shell.
+
+   shell.c is the stock SQLite3 shell built with main renamed to
+   sqlite3_shell_main.  This registers the q3log SQL functions from
+   sql_delta.c and sql_compress.c and the virtual tables from sqllog_vtab.c
+   on every connection it opens before handing over to it.
+*/
+
+#include "../sqlite3/sqlite3.h"
+
+int sqlite3_shell_main(int argc, char **argv);
+int sql_register_functions(sqlite3 *db);
+int sql_register_compress(sqlite3 *db);
+int sqllog_register_vtabs(sqlite3 *db);
+
+static int
+sqllog_init(sqlite3 *db, char **err, const void *api)
+{
+	if (sql_register_functions(db) != SQLITE_OK || sql_register_compress(db) != SQLITE_OK) {
+		return SQLITE_ERROR;
+	}
+	return sqllog_register_vtabs(db);
+}
+
+int
+main(int argc, char **argv)
+{
+	sqlite3_auto_extension((void (*)(void))sqllog_init);
+	return sqlite3_shell_main(argc, argv);
+}
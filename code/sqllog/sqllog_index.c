@@ -0,0 +1,106 @@
+/* sqllog_index: get a finished q3log database ready for queries.
+
+   The engine only writes q3log_data with its rowid, since every index would
+   slow the inserts down.  This adds the indexes from sql_create_indexes and
+   brings the summary table (rows per msgid per second) up to date, so the
+   usual GROUP BY msgid and time range queries don't scan the whole log.
+
+   Running it again only counts the rows added since.  -s only updates the
+   summary, for a log the engine is still writing to, since the engine would
+   have to keep the indexes up to date too.
+
+     sqllog_index [-s] server_qvm_log.db server_qvm_log.0001.db ...
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "../qcommon/q_shared.h"
+#include "../qcommon/qcommon.h"
+
+/* How long to wait for the engine's transaction on a live log */
+#define INDEX_BUSY_MS 10000
+
+static double
+index_seconds(void)
+{
+#ifdef _WIN32
+	return GetTickCount() / 1000.0;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+static int
+index_log(const char *filename, int summaryOnly)
+{
+	double start = index_seconds();
+	long long rows;
+	sqlite3 *db;
+
+	/* Don't make an empty database out of a typo */
+	if (sqlite3_open_v2(filename, &db, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK) {
+		fprintf(stderr, "Can't open %s: %s\n", filename, sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 0;
+	}
+	sqlite3_busy_timeout(db, INDEX_BUSY_MS);
+	sqlite3_exec(db, "PRAGMA cache_size = -65536; PRAGMA temp_store = 2", NULL, NULL, NULL);
+
+	/* sql_create_schema also brings an old layout up to date */
+	if (! sql_create_schema(db) ||
+	    sqlite3_exec(db, "BEGIN IMMEDIATE TRANSACTION", NULL, NULL, NULL) != SQLITE_OK) {
+		fprintf(stderr, "Failed to set up %s: %s\n", filename, sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 0;
+	}
+
+	if ((rows = sql_update_summary(db)) < 0 ||
+	    (! summaryOnly && ! sql_create_indexes(db))) {
+		fprintf(stderr, "Failed to index %s: %s\n", filename, sqlite3_errmsg(db));
+		sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+		sqlite3_close(db);
+		return 0;
+	}
+	if (sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL) != SQLITE_OK) {
+		fprintf(stderr, "Failed to commit %s: %s\n", filename, sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 0;
+	}
+	sqlite3_close(db);
+
+	printf("%s: %lld new rows summarized%s in %.2f s\n", filename, rows,
+	    summaryOnly ? "" : ", indexed", index_seconds() - start);
+	return 1;
+}
+
+int
+main(int argc, char **argv)
+{
+	int i, first = 1, summaryOnly = 0, failed = 0;
+
+	if (argc > 1 && ! strcmp(argv[1], "-s")) {
+		summaryOnly = 1;
+		first++;
+	}
+	if (first >= argc) {
+		fprintf(stderr, "usage: %s [-s] <log.db>...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (i = first; i < argc; i++) {
+		if (! index_log(argv[i], summaryOnly)) {
+			failed++;
+		}
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+/* sqllog_test: checks sql_create_schema brings every older database
+   layout up to date.
+
+   Each case makes an in-memory database the way an older build left it,
+   opens it the way the engine does and checks q3log is the view over the
+   new tables and the old rows were kept under another name.
+
+     sqllog_test
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../qcommon/q_shared.h"
+#include "../qcommon/qcommon.h"
+
+typedef struct {
+	const char *name;
+	const char *setup;	/* the older build's layout and a row */
+	const char *kept;	/* where that row should be afterwards */
+} test_case_t;
+
+static const test_case_t test_cases[] = {
+	{ "new database", "", NULL },
+	{ "original q3log table",
+	    "CREATE TABLE q3log"
+	    "("
+	    "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
+	    "  tstamp TEXT DEFAULT (strftime('%Y-%m-%dT%H:%M:%f','now')),"
+	    "  caller TEXT NOT NULL,"
+	    "  target TEXT NOT NULL,"
+	    "  msgid  TEXT NOT NULL,"
+	    "  value  BLOB"
+	    ");"
+	    "INSERT INTO q3log (caller, target, msgid, value)"
+	    "  VALUES ('QAGAME_QVM', 'SERVER', 'G_MILLISECONDS', '1234');",
+	    "q3log_v0" },
+	{ "q3log_data with a TEXT tstamp",
+	    "CREATE TABLE q3log_data"
+	    "("
+	    "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
+	    "  tstamp TEXT DEFAULT (strftime('%Y-%m-%dT%H:%M:%f','now')),"
+	    "  caller INTEGER NOT NULL,"
+	    "  target INTEGER NOT NULL,"
+	    "  msgid  INTEGER NOT NULL,"
+	    "  value  BLOB"
+	    ");"
+	    "INSERT INTO q3log_data (caller, target, msgid, value) VALUES (1, 2, 3, '1234');",
+	    "q3log_data_v0" },
+	{ "q3log_data without flags",
+	    "CREATE TABLE q3log_data"
+	    "("
+	    "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
+	    "  tstamp INTEGER NOT NULL,"
+	    "  frame  INTEGER,"
+	    "  svtime INTEGER,"
+	    "  client INTEGER,"
+	    "  caller INTEGER NOT NULL,"
+	    "  target INTEGER NOT NULL,"
+	    "  msgid  INTEGER NOT NULL,"
+	    "  value  BLOB"
+	    ");"
+	    "INSERT INTO q3log_data (tstamp, caller, target, msgid, value) VALUES (5, 2, 3, 4, '1234');"
+	    "PRAGMA user_version = 1;",
+	    "q3log_data" }
+};
+
+/* The single integer a query selects, or -1 */
+static int
+test_query_int(sqlite3 *db, const char *query)
+{
+	sqlite3_stmt *stmt;
+	int value = -1;
+
+	if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) != SQLITE_OK) {
+		return -1;
+	}
+	if (sqlite3_step(stmt) == SQLITE_ROW) {
+		value = sqlite3_column_int(stmt, 0);
+	}
+	sqlite3_finalize(stmt);
+	return value;
+}
+
+static int
+test_check(const test_case_t *test, int ok, const char *what)
+{
+	if (! ok) {
+		fprintf(stderr, "%s: %s\n", test->name, what);
+	}
+	return ok;
+}
+
+static int
+test_upgrade(const test_case_t *test)
+{
+	char query[256];
+	sqlite3 *db;
+	int ok = 1;
+
+	if (sqlite3_open(":memory:", &db) != SQLITE_OK ||
+	    sqlite3_exec(db, test->setup, NULL, NULL, NULL) != SQLITE_OK) {
+		fprintf(stderr, "%s: can't set up: %s\n", test->name, sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 0;
+	}
+
+	/* Twice, since every open after the first has to leave it alone */
+	ok &= test_check(test, sql_create_schema(db), "sql_create_schema failed");
+	ok &= test_check(test, sql_create_schema(db), "sql_create_schema failed the second time");
+
+	ok &= test_check(test, test_query_int(db,
+	    "SELECT COUNT(*) FROM sqlite_master WHERE type = 'view' AND name = 'q3log'") == 1,
+	    "q3log isn't a view");
+	ok &= test_check(test, test_query_int(db,
+	    "SELECT COUNT(*) FROM msgtype WHERE name = 'G_MILLISECONDS'") == 1,
+	    "the dictionaries weren't filled");
+	ok &= test_check(test, test_query_int(db, "PRAGMA user_version") == 2,
+	    "user_version wasn't updated");
+
+	/* The view works over the new table */
+	ok &= test_check(test, sqlite3_exec(db,
+	    "INSERT INTO q3log_data (tstamp, caller, target, msgid) VALUES (1, 0, 0, 0)",
+	    NULL, NULL, NULL) == SQLITE_OK, "can't insert a row");
+	ok &= test_check(test, test_query_int(db,
+	    "SELECT COUNT(*) FROM q3log WHERE tstamp = 1") == 1, "the view doesn't show the new row");
+
+	if (test->kept != NULL) {
+		sqlite3_snprintf(sizeof(query), query, "SELECT COUNT(*) FROM %s WHERE value = '1234'", test->kept);
+		ok &= test_check(test, test_query_int(db, query) == 1, "the old row wasn't kept");
+	}
+
+	sqlite3_close(db);
+	printf("%s: %s\n", test->name, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+	int i, failed = 0;
+
+	for (i = 0; i < ARRAY_LEN(test_cases); i++) {
+		if (! test_upgrade(&test_cases[i])) {
+			failed++;
+		}
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,986 @@
+/* Virtual tables that decode the snapshot and gamestate rows of a q3log
+   database, for the bundled sqlite3 shell.
+
+   Those rows hold clSnapshot_t, snapshot_t and gameState_t as the engine
+   had them in memory, delta coded when they come from the netchan log
+   (see sql_delta.c).  These tables read them back as columns:
+
+     q3_snapshot         one row per snapshot and CG_GETSNAPSHOT row
+     q3_snapshot_entity  one row per entity of a CG_GETSNAPSHOT row
+     q3_configstring     one row per config string of a gamestate and
+                         CG_GETGAMESTATE row
+
+   The scan only reads id, tstamp and msgid from q3log_data.  A value is
+   read with incremental blob I/O the first time one of its columns is
+   asked for, so rows a query throws away on id or tstamp never have their
+   blob read.  A delta is applied on top of the structure the cursor
+   decoded last, or replayed from the keyframe before it when the query
+   skipped rows.  Compressed values (see sql_compress.c) are uncompressed
+   as they're read.
+
+   A value that isn't the size of the structure in this build (a log from
+   another version) decodes to NULL columns.
+
+     CREATE VIRTUAL TABLE temp.snap USING q3_snapshot;
+     CREATE VIRTUAL TABLE temp.netsnap USING q3_snapshot(netlog);
+
+   The argument is the attached database to read, main by default.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../client/client.h"
+
+/* Rowid of a sub row: the log row id with the entity or config string
+   number in the low bits */
+#define SQLLOG_ITEM_BITS	10
+
+#define SQLLOG_SOURCES		2
+
+/* The leading columns every table has, straight from q3log_data */
+enum {
+	SQLLOG_COL_ID,
+	SQLLOG_COL_TSTAMP,
+	SQLLOG_COL_MSGID,
+	SQLLOG_COL_MAX
+};
+
+typedef enum {
+	SQLLOG_CLSNAPSHOT,	/* clSnapshot_t */
+	SQLLOG_SNAPSHOT,	/* snapshot_t */
+	SQLLOG_GAMESTATE	/* gameState_t */
+} sqllog_struct_t;
+
+typedef struct {
+	int		msgid;		/* 0 for an unused slot */
+	sqllog_struct_t	type;
+	int		size;
+	int		delta;		/* delta coded, see sql_delta.c */
+} sqllog_source_t;
+
+typedef struct {
+	const char	*module;
+	const char	**columns;	/* after id, tstamp and msgid */
+	int		numColumns;
+	sqllog_source_t	sources[SQLLOG_SOURCES];
+	/* The first sub row at or after item, or -1.  NULL when every log
+	   row is one table row */
+	int		(*next)(const void *data, sqllog_struct_t type, int item);
+	void		(*column)(sqlite3_context *ctx, const void *data, sqllog_struct_t type, int item, int column);
+} sqllog_table_t;
+
+typedef struct {
+	sqlite3_vtab		base;
+	sqlite3			*db;
+	char			*schema;	/* the database holding q3log_data */
+	const char		*flags;		/* "NULL" for a log from before the column */
+	const sqllog_table_t	*table;
+} sqllog_vtab_t;
+
+typedef struct {
+	sqlite3_vtab_cursor	base;
+	sqlite3_stmt		*rows;		/* id, tstamp, msgid, flags in id order */
+	sqlite3_blob		*blob;
+	int			eof;
+	sqlite3_int64		id;
+	int			source;
+	int			item;
+	/* The decoded structure of each source, the row it was decoded
+	   from and the row of that source the scan passed before this one */
+	unsigned char		*data[SQLLOG_SOURCES];
+	sqlite3_int64		dataId[SQLLOG_SOURCES];
+	sqlite3_int64		prevId[SQLLOG_SOURCES];
+	unsigned char		*scratch;	/* a keyframe or delta, 1 + the largest size */
+	int			scratchSize;
+	unsigned char		*packed;	/* a compressed value */
+	int			packedSize;
+} sqllog_cursor_t;
+
+/*
+ * q3_snapshot
+ */
+
+typedef enum {
+	SNAP_SERVERTIME,
+	SNAP_SNAPFLAGS,
+	SNAP_PING,
+	SNAP_MESSAGENUM,
+	SNAP_DELTANUM,
+	SNAP_CMDNUM,
+	SNAP_SERVERCOMMANDNUM,
+	SNAP_NUMENTITIES,
+	SNAP_AREAMASK,
+	SNAP_PS_COMMANDTIME,
+	SNAP_PS_PM_TYPE,
+	SNAP_PS_PM_FLAGS,
+	SNAP_PS_CLIENTNUM,
+	SNAP_PS_ORIGIN_X,
+	SNAP_PS_ORIGIN_Y,
+	SNAP_PS_ORIGIN_Z,
+	SNAP_PS_VELOCITY_X,
+	SNAP_PS_VELOCITY_Y,
+	SNAP_PS_VELOCITY_Z,
+	SNAP_PS_VIEWANGLES_X,
+	SNAP_PS_VIEWANGLES_Y,
+	SNAP_PS_VIEWANGLES_Z,
+	SNAP_PS_VIEWHEIGHT,
+	SNAP_PS_GROUNDENTITYNUM,
+	SNAP_PS_EFLAGS,
+	SNAP_PS_WEAPON,
+	SNAP_PS_WEAPONSTATE,
+	SNAP_PS_HEALTH,
+	SNAP_PS,
+	SNAP_MAX
+} sqllog_snapshotColumn_t;
+
+static const char *sqllog_snapshotColumns[SNAP_MAX] = {
+	[SNAP_SERVERTIME] = "serverTime INTEGER",
+	[SNAP_SNAPFLAGS] = "snapFlags INTEGER",
+	[SNAP_PING] = "ping INTEGER",
+	[SNAP_MESSAGENUM] = "messageNum INTEGER",	/* netchan only */
+	[SNAP_DELTANUM] = "deltaNum INTEGER",		/* netchan only */
+	[SNAP_CMDNUM] = "cmdNum INTEGER",		/* netchan only */
+	[SNAP_SERVERCOMMANDNUM] = "serverCommandNum INTEGER",
+	[SNAP_NUMENTITIES] = "numEntities INTEGER",
+	[SNAP_AREAMASK] = "areamask BLOB",
+	[SNAP_PS_COMMANDTIME] = "ps_commandTime INTEGER",
+	[SNAP_PS_PM_TYPE] = "ps_pm_type INTEGER",
+	[SNAP_PS_PM_FLAGS] = "ps_pm_flags INTEGER",
+	[SNAP_PS_CLIENTNUM] = "ps_clientNum INTEGER",
+	[SNAP_PS_ORIGIN_X] = "ps_origin_x REAL",
+	[SNAP_PS_ORIGIN_Y] = "ps_origin_y REAL",
+	[SNAP_PS_ORIGIN_Z] = "ps_origin_z REAL",
+	[SNAP_PS_VELOCITY_X] = "ps_velocity_x REAL",
+	[SNAP_PS_VELOCITY_Y] = "ps_velocity_y REAL",
+	[SNAP_PS_VELOCITY_Z] = "ps_velocity_z REAL",
+	[SNAP_PS_VIEWANGLES_X] = "ps_viewangles_x REAL",
+	[SNAP_PS_VIEWANGLES_Y] = "ps_viewangles_y REAL",
+	[SNAP_PS_VIEWANGLES_Z] = "ps_viewangles_z REAL",
+	[SNAP_PS_VIEWHEIGHT] = "ps_viewheight INTEGER",
+	[SNAP_PS_GROUNDENTITYNUM] = "ps_groundEntityNum INTEGER",
+	[SNAP_PS_EFLAGS] = "ps_eFlags INTEGER",
+	[SNAP_PS_WEAPON] = "ps_weapon INTEGER",
+	[SNAP_PS_WEAPONSTATE] = "ps_weaponstate INTEGER",
+	[SNAP_PS_HEALTH] = "ps_health INTEGER",
+	[SNAP_PS] = "ps BLOB"			/* the whole playerState_t */
+};
+
+static void
+sqllog_snapshot_column(sqlite3_context *ctx, const void *data, sqllog_struct_t type, int item, int column)
+{
+	const clSnapshot_t *net = data;
+	const snapshot_t *snap = data;
+	const playerState_t *ps = type == SQLLOG_CLSNAPSHOT ? &net->ps : &snap->ps;
+
+	switch (column) {
+	case SNAP_SERVERTIME:
+		sqlite3_result_int(ctx, type == SQLLOG_CLSNAPSHOT ? net->serverTime : snap->serverTime);
+		break;
+	case SNAP_SNAPFLAGS:
+		sqlite3_result_int(ctx, type == SQLLOG_CLSNAPSHOT ? net->snapFlags : snap->snapFlags);
+		break;
+	case SNAP_PING:
+		sqlite3_result_int(ctx, type == SQLLOG_CLSNAPSHOT ? net->ping : snap->ping);
+		break;
+	case SNAP_MESSAGENUM:
+		if (type == SQLLOG_CLSNAPSHOT) {
+			sqlite3_result_int(ctx, net->messageNum);
+		}
+		break;
+	case SNAP_DELTANUM:
+		if (type == SQLLOG_CLSNAPSHOT) {
+			sqlite3_result_int(ctx, net->deltaNum);
+		}
+		break;
+	case SNAP_CMDNUM:
+		if (type == SQLLOG_CLSNAPSHOT) {
+			sqlite3_result_int(ctx, net->cmdNum);
+		}
+		break;
+	case SNAP_SERVERCOMMANDNUM:
+		sqlite3_result_int(ctx, type == SQLLOG_CLSNAPSHOT ? net->serverCommandNum : snap->serverCommandSequence);
+		break;
+	case SNAP_NUMENTITIES:
+		sqlite3_result_int(ctx, type == SQLLOG_CLSNAPSHOT ? net->numEntities : snap->numEntities);
+		break;
+	case SNAP_AREAMASK:
+		sqlite3_result_blob(ctx, type == SQLLOG_CLSNAPSHOT ? net->areamask : snap->areamask,
+		    MAX_MAP_AREA_BYTES, SQLITE_TRANSIENT);
+		break;
+	case SNAP_PS_COMMANDTIME:
+		sqlite3_result_int(ctx, ps->commandTime);
+		break;
+	case SNAP_PS_PM_TYPE:
+		sqlite3_result_int(ctx, ps->pm_type);
+		break;
+	case SNAP_PS_PM_FLAGS:
+		sqlite3_result_int(ctx, ps->pm_flags);
+		break;
+	case SNAP_PS_CLIENTNUM:
+		sqlite3_result_int(ctx, ps->clientNum);
+		break;
+	case SNAP_PS_ORIGIN_X:
+	case SNAP_PS_ORIGIN_Y:
+	case SNAP_PS_ORIGIN_Z:
+		sqlite3_result_double(ctx, ps->origin[column - SNAP_PS_ORIGIN_X]);
+		break;
+	case SNAP_PS_VELOCITY_X:
+	case SNAP_PS_VELOCITY_Y:
+	case SNAP_PS_VELOCITY_Z:
+		sqlite3_result_double(ctx, ps->velocity[column - SNAP_PS_VELOCITY_X]);
+		break;
+	case SNAP_PS_VIEWANGLES_X:
+	case SNAP_PS_VIEWANGLES_Y:
+	case SNAP_PS_VIEWANGLES_Z:
+		sqlite3_result_double(ctx, ps->viewangles[column - SNAP_PS_VIEWANGLES_X]);
+		break;
+	case SNAP_PS_VIEWHEIGHT:
+		sqlite3_result_int(ctx, ps->viewheight);
+		break;
+	case SNAP_PS_GROUNDENTITYNUM:
+		sqlite3_result_int(ctx, ps->groundEntityNum);
+		break;
+	case SNAP_PS_EFLAGS:
+		sqlite3_result_int(ctx, ps->eFlags);
+		break;
+	case SNAP_PS_WEAPON:
+		sqlite3_result_int(ctx, ps->weapon);
+		break;
+	case SNAP_PS_WEAPONSTATE:
+		sqlite3_result_int(ctx, ps->weaponstate);
+		break;
+	case SNAP_PS_HEALTH:
+		sqlite3_result_int(ctx, ps->stats[STAT_HEALTH]);
+		break;
+	case SNAP_PS:
+		sqlite3_result_blob(ctx, ps, sizeof(*ps), SQLITE_TRANSIENT);
+		break;
+	}
+}
+
+/*
+ * q3_snapshot_entity
+ */
+
+typedef enum {
+	ENT_SERVERTIME,
+	ENT_IDX,
+	ENT_NUMBER,
+	ENT_ETYPE,
+	ENT_EFLAGS,
+	ENT_TRTYPE,
+	ENT_ORIGIN_X,
+	ENT_ORIGIN_Y,
+	ENT_ORIGIN_Z,
+	ENT_ANGLES_X,
+	ENT_ANGLES_Y,
+	ENT_ANGLES_Z,
+	ENT_MODELINDEX,
+	ENT_CLIENTNUM,
+	ENT_FRAME,
+	ENT_SOLID,
+	ENT_EVENT,
+	ENT_EVENTPARM,
+	ENT_GROUNDENTITYNUM,
+	ENT_OTHERENTITYNUM,
+	ENT_POWERUPS,
+	ENT_WEAPON,
+	ENT_LEGSANIM,
+	ENT_TORSOANIM,
+	ENT_STATE,
+	ENT_MAX
+} sqllog_entityColumn_t;
+
+static const char *sqllog_entityColumns[ENT_MAX] = {
+	[ENT_SERVERTIME] = "serverTime INTEGER",	/* of the snapshot */
+	[ENT_IDX] = "idx INTEGER",			/* position in the snapshot */
+	[ENT_NUMBER] = "number INTEGER",
+	[ENT_ETYPE] = "eType INTEGER",
+	[ENT_EFLAGS] = "eFlags INTEGER",
+	[ENT_TRTYPE] = "trType INTEGER",
+	[ENT_ORIGIN_X] = "origin_x REAL",		/* pos.trBase */
+	[ENT_ORIGIN_Y] = "origin_y REAL",
+	[ENT_ORIGIN_Z] = "origin_z REAL",
+	[ENT_ANGLES_X] = "angles_x REAL",		/* apos.trBase */
+	[ENT_ANGLES_Y] = "angles_y REAL",
+	[ENT_ANGLES_Z] = "angles_z REAL",
+	[ENT_MODELINDEX] = "modelindex INTEGER",
+	[ENT_CLIENTNUM] = "clientNum INTEGER",
+	[ENT_FRAME] = "frame INTEGER",
+	[ENT_SOLID] = "solid INTEGER",
+	[ENT_EVENT] = "event INTEGER",
+	[ENT_EVENTPARM] = "eventParm INTEGER",
+	[ENT_GROUNDENTITYNUM] = "groundEntityNum INTEGER",
+	[ENT_OTHERENTITYNUM] = "otherEntityNum INTEGER",
+	[ENT_POWERUPS] = "powerups INTEGER",
+	[ENT_WEAPON] = "weapon INTEGER",
+	[ENT_LEGSANIM] = "legsAnim INTEGER",
+	[ENT_TORSOANIM] = "torsoAnim INTEGER",
+	[ENT_STATE] = "state BLOB"			/* the whole entityState_t */
+};
+
+static int
+sqllog_entity_next(const void *data, sqllog_struct_t type, int item)
+{
+	const snapshot_t *snap = data;
+
+	return item < snap->numEntities && item < MAX_ENTITIES_IN_SNAPSHOT ? item : -1;
+}
+
+static void
+sqllog_entity_column(sqlite3_context *ctx, const void *data, sqllog_struct_t type, int item, int column)
+{
+	const snapshot_t *snap = data;
+	const entityState_t *es = &snap->entities[item];
+
+	switch (column) {
+	case ENT_SERVERTIME:
+		sqlite3_result_int(ctx, snap->serverTime);
+		break;
+	case ENT_IDX:
+		sqlite3_result_int(ctx, item);
+		break;
+	case ENT_NUMBER:
+		sqlite3_result_int(ctx, es->number);
+		break;
+	case ENT_ETYPE:
+		sqlite3_result_int(ctx, es->eType);
+		break;
+	case ENT_EFLAGS:
+		sqlite3_result_int(ctx, es->eFlags);
+		break;
+	case ENT_TRTYPE:
+		sqlite3_result_int(ctx, es->pos.trType);
+		break;
+	case ENT_ORIGIN_X:
+	case ENT_ORIGIN_Y:
+	case ENT_ORIGIN_Z:
+		sqlite3_result_double(ctx, es->pos.trBase[column - ENT_ORIGIN_X]);
+		break;
+	case ENT_ANGLES_X:
+	case ENT_ANGLES_Y:
+	case ENT_ANGLES_Z:
+		sqlite3_result_double(ctx, es->apos.trBase[column - ENT_ANGLES_X]);
+		break;
+	case ENT_MODELINDEX:
+		sqlite3_result_int(ctx, es->modelindex);
+		break;
+	case ENT_CLIENTNUM:
+		sqlite3_result_int(ctx, es->clientNum);
+		break;
+	case ENT_FRAME:
+		sqlite3_result_int(ctx, es->frame);
+		break;
+	case ENT_SOLID:
+		sqlite3_result_int(ctx, es->solid);
+		break;
+	case ENT_EVENT:
+		sqlite3_result_int(ctx, es->event);
+		break;
+	case ENT_EVENTPARM:
+		sqlite3_result_int(ctx, es->eventParm);
+		break;
+	case ENT_GROUNDENTITYNUM:
+		sqlite3_result_int(ctx, es->groundEntityNum);
+		break;
+	case ENT_OTHERENTITYNUM:
+		sqlite3_result_int(ctx, es->otherEntityNum);
+		break;
+	case ENT_POWERUPS:
+		sqlite3_result_int(ctx, es->powerups);
+		break;
+	case ENT_WEAPON:
+		sqlite3_result_int(ctx, es->weapon);
+		break;
+	case ENT_LEGSANIM:
+		sqlite3_result_int(ctx, es->legsAnim);
+		break;
+	case ENT_TORSOANIM:
+		sqlite3_result_int(ctx, es->torsoAnim);
+		break;
+	case ENT_STATE:
+		sqlite3_result_blob(ctx, es, sizeof(*es), SQLITE_TRANSIENT);
+		break;
+	}
+}
+
+/*
+ * q3_configstring
+ */
+
+typedef enum {
+	CS_COL_IDX,
+	CS_COL_STRING,
+	CS_COL_MAX
+} sqllog_configstringColumn_t;
+
+static const char *sqllog_configstringColumns[CS_COL_MAX] = {
+	[CS_COL_IDX] = "idx INTEGER",		/* the CS_ number */
+	[CS_COL_STRING] = "string TEXT"
+};
+
+/* Offset 0 is the empty string every unset config string points at */
+static int
+sqllog_configstring_next(const void *data, sqllog_struct_t type, int item)
+{
+	const gameState_t *gs = data;
+
+	for (; item < MAX_CONFIGSTRINGS; item++) {
+		if (gs->stringOffsets[item] > 0 && gs->stringOffsets[item] < MAX_GAMESTATE_CHARS) {
+			return item;
+		}
+	}
+	return -1;
+}
+
+static void
+sqllog_configstring_column(sqlite3_context *ctx, const void *data, sqllog_struct_t type, int item, int column)
+{
+	const gameState_t *gs = data;
+	const char *s = gs->stringData + gs->stringOffsets[item];
+	const char *end;
+
+	switch (column) {
+	case CS_COL_IDX:
+		sqlite3_result_int(ctx, item);
+		break;
+	case CS_COL_STRING:
+		end = memchr(s, '\0', MAX_GAMESTATE_CHARS - gs->stringOffsets[item]);
+		sqlite3_result_text(ctx, s, end != NULL ? end - s : MAX_GAMESTATE_CHARS - gs->stringOffsets[item],
+		    SQLITE_TRANSIENT);
+		break;
+	}
+}
+
+static const sqllog_table_t sqllog_tables[] = {
+	{
+		"q3_snapshot", sqllog_snapshotColumns, SNAP_MAX,
+		{
+			{ SQL_ENGINE(SQL_MSG_SNAPSHOT), SQLLOG_CLSNAPSHOT, sizeof(clSnapshot_t), 1 },
+			{ SQL_CGAME_TRAP(CG_GETSNAPSHOT), SQLLOG_SNAPSHOT, sizeof(snapshot_t), 0 }
+		},
+		NULL, sqllog_snapshot_column
+	},
+	{
+		"q3_snapshot_entity", sqllog_entityColumns, ENT_MAX,
+		{
+			{ SQL_CGAME_TRAP(CG_GETSNAPSHOT), SQLLOG_SNAPSHOT, sizeof(snapshot_t), 0 }
+		},
+		sqllog_entity_next, sqllog_entity_column
+	},
+	{
+		"q3_configstring", sqllog_configstringColumns, CS_COL_MAX,
+		{
+			{ SQL_ENGINE(SQL_MSG_GAMESTATE), SQLLOG_GAMESTATE, sizeof(gameState_t), 1 },
+			{ SQL_CGAME_TRAP(CG_GETGAMESTATE), SQLLOG_GAMESTATE, sizeof(gameState_t), 0 }
+		},
+		sqllog_configstring_next, sqllog_configstring_column
+	}
+};
+
+/*
+ * Reading the values
+ */
+
+/* Point the cursor's blob handle at a row.  Returns its size or -1. */
+static int
+sqllog_blob(sqllog_cursor_t *cur, sqlite3_int64 id)
+{
+	sqllog_vtab_t *vtab = (sqllog_vtab_t *)cur->base.pVtab;
+
+	if (cur->blob != NULL && sqlite3_blob_reopen(cur->blob, id) != SQLITE_OK) {
+		/* A handle that failed to move is aborted */
+		sqlite3_blob_close(cur->blob);
+		cur->blob = NULL;
+		return -1;
+	}
+	if (cur->blob == NULL &&
+	    sqlite3_blob_open(vtab->db, vtab->schema, "q3log_data", "value", id, 0, &cur->blob) != SQLITE_OK) {
+		sqlite3_blob_close(cur->blob);
+		cur->blob = NULL;
+		return -1;
+	}
+	return sqlite3_blob_bytes(cur->blob);
+}
+
+/* Read a value into out, uncompressing it when flags say so.  Returns its
+   size, or -1 when it doesn't fit in outSize bytes. */
+static int
+sqllog_read(sqllog_cursor_t *cur, sqlite3_int64 id, int flags, void *out, int outSize)
+{
+	int len = sqllog_blob(cur, id);
+
+	if (len < 1) {
+		return -1;
+	}
+	if (! (flags & SQL_FLAG_ZLIB)) {
+		return len <= outSize && sqlite3_blob_read(cur->blob, out, len, 0) == SQLITE_OK ? len : -1;
+	}
+
+	if (len > cur->packedSize) {
+		unsigned char *packed = realloc(cur->packed, len);
+		if (packed == NULL) {
+			return -1;
+		}
+		cur->packed = packed;
+		cur->packedSize = len;
+	}
+	if (sqlite3_blob_read(cur->blob, cur->packed, len, 0) != SQLITE_OK) {
+		return -1;
+	}
+	return sql_inflate(cur->packed, len, out, outSize);
+}
+
+/* 1 if a row of a delta coded source is a keyframe.  It's read into the
+   scratch buffer when it's compressed. */
+static int
+sqllog_keyframe(sqllog_cursor_t *cur, sqlite3_int64 id, int flags)
+{
+	unsigned char tag;
+
+	if (flags & SQL_FLAG_ZLIB) {
+		return sqllog_read(cur, id, flags, cur->scratch, cur->scratchSize) > 0 && cur->scratch[0] == 'K';
+	}
+	return sqllog_read(cur, id, flags, &tag, 1) == 1 && tag == 'K';
+}
+
+/* Apply a keyframe or a delta of a delta coded source on top of what its
+   buffer holds */
+static int
+sqllog_apply(sqllog_cursor_t *cur, int source, sqlite3_int64 id, int flags)
+{
+	const sqllog_source_t *src = &((sqllog_vtab_t *)cur->base.pVtab)->table->sources[source];
+	int len = sqllog_read(cur, id, flags, cur->scratch, 1 + src->size);
+
+	cur->dataId[source] = 0;
+	if (len < 1) {
+		return 0;
+	}
+	if (cur->scratch[0] == 'K' && len == 1 + src->size) {
+		memcpy(cur->data[source], cur->scratch + 1, src->size);
+	} else if (cur->scratch[0] != 'D' ||
+	    ! sql_delta_apply(cur->data[source], src->size, cur->scratch, len)) {
+		return 0;
+	}
+	cur->dataId[source] = id;
+	return 1;
+}
+
+/* Bring a delta coded source up to the row before id: walk back to the
+   row its buffer holds or to a keyframe, then forward again */
+static int
+sqllog_rebuild(sqllog_cursor_t *cur, int source, sqlite3_int64 id)
+{
+	sqllog_vtab_t *vtab = (sqllog_vtab_t *)cur->base.pVtab;
+	struct {
+		sqlite3_int64	id;
+		int		flags;
+	} *path = NULL;
+	sqlite3_stmt *stmt;
+	char *sql;
+	int count = 0, max = 0, found = 0;
+	int i, ok = 1;
+
+	sql = sqlite3_mprintf("SELECT id, %s FROM \"%w\".q3log_data WHERE msgid = %d AND id < %lld ORDER BY id DESC",
+	    vtab->flags, vtab->schema, vtab->table->sources[source].msgid, id);
+	if (sql == NULL || sqlite3_prepare_v2(vtab->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+		sqlite3_free(sql);
+		return 0;
+	}
+	sqlite3_free(sql);
+
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		sqlite3_int64 row = sqlite3_column_int64(stmt, 0);
+
+		if (row == cur->dataId[source]) {
+			found = 1;
+			break;
+		}
+		if (count == max) {
+			void *p = realloc(path, (max = max ? 2 * max : 32) * sizeof(*path));
+			if (p == NULL) {
+				break;
+			}
+			path = p;
+		}
+		path[count].id = row;
+		path[count].flags = sqlite3_column_int(stmt, 1);
+		if (sqllog_keyframe(cur, row, path[count++].flags)) {
+			found = 1;
+			break;
+		}
+	}
+	sqlite3_finalize(stmt);
+
+	for (i = count - 1; found && ok && i >= 0; i--) {
+		ok = sqllog_apply(cur, source, path[i].id, path[i].flags);
+	}
+	free(path);
+	return found && ok;
+}
+
+/* The structure of the current row, or NULL */
+static const void *
+sqllog_decode(sqllog_cursor_t *cur)
+{
+	const sqllog_source_t *src = &((sqllog_vtab_t *)cur->base.pVtab)->table->sources[cur->source];
+	int s = cur->source;
+	int flags = sqlite3_column_int(cur->rows, SQLLOG_COL_MAX);
+
+	if (cur->dataId[s] == cur->id) {
+		return cur->data[s];
+	}
+	if (cur->data[s] == NULL && (cur->data[s] = malloc(src->size)) == NULL) {
+		return NULL;
+	}
+
+	if (! src->delta) {
+		cur->dataId[s] = 0;
+		if (sqllog_read(cur, cur->id, flags, cur->data[s], src->size) != src->size) {
+			return NULL;
+		}
+		cur->dataId[s] = cur->id;
+		return cur->data[s];
+	}
+
+	/* A delta on top of a row the query didn't look at */
+	if ((cur->dataId[s] == 0 || cur->dataId[s] != cur->prevId[s]) &&
+	    ! sqllog_keyframe(cur, cur->id, flags) && ! sqllog_rebuild(cur, s, cur->id)) {
+		cur->dataId[s] = 0;
+		return NULL;
+	}
+	return sqllog_apply(cur, s, cur->id, flags) ? cur->data[s] : NULL;
+}
+
+/*
+ * The module
+ */
+
+static int
+sqllog_connect(sqlite3 *db, void *aux, int argc, const char *const *argv, sqlite3_vtab **out, char **err)
+{
+	const sqllog_table_t *table = aux;
+	sqllog_vtab_t *vtab;
+	char *sql;
+	int i, rc;
+
+	sql = sqlite3_mprintf("CREATE TABLE x(id INTEGER, tstamp INTEGER, msgid INTEGER");
+	for (i = 0; sql != NULL && i < table->numColumns; i++) {
+		char *more = sqlite3_mprintf("%s, %s", sql, table->columns[i]);
+		sqlite3_free(sql);
+		sql = more;
+	}
+	if (sql != NULL) {
+		char *more = sqlite3_mprintf("%s)", sql);
+		sqlite3_free(sql);
+		sql = more;
+	}
+	if (sql == NULL) {
+		return SQLITE_NOMEM;
+	}
+	rc = sqlite3_declare_vtab(db, sql);
+	sqlite3_free(sql);
+	if (rc != SQLITE_OK) {
+		return rc;
+	}
+
+	if ((vtab = sqlite3_malloc(sizeof(*vtab))) == NULL) {
+		return SQLITE_NOMEM;
+	}
+	memset(vtab, 0, sizeof(*vtab));
+	vtab->db = db;
+	vtab->table = table;
+	vtab->schema = sqlite3_mprintf("%s", argc > 3 ? argv[3] : "main");
+	if (vtab->schema == NULL) {
+		sqlite3_free(vtab);
+		return SQLITE_NOMEM;
+	}
+
+	/* Only the engine adds the flags column to an older log */
+	vtab->flags = "NULL";
+	if ((sql = sqlite3_mprintf("SELECT flags FROM \"%w\".q3log_data", vtab->schema)) != NULL) {
+		sqlite3_stmt *stmt;
+
+		if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
+			vtab->flags = "flags";
+		}
+		sqlite3_finalize(stmt);
+		sqlite3_free(sql);
+	}
+	*out = &vtab->base;
+	return SQLITE_OK;
+}
+
+static int
+sqllog_disconnect(sqlite3_vtab *base)
+{
+	sqllog_vtab_t *vtab = (sqllog_vtab_t *)base;
+
+	sqlite3_free(vtab->schema);
+	sqlite3_free(vtab);
+	return SQLITE_OK;
+}
+
+/* The id and tstamp constraints that can go into the scan.  idxNum has a
+   bit for each, in this order, and the arguments come in the same order */
+static const struct {
+	int		column;
+	unsigned char	op;
+	const char	*sql;
+} sqllog_constraints[] = {
+	{ SQLLOG_COL_ID, SQLITE_INDEX_CONSTRAINT_EQ, "id = ?" },
+	{ SQLLOG_COL_ID, SQLITE_INDEX_CONSTRAINT_GT, "id > ?" },
+	{ SQLLOG_COL_ID, SQLITE_INDEX_CONSTRAINT_GE, "id >= ?" },
+	{ SQLLOG_COL_ID, SQLITE_INDEX_CONSTRAINT_LT, "id < ?" },
+	{ SQLLOG_COL_ID, SQLITE_INDEX_CONSTRAINT_LE, "id <= ?" },
+	{ SQLLOG_COL_TSTAMP, SQLITE_INDEX_CONSTRAINT_EQ, "tstamp = ?" },
+	{ SQLLOG_COL_TSTAMP, SQLITE_INDEX_CONSTRAINT_GT, "tstamp > ?" },
+	{ SQLLOG_COL_TSTAMP, SQLITE_INDEX_CONSTRAINT_GE, "tstamp >= ?" },
+	{ SQLLOG_COL_TSTAMP, SQLITE_INDEX_CONSTRAINT_LT, "tstamp < ?" },
+	{ SQLLOG_COL_TSTAMP, SQLITE_INDEX_CONSTRAINT_LE, "tstamp <= ?" }
+};
+
+static int
+sqllog_best_index(sqlite3_vtab *base, sqlite3_index_info *info)
+{
+	double cost = 1e6;
+	int i, j, arg = 0;
+
+	info->idxNum = 0;
+	for (j = 0; j < ARRAY_LEN(sqllog_constraints); j++) {
+		for (i = 0; i < info->nConstraint; i++) {
+			const struct sqlite3_index_constraint *c = &info->aConstraint[i];
+
+			if (! c->usable || c->iColumn != sqllog_constraints[j].column || c->op != sqllog_constraints[j].op) {
+				continue;
+			}
+			info->idxNum |= 1 << j;
+			info->aConstraintUsage[i].argvIndex = ++arg;
+			info->aConstraintUsage[i].omit = 1;
+			cost /= sqllog_constraints[j].op == SQLITE_INDEX_CONSTRAINT_EQ ? 1e5 : 4;
+			break;
+		}
+	}
+	info->estimatedCost = cost;
+
+	if (info->nOrderBy == 1 && info->aOrderBy[0].iColumn == SQLLOG_COL_ID && ! info->aOrderBy[0].desc) {
+		info->orderByConsumed = 1;
+	}
+	return SQLITE_OK;
+}
+
+static int
+sqllog_open(sqlite3_vtab *base, sqlite3_vtab_cursor **out)
+{
+	const sqllog_table_t *table = ((sqllog_vtab_t *)base)->table;
+	sqllog_cursor_t *cur;
+	int i;
+
+	if ((cur = sqlite3_malloc(sizeof(*cur))) == NULL) {
+		return SQLITE_NOMEM;
+	}
+	memset(cur, 0, sizeof(*cur));
+	cur->eof = 1;
+
+	for (i = 0; i < SQLLOG_SOURCES; i++) {
+		if (1 + table->sources[i].size > cur->scratchSize) {
+			cur->scratchSize = 1 + table->sources[i].size;
+		}
+	}
+	if ((cur->scratch = malloc(cur->scratchSize)) == NULL) {
+		sqlite3_free(cur);
+		return SQLITE_NOMEM;
+	}
+	*out = &cur->base;
+	return SQLITE_OK;
+}
+
+static int
+sqllog_close(sqlite3_vtab_cursor *base)
+{
+	sqllog_cursor_t *cur = (sqllog_cursor_t *)base;
+	int i;
+
+	sqlite3_finalize(cur->rows);
+	sqlite3_blob_close(cur->blob);
+	for (i = 0; i < SQLLOG_SOURCES; i++) {
+		free(cur->data[i]);
+	}
+	free(cur->scratch);
+	free(cur->packed);
+	sqlite3_free(cur);
+	return SQLITE_OK;
+}
+
+/* Step to the next log row that has a table row */
+static int
+sqllog_step(sqllog_cursor_t *cur)
+{
+	const sqllog_table_t *table = ((sqllog_vtab_t *)cur->base.pVtab)->table;
+	const void *data;
+	int rc, s;
+
+	for (;;) {
+		if (! cur->eof) {
+			cur->prevId[cur->source] = cur->id;
+		}
+		if ((rc = sqlite3_step(cur->rows)) != SQLITE_ROW) {
+			cur->eof = 1;
+			return rc == SQLITE_DONE ? SQLITE_OK : rc;
+		}
+		cur->eof = 0;
+		cur->id = sqlite3_column_int64(cur->rows, SQLLOG_COL_ID);
+		cur->item = 0;
+		for (s = 0; s < SQLLOG_SOURCES - 1; s++) {
+			if (table->sources[s].msgid == sqlite3_column_int(cur->rows, SQLLOG_COL_MSGID)) {
+				break;
+			}
+		}
+		cur->source = s;
+
+		if (table->next == NULL) {
+			return SQLITE_OK;
+		}
+		if ((data = sqllog_decode(cur)) != NULL &&
+		    (cur->item = table->next(data, table->sources[s].type, 0)) >= 0) {
+			return SQLITE_OK;
+		}
+	}
+}
+
+static int
+sqllog_filter(sqlite3_vtab_cursor *base, int idxNum, const char *idxStr, int argc, sqlite3_value **argv)
+{
+	sqllog_cursor_t *cur = (sqllog_cursor_t *)base;
+	sqllog_vtab_t *vtab = (sqllog_vtab_t *)base->pVtab;
+	const sqllog_table_t *table = vtab->table;
+	char *sql;
+	int i, j, rc;
+
+	sqlite3_finalize(cur->rows);
+	cur->rows = NULL;
+	cur->eof = 1;
+	for (i = 0; i < SQLLOG_SOURCES; i++) {
+		cur->prevId[i] = 0;
+	}
+
+	/* length() doesn't read the blob */
+	sql = sqlite3_mprintf("SELECT id, tstamp, msgid, %s FROM \"%w\".q3log_data"
+	    " WHERE length(value) > 0 AND msgid IN (%d", vtab->flags, vtab->schema, table->sources[0].msgid);
+	for (i = 1; sql != NULL && i < SQLLOG_SOURCES && table->sources[i].msgid != 0; i++) {
+		char *more = sqlite3_mprintf("%s, %d", sql, table->sources[i].msgid);
+		sqlite3_free(sql);
+		sql = more;
+	}
+	if (sql != NULL) {
+		char *more = sqlite3_mprintf("%s)", sql);
+		sqlite3_free(sql);
+		sql = more;
+	}
+	for (j = 0; sql != NULL && j < ARRAY_LEN(sqllog_constraints); j++) {
+		if (idxNum & (1 << j)) {
+			char *more = sqlite3_mprintf("%s AND %s", sql, sqllog_constraints[j].sql);
+			sqlite3_free(sql);
+			sql = more;
+		}
+	}
+	if (sql != NULL) {
+		char *more = sqlite3_mprintf("%s ORDER BY id", sql);
+		sqlite3_free(sql);
+		sql = more;
+	}
+	if (sql == NULL) {
+		return SQLITE_NOMEM;
+	}
+	rc = sqlite3_prepare_v2(vtab->db, sql, -1, &cur->rows, NULL);
+	sqlite3_free(sql);
+	if (rc != SQLITE_OK) {
+		return rc;
+	}
+	for (i = 0; i < argc; i++) {
+		sqlite3_bind_value(cur->rows, i + 1, argv[i]);
+	}
+
+	return sqllog_step(cur);
+}
+
+static int
+sqllog_next(sqlite3_vtab_cursor *base)
+{
+	sqllog_cursor_t *cur = (sqllog_cursor_t *)base;
+	const sqllog_table_t *table = ((sqllog_vtab_t *)base->pVtab)->table;
+	const void *data;
+
+	if (table->next != NULL && (data = sqllog_decode(cur)) != NULL &&
+	    (cur->item = table->next(data, table->sources[cur->source].type, cur->item + 1)) >= 0) {
+		return SQLITE_OK;
+	}
+	return sqllog_step(cur);
+}
+
+static int
+sqllog_eof(sqlite3_vtab_cursor *base)
+{
+	return ((sqllog_cursor_t *)base)->eof;
+}
+
+static int
+sqllog_column(sqlite3_vtab_cursor *base, sqlite3_context *ctx, int column)
+{
+	sqllog_cursor_t *cur = (sqllog_cursor_t *)base;
+	const sqllog_table_t *table = ((sqllog_vtab_t *)base->pVtab)->table;
+	const void *data;
+
+	if (column < SQLLOG_COL_MAX) {
+		sqlite3_result_value(ctx, sqlite3_column_value(cur->rows, column));
+	} else if ((data = sqllog_decode(cur)) != NULL) {
+		table->column(ctx, data, table->sources[cur->source].type, cur->item, column - SQLLOG_COL_MAX);
+	}
+	return SQLITE_OK;
+}
+
+static int
+sqllog_rowid(sqlite3_vtab_cursor *base, sqlite3_int64 *rowid)
+{
+	sqllog_cursor_t *cur = (sqllog_cursor_t *)base;
+
+	if (((sqllog_vtab_t *)base->pVtab)->table->next != NULL) {
+		*rowid = (cur->id << SQLLOG_ITEM_BITS) | cur->item;
+	} else {
+		*rowid = cur->id;
+	}
+	return SQLITE_OK;
+}
+
+/* xCreate is xConnect, the tables don't store anything */
+static sqlite3_module sqllog_module = {
+	0,			/* iVersion */
+	sqllog_connect,		/* xCreate */
+	sqllog_connect,		/* xConnect */
+	sqllog_best_index,	/* xBestIndex */
+	sqllog_disconnect,	/* xDisconnect */
+	sqllog_disconnect,	/* xDestroy */
+	sqllog_open,		/* xOpen */
+	sqllog_close,		/* xClose */
+	sqllog_filter,		/* xFilter */
+	sqllog_next,		/* xNext */
+	sqllog_eof,		/* xEof */
+	sqllog_column,		/* xColumn */
+	sqllog_rowid		/* xRowid */
+};
+
+/* Register the q3log virtual table modules on a connection */
+int
+sqllog_register_vtabs(sqlite3 *db)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_LEN(sqllog_tables); i++) {
+		if (sqlite3_create_module(db, sqllog_tables[i].module, &sqllog_module,
+		    (void *)&sqllog_tables[i]) != SQLITE_OK) {
+			return SQLITE_ERROR;
+		}
+	}
+	return SQLITE_OK;
+}
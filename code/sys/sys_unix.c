@@ -38,6 +38,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <fcntl.h>
 #include <fenv.h>
 #include <sys/wait.h>
+#include <ucontext.h>
+#include <pthread.h>
 
 qboolean stdinIsATTY;
 
@@ -483,6 +485,96 @@ void Sys_Sleep( int msec )
 	}
 }
 
+/*
+==================
+Sys_StartSampling
+
+ITIMER_PROF counts CPU time, so the SIGPROF only arrives while the
+process is running, at most once per kernel tick.  It goes to whichever
+thread is running, samples from other threads are dropped.
+==================
+*/
+
+// the program counter and stack pointer from the signal context
+#if defined( __linux__ ) && defined( __x86_64__ )
+	#define SAMPLE_PC( uc )	( (void *)( uc )->uc_mcontext.gregs[ 16 ] )	// REG_RIP
+	#define SAMPLE_SP( uc )	( (void *)( uc )->uc_mcontext.gregs[ 15 ] )	// REG_RSP
+#elif defined( __linux__ ) && defined( __i386__ )
+	#define SAMPLE_PC( uc )	( (void *)( uc )->uc_mcontext.gregs[ 14 ] )	// REG_EIP
+	#define SAMPLE_SP( uc )	( (void *)( uc )->uc_mcontext.gregs[ 7 ] )	// REG_ESP
+#elif defined( __FreeBSD__ ) && defined( __x86_64__ )
+	#define SAMPLE_PC( uc )	( (void *)( uc )->uc_mcontext.mc_rip )
+	#define SAMPLE_SP( uc )	( (void *)( uc )->uc_mcontext.mc_rsp )
+#elif defined( __FreeBSD__ ) && defined( __i386__ )
+	#define SAMPLE_PC( uc )	( (void *)( uc )->uc_mcontext.mc_eip )
+	#define SAMPLE_SP( uc )	( (void *)( uc )->uc_mcontext.mc_esp )
+#elif defined( __APPLE__ ) && defined( __x86_64__ )
+	#define SAMPLE_PC( uc )	( (void *)( uc )->uc_mcontext->__ss.__rip )
+	#define SAMPLE_SP( uc )	( (void *)( uc )->uc_mcontext->__ss.__rsp )
+#elif defined( __APPLE__ ) && defined( __i386__ )
+	#define SAMPLE_PC( uc )	( (void *)( uc )->uc_mcontext->__ss.__eip )
+	#define SAMPLE_SP( uc )	( (void *)( uc )->uc_mcontext->__ss.__esp )
+#else
+	// only the interpreter can be sampled
+	#define SAMPLE_PC( uc )	NULL
+	#define SAMPLE_SP( uc )	NULL
+#endif
+
+static void ( *sampleFunction )( void *pc, void *sp );
+static pthread_t sampleThread;
+
+static void Sys_SampleSignal( int signum, siginfo_t *info, void *context )
+{
+	ucontext_t *uc = context;
+
+	if( pthread_equal( pthread_self( ), sampleThread ) )
+		sampleFunction( SAMPLE_PC( uc ), SAMPLE_SP( uc ) );
+}
+
+qboolean Sys_StartSampling( int hz, void (*sample)( void *pc, void *sp ) )
+{
+	struct sigaction action;
+	struct itimerval timer;
+
+	sampleFunction = sample;
+	sampleThread = pthread_self( );
+
+	memset( &action, 0, sizeof( action ) );
+	action.sa_sigaction = Sys_SampleSignal;
+	action.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset( &action.sa_mask );
+	if( sigaction( SIGPROF, &action, NULL ) )
+		return qfalse;
+
+	// tv_usec has to stay below a second
+	timer.it_interval.tv_sec = 1 / hz;
+	timer.it_interval.tv_usec = ( 1000000 / hz ) % 1000000;
+	timer.it_value = timer.it_interval;
+	if( setitimer( ITIMER_PROF, &timer, NULL ) )
+	{
+		signal( SIGPROF, SIG_IGN );
+		return qfalse;
+	}
+
+	return qtrue;
+}
+
+/*
+==================
+Sys_StopSampling
+==================
+*/
+void Sys_StopSampling( void )
+{
+	struct itimerval timer;
+
+	memset( &timer, 0, sizeof( timer ) );
+	setitimer( ITIMER_PROF, &timer, NULL );
+
+	// one may still be pending
+	signal( SIGPROF, SIG_IGN );
+}
+
 /*
 ==============
 Sys_ErrorDialog
@@ -562,6 +562,27 @@ void Sys_Sleep( int msec )
 #endif
 }
 
+/*
+==================
+Sys_StartSampling
+
+Not done on Windows
+==================
+*/
+qboolean Sys_StartSampling( int hz, void (*sample)( void *pc, void *sp ) )
+{
+	return qfalse;
+}
+
+/*
+==================
+Sys_StopSampling
+==================
+*/
+void Sys_StopSampling( void )
+{
+}
+
 /*
 ==============
 Sys_ErrorDialog